@@ -116,8 +116,14 @@ RunnerFactory.prototype._onForce = function(force) {
 RunnerFactory.prototype._onStart = function() {
   this._debug('Started ' + this.current_runner_);
   
-  // Haptic loop runs every 1ms.
-  this.haptic_interval_ = setInterval(this._onHapticLoop.bind(this), 1, this);
+  // Let the plugin push state changes when it can. Polling every 1ms gets
+  // clamped by the browser and burns CPU even when the tool is still.
+  if (this.haptics_.onState) {
+    this.haptics_.onState(this._onState.bind(this));
+  } else {
+    // Haptic loop runs every 1ms.
+    this.haptic_interval_ = setInterval(this._onHapticLoop.bind(this), 1, this);
+  }
   
   // Renderer loop runs every 30 ms.
   this.render_interval_ = setInterval(this._onRenderLoop.bind(this), 30, this);
@@ -127,6 +133,9 @@ RunnerFactory.prototype._onStart = function() {
  * @private
  */
 RunnerFactory.prototype._onStop = function() {
+  if (this.haptics_.onState) {
+    this.haptics_.onState(null);
+  }
   clearInterval(this.haptic_interval_);
   clearInterval(this.render_interval_);
   this.haptics_.sendForce([0.0, 0.0, 0.0]);
@@ -144,6 +153,19 @@ RunnerFactory.prototype._onHapticLoop = function() {
   this.post({cmd: 'update', position: this.position_});
 };
 
+/**
+ * Called by the plugin whenever the device state changed.
+ * @param {number} x The x position of the device.
+ * @param {number} y The y position of the device.
+ * @param {number} z The z position of the device.
+ * @param {boolean} button Whether the main button is down.
+ * @private
+ */
+RunnerFactory.prototype._onState = function(x, y, z, button) {
+  this.position_ = [x, y, z];
+  this.post({cmd: 'update', position: this.position_});
+};
+
 /**
  * Renderer loop that runs ever 1ms.
  * @private
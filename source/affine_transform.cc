@@ -0,0 +1,92 @@
+// Copyright 2010 Mohamed Mansour. All rights reserved.
+// Use of this source code is governed by a GPL license that can
+// be found in the LICENSE file.
+
+#include "affine_transform.h"
+
+namespace haptics {
+
+AffineTransform::AffineTransform() {
+  SetIdentity();
+}
+
+AffineTransform::AffineTransform(const double matrix[16]) {
+  for (int i = 0; i < 16; i++)
+    matrix_[i] = matrix[i];
+  matrix_[3] = matrix_[7] = matrix_[11] = 0.0;
+  matrix_[15] = 1.0;
+}
+
+void AffineTransform::SetIdentity() {
+  for (int i = 0; i < 16; i++)
+    matrix_[i] = i % 5 == 0 ? 1.0 : 0.0;
+}
+
+void AffineTransform::SetBoxMapping(const double from[6],
+                                    const double to[6],
+                                    bool uniform) {
+  double scale[3];
+  for (int i = 0; i < 3; i++) {
+    double extent = from[i + 3] - from[i];
+    scale[i] = extent != 0.0 ? (to[i + 3] - to[i]) / extent : 1.0;
+  }
+  if (uniform) {
+    double smallest = scale[0];
+    if (scale[1] < smallest) smallest = scale[1];
+    if (scale[2] < smallest) smallest = scale[2];
+    scale[0] = scale[1] = scale[2] = smallest;
+  }
+
+  for (int i = 0; i < 16; i++)
+    matrix_[i] = 0.0;
+  for (int i = 0; i < 3; i++) {
+    double from_center = (from[i] + from[i + 3]) / 2.0;
+    double to_center = (to[i] + to[i + 3]) / 2.0;
+    matrix_[i * 5] = scale[i];
+    matrix_[12 + i] = to_center - scale[i] * from_center;
+  }
+  matrix_[15] = 1.0;
+}
+
+double AffineTransform::Determinant() const {
+  const double* m = matrix_;
+  return m[0] * (m[5] * m[10] - m[9] * m[6]) -
+         m[4] * (m[1] * m[10] - m[9] * m[2]) +
+         m[8] * (m[1] * m[6] - m[5] * m[2]);
+}
+
+bool AffineTransform::Invert(AffineTransform* inverse) const {
+  double determinant = Determinant();
+  if (determinant == 0.0)
+    return false;
+
+  // The inverse of the linear part is its adjugate over the determinant,
+  // and the translation is undone after it.
+  const double* m = matrix_;
+  double* r = inverse->matrix_;
+  double scale = 1.0 / determinant;
+  r[0] = (m[5] * m[10] - m[6] * m[9]) * scale;
+  r[1] = (m[2] * m[9] - m[1] * m[10]) * scale;
+  r[2] = (m[1] * m[6] - m[2] * m[5]) * scale;
+  r[4] = (m[6] * m[8] - m[4] * m[10]) * scale;
+  r[5] = (m[0] * m[10] - m[2] * m[8]) * scale;
+  r[6] = (m[2] * m[4] - m[0] * m[6]) * scale;
+  r[8] = (m[4] * m[9] - m[5] * m[8]) * scale;
+  r[9] = (m[1] * m[8] - m[0] * m[9]) * scale;
+  r[10] = (m[0] * m[5] - m[1] * m[4]) * scale;
+  for (int i = 0; i < 3; i++)
+    r[12 + i] = -(r[i] * m[12] + r[4 + i] * m[13] + r[8 + i] * m[14]);
+  r[3] = r[7] = r[11] = 0.0;
+  r[15] = 1.0;
+  return true;
+}
+
+AffineTransform AffineTransform::LinearPart(double scale) const {
+  AffineTransform linear;
+  for (int i = 0; i < 12; i++)
+    linear.matrix_[i] = matrix_[i] * scale;
+  linear.matrix_[3] = linear.matrix_[7] = linear.matrix_[11] = 0.0;
+  return linear;
+}
+
+}  // namespace haptics
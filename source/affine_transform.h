@@ -0,0 +1,91 @@
+// Copyright 2010 Mohamed Mansour. All rights reserved.
+// Use of this source code is governed by a GPL license that can
+// be found in the LICENSE file.
+
+#ifndef AFFINE_TRANSFORM_H_
+#define AFFINE_TRANSFORM_H_
+#pragma once
+
+#include "simd_ops.h"
+
+namespace haptics {
+
+// Affine map of 3D space as a column-major 4x4 matrix whose last row is
+// 0 0 0 1, the layout OpenGL and HDAL use. The servo thread maps every tool
+// position and force through one, so the kernels are inline and branch free.
+class AffineTransform {
+ public:
+  // The identity.
+  AffineTransform();
+
+  // Takes the 16 numbers of a column-major matrix. The last row is ignored
+  // and taken to be 0 0 0 1.
+  explicit AffineTransform(const double matrix[16]);
+
+  const double* matrix() const { return matrix_; }
+
+  void SetIdentity();
+
+  // Maps the |from| box onto the |to| box, both given as minx, miny, minz,
+  // maxx, maxy, maxz, center onto center. With |uniform| set the same scale
+  // is used on every axis, the smallest one that fits, so shapes keep their
+  // proportions. Equivalent to hdluGenerateHapticToAppWorkspaceTransform.
+  void SetBoxMapping(const double from[6], const double to[6], bool uniform);
+
+  // Determinant of the linear part, the change of volume.
+  double Determinant() const;
+
+  // Stores the inverse in |inverse|. Returns false if there is none.
+  bool Invert(AffineTransform* inverse) const;
+
+  // Drops the translation and scales what is left by |scale|.
+  AffineTransform LinearPart(double scale) const;
+
+  // Maps the point |in| to |out|, which may be the same array.
+  void TransformPoint(const double in[3], double out[3]) const {
+    Transform(in, true, out);
+  }
+
+  // Maps the direction |in| to |out|, ignoring the translation.
+  void TransformVector(const double in[3], double out[3]) const {
+    Transform(in, false, out);
+  }
+
+ private:
+  void Transform(const double in[3], bool point, double out[3]) const {
+    const double* m = matrix_;
+#if defined(HAPTICS_SSE2)
+    // Two lanes hold rows 0 and 1 of a column, a third holds row 2 and the
+    // ignored row 3, so each column is two multiply-adds.
+    __m128d x = _mm_set1_pd(in[0]);
+    __m128d y = _mm_set1_pd(in[1]);
+    __m128d z = _mm_set1_pd(in[2]);
+    __m128d w = _mm_set1_pd(point ? 1.0 : 0.0);
+    __m128d low = _mm_add_pd(
+        _mm_add_pd(_mm_mul_pd(_mm_loadu_pd(m), x),
+                   _mm_mul_pd(_mm_loadu_pd(m + 4), y)),
+        _mm_add_pd(_mm_mul_pd(_mm_loadu_pd(m + 8), z),
+                   _mm_mul_pd(_mm_loadu_pd(m + 12), w)));
+    __m128d high = _mm_add_pd(
+        _mm_add_pd(_mm_mul_pd(_mm_loadu_pd(m + 2), x),
+                   _mm_mul_pd(_mm_loadu_pd(m + 6), y)),
+        _mm_add_pd(_mm_mul_pd(_mm_loadu_pd(m + 10), z),
+                   _mm_mul_pd(_mm_loadu_pd(m + 14), w)));
+    _mm_storeu_pd(out, low);
+    _mm_store_sd(out + 2, high);
+#else
+    double w = point ? 1.0 : 0.0;
+    double x = in[0];
+    double y = in[1];
+    double z = in[2];
+    for (int i = 0; i < 3; i++)
+      out[i] = m[i] * x + m[4 + i] * y + m[8 + i] * z + m[12 + i] * w;
+#endif
+  }
+
+  double matrix_[16];
+};
+
+}  // namespace haptics
+
+#endif  // AFFINE_TRANSFORM_H_
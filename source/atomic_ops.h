@@ -0,0 +1,172 @@
+// Copyright 2010 Mohamed Mansour. All rights reserved.
+// Use of this source code is governed by a GPL license that can
+// be found in the LICENSE file.
+
+#ifndef ATOMIC_OPS_H_
+#define ATOMIC_OPS_H_
+#pragma once
+
+#include <stddef.h>
+#include <stdlib.h>
+
+#include <new>
+
+#if defined(_MSC_VER)
+#include <windows.h>
+#include <intrin.h>
+#include <malloc.h>
+#endif
+
+// Size of a cache line on the x86 processors the Falcon runs with. Data that
+// is written by the servo thread and data that is written by the browser
+// thread must never share a line, otherwise every servo tick would bounce it
+// between cores.
+#define HAPTICS_CACHE_LINE_SIZE 64
+
+#if defined(_MSC_VER)
+#define HAPTICS_CACHE_ALIGNED __declspec(align(64))
+#else
+#define HAPTICS_CACHE_ALIGNED __attribute__((aligned(64)))
+#endif
+
+// Plain operator new only aligns to 16 bytes, so a class that holds
+// HAPTICS_CACHE_ALIGNED members and is allocated with new declares this to
+// get its cache lines.
+#define HAPTICS_CACHE_ALIGNED_NEW \
+  static void* operator new(size_t size) { \
+    void* memory = haptics::AlignedAlloc(size); \
+    if (memory == NULL) \
+      throw std::bad_alloc(); \
+    return memory; \
+  } \
+  static void* operator new(size_t size, const std::nothrow_t&) throw() { \
+    return haptics::AlignedAlloc(size); \
+  } \
+  static void operator delete(void* memory) { \
+    haptics::AlignedFree(memory); \
+  } \
+  static void operator delete(void* memory, const std::nothrow_t&) throw() { \
+    haptics::AlignedFree(memory); \
+  }
+
+namespace haptics {
+
+// Allocates |size| bytes on a cache line boundary, or returns NULL. The
+// memory must be released with AlignedFree.
+inline void* AlignedAlloc(size_t size) {
+#if defined(_MSC_VER)
+  return _aligned_malloc(size, HAPTICS_CACHE_LINE_SIZE);
+#else
+  void* memory;
+  if (posix_memalign(&memory, HAPTICS_CACHE_LINE_SIZE, size) != 0)
+    return NULL;
+  return memory;
+#endif
+}
+
+inline void AlignedFree(void* memory) {
+#if defined(_MSC_VER)
+  _aligned_free(memory);
+#else
+  free(memory);
+#endif
+}
+
+// The minimal set of atomic operations needed to exchange data between the
+// servo thread and the browser thread without locks. Loosely modelled on
+// Chromium's base/atomicops.h.
+#if defined(_MSC_VER)
+typedef LONG Atomic32;
+#else
+typedef int Atomic32;
+#endif
+
+// Atomically stores |new_value| into |*ptr| and returns the previous value.
+// Acts as a full memory barrier.
+inline Atomic32 AtomicExchange(volatile Atomic32* ptr, Atomic32 new_value) {
+#if defined(_MSC_VER)
+  return InterlockedExchange(ptr, new_value);
+#else
+  return __atomic_exchange_n(ptr, new_value, __ATOMIC_SEQ_CST);
+#endif
+}
+
+// Atomically replaces |*ptr| with |new_value| if it currently equals
+// |old_value|. Returns the value |*ptr| held before the operation.
+inline Atomic32 AtomicCompareAndSwap(volatile Atomic32* ptr,
+                                     Atomic32 old_value,
+                                     Atomic32 new_value) {
+#if defined(_MSC_VER)
+  return InterlockedCompareExchange(ptr, new_value, old_value);
+#else
+  __atomic_compare_exchange_n(ptr, &old_value, new_value, false,
+                              __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+  return old_value;
+#endif
+}
+
+// Atomically adds |increment| to |*ptr| and returns the new value.
+inline Atomic32 AtomicIncrement(volatile Atomic32* ptr, Atomic32 increment) {
+#if defined(_MSC_VER)
+  return InterlockedExchangeAdd(ptr, increment) + increment;
+#else
+  return __atomic_add_fetch(ptr, increment, __ATOMIC_SEQ_CST);
+#endif
+}
+
+// Atomically stores |new_value| into |*ptr| and returns the previous pointer.
+// Acts as a full memory barrier.
+inline void* AtomicExchangePointer(void* volatile* ptr, void* new_value) {
+#if defined(_MSC_VER)
+  return InterlockedExchangePointer(ptr, new_value);
+#else
+  return __atomic_exchange_n(ptr, new_value, __ATOMIC_SEQ_CST);
+#endif
+}
+
+// Loads |*ptr|. No later memory access may be reordered before it.
+inline Atomic32 AcquireLoad(volatile const Atomic32* ptr) {
+#if defined(_MSC_VER)
+  Atomic32 value = *ptr;
+  _ReadWriteBarrier();
+  return value;
+#else
+  return __atomic_load_n(ptr, __ATOMIC_ACQUIRE);
+#endif
+}
+
+inline void* AcquireLoadPointer(void* volatile const* ptr) {
+#if defined(_MSC_VER)
+  void* value = *ptr;
+  _ReadWriteBarrier();
+  return value;
+#else
+  return __atomic_load_n(ptr, __ATOMIC_ACQUIRE);
+#endif
+}
+
+// Stores |value| into |*ptr|. No earlier memory access may be reordered
+// after it.
+inline void ReleaseStore(volatile Atomic32* ptr, Atomic32 value) {
+#if defined(_MSC_VER)
+  _ReadWriteBarrier();
+  *ptr = value;
+#else
+  __atomic_store_n(ptr, value, __ATOMIC_RELEASE);
+#endif
+}
+
+// No load after the fence may be reordered before a load ahead of it. x86
+// never reorders loads with one another, so this only restrains the compiler
+// there.
+inline void AcquireFence() {
+#if defined(_MSC_VER)
+  _ReadWriteBarrier();
+#else
+  __atomic_thread_fence(__ATOMIC_ACQUIRE);
+#endif
+}
+
+}  // namespace haptics
+
+#endif  // ATOMIC_OPS_H_
@@ -0,0 +1,121 @@
+// Copyright 2010 Mohamed Mansour. All rights reserved.
+// Use of this source code is governed by a GPL license that can
+// be found in the LICENSE file.
+
+#include "deformable_simulation.h"
+
+#include <math.h>
+
+namespace haptics {
+
+namespace {
+
+// How often the node positions are published, a little faster than the
+// page draws.
+const int64_t kFramePeriodMicroseconds = 16000;
+
+}  // namespace
+
+DeformableSimulation::DeformableSimulation()
+    : body_(NULL),
+      tool_radius_(0.0),
+      contact_stiffness_(0.0),
+      substeps_(1),
+      stop_requested_(0) {
+}
+
+DeformableSimulation::~DeformableSimulation() {
+  Stop();
+  delete body_;
+}
+
+bool DeformableSimulation::Start(MassSpringBody* body,
+                                 double tool_radius,
+                                 double contact_stiffness) {
+  Stop();
+  delete body_;
+  body_ = body;
+  tool_radius_ = tool_radius;
+  contact_stiffness_ = contact_stiffness;
+
+  double step = 1.0 / kStepHz;
+  double substeps = ceil(step / body->StableTimeStep(contact_stiffness));
+  if (substeps > kMaxSubsteps)
+    return false;
+  substeps_ = substeps < 1 ? 1 : static_cast<int>(substeps);
+
+  ReleaseStore(&stop_requested_, 0);
+  return thread_.Start(RunThunk, this);
+}
+
+void DeformableSimulation::Stop() {
+  ReleaseStore(&stop_requested_, 1);
+  thread_.Join();
+}
+
+void DeformableSimulation::SetToolPosition(const double position[3]) {
+  DeformableToolSample* sample = tool_buffer_.write_buffer();
+  for (int i = 0; i < 3; i++)
+    sample->position[i] = position[i];
+  sample->present = true;
+  tool_buffer_.Publish();
+}
+
+const DeformableContact& DeformableSimulation::UpdateContact() {
+  contact_buffer_.Update();
+  return contact_buffer_.read_buffer();
+}
+
+const DeformableFrame& DeformableSimulation::UpdateFrame() {
+  frame_buffer_.Update();
+  return frame_buffer_.read_buffer();
+}
+
+void DeformableSimulation::Run() {
+  const int64_t period = 1000000 / kStepHz;
+  const double substep = 1.0 / kStepHz / substeps_;
+  int64_t deadline = MonotonicMicroseconds();
+  int64_t next_frame = deadline;
+
+  DeformableTool tool;
+  tool.radius = tool_radius_;
+  tool.stiffness = contact_stiffness_;
+
+  while (!AcquireLoad(&stop_requested_)) {
+    tool_buffer_.Update();
+    const DeformableToolSample& sample = tool_buffer_.read_buffer();
+    for (int i = 0; i < 3; i++)
+      tool.position[i] = sample.position[i];
+
+    // The contact is taken where the tool is now, before the body moves,
+    // so its anchor is where the servo thread last saw the tool.
+    DeformableContact* contact = contact_buffer_.write_buffer();
+    for (int i = 0; i < substeps_; i++) {
+      body_->Step(substep, sample.present ? &tool : NULL,
+                  i == 0 ? contact : NULL);
+    }
+    contact_buffer_.Publish();
+
+    int64_t now = MonotonicMicroseconds();
+    if (now >= next_frame) {
+      // The vectors of the three slots keep their memory, so this only
+      // allocates for the first few frames.
+      DeformableFrame* frame = frame_buffer_.write_buffer();
+      frame->positions.clear();
+      body_->GetPositions(&frame->positions);
+      frame_buffer_.Publish();
+      next_frame = now + kFramePeriodMicroseconds;
+    }
+
+    // Keep a steady rate. If we fell more than a full period behind, start
+    // over from now rather than running a burst of steps to catch up.
+    deadline += period;
+    now = MonotonicMicroseconds();
+    if (now > deadline + period)
+      deadline = now;
+    else
+      SleepUntilMicroseconds(deadline);
+  }
+}
+
+}  // namespace haptics
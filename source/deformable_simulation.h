@@ -0,0 +1,99 @@
+// Copyright 2010 Mohamed Mansour. All rights reserved.
+// Use of this source code is governed by a GPL license that can
+// be found in the LICENSE file.
+
+#ifndef DEFORMABLE_SIMULATION_H_
+#define DEFORMABLE_SIMULATION_H_
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "atomic_ops.h"
+#include "haptics_signal.h"
+#include "mass_spring_body.h"
+#include "platform_thread.h"
+#include "triple_buffer.h"
+
+namespace haptics {
+
+// Where the servo thread last saw the tool.
+struct DeformableToolSample {
+  double position[3];
+  // Clear until the servo thread reports the tool.
+  bool present;
+};
+
+// Node positions for display, x, y, z per node.
+struct DeformableFrame {
+  std::vector<double> positions;
+};
+
+// Runs a MassSpringBody on its own thread at kStepHz, coupled to the servo
+// thread through triple buffers: the servo thread reports the tool on every
+// tick and picks up the contact of the latest step, as a local linear model
+// it follows until the next one. Neither thread ever waits for the other,
+// and a body too large for one step per millisecond just steps less often
+// instead of delaying the servo loop. The node positions are published at
+// display rate for the application.
+class DeformableSimulation {
+ public:
+  enum {
+    kStepHz = 1000,
+    // Most substeps a body may need per step to stay stable.
+    kMaxSubsteps = 32
+  };
+
+  HAPTICS_CACHE_ALIGNED_NEW
+
+  // An empty simulation, which renders nothing.
+  DeformableSimulation();
+  // Stops the thread. Virtual like the thread callback HAPTIC_CALLBACK
+  // declares.
+  virtual ~DeformableSimulation();
+
+  // Takes ownership of |body| and starts simulating it with |tool_radius|
+  // and |contact_stiffness|. Returns false if the body is too stiff for
+  // its masses, or the thread could not start.
+  bool Start(MassSpringBody* body,
+             double tool_radius,
+             double contact_stiffness);
+  // Stops the thread. The servo thread may keep calling the methods below,
+  // the contact just no longer changes.
+  void Stop();
+
+  bool empty() const { return body_ == NULL; }
+
+  // Servo thread: reports the tool, in the coordinates of the body.
+  void SetToolPosition(const double position[3]);
+  // Servo thread: returns the contact of the latest step.
+  const DeformableContact& UpdateContact();
+
+  // Application thread: returns the latest node positions, empty until the
+  // first frame is out.
+  const DeformableFrame& UpdateFrame();
+
+ private:
+  HAPTIC_CALLBACK(DeformableSimulation, void, Run);
+
+  MassSpringBody* body_;
+  double tool_radius_;
+  double contact_stiffness_;
+  int substeps_;
+
+  PlatformThread thread_;
+  volatile Atomic32 stop_requested_;
+
+  TripleBuffer<DeformableToolSample> tool_buffer_;
+  TripleBuffer<DeformableContact> contact_buffer_;
+  TripleBuffer<DeformableFrame> frame_buffer_;
+
+  DeformableSimulation(const DeformableSimulation&);
+  void operator=(const DeformableSimulation&);
+};
+
+}  // namespace haptics
+
+#endif  // DEFORMABLE_SIMULATION_H_
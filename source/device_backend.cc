@@ -0,0 +1,53 @@
+// Copyright 2010 Mohamed Mansour. All rights reserved.
+// Use of this source code is governed by a GPL license that can
+// be found in the LICENSE file.
+
+#include "device_backend.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+#if defined(_WIN32)
+#include "hdal_backend.h"
+#endif
+#include "replay_backend.h"
+#include "simulated_backend.h"
+
+namespace haptics {
+
+// The simulated backend is configured through the environment so the plugin
+// can be benchmarked without changing the page:
+//   HAPTICS_DEVICE=simulated            selects the simulated device.
+//   HAPTICS_SIMULATED_RATE=4000         servo rate in Hz, 1000 by default.
+//   HAPTICS_SIMULATED_SCRIPT=path.txt   trajectory to replay, see LoadScript.
+//   HAPTICS_SIMULATED_DEVICES=2         number of devices, 1 by default.
+// Recordings are replayed the same way:
+//   HAPTICS_DEVICE=replay               selects the replay backend.
+//   HAPTICS_REPLAY_FILE=path            file written by startRecording.
+//   HAPTICS_REPLAY_SPEED=10             speed up, 0 for as fast as possible.
+DeviceBackend* DeviceBackend::Create() {
+  const char* device = getenv("HAPTICS_DEVICE");
+  const char* replay_file = getenv("HAPTICS_REPLAY_FILE");
+  if (device && strcmp(device, "replay") == 0 && replay_file) {
+    const char* speed = getenv("HAPTICS_REPLAY_SPEED");
+    return new ReplayBackend(replay_file, speed ? atof(speed) : 1.0);
+  }
+
+#if defined(_WIN32)
+  if (device == NULL || strcmp(device, "simulated") != 0)
+    return new HdalBackend();
+#endif
+
+  const char* rate = getenv("HAPTICS_SIMULATED_RATE");
+  const char* devices = getenv("HAPTICS_SIMULATED_DEVICES");
+  SimulatedBackend* backend =
+      new SimulatedBackend(rate ? atoi(rate) : SimulatedBackend::kMinRateHz,
+                           devices ? atoi(devices) : 1);
+
+  const char* script = getenv("HAPTICS_SIMULATED_SCRIPT");
+  if (script)
+    backend->LoadScript(script);
+  return backend;
+}
+
+}  // namespace haptics
@@ -0,0 +1,73 @@
+// Copyright 2010 Mohamed Mansour. All rights reserved.
+// Use of this source code is governed by a GPL license that can
+// be found in the LICENSE file.
+
+#ifndef DEVICE_BACKEND_H_
+#define DEVICE_BACKEND_H_
+#pragma once
+
+#include <stdint.h>
+
+#include "haptics_signal.h"
+#include "platform_thread.h"
+
+namespace haptics {
+
+// Return value of a servo operation, mirrors HDLServoOpExitCode.
+enum ServoOpExitCode {
+  SERVOOP_CONTINUE,
+  SERVOOP_EXIT
+};
+
+// Function called by the backend once per servo tick, on the servo thread.
+typedef ServoOpExitCode (*ServoOp)(hpointer data);
+
+// Abstraction over the driver that talks to the physical devices. The HDAL
+// backend drives Novint Falcons, the simulated backend runs the same servo
+// loop without any hardware so the force path can be exercised anywhere.
+//
+// A backend serves every device attached to the machine from a single servo
+// thread. Like HDAL, it has a current device that the tool accessors refer
+// to, which the servo operation switches between devices.
+class DeviceBackend {
+ public:
+  virtual ~DeviceBackend() {}
+
+  // Number of devices attached, at least 1. May be called before Open().
+  virtual int CountDevices() = 0;
+
+  // Opens the |device_count| devices CountDevices() reported. Returns false
+  // if one could not be opened, or if devices were attached or removed since
+  // they were counted.
+  virtual bool Open(int device_count) = 0;
+  virtual void Close() = 0;
+
+  // Starts the servo thread, which calls |op| with |data| every tick until
+  // Stop() is called or |op| returns SERVOOP_EXIT.
+  virtual bool Start(ServoOp op, hpointer data) = 0;
+  virtual void Stop() = 0;
+
+  // Extents of the workspace of |device| as minx, miny, minz, maxx, maxy,
+  // maxz. Only valid while the devices are open.
+  virtual void GetWorkspace(int device, double workspace[6]) = 0;
+
+  // These may only be called from within the servo operation. The tool
+  // accessors refer to the device last passed to MakeCurrent().
+  virtual void MakeCurrent(int device) = 0;
+  virtual void GetToolPosition(double position[3]) = 0;
+  virtual void GetToolButton(bool* button) = 0;
+  virtual void SetToolForce(const double force[3]) = 0;
+
+  // Time of the current tick for the servo loop, MonotonicMicroseconds()
+  // unless the backend replays time of its own.
+  virtual int64_t Now() { return MonotonicMicroseconds(); }
+
+  // Creates the backend selected by the HAPTICS_DEVICE environment variable,
+  // "hdal" (the default on Windows), "simulated" (the default elsewhere) or
+  // "replay".
+  static DeviceBackend* Create();
+};
+
+}  // namespace haptics
+
+#endif  // DEVICE_BACKEND_H_
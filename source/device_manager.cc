@@ -0,0 +1,346 @@
+// Copyright 2010 Mohamed Mansour. All rights reserved.
+// Use of this source code is governed by a GPL license that can
+// be found in the LICENSE file.
+
+#include "device_manager.h"
+
+#include <stddef.h>
+#include <stdlib.h>
+
+#include <iostream>
+#include <vector>
+
+#include "platform_thread.h"
+
+namespace haptics {
+
+namespace {
+
+// How long WaitForTick waits for the servo thread to finish a tick before
+// giving up on it.
+const int64_t kTickTimeoutMicroseconds = 1000000;
+
+}  // namespace
+
+// Only touched on the plugin thread, which every instance shares.
+DeviceManager* DeviceManager::instance_ = NULL;
+int DeviceManager::references_ = 0;
+DeviceManager::BackendFactory DeviceManager::backend_factory_ =
+    DeviceBackend::Create;
+
+// static
+DeviceManager* DeviceManager::Acquire() {
+  if (instance_ == NULL)
+    instance_ = new DeviceManager(backend_factory_());
+  references_++;
+  return instance_;
+}
+
+// static
+void DeviceManager::SetBackendFactoryForTesting(BackendFactory create) {
+  backend_factory_ = create ? create : DeviceBackend::Create;
+}
+
+void DeviceManager::Release() {
+  if (--references_ > 0)
+    return;
+  instance_ = NULL;
+  delete this;
+}
+
+DeviceManager::DeviceManager(DeviceBackend* backend)
+    : backend_(backend),
+      devices_(NULL),
+      device_count_(backend->CountDevices()),
+      hardware_state_(HARDWARE_CLOSED),
+      open_status_(DEVICE_OK),
+      recorder_(NULL),
+      telemetry_(NULL),
+      last_tick_start_(0),
+      last_tick_execution_us_(0),
+      ticks_(0) {
+  if (device_count_ < 1)
+    device_count_ = 1;
+  devices_ = new Device[device_count_];
+  for (int i = 0; i < device_count_; i++) {
+    for (int j = 0; j < kMaxClients; j++)
+      devices_[i].clients[j] = NULL;
+  }
+
+  const char* telemetry_name = getenv("HAPTICS_TELEMETRY");
+  if (telemetry_name && *telemetry_name) {
+    telemetry_ = new TelemetryPublisher;
+    if (!telemetry_->Open(telemetry_name, device_count_)) {
+      std::cout << "Telemetry Failure: Could not create channel.";
+      delete telemetry_;
+      telemetry_ = NULL;
+    }
+  }
+}
+
+DeviceManager::~DeviceManager() {
+  opener_.Join();
+  if (AcquireLoad(&hardware_state_) == HARDWARE_RUNNING) {
+    backend_->Stop();
+    backend_->Close();
+  }
+  delete static_cast<TrajectoryRecorder*>(recorder_);
+  delete telemetry_;
+  delete[] devices_;
+  delete backend_;
+}
+
+bool DeviceManager::AddClient(int index, HapticsDevice* client) {
+  void* volatile* clients = devices_[index].clients;
+  for (int i = 0; i < kMaxClients; i++) {
+    if (clients[i] == NULL) {
+      AtomicExchangePointer(&clients[i], client);
+      return true;
+    }
+  }
+  return false;
+}
+
+bool DeviceManager::RemoveClient(HapticsDevice* client) {
+  int index = FindClient(client);
+  if (index < 0)
+    return true;
+  void* volatile* clients = devices_[index].clients;
+  for (int i = 0; i < kMaxClients; i++) {
+    if (clients[i] == client)
+      AtomicExchangePointer(&clients[i], NULL);
+  }
+
+  // The opener thread may be about to notify the client, and a tick that
+  // started before the slot was cleared may still be using it. Ticks are a
+  // millisecond long, so just wait for them to end.
+  opener_.Join();
+  if (!WaitForTick()) {
+    std::cout << "Device Failure: Servo thread stopped ticking.";
+    return false;
+  }
+  return true;
+}
+
+bool DeviceManager::WaitForTick() {
+  if (AcquireLoad(&hardware_state_) != HARDWARE_RUNNING)
+    return true;
+  Atomic32 ticks = AcquireLoad(&ticks_);
+  int64_t deadline = MonotonicMicroseconds() + kTickTimeoutMicroseconds;
+  while (AcquireLoad(&ticks_) == ticks) {
+    int64_t now = MonotonicMicroseconds();
+    if (now >= deadline)
+      return false;
+    SleepUntilMicroseconds(now + 100);
+  }
+  return true;
+}
+
+bool DeviceManager::StartRecording(const std::string& path) {
+  if (AcquireLoad(&hardware_state_) != HARDWARE_RUNNING || recorder_)
+    return false;
+
+  // The workspaces go in the file so a replay reports the same ones.
+  std::vector<double> workspaces(device_count_ * 6);
+  for (int i = 0; i < device_count_; i++)
+    backend_->GetWorkspace(i, &workspaces[i * 6]);
+
+  TrajectoryRecorder* recorder = new TrajectoryRecorder;
+  if (!recorder->Open(path, device_count_, &workspaces[0])) {
+    delete recorder;
+    return false;
+  }
+  AtomicExchangePointer(&recorder_, recorder);
+  return true;
+}
+
+int64_t DeviceManager::StopRecording() {
+  TrajectoryRecorder* recorder = static_cast<TrajectoryRecorder*>(
+      AtomicExchangePointer(&recorder_, NULL));
+  if (recorder == NULL)
+    return -1;
+  // A stuck tick may still be writing to the recorder, so it is left open
+  // rather than freed under the servo thread.
+  if (!WaitForTick())
+    return -1;
+  recorder->Close();
+  int64_t record_count = recorder->record_count();
+  delete recorder;
+  return record_count;
+}
+
+DeviceStatus DeviceManager::StartClient(HapticsDevice* client) {
+  int index = FindClient(client);
+  if (index < 0)
+    return DEVICE_BUSY;
+  if (client->running())
+    return DEVICE_OK;
+
+  switch (AcquireLoad(&hardware_state_)) {
+    case HARDWARE_RUNNING:
+      StartOnDevice(index, client);
+      return DEVICE_OK;
+    case HARDWARE_CLOSED:
+      // Reap the thread of an earlier attempt that failed.
+      opener_.Join();
+      ReleaseStore(&hardware_state_, HARDWARE_OPENING);
+      if (!opener_.Start(OpenDevicesThunk, this)) {
+        ReleaseStore(&hardware_state_, HARDWARE_CLOSED);
+        return DEVICE_OPEN_FAILED;
+      }
+      return DEVICE_STARTING;
+    default:
+      return DEVICE_STARTING;
+  }
+}
+
+DeviceStatus DeviceManager::FinishStart(HapticsDevice* client) {
+  int index = FindClient(client);
+  if (index < 0)
+    return DEVICE_BUSY;
+  if (client->running())
+    return DEVICE_OK;
+
+  switch (AcquireLoad(&hardware_state_)) {
+    case HARDWARE_RUNNING:
+      StartOnDevice(index, client);
+      return DEVICE_OK;
+    case HARDWARE_CLOSED:
+      return static_cast<DeviceStatus>(AcquireLoad(&open_status_));
+    default:
+      return DEVICE_STARTING;
+  }
+}
+
+void DeviceManager::StartOnDevice(int index, HapticsDevice* client) {
+  double haptic_workspace[6];
+  backend_->GetWorkspace(index, haptic_workspace);
+  client->OnStarted(haptic_workspace);
+}
+
+void DeviceManager::OpenDevices() {
+  DeviceStatus status = DEVICE_OK;
+  if (!backend_->Open(device_count_)) {
+    std::cout << "Device Failure: Could not open device.";
+    status = DEVICE_OPEN_FAILED;
+  } else if (!backend_->Start(OnServoTickThunk, this)) {
+    std::cout << "Device Failure: Invalid servo operation.";
+    backend_->Close();
+    status = DEVICE_SERVO_FAILED;
+  }
+  ReleaseStore(&open_status_, status);
+  ReleaseStore(&hardware_state_,
+               status == DEVICE_OK ? HARDWARE_RUNNING : HARDWARE_CLOSED);
+
+  // Clients attach and detach on the plugin thread while we run, but
+  // RemoveClient waits for us before a client can go away.
+  for (int i = 0; i < device_count_; i++) {
+    for (int j = 0; j < kMaxClients; j++) {
+      HapticsDevice* client = static_cast<HapticsDevice*>(
+          AcquireLoadPointer(&devices_[i].clients[j]));
+      if (client)
+        client->NotifyStartFinished();
+    }
+  }
+}
+
+void DeviceManager::StopClient(HapticsDevice* client) {
+  client->OnStopped();
+}
+
+int DeviceManager::FindClient(HapticsDevice* client) const {
+  for (int i = 0; i < device_count_; i++) {
+    for (int j = 0; j < kMaxClients; j++) {
+      if (devices_[i].clients[j] == client)
+        return i;
+    }
+  }
+  return -1;
+}
+
+ServoOpExitCode DeviceManager::OnServoTick() {
+  int64_t now = backend_->Now();
+  // The servo clock of a replay runs at its own pace, the health of the
+  // loop is timed on the wall clock.
+  int64_t tick_start = telemetry_ ? MonotonicMicroseconds() : 0;
+  int period_us = last_tick_start_ ?
+      static_cast<int>(tick_start - last_tick_start_) : 0;
+  TrajectoryRecorder* recorder =
+      static_cast<TrajectoryRecorder*>(AcquireLoadPointer(&recorder_));
+
+  for (int i = 0; i < device_count_; i++) {
+    backend_->MakeCurrent(i);
+
+    // Pick the running clients and the priority that gets to be felt.
+    HapticsDevice* clients[kMaxClients];
+    int priorities[kMaxClients];
+    int client_count = 0;
+    int top_priority = 0;
+    for (int j = 0; j < kMaxClients; j++) {
+      HapticsDevice* client = static_cast<HapticsDevice*>(
+          AcquireLoadPointer(&devices_[i].clients[j]));
+      if (client == NULL || !client->running())
+        continue;
+      int priority = client->priority();
+      if (client_count == 0 || priority > top_priority)
+        top_priority = priority;
+      clients[client_count] = client;
+      priorities[client_count] = priority;
+      client_count++;
+    }
+
+    double force[3] = { 0.0, 0.0, 0.0 };
+    if (client_count == 0 && recorder == NULL && telemetry_ == NULL) {
+      backend_->SetToolForce(force);
+      continue;
+    }
+
+    // Get current state of haptic device, once for every client.
+    double position[3];
+    bool button;
+    backend_->GetToolPosition(position);
+    backend_->GetToolButton(&button);
+
+    for (int j = 0; j < client_count; j++) {
+      double client_force[3];
+      clients[j]->ServoTick(now, position, button, client_force);
+      if (priorities[j] != top_priority)
+        continue;
+      for (int k = 0; k < 3; k++)
+        force[k] += client_force[k];
+    }
+
+    // Send forces to device
+    backend_->SetToolForce(force);
+    for (int j = 0; j < client_count; j++)
+      clients[j]->FinishTick(now, force);
+    if (recorder)
+      recorder->Record(now, i, button, position, force);
+    if (telemetry_) {
+      TelemetryRecord* record = telemetry_->BeginRecord();
+      record->device = i;
+      record->time_us = now;
+      record->button = button ? 1 : 0;
+      record->client_count = client_count;
+      for (int k = 0; k < 3; k++) {
+        record->position[k] = position[k];
+        record->force[k] = force[k];
+      }
+      record->period_us = period_us;
+      record->execution_us = last_tick_execution_us_;
+      telemetry_->EndRecord();
+    }
+  }
+
+  if (telemetry_) {
+    last_tick_start_ = tick_start;
+    last_tick_execution_us_ =
+        static_cast<int>(MonotonicMicroseconds() - tick_start);
+  }
+  AtomicIncrement(&ticks_, 1);
+
+  // Make sure to continue processing
+  return SERVOOP_CONTINUE;
+}
+
+}  // namespace haptics
@@ -0,0 +1,169 @@
+// Copyright 2010 Mohamed Mansour. All rights reserved.
+// Use of this source code is governed by a GPL license that can
+// be found in the LICENSE file.
+
+#ifndef DEVICE_MANAGER_H_
+#define DEVICE_MANAGER_H_
+#pragma once
+
+#include <stdint.h>
+
+#include <string>
+
+#include "atomic_ops.h"
+#include "device_backend.h"
+#include "haptics_device.h"
+#include "haptics_signal.h"
+#include "platform_thread.h"
+#include "telemetry_channel.h"
+#include "trajectory_recorder.h"
+
+namespace haptics {
+
+// Outcome of starting a client.
+enum DeviceStatus {
+  DEVICE_OK,
+  // The devices are being opened on a background thread.
+  DEVICE_STARTING,
+  // No device could be opened.
+  DEVICE_OPEN_FAILED,
+  // The devices opened but the servo thread did not start.
+  DEVICE_SERVO_FAILED,
+  // The device already has DeviceManager::kMaxClients clients.
+  DEVICE_BUSY,
+  // The client was stopped before it finished starting.
+  DEVICE_STOPPED
+};
+
+// Every device attached to the machine, shared by all plugin instances in the
+// process. The HDAL servo thread is process-wide, so instances that each
+// started and stopped it would stop it for one another; instead each one
+// attaches to the single manager as a client of the devices it uses.
+//
+// A client is a HapticsDevice with its own force pipeline. On every tick the
+// manager reads each device once, runs the tick of every running client of
+// that device, and sends the device the sum of the forces of the running
+// clients with the highest priority. Devices are serviced back to back by
+// the one servo thread, which keeps running from the first start until the
+// last instance lets go of the manager.
+//
+// With HAPTICS_TELEMETRY set in the environment, every tick of every device
+// is also published to the telemetry channel of that name, see
+// TelemetryPublisher, for other processes to follow.
+class DeviceManager {
+ public:
+  enum { kMaxClients = 8 };
+
+  HAPTICS_CACHE_ALIGNED_NEW
+
+  // Returns the manager, creating it for the first caller. Every Acquire()
+  // is matched by a Release(); the last one stops the servo thread and
+  // closes the devices. Plugin thread only.
+  static DeviceManager* Acquire();
+  void Release();
+
+  // Makes the next manager created by Acquire() use the backend |create|
+  // returns instead of DeviceBackend::Create(), or that again if |create| is
+  // NULL. Lets tests fail the backend in ways real devices rarely do.
+  typedef DeviceBackend* (*BackendFactory)();
+  static void SetBackendFactoryForTesting(BackendFactory create);
+
+  // There is always at least one device, so pages written for a single
+  // device keep working when none is attached.
+  int device_count() const { return device_count_; }
+
+  // Attaches |client| to the device at |index|. Returns false if that
+  // device already has kMaxClients clients.
+  bool AddClient(int index, HapticsDevice* client);
+  // Detaches |client|. Once this returns true the servo thread no longer
+  // uses it. Returns false if the servo thread is stuck in a tick that may
+  // still use it, in which case |client| must not be freed.
+  bool RemoveClient(HapticsDevice* client);
+
+  // Starts rendering the forces of |client|. Opening the devices and
+  // starting the servo thread can take seconds, so the first start does it
+  // on a background thread and returns DEVICE_STARTING. Once that is over
+  // every client's start notifier is called on that thread, and the caller
+  // finishes with FinishStart() back on the plugin thread.
+  DeviceStatus StartClient(HapticsDevice* client);
+  // Starts |client| now that the devices are open, or returns why they could
+  // not be opened.
+  DeviceStatus FinishStart(HapticsDevice* client);
+  // Stops rendering the forces of |client|. The servo thread keeps running
+  // for the other clients.
+  void StopClient(HapticsDevice* client);
+
+  // Records every tick of every device to |path|, see TrajectoryRecorder,
+  // until StopRecording(). The devices must be running. Returns false if
+  // they are not, a recording is already going on, or |path| cannot be
+  // written.
+  bool StartRecording(const std::string& path);
+  // Returns the number of records written, or -1 if nothing was recorded or
+  // the servo thread is stuck in a tick.
+  int64_t StopRecording();
+
+ private:
+  // Client slots of one device, HapticsDevice pointers or NULL. Written by
+  // the plugin thread, read by the servo thread.
+  struct Device {
+    void* volatile clients[kMaxClients];
+  };
+
+  // Takes ownership of |backend|.
+  explicit DeviceManager(DeviceBackend* backend);
+  // Virtual like the servo callbacks HAPTIC_CALLBACK declares.
+  virtual ~DeviceManager();
+
+  // Where the devices are at, written by the plugin thread before it starts
+  // the opener thread and by the opener thread when it is done.
+  enum HardwareState {
+    HARDWARE_CLOSED,
+    HARDWARE_OPENING,
+    HARDWARE_RUNNING
+  };
+
+  HAPTIC_CALLBACK(DeviceManager, ServoOpExitCode, OnServoTick);
+  // Opens the devices and starts the servo thread, on |opener_|.
+  HAPTIC_CALLBACK(DeviceManager, void, OpenDevices);
+
+  // Index of the device |client| is attached to, or -1.
+  int FindClient(HapticsDevice* client) const;
+  // Starts |client| on the open device at |index|.
+  void StartOnDevice(int index, HapticsDevice* client);
+  // Waits until a tick that may have started before now is over. Returns
+  // false if none ends within a second, a thousand ticks.
+  bool WaitForTick();
+
+  static DeviceManager* instance_;
+  static int references_;
+  static BackendFactory backend_factory_;
+
+  DeviceBackend* backend_;
+  Device* devices_;
+  // Counted once when the manager is created; opening the devices fails if
+  // the backend no longer sees as many.
+  int device_count_;
+
+  PlatformThread opener_;
+  volatile Atomic32 hardware_state_;
+  // Outcome of the last attempt to open the devices.
+  volatile Atomic32 open_status_;
+
+  // TrajectoryRecorder the servo thread writes to, or NULL.
+  void* volatile recorder_;
+
+  // Set up before the servo thread starts, NULL without HAPTICS_TELEMETRY.
+  TelemetryPublisher* telemetry_;
+  // Wall clock timing of the previous tick, for the telemetry. Servo thread
+  // only.
+  int64_t last_tick_start_;
+  int last_tick_execution_us_;
+
+  // Bumped by the servo thread after every tick, so RemoveClient can tell
+  // when a tick that may have seen the client is over.
+  HAPTICS_CACHE_ALIGNED volatile Atomic32 ticks_;
+};
+
+}  // namespace haptics
+
+#endif  // DEVICE_MANAGER_H_
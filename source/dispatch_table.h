@@ -0,0 +1,88 @@
+// Copyright 2010 Mohamed Mansour. All rights reserved.
+// Use of this source code is governed by a GPL license that can
+// be found in the LICENSE file.
+
+#ifndef DISPATCH_TABLE_H_
+#define DISPATCH_TABLE_H_
+#pragma once
+
+#include <algorithm>
+#include <functional>
+
+#include "npapi.h"
+#include "npfunctions.h"
+
+namespace haptics {
+
+// Maps identifiers interned by NPN_GetStringIdentifier to handlers. The
+// browser hands out the same identifier for a name for the life of the
+// process, so a table is filled once, sorted, and then shared by every
+// plugin instance. Lookups are a binary search over one small contiguous
+// array instead of a walk through heap-allocated map nodes.
+template <typename Selector, int kCapacity>
+class DispatchTable {
+ public:
+  DispatchTable() : size_(0), sealed_(false), overflowed_(false) {}
+
+  // Registers |selector| for |name|. Entries that do not fit are dropped and
+  // reported by Seal().
+  void Add(NPIdentifier name, Selector selector) {
+    if (sealed_ || size_ == kCapacity) {
+      overflowed_ = true;
+      return;
+    }
+    entries_[size_].name = name;
+    entries_[size_].selector = selector;
+    size_++;
+  }
+
+  // Sorts the entries. Call once after the last Add, before any Find.
+  // Returns false if an entry was dropped.
+  bool Seal() {
+    std::sort(entries_, entries_ + size_, EntryLess());
+    sealed_ = true;
+    return !overflowed_;
+  }
+
+  bool sealed() const { return sealed_; }
+
+  // Looks up |name|. Returns false if it has no handler.
+  bool Find(NPIdentifier name, Selector* selector) const {
+    std::less<NPIdentifier> less;
+    int low = 0;
+    int high = size_;
+    while (low < high) {
+      int middle = (low + high) / 2;
+      if (less(entries_[middle].name, name))
+        low = middle + 1;
+      else
+        high = middle;
+    }
+    if (low == size_ || entries_[low].name != name)
+      return false;
+    if (selector)
+      *selector = entries_[low].selector;
+    return true;
+  }
+
+ private:
+  struct Entry {
+    NPIdentifier name;
+    Selector selector;
+  };
+
+  struct EntryLess {
+    bool operator()(const Entry& a, const Entry& b) const {
+      return std::less<NPIdentifier>()(a.name, b.name);
+    }
+  };
+
+  Entry entries_[kCapacity];
+  int size_;
+  bool sealed_;
+  bool overflowed_;
+};
+
+}  // namespace haptics
+
+#endif  // DISPATCH_TABLE_H_
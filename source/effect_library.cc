@@ -0,0 +1,329 @@
+// Copyright 2010 Mohamed Mansour. All rights reserved.
+// Use of this source code is governed by a GPL license that can
+// be found in the LICENSE file.
+
+#include "effect_library.h"
+
+#include <math.h>
+
+namespace haptics {
+
+namespace {
+
+// One period of each waveform, with the first sample repeated at the end so
+// lookups can interpolate without wrapping.
+class Wavetables {
+ public:
+  enum { kSize = 256 };
+
+  Wavetables() {
+    const double kPi = 3.14159265358979323846;
+    for (int i = 0; i <= kSize; i++) {
+      double phase = static_cast<double>(i % kSize) / kSize;
+      sine[i] = sin(2.0 * kPi * phase);
+      square[i] = phase < 0.5 ? 1.0 : -1.0;
+      saw[i] = 2.0 * phase - 1.0;
+    }
+  }
+
+  double sine[kSize + 1];
+  double square[kSize + 1];
+  double saw[kSize + 1];
+};
+
+// Filled during static initialization, long before any servo thread runs.
+const Wavetables g_wavetables;
+
+// Value of |table| at |phase| in [0, 1).
+inline double LookUp(const double* table, double phase) {
+  double position = phase * Wavetables::kSize;
+  int index = static_cast<int>(position);
+  // Rounding can land a phase just below 0 on exactly 1.
+  if (index >= Wavetables::kSize)
+    index = Wavetables::kSize - 1;
+  double fraction = position - index;
+  return table[index] + fraction * (table[index + 1] - table[index]);
+}
+
+struct EffectInput {
+  int64_t now;
+  const double* position;
+  const double* velocity;
+  double speed;
+};
+
+inline double Clamp01(double value) {
+  return value < 0.0 ? 0.0 : (value > 1.0 ? 1.0 : value);
+}
+
+// 1 while |effect| is running, 0 otherwise. Every kernel scales its force by
+// this instead of skipping, so a group is evaluated without branches.
+inline double ActiveGain(const HapticEffect& effect, int64_t now) {
+  bool started = now >= effect.start_us;
+  bool stopped = effect.stop_us != 0 && now >= effect.stop_us;
+  return static_cast<double>(started & !stopped);
+}
+
+inline double SecondsSinceStart(const HapticEffect& effect, int64_t now) {
+  return (now - effect.start_us) * 1e-6;
+}
+
+// The force of one effect of type |kType|, scaled by |gain|. Specialized
+// below for every type.
+template <EffectType kType>
+struct EffectKernel {
+  static void Apply(const HapticEffect& effect,
+                    const EffectInput& input,
+                    double gain,
+                    double force[3]);
+};
+
+template <>
+struct EffectKernel<EFFECT_SPRING> {
+  static void Apply(const HapticEffect& effect, const EffectInput& input,
+                    double gain, double force[3]) {
+    double scale = gain * effect.params[3];
+    for (int i = 0; i < 3; i++)
+      force[i] += scale * (effect.params[i] - input.position[i]);
+  }
+};
+
+template <>
+struct EffectKernel<EFFECT_DAMPER> {
+  static void Apply(const HapticEffect& effect, const EffectInput& input,
+                    double gain, double force[3]) {
+    double scale = gain * effect.params[0];
+    for (int i = 0; i < 3; i++)
+      force[i] -= scale * input.velocity[i];
+  }
+};
+
+template <>
+struct EffectKernel<EFFECT_CONSTANT> {
+  static void Apply(const HapticEffect& effect, const EffectInput& /* input */,
+                    double gain, double force[3]) {
+    for (int i = 0; i < 3; i++)
+      force[i] += gain * effect.params[i];
+  }
+};
+
+template <>
+struct EffectKernel<EFFECT_RAMP> {
+  static void Apply(const HapticEffect& effect, const EffectInput& input,
+                    double gain, double force[3]) {
+    double progress = Clamp01(
+        static_cast<double>(input.now - effect.start_us) /
+        static_cast<double>(effect.stop_us - effect.start_us));
+    for (int i = 0; i < 3; i++) {
+      double from = effect.params[i];
+      double to = effect.params[i + 3];
+      force[i] += gain * (from + progress * (to - from));
+    }
+  }
+};
+
+// Shared by the periodic types, which only differ in their table.
+inline void ApplyPeriodic(const double* table,
+                          const HapticEffect& effect,
+                          const EffectInput& input,
+                          double gain,
+                          double force[3]) {
+  double cycles = SecondsSinceStart(effect, input.now) * effect.params[3];
+  double scale = gain * LookUp(table, cycles - floor(cycles));
+  for (int i = 0; i < 3; i++)
+    force[i] += scale * effect.params[i];
+}
+
+template <>
+struct EffectKernel<EFFECT_SINE> {
+  static void Apply(const HapticEffect& effect, const EffectInput& input,
+                    double gain, double force[3]) {
+    ApplyPeriodic(g_wavetables.sine, effect, input, gain, force);
+  }
+};
+
+template <>
+struct EffectKernel<EFFECT_SQUARE> {
+  static void Apply(const HapticEffect& effect, const EffectInput& input,
+                    double gain, double force[3]) {
+    ApplyPeriodic(g_wavetables.square, effect, input, gain, force);
+  }
+};
+
+template <>
+struct EffectKernel<EFFECT_SAW> {
+  static void Apply(const HapticEffect& effect, const EffectInput& input,
+                    double gain, double force[3]) {
+    ApplyPeriodic(g_wavetables.saw, effect, input, gain, force);
+  }
+};
+
+template <>
+struct EffectKernel<EFFECT_FRICTION> {
+  static void Apply(const HapticEffect& effect, const EffectInput& input,
+                    double gain, double force[3]) {
+    double speed = input.speed > effect.params[1] ? input.speed
+                                                  : effect.params[1];
+    double scale = gain * effect.params[0] / speed;
+    for (int i = 0; i < 3; i++)
+      force[i] -= scale * input.velocity[i];
+  }
+};
+
+template <>
+struct EffectKernel<EFFECT_IMPULSE> {
+  static void Apply(const HapticEffect& effect, const EffectInput& input,
+                    double gain, double force[3]) {
+    double attack = effect.params[3];
+    double fade = effect.params[4];
+    double envelope = attack > 0.0 ?
+        Clamp01(SecondsSinceStart(effect, input.now) / attack) : 1.0;
+    if (effect.stop_us != 0 && fade > 0.0)
+      envelope *= Clamp01((effect.stop_us - input.now) * 1e-6 / fade);
+    double scale = gain * envelope;
+    for (int i = 0; i < 3; i++)
+      force[i] += scale * effect.params[i];
+  }
+};
+
+template <EffectType kType>
+inline void EvaluateGroup(const HapticEffect* begin,
+                          const HapticEffect* end,
+                          const EffectInput& input,
+                          double force[3]) {
+  for (const HapticEffect* effect = begin; effect != end; ++effect) {
+    EffectKernel<kType>::Apply(*effect, input,
+                               ActiveGain(*effect, input.now), force);
+  }
+}
+
+bool IsValid(const HapticEffect& effect) {
+  if (effect.type < 0 || effect.type >= EFFECT_TYPE_COUNT)
+    return false;
+  if (effect.stop_us != 0 && effect.stop_us <= effect.start_us)
+    return false;
+  switch (effect.type) {
+    case EFFECT_RAMP:
+      return effect.stop_us != 0;
+    case EFFECT_SINE:
+    case EFFECT_SQUARE:
+    case EFFECT_SAW:
+      return effect.params[3] >= 0.0;
+    case EFFECT_FRICTION:
+      return effect.params[1] > 0.0;
+    case EFFECT_IMPULSE:
+      return effect.params[3] >= 0.0 && effect.params[4] >= 0.0;
+    default:
+      return true;
+  }
+}
+
+}  // namespace
+
+int HapticEffect::ParamCount(EffectType type) {
+  switch (type) {
+    case EFFECT_SPRING:
+      return 4;
+    case EFFECT_DAMPER:
+      return 1;
+    case EFFECT_CONSTANT:
+      return 3;
+    case EFFECT_RAMP:
+      return 6;
+    case EFFECT_SINE:
+    case EFFECT_SQUARE:
+    case EFFECT_SAW:
+      return 4;
+    case EFFECT_FRICTION:
+      return 2;
+    case EFFECT_IMPULSE:
+      return 5;
+    case EFFECT_TYPE_COUNT:
+      break;
+  }
+  return 0;
+}
+
+EffectLibrary::EffectLibrary()
+    : next_id_(1) {
+  for (int i = 0; i <= EFFECT_TYPE_COUNT; i++)
+    begin_[i] = 0;
+}
+
+int EffectLibrary::Add(const HapticEffect& effect, int64_t now) {
+  if (!IsValid(effect))
+    return -1;
+
+  for (int i = count() - 1; i >= 0; i--) {
+    if (effects_[i].stop_us != 0 && effects_[i].stop_us <= now)
+      RemoveAt(i);
+  }
+  if (count() == kMaxEffects)
+    return -1;
+
+  // Make room at the end of the effect's group.
+  int index = begin_[effect.type + 1];
+  for (int i = count(); i > index; i--)
+    effects_[i] = effects_[i - 1];
+  for (int t = effect.type + 1; t <= EFFECT_TYPE_COUNT; t++)
+    begin_[t]++;
+
+  effects_[index] = effect;
+  effects_[index].id = next_id_++;
+  return effects_[index].id;
+}
+
+bool EffectLibrary::Remove(int id) {
+  for (int i = 0; i < count(); i++) {
+    if (effects_[i].id == id) {
+      RemoveAt(i);
+      return true;
+    }
+  }
+  return false;
+}
+
+void EffectLibrary::Clear() {
+  for (int i = 0; i <= EFFECT_TYPE_COUNT; i++)
+    begin_[i] = 0;
+}
+
+void EffectLibrary::RemoveAt(int index) {
+  int type = effects_[index].type;
+  for (int i = index; i < count() - 1; i++)
+    effects_[i] = effects_[i + 1];
+  for (int t = type + 1; t <= EFFECT_TYPE_COUNT; t++)
+    begin_[t]--;
+}
+
+void EffectLibrary::Evaluate(int64_t now,
+                             const double position[3],
+                             const double velocity[3],
+                             double force[3]) const {
+  if (count() == 0)
+    return;
+
+  EffectInput input;
+  input.now = now;
+  input.position = position;
+  input.velocity = velocity;
+  input.speed = sqrt(velocity[0] * velocity[0] +
+                     velocity[1] * velocity[1] +
+                     velocity[2] * velocity[2]);
+
+#define EVALUATE_GROUP(type) \
+  EvaluateGroup<type>(effects_ + begin_[type], effects_ + begin_[type + 1], \
+                      input, force)
+  EVALUATE_GROUP(EFFECT_SPRING);
+  EVALUATE_GROUP(EFFECT_DAMPER);
+  EVALUATE_GROUP(EFFECT_CONSTANT);
+  EVALUATE_GROUP(EFFECT_RAMP);
+  EVALUATE_GROUP(EFFECT_SINE);
+  EVALUATE_GROUP(EFFECT_SQUARE);
+  EVALUATE_GROUP(EFFECT_SAW);
+  EVALUATE_GROUP(EFFECT_FRICTION);
+  EVALUATE_GROUP(EFFECT_IMPULSE);
+#undef EVALUATE_GROUP
+}
+
+}  // namespace haptics
@@ -0,0 +1,99 @@
+// Copyright 2010 Mohamed Mansour. All rights reserved.
+// Use of this source code is governed by a GPL license that can
+// be found in the LICENSE file.
+
+#ifndef EFFECT_LIBRARY_H_
+#define EFFECT_LIBRARY_H_
+#pragma once
+
+#include <stdint.h>
+
+namespace haptics {
+
+// Forces are in N, positions in m, times on the MonotonicMicroseconds()
+// clock.
+enum EffectType {
+  // Pulls the tool to a point. params: x, y, z, stiffness (N/m).
+  EFFECT_SPRING,
+  // Resists motion. params: coefficient (N*s/m).
+  EFFECT_DAMPER,
+  // params: fx, fy, fz.
+  EFFECT_CONSTANT,
+  // Goes linearly from one force to another over the life of the effect,
+  // which must have a stop time. params: start fx, fy, fz, end fx, fy, fz.
+  EFFECT_RAMP,
+  // Vibrations along a direction. params: amplitude x, y, z (N),
+  // frequency (Hz).
+  EFFECT_SINE,
+  EFFECT_SQUARE,
+  EFFECT_SAW,
+  // Dry friction against the direction of motion, smoothed below the
+  // threshold speed so the tool does not chatter at rest.
+  // params: force (N), threshold speed (m/s).
+  EFFECT_FRICTION,
+  // Click or bump: a force that fades in and out. params: fx, fy, fz,
+  // attack (s), fade (s). Without a stop time it fades in and then holds.
+  EFFECT_IMPULSE,
+  EFFECT_TYPE_COUNT
+};
+
+struct HapticEffect {
+  enum { kMaxParams = 6 };
+
+  // Number of parameters each EffectType takes.
+  static int ParamCount(EffectType type);
+
+  EffectType type;
+  double params[kMaxParams];
+  // The effect is felt from |start_us| until |stop_us|, or for ever if
+  // |stop_us| is 0.
+  int64_t start_us;
+  int64_t stop_us;
+  // Handle returned to the page, unique within a library.
+  int id;
+};
+
+// Layered effects rendered natively on every servo tick. Like ForceField, the
+// browser thread edits a master copy and hands snapshots to the servo thread.
+//
+// Effects are kept grouped by type, and each group is evaluated by a loop
+// specialized for that type at compile time, so the servo thread never
+// switches on the type of an effect and inactive effects are masked out
+// rather than branched around.
+class EffectLibrary {
+ public:
+  enum { kMaxEffects = 32 };
+
+  EffectLibrary();
+
+  // Adds |effect| and returns its id, or -1 if it is malformed or the
+  // library is full. Effects that are over by |now| are dropped first.
+  int Add(const HapticEffect& effect, int64_t now);
+
+  // Removes the effect with |id|. Returns false if there is none.
+  bool Remove(int id);
+
+  void Clear();
+
+  int count() const { return begin_[EFFECT_TYPE_COUNT]; }
+
+  // Adds the force of every effect active at |now| to |force|. Called on
+  // the servo thread.
+  void Evaluate(int64_t now,
+                const double position[3],
+                const double velocity[3],
+                double force[3]) const;
+
+ private:
+  // Drops the effect at |index|, keeping the groups together.
+  void RemoveAt(int index);
+
+  HapticEffect effects_[kMaxEffects];
+  // Effects of type t are effects_[begin_[t], begin_[t + 1]).
+  int begin_[EFFECT_TYPE_COUNT + 1];
+  int next_id_;
+};
+
+}  // namespace haptics
+
+#endif  // EFFECT_LIBRARY_H_
@@ -0,0 +1,157 @@
+// Copyright 2010 Mohamed Mansour. All rights reserved.
+// Use of this source code is governed by a GPL license that can
+// be found in the LICENSE file.
+
+#include "force_field.h"
+
+#include <math.h>
+
+namespace haptics {
+
+namespace {
+
+void AddPlaneForce(const ForcePrimitive& plane, const double position[3],
+                   double force[3]) {
+  const double* normal = plane.params;
+  double depth = plane.params[3] - (normal[0] * position[0] +
+                                    normal[1] * position[1] +
+                                    normal[2] * position[2]);
+  if (depth <= 0.0)
+    return;
+  double magnitude = plane.stiffness * depth;
+  force[0] += magnitude * normal[0];
+  force[1] += magnitude * normal[1];
+  force[2] += magnitude * normal[2];
+}
+
+void AddSphereForce(const ForcePrimitive& sphere, const double position[3],
+                    double force[3]) {
+  double offset[3] = { position[0] - sphere.params[0],
+                       position[1] - sphere.params[1],
+                       position[2] - sphere.params[2] };
+  double distance = sqrt(offset[0] * offset[0] +
+                         offset[1] * offset[1] +
+                         offset[2] * offset[2]);
+  double radius = sphere.params[3];
+  // At the exact center there is no preferred direction to push towards.
+  if (distance >= radius || distance == 0.0)
+    return;
+  double magnitude = sphere.stiffness * (radius - distance) / distance;
+  force[0] += magnitude * offset[0];
+  force[1] += magnitude * offset[1];
+  force[2] += magnitude * offset[2];
+}
+
+void AddBoxForce(const ForcePrimitive& box, const double position[3],
+                 double force[3]) {
+  // Push out through the face the tool is closest to.
+  int axis = -1;
+  double depth = 0.0;
+  double sign = 0.0;
+  for (int i = 0; i < 3; i++) {
+    double offset = position[i] - box.params[i];
+    double axis_depth = box.params[i + 3] - fabs(offset);
+    if (axis_depth <= 0.0)
+      return;
+    if (axis < 0 || axis_depth < depth) {
+      axis = i;
+      depth = axis_depth;
+      sign = offset < 0.0 ? -1.0 : 1.0;
+    }
+  }
+  force[axis] += box.stiffness * depth * sign;
+}
+
+void AddSpringForce(const ForcePrimitive& spring, const double position[3],
+                    double force[3]) {
+  force[0] += spring.stiffness * (spring.params[0] - position[0]);
+  force[1] += spring.stiffness * (spring.params[1] - position[1]);
+  force[2] += spring.stiffness * (spring.params[2] - position[2]);
+}
+
+}  // namespace
+
+int ForcePrimitive::ParamCount(ForcePrimitiveType type) {
+  switch (type) {
+    case FORCE_PLANE:
+      return 4;
+    case FORCE_SPHERE:
+      return 4;
+    case FORCE_BOX:
+      return 6;
+    case FORCE_SPRING:
+      return 3;
+  }
+  return 0;
+}
+
+ForceField::ForceField()
+    : count_(0),
+      next_id_(1),
+      damping_(0.0) {
+}
+
+int ForceField::Add(const ForcePrimitive& primitive) {
+  if (count_ == kMaxPrimitives)
+    return -1;
+
+  ForcePrimitive& added = primitives_[count_];
+  added = primitive;
+  if (added.type == FORCE_PLANE) {
+    // Evaluate relies on a unit normal.
+    double length = sqrt(added.params[0] * added.params[0] +
+                         added.params[1] * added.params[1] +
+                         added.params[2] * added.params[2]);
+    if (length == 0.0)
+      return -1;
+    added.params[0] /= length;
+    added.params[1] /= length;
+    added.params[2] /= length;
+  }
+  added.id = next_id_++;
+  count_++;
+  return added.id;
+}
+
+bool ForceField::Remove(int id) {
+  for (int i = 0; i < count_; i++) {
+    if (primitives_[i].id == id) {
+      primitives_[i] = primitives_[count_ - 1];
+      count_--;
+      return true;
+    }
+  }
+  return false;
+}
+
+void ForceField::Clear() {
+  count_ = 0;
+}
+
+void ForceField::Evaluate(const double position[3],
+                          const double velocity[3],
+                          double force[3]) const {
+  for (int i = 0; i < count_; i++) {
+    const ForcePrimitive& primitive = primitives_[i];
+    switch (primitive.type) {
+      case FORCE_PLANE:
+        AddPlaneForce(primitive, position, force);
+        break;
+      case FORCE_SPHERE:
+        AddSphereForce(primitive, position, force);
+        break;
+      case FORCE_BOX:
+        AddBoxForce(primitive, position, force);
+        break;
+      case FORCE_SPRING:
+        AddSpringForce(primitive, position, force);
+        break;
+    }
+  }
+
+  force[0] -= damping_ * velocity[0];
+  force[1] -= damping_ * velocity[1];
+  force[2] -= damping_ * velocity[2];
+}
+
+}  // namespace haptics
@@ -0,0 +1,74 @@
+// Copyright 2010 Mohamed Mansour. All rights reserved.
+// Use of this source code is governed by a GPL license that can
+// be found in the LICENSE file.
+
+#ifndef FORCE_FIELD_H_
+#define FORCE_FIELD_H_
+#pragma once
+
+namespace haptics {
+
+enum ForcePrimitiveType {
+  // Half space behind the plane n.x = offset. params: nx, ny, nz, offset.
+  FORCE_PLANE,
+  // Solid sphere. params: cx, cy, cz, radius.
+  FORCE_SPHERE,
+  // Solid axis aligned box. params: cx, cy, cz, half_x, half_y, half_z.
+  FORCE_BOX,
+  // Spring pulling the tool to a point. params: x, y, z.
+  FORCE_SPRING
+};
+
+// A single shape the tool can touch, in application coordinates (meters
+// unless the page set a workspace mapping).
+struct ForcePrimitive {
+  enum { kMaxParams = 6 };
+
+  // Number of parameters each ForcePrimitiveType takes.
+  static int ParamCount(ForcePrimitiveType type);
+
+  ForcePrimitiveType type;
+  double params[kMaxParams];
+  // N/m.
+  double stiffness;
+  // Handle returned to the page, unique within a field.
+  int id;
+};
+
+// Set of primitives rendered natively on every servo tick. The browser
+// thread edits a master copy and hands snapshots to the servo thread, so the
+// class is a plain value type with fixed capacity and no allocations.
+class ForceField {
+ public:
+  enum { kMaxPrimitives = 32 };
+
+  ForceField();
+
+  // Adds |primitive| and returns its id, or -1 if the field is full.
+  int Add(const ForcePrimitive& primitive);
+
+  // Removes the primitive with |id|. Returns false if there is none.
+  bool Remove(int id);
+
+  void Clear();
+
+  // Viscous damping applied everywhere, in N*s/m.
+  double damping() const { return damping_; }
+  void set_damping(double damping) { damping_ = damping; }
+
+  // Computes the force the field applies to a tool at |position| moving
+  // with |velocity|. Called on the servo thread.
+  void Evaluate(const double position[3],
+                const double velocity[3],
+                double force[3]) const;
+
+ private:
+  ForcePrimitive primitives_[kMaxPrimitives];
+  int count_;
+  int next_id_;
+  double damping_;
+};
+
+}  // namespace haptics
+
+#endif  // FORCE_FIELD_H_
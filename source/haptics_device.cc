@@ -4,143 +4,637 @@
 
 #include "haptics_device.h"
 
-#include "windows.h"
+#include <math.h>
 
-#include <iostream>
+#include "platform_thread.h"
 
 namespace haptics {
 
 HapticsDevice::HapticsDevice()
     : initialized_(false),
       button_servo_(false),
-      device_handle_(HDL_INVALID_HANDLE),
-      servo_callback_(HDL_INVALID_HANDLE) {
+      tick_servo_(0),
+      notified_time_servo_(0),
+      notified_button_servo_(false),
+      force_sent_servo_(0),
+      started_servo_(0),
+      has_keyframe_servo_(false),
+      schedule_generation_servo_(0),
+      has_app_workspace_(false),
+      uniform_workspace_(true),
+      deformable_(NULL),
+      dropped_samples_(0),
+      dropped_button_events_(0),
+      schedule_generation_(0),
+      state_notifier_(NULL),
+      state_notifier_data_(NULL),
+      start_notifier_(NULL),
+      start_notifier_data_(NULL),
+      state_notification_pending_(0),
+      running_(0),
+      priority_(0) {
+  for (int i = 0; i < 3; i++) {
+    position_servo_[i] = 0.0;
+    notified_position_servo_[i] = 0.0;
+    force_servo_.force[i] = 0.0;
+    force_servo_.anchor[i] = 0.0;
+  }
+  for (int i = 0; i < 9; i++) {
+    force_servo_.stiffness[i] = 0.0;
+    force_servo_.damping[i] = 0.0;
+  }
+  force_servo_.sent_us = 0;
+  for (int i = 0; i < 6; i++) {
+    haptic_workspace_[i] = 0.0;
+    app_workspace_[i] = 0.0;
+  }
 }
 
 HapticsDevice::~HapticsDevice() {
-  StopDevice();
 }
 
 void HapticsDevice::SendForce(double force[3]) {
-  force_servo_[0] = force[0];
-  force_servo_[1] = force[1];
-  force_servo_[2] = force[2];
+  static const double kZero[9] = { 0.0 };
+  SendForce(force, kZero, kZero, kZero);
+}
+
+void HapticsDevice::SendForce(const double force[3],
+                              const double anchor[3],
+                              const double stiffness[9],
+                              const double damping[9]) {
+  ForceCommand* command = force_buffer_.write_buffer();
+  for (int i = 0; i < 3; i++) {
+    command->force[i] = force[i];
+    command->anchor[i] = anchor[i];
+  }
+  for (int i = 0; i < 9; i++) {
+    command->stiffness[i] = stiffness[i];
+    command->damping[i] = damping[i];
+  }
+  command->sent_us = MonotonicMicroseconds();
+  force_buffer_.Publish();
 }
 
-void HapticsDevice::StartDevice() {
-  HDLError err = HDL_NO_ERROR;
+int HapticsDevice::ScheduleForces(const ForceKeyframe* keyframes,
+                                  int count) {
+  if (count == 0)
+    return 0;
 
-  // Gets the default device handle from the hdal.ini file from the driver.
-  device_handle_ = hdlInitNamedDevice((const char*)0);
-  if (device_handle_ == HDL_INVALID_HANDLE) {
-    std::cout << "Device Failure: Could not open device.";
+  // Of the keyframes that are due, the servo thread only still needs the
+  // last one.
+  int64_t now = Now();
+  size_t passed = 0;
+  while (passed + 1 < scheduled_.size() &&
+         scheduled_[passed + 1].time_us <= now) {
+    passed++;
   }
-  CheckError("hdlInitNamedDevice");
+  scheduled_.erase(scheduled_.begin(), scheduled_.begin() + passed);
 
-  // Now that the device is fully initialized, start the servo thread.
-  // Failing to do this will result in a non-funtional haptics application.
-  hdlStart();
-  CheckError("hdlStart");
+  Atomic32 generation = AcquireLoad(&schedule_generation_);
+  bool replaces = !scheduled_.empty() &&
+      keyframes[0].time_us <= scheduled_.back().time_us;
+  std::vector<ForceKeyframe> batch;
+  if (replaces) {
+    // The servo thread cannot skip part of the queue, so the keyframes kept
+    // are queued again under a new generation, which drops the old queue.
+    generation++;
+    size_t kept = 0;
+    while (kept < scheduled_.size() &&
+           scheduled_[kept].time_us < keyframes[0].time_us) {
+      kept++;
+    }
+    scheduled_.resize(kept);
+    batch.swap(scheduled_);
+  }
+  batch.insert(batch.end(), keyframes, keyframes + count);
 
-  // Setup the callback function.
-  servo_callback_ = hdlCreateServoOp(OnContactThunk, this, false);
-  if (servo_callback_ == HDL_INVALID_HANDLE) {
-    std::cout << "Device Failure: Invalid servo operation.";
+  size_t first_new = batch.size() - count;
+  int queued = 0;
+  for (size_t i = 0; i < batch.size(); i++) {
+    ForceKeyframe* slot = keyframes_.BeginWrite();
+    if (slot == NULL)
+      break;
+    *slot = batch[i];
+    slot->generation = generation;
+    keyframes_.EndWrite();
+    scheduled_.push_back(*slot);
+    if (i >= first_new)
+      queued++;
   }
-  CheckError("hdlCreateServoOp");
+  // Only now that the whole queue is in place, so the servo thread never
+  // sees the new generation without its keyframes.
+  if (replaces)
+    ReleaseStore(&schedule_generation_, generation);
+  return queued;
+}
 
-  // Make the device current. All subsequent calls will
-  // be directed towards the current device.
-  hdlMakeCurrent(device_handle_);
-  CheckError("hdlMakeCurrent");
+void HapticsDevice::ClearScheduledForces() {
+  scheduled_.clear();
+  AtomicIncrement(&schedule_generation_, 1);
+}
 
-  // Get the extents of the device workspace.
-  // Used to create the mapping between device and application coordinates.
-  // Returned dimensions in the array are minx, miny, minz, maxx, maxy, maxz
-  //                                      left, bottom, far, right, top, near)
+void HapticsDevice::OnStarted(const double haptic_workspace[6]) {
+  // The extents of the device workspace are used to create the mapping
+  // between device and application coordinates. Returned dimensions in the
+  // array are minx, miny, minz, maxx, maxy, maxz
+  //        (left, bottom, far, right, top, near)
   // Right-handed coordinates.
   //  left-right is the x-axis, right is greater than left 
   //  bottom-top is the y-axis, top is greater than bottom 
   //  near-far is the z-axis, near is greater than far 
   //  workspace center is (0,0,0)
-  double haptic_workspace[6];
-  hdlDeviceWorkspace(haptic_workspace);
-
-  // Establish the transformation from device space to app space
-  // To keep things simple, we will define the app space units as
-  // inches, and set the workspace to approximate the physical
-  // workspace of the Falcon.  That is, a 4" cube centered on the
-  // origin.  Note the Z axis values; this has the effect of
-  // moving the origin of world coordinates toward the base of the
-  // unit.
-  double game_workspace[] = {-2, -2, -2, 2, 2, 3};
-  hdluGenerateHapticToAppWorkspaceTransform(haptic_workspace,
-                                            game_workspace,
-                                            true,
-                                            transformation_matrix_);
+
+  for (int i = 0; i < 6; i++)
+    haptic_workspace_[i] = haptic_workspace[i];
 
   // Device initialized!
   initialized_ = true;
+  // Fit the box the page asked for now that the workspace is known.
+  if (has_app_workspace_)
+    SetWorkspace(app_workspace_, uniform_workspace_);
+  ReleaseStore(&running_, 1);
+}
+
+void HapticsDevice::SetMotionFilter(const MotionFilterSettings& settings) {
+  *motion_settings_buffer_.write_buffer() = settings;
+  motion_settings_buffer_.Publish();
+}
+
+void HapticsDevice::SetWorkspace(const double app_workspace[6],
+                                 bool uniform) {
+  for (int i = 0; i < 6; i++)
+    app_workspace_[i] = app_workspace[i];
+  uniform_workspace_ = uniform;
+  has_app_workspace_ = true;
+  if (!initialized_)
+    return;
+
+  AffineTransform transform;
+  transform.SetBoxMapping(haptic_workspace_, app_workspace_, uniform);
+  PublishWorkspaceMapping(transform, false);
+}
+
+bool HapticsDevice::SetWorkspaceTransform(const AffineTransform& transform) {
+  if (transform.Determinant() == 0.0)
+    return false;
+  has_app_workspace_ = false;
+  PublishWorkspaceMapping(transform, false);
+  return true;
+}
+
+void HapticsDevice::ResetWorkspace() {
+  has_app_workspace_ = false;
+  PublishWorkspaceMapping(AffineTransform(), true);
+}
+
+void HapticsDevice::PublishWorkspaceMapping(const AffineTransform& position,
+                                            bool identity) {
+  AffineTransform inverse;
+  if (!position.Invert(&inverse))
+    return;
+  // Scale forces by the cube root of the change of volume, so the mapping
+  // back to the device keeps their size under a uniform scale.
+  double determinant = position.Determinant();
+  double scale = pow(determinant < 0.0 ? -determinant : determinant,
+                     1.0 / 3.0);
+
+  WorkspaceMapping* mapping = mapping_buffer_.write_buffer();
+  mapping->position = position;
+  mapping->force_to_device = inverse.LinearPart(scale);
+  mapping->force_to_app = position.LinearPart(1.0 / scale);
+  mapping->identity = identity;
+  mapping_buffer_.Publish();
+}
+
+void HapticsDevice::OnStopped() {
+  ReleaseStore(&running_, 0);
+  initialized_ = false;
+}
+
+void HapticsDevice::GetPosition(double pos[3]) {
+  state_buffer_.Update();
+  const ServoState& state = state_buffer_.read_buffer();
+  pos[0] = state.position[0];
+  pos[1] = state.position[1];
+  pos[2] = state.position[2];
+}
+
+void HapticsDevice::GetState(ServoState* state) {
+  state_buffer_.Update();
+  *state = state_buffer_.read_buffer();
+}
+
+int64_t HapticsDevice::Now() {
+  state_buffer_.Update();
+  return MonotonicMicroseconds() + state_buffer_.read_buffer().clock_offset_us;
+}
+
+bool HapticsDevice::PopSample(ServoSample* sample) {
+  return samples_.Pop(sample);
+}
+
+bool HapticsDevice::PopButtonEvent(ButtonEvent* event) {
+  return button_events_.Pop(event);
+}
+
+void HapticsDevice::Subscribe(double rate_hz, double min_delta) {
+  StateSubscription* subscription = subscription_buffer_.write_buffer();
+  subscription->enabled = true;
+  subscription->period_us =
+      rate_hz > 0.0 ? static_cast<int64_t>(1000000.0 / rate_hz) : 0;
+  subscription->min_delta = min_delta;
+  subscription_buffer_.Publish();
+}
+
+void HapticsDevice::Unsubscribe() {
+  StateSubscription* subscription = subscription_buffer_.write_buffer();
+  subscription->enabled = false;
+  subscription->period_us = 0;
+  subscription->min_delta = 0.0;
+  subscription_buffer_.Publish();
+}
+
+void HapticsDevice::AcknowledgeStateNotification() {
+  ReleaseStore(&state_notification_pending_, 0);
+}
+
+void HapticsDevice::NotifyStateIfChanged(int64_t now) {
+  subscription_buffer_.Update();
+  const StateSubscription& subscription = subscription_buffer_.read_buffer();
+  if (!subscription.enabled || state_notifier_ == NULL)
+    return;
+  if (now - notified_time_servo_ < subscription.period_us)
+    return;
+  // Coalesce: the application reads the newest state when it gets to it, so
+  // there is no point in queueing more than one notification.
+  if (AcquireLoad(&state_notification_pending_))
+    return;
+
+  bool changed = button_servo_ != notified_button_servo_;
+  for (int i = 0; i < 3 && !changed; i++) {
+    double delta = position_servo_[i] - notified_position_servo_[i];
+    changed = delta > subscription.min_delta ||
+              delta < -subscription.min_delta;
+  }
+  if (!changed)
+    return;
+
+  notified_time_servo_ = now;
+  notified_button_servo_ = button_servo_;
+  for (int i = 0; i < 3; i++)
+    notified_position_servo_[i] = position_servo_[i];
+  ReleaseStore(&state_notification_pending_, 1);
+  state_notifier_(state_notifier_data_);
+}
+
+int HapticsDevice::AddForcePrimitive(const ForcePrimitive& primitive) {
+  int id = force_field_.Add(primitive);
+  if (id >= 0)
+    PublishForceField();
+  return id;
 }
 
-void HapticsDevice::StopDevice() {
-  if (servo_callback_ != HDL_INVALID_HANDLE) {
-    hdlDestroyServoOp(servo_callback_);
-    servo_callback_ = HDL_INVALID_HANDLE;
+bool HapticsDevice::RemoveForcePrimitive(int id) {
+  if (!force_field_.Remove(id))
+    return false;
+  PublishForceField();
+  return true;
+}
+
+void HapticsDevice::ClearForcePrimitives() {
+  force_field_.Clear();
+  PublishForceField();
+}
+
+void HapticsDevice::set_damping(double damping) {
+  force_field_.set_damping(damping);
+  PublishForceField();
+}
+
+int HapticsDevice::AddEffect(const HapticEffect& effect) {
+  int id = effects_.Add(effect, Now());
+  if (id >= 0)
+    PublishEffects();
+  return id;
+}
+
+bool HapticsDevice::RemoveEffect(int id) {
+  if (!effects_.Remove(id))
+    return false;
+  PublishEffects();
+  return true;
+}
+
+void HapticsDevice::ClearEffects() {
+  effects_.Clear();
+  PublishEffects();
+}
+
+void HapticsDevice::PublishEffects() {
+  *effects_buffer_.write_buffer() = effects_;
+  effects_buffer_.Publish();
+}
+
+int HapticsDevice::UploadMesh(const std::vector<double>& vertices,
+                              const std::vector<double>& indices,
+                              double stiffness) {
+  TriangleMesh* mesh = new TriangleMesh;
+  if (!mesh->Build(vertices, indices)) {
+    delete mesh;
+    return -1;
   }
-  hdlStop();
+  mesh->set_stiffness(stiffness);
+  int triangle_count = mesh->triangle_count();
+  mesh_handoff_.Publish(mesh);
+  return triangle_count;
+}
+
+void HapticsDevice::ClearMesh() {
+  mesh_handoff_.Publish(new TriangleMesh);
+}
 
-  if (device_handle_ != HDL_INVALID_HANDLE) {
-    hdlUninitDevice(device_handle_);
-    device_handle_ = HDL_INVALID_HANDLE;
+int HapticsDevice::UploadVolume(const VolumeGrid& grid,
+                                const std::vector<double>& values,
+                                bool bricked,
+                                double stiffness) {
+  SdfVolume* volume = new SdfVolume;
+  bool built = bricked ? volume->BuildSparse(grid, values)
+                       : volume->BuildDense(grid, values);
+  if (!built) {
+    delete volume;
+    return -1;
   }
+  volume->set_stiffness(stiffness);
+  int stored_bricks = volume->stored_bricks();
+  volume_handoff_.Publish(volume);
+  return stored_bricks;
+}
 
-  initialized_ = false;
+void HapticsDevice::ClearVolume() {
+  volume_handoff_.Publish(new SdfVolume);
 }
 
-void HapticsDevice::SynchronizeClient() {
-  hdlCreateServoOp(OnStateThunk, this, true);
+int HapticsDevice::UploadDeformable(const std::vector<double>& nodes,
+                                    const std::vector<double>& springs,
+                                    double damping,
+                                    double tool_radius,
+                                    double contact_stiffness) {
+  if (!(tool_radius > 0.0) || !(contact_stiffness >= 0.0))
+    return -1;
+  MassSpringBody* body = new MassSpringBody;
+  if (!body->Build(nodes, springs, damping)) {
+    delete body;
+    return -1;
+  }
+  int node_count = body->node_count();
+  DeformableSimulation* simulation = new DeformableSimulation;
+  if (!simulation->Start(body, tool_radius, contact_stiffness)) {
+    delete simulation;
+    return -1;
+  }
+  // The servo thread may still read the old simulation's contact for a
+  // tick, but nothing needs to step it anymore.
+  if (deformable_)
+    deformable_->Stop();
+  deformable_ = simulation;
+  deformable_handoff_.Publish(simulation);
+  return node_count;
 }
 
-bool HapticsDevice::IsButtonDown() {
-  return button_;
+void HapticsDevice::ClearDeformable() {
+  if (deformable_)
+    deformable_->Stop();
+  deformable_ = new DeformableSimulation;
+  deformable_handoff_.Publish(deformable_);
 }
 
-void HapticsDevice::GetPosition(double pos[3]) {
-  pos[0] = position_servo_[0];
-  pos[1] = position_servo_[1];
-  pos[2] = position_servo_[2];
+const std::vector<double>* HapticsDevice::GetDeformablePositions() {
+  if (deformable_ == NULL || deformable_->empty())
+    return NULL;
+  return &deformable_->UpdateFrame().positions;
 }
 
-void HapticsDevice::CheckError(const char* message) const {
-  HDLError err = hdlGetError();
-  if (err != HDL_NO_ERROR) {
-    MessageBox(NULL, message, "HDAL ERROR", MB_OK);
-    abort();
+void HapticsDevice::PublishForceField() {
+  *force_field_buffer_.write_buffer() = force_field_;
+  force_field_buffer_.Publish();
+}
+
+void HapticsDevice::AddScheduledForce(int64_t now, double force[3]) {
+  Atomic32 generation = AcquireLoad(&schedule_generation_);
+  if (generation != schedule_generation_servo_) {
+    schedule_generation_servo_ = generation;
+    has_keyframe_servo_ = false;
+  }
+
+  // Move past every keyframe that is due, remembering the last one.
+  const ForceKeyframe* next;
+  while ((next = keyframes_.Front()) != NULL) {
+    if (next->generation != schedule_generation_servo_) {
+      // Queued after a clear we have not seen yet, or before one we have.
+      if (next->generation - schedule_generation_servo_ > 0) {
+        schedule_generation_servo_ = next->generation;
+        has_keyframe_servo_ = false;
+      } else {
+        keyframes_.PopFront();
+      }
+      continue;
+    }
+    if (next->time_us > now)
+      break;
+    keyframe_servo_ = *next;
+    has_keyframe_servo_ = true;
+    keyframes_.PopFront();
+  }
+  if (!has_keyframe_servo_)
+    return;
+
+  double progress = 0.0;
+  if (next && next->time_us > keyframe_servo_.time_us) {
+    progress = static_cast<double>(now - keyframe_servo_.time_us) /
+               (next->time_us - keyframe_servo_.time_us);
+  }
+  for (int i = 0; i < 3; i++) {
+    double from = keyframe_servo_.force[i];
+    double to = next ? next->force[i] : from;
+    force[i] += from + progress * (to - from);
   }
 }
 
-HDLServoOpExitCode HapticsDevice::OnContact() {
-  // Get current state of haptic device
-  hdlToolPosition(position_servo_);
-  hdlToolButton(&(button_servo_));
+void HapticsDevice::ServoTick(int64_t now,
+                              const double position[3],
+                              bool button,
+                              double force[3]) {
+  // |now| is on the clock of the backend, which a replay runs at its own
+  // pace, so time the servo loop itself on the real clock.
+  started_servo_ = MonotonicMicroseconds();
+  stats_.BeginTick(started_servo_);
 
-  // Send forces to device
-  hdlSetToolForce(force_servo_);
+  // Get current state of haptic device, in application coordinates.
+  bool remapped = mapping_buffer_.Update();
+  const WorkspaceMapping& mapping = mapping_buffer_.read_buffer();
+  if (mapping.identity) {
+    for (int i = 0; i < 3; i++)
+      position_servo_[i] = position[i];
+  } else {
+    mapping.position.TransformPoint(position, position_servo_);
+  }
+
+  // Queue the edges of the button. When the application falls behind we
+  // keep the oldest events and count the ones that were lost.
+  if (button != button_servo_) {
+    ButtonEvent* event = button_events_.BeginWrite();
+    if (event) {
+      event->time_us = now;
+      event->pressed = button;
+      for (int i = 0; i < 3; i++)
+        event->position[i] = position_servo_[i];
+      button_events_.EndWrite();
+    } else {
+      AtomicIncrement(&dropped_button_events_, 1);
+    }
+  }
+  button_servo_ = button;
+
+  // Estimate the tool motion for viscous effects and the application from
+  // the real time between ticks, since the servo rate is never perfectly
+  // steady. A new mapping moves the tool without it moving, so the motion
+  // starts over.
+  if (motion_settings_buffer_.Update())
+    motion_servo_.Configure(motion_settings_buffer_.read_buffer());
+  if (remapped)
+    motion_servo_.Reset();
+  motion_servo_.Update(now, position_servo_);
+  const double* velocity = motion_servo_.velocity();
+  const double* acceleration = motion_servo_.acceleration();
+
+  // Publish a consistent snapshot for the application thread.
+  ServoState* state = state_buffer_.write_buffer();
+  state->position[0] = position_servo_[0];
+  state->position[1] = position_servo_[1];
+  state->position[2] = position_servo_[2];
+  for (int i = 0; i < 3; i++) {
+    state->velocity[i] = velocity[i];
+    state->acceleration[i] = acceleration[i];
+  }
+  state->button = button_servo_;
+  state->tick = ++tick_servo_;
+  state->clock_offset_us = now - started_servo_;
+  state_buffer_.Publish();
+
+  NotifyStateIfChanged(now);
+
+  // Pick up the latest force the application asked for, if any. Otherwise
+  // keep applying the previous one.
+  force_sent_servo_ = 0;
+  if (force_buffer_.Update()) {
+    force_servo_ = force_buffer_.read_buffer();
+    force_sent_servo_ = force_servo_.sent_us;
+  }
 
-  // Make sure to continue processing
-  return HDL_SERVOOP_CONTINUE;
+  // Follow the page's force model to where the tool is now, instead of
+  // holding the force the page computed for where the tool was.
+  for (int i = 0; i < 3; i++) {
+    const double* stiffness = &force_servo_.stiffness[i * 3];
+    const double* damping = &force_servo_.damping[i * 3];
+    force[i] = force_servo_.force[i];
+    for (int j = 0; j < 3; j++) {
+      double offset = position_servo_[j] - force_servo_.anchor[j];
+      force[i] += stiffness[j] * offset + damping[j] * velocity[j];
+    }
+  }
+
+  AddScheduledForce(now, force);
+
+  // Add the natively rendered force field on top of the page's force.
+  force_field_buffer_.Update();
+  force_field_buffer_.read_buffer().Evaluate(position_servo_,
+                                             velocity,
+                                             force);
+
+  // Then the page's effects, timed against the start of the tick.
+  effects_buffer_.Update();
+  effects_buffer_.read_buffer().Evaluate(now, position_servo_,
+                                         velocity, force);
+
+  // The mesh pushes the tool towards the proxy held on its surface. A new
+  // mesh starts with the proxy on the tool, wherever that is.
+  bool mesh_changed;
+  const TriangleMesh* mesh = mesh_handoff_.Acquire(&mesh_changed);
+  if (mesh_changed)
+    god_object_.Reset(position_servo_);
+  if (mesh && !mesh->empty()) {
+    god_object_.Update(*mesh, position_servo_);
+    const double* proxy = god_object_.position();
+    for (int i = 0; i < 3; i++)
+      force[i] += mesh->stiffness() * (proxy[i] - position_servo_[i]);
+  }
+
+  // The volume pushes the tool out along the distance gradient, in
+  // proportion to how deep it is.
+  bool volume_changed;
+  const SdfVolume* volume = volume_handoff_.Acquire(&volume_changed);
+  double distance;
+  double gradient[3];
+  if (volume && volume->Sample(position_servo_, &distance, gradient) &&
+      distance < 0.0) {
+    double length = sqrt(gradient[0] * gradient[0] +
+                         gradient[1] * gradient[1] +
+                         gradient[2] * gradient[2]);
+    if (length > 0.0) {
+      double magnitude = -volume->stiffness() * distance / length;
+      for (int i = 0; i < 3; i++)
+        force[i] += magnitude * gradient[i];
+    }
+  }
+
+  // The deformable body runs on its own thread. It learns where the tool is
+  // and hands back its contact from the latest step, which is followed to
+  // where the tool is now.
+  bool deformable_changed;
+  DeformableSimulation* deformable =
+      deformable_handoff_.Acquire(&deformable_changed);
+  if (deformable && !deformable->empty()) {
+    deformable->SetToolPosition(position_servo_);
+    const DeformableContact& contact = deformable->UpdateContact();
+    if (contact.node_count > 0) {
+      for (int i = 0; i < 3; i++) {
+        force[i] += contact.force[i];
+        for (int j = 0; j < 3; j++) {
+          force[i] += contact.stiffness[i * 3 + j] *
+                      (position_servo_[j] - contact.anchor[j]);
+        }
+      }
+    }
+  }
+
+  if (!mapping.identity)
+    mapping.force_to_device.TransformVector(force, force);
 }
 
-HDLServoOpExitCode HapticsDevice::OnState() {
-  // Call JavaScript synchronization that copies data from servo side.
+void HapticsDevice::FinishTick(int64_t now, const double force[3]) {
+  if (force_sent_servo_ != 0)
+    stats_.RecordForceAge(force_sent_servo_, MonotonicMicroseconds());
 
-  button_ = button_servo_;
+  // Keep the history of the tick. When the application falls behind we keep
+  // the oldest samples and count the ticks that were lost.
+  ServoSample* sample = samples_.BeginWrite();
+  if (sample) {
+    sample->time_us = now;
+    sample->button = button_servo_;
+    for (int i = 0; i < 3; i++) {
+      sample->position[i] = position_servo_[i];
+      sample->force[i] = force[i];
+    }
+    // Store the force in the coordinates of the position.
+    const WorkspaceMapping& mapping = mapping_buffer_.read_buffer();
+    if (!mapping.identity)
+      mapping.force_to_app.TransformVector(sample->force, sample->force);
+    samples_.EndWrite();
+  } else {
+    AtomicIncrement(&dropped_samples_, 1);
+  }
 
-  // Only do this once.  The application will decide when it
-  // wants to do it again, and call CreateServoOp with
-  // bBlocking = true
-  return HDL_SERVOOP_EXIT;
+  stats_.EndTick(started_servo_, MonotonicMicroseconds());
 }
 
 }  // namespace haptics
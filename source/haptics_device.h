@@ -6,54 +6,392 @@
 #define HAPTICS_DEVICE_H_
 #pragma once
 
-#include <hdl/hdl.h>
+#include <stdint.h>
+
+#include <vector>
+
+#include "affine_transform.h"
+#include "deformable_simulation.h"
+#include "effect_library.h"
+#include "force_field.h"
 #include "haptics_signal.h"
+#include "motion_filter.h"
+#include "object_handoff.h"
+#include "ring_buffer.h"
+#include "sdf_volume.h"
+#include "servo_stats.h"
+#include "triangle_mesh.h"
+#include "triple_buffer.h"
 
 namespace haptics {
 
+// Snapshot of the device as sampled by a single servo tick.
+struct ServoState {
+  double position[3];
+  // Filtered estimates, see MotionFilter.
+  double velocity[3];
+  double acceleration[3];
+  bool button;
+  // Incremented on every servo tick, lets the reader detect skipped ticks.
+  unsigned int tick;
+  // The servo clock minus MonotonicMicroseconds() at this tick. Zero unless
+  // the backend runs its own clock, like a replay.
+  int64_t clock_offset_us;
+};
+
+// Force requested by the application thread, as a local linear model the
+// servo thread evaluates on every tick:
+//   force + stiffness * (position - anchor) + damping * velocity
+// The matrices are row-major Jacobians, so a restoring spring has negative
+// entries. With both matrices zero the force is held constant.
+struct ForceCommand {
+  double force[3];
+  double anchor[3];
+  double stiffness[9];
+  double damping[9];
+  // MonotonicMicroseconds() when the application sent it.
+  int64_t sent_us;
+};
+
+// Force the application wants applied at a given time. The servo thread
+// interpolates linearly between consecutive keyframes and holds the last one
+// once the queue runs dry.
+struct ForceKeyframe {
+  // MonotonicMicroseconds() at which |force| is reached.
+  int64_t time_us;
+  double force[3];
+  // Keyframes queued before the last ClearScheduledForces() are skipped.
+  Atomic32 generation;
+};
+
+// Record of a single servo tick kept for the page's history.
+struct ServoSample {
+  // MonotonicMicroseconds() when the tick ran.
+  int64_t time_us;
+  double position[3];
+  bool button;
+  // Total force sent to the device on this tick.
+  double force[3];
+};
+
+// How the servo thread maps between device and application coordinates.
+// Forces are in newtons along the application axes: they are mapped back
+// with the inverse of the linear part of |position|, rescaled so a uniform
+// scale only rotates them, and a pure rotation keeps them as they are.
+struct WorkspaceMapping {
+  WorkspaceMapping() : identity(true) {}
+
+  // Device to application, for positions.
+  AffineTransform position;
+  // Application to device and device to application, for forces.
+  AffineTransform force_to_device;
+  AffineTransform force_to_app;
+  // Set while every transform is the identity, so ticks can skip them.
+  bool identity;
+};
+
+// Press or release of the main button, as seen by the servo thread.
+struct ButtonEvent {
+  // MonotonicMicroseconds() of the tick that saw it.
+  int64_t time_us;
+  bool pressed;
+  // Where the tool was, in application coordinates.
+  double position[3];
+};
+
+// When the servo thread should tell the application about new state.
+struct StateSubscription {
+  bool enabled;
+  // Minimum time between two notifications.
+  int64_t period_us;
+  // The tool has to move at least this far on some axis, or the button has
+  // to change, since the last notification.
+  double min_delta;
+};
+
+// Called on the servo thread when the application should pick up new state.
+typedef void (*StateNotifier)(hpointer data);
+
+// One plugin instance's use of a haptic device: its state buffers, force
+// pipeline and servo state. The device itself and the servo thread belong to
+// the DeviceManager, which runs the tick of every client of a device and
+// decides which forces reach it.
 class HapticsDevice {  
- // Define callback functions as friends.
  public:
-  explicit HapticsDevice();
+  HAPTICS_CACHE_ALIGNED_NEW
+
+  HapticsDevice();
   ~HapticsDevice();
 
   void SendForce(double force[3]);
-  void StartDevice();
-  void StopDevice();
+  // Sends the force together with how it changes around |anchor|, see
+  // ForceCommand, so the servo thread can follow the tool between two
+  // updates of a slow simulation.
+  void SendForce(const double force[3],
+                 const double anchor[3],
+                 const double stiffness[9],
+                 const double damping[9]);
+
+  // Called by the DeviceManager once the device is open, with its
+  // workspace, and when the servo thread should stop or start running this
+  // client.
+  void OnStarted(const double haptic_workspace[6]);
+  void OnStopped();
+  bool running() const { return AcquireLoad(&running_) != 0; }
+
+  // Among the running clients of a device, only those with the highest
+  // priority are felt; their forces add up.
+  int priority() const { return AcquireLoad(&priority_); }
+  void set_priority(int priority) { ReleaseStore(&priority_, priority); }
 
-  void SynchronizeClient();
+  // Positions, velocities and forces the application sees and sends are in
+  // application coordinates, which are the device's own (meters) until one
+  // of these is called. SetWorkspace() maps the device workspace onto the
+  // |app_workspace| box, minx, miny, minz, maxx, maxy, maxz, keeping the
+  // proportions with |uniform| set; it applies once the device has started
+  // when called before. SetWorkspaceTransform() maps device coordinates
+  // through |transform| instead, and returns false if it is not invertible.
+  void SetWorkspace(const double app_workspace[6], bool uniform);
+  bool SetWorkspaceTransform(const AffineTransform& transform);
+  void ResetWorkspace();
+
+  // Changes how velocity and acceleration are smoothed from the next tick.
+  void SetMotionFilter(const MotionFilterSettings& settings);
+
+  // Called by the DeviceManager on the servo thread. ServoTick() takes the
+  // tool as read for this tick, in device coordinates, updates what the
+  // application sees and computes this client's force into |force|, mapped
+  // back to the device. FinishTick() is told the force the device was
+  // actually sent.
+  void ServoTick(int64_t now,
+                 const double position[3],
+                 bool button,
+                 double force[3]);
+  void FinishTick(int64_t now, const double force[3]);
 
-  // Is the main button pressed down.
-  bool IsButtonDown();
-  
   // Get position of the device.
   void GetPosition(double pos[3]);
 
+  // Copies the state of the latest servo tick.
+  void GetState(ServoState* state);
+
+  // The time on the servo clock, the |now| of ServoTick(), for scheduling
+  // forces and effects from the application thread.
+  int64_t Now();
+
+  // The servo thread keeps a record of every tick until the application
+  // takes it. Returns false once every recorded tick has been taken.
+  bool PopSample(ServoSample* sample);
+  // Number of samples waiting for PopSample.
+  int pending_samples() const { return samples_.size(); }
+  // Number of ticks that were not recorded because nobody took the samples
+  // in time.
+  int dropped_samples() const { return AcquireLoad(&dropped_samples_); }
+
+  // Ticks of history kept, a bit over four seconds at 1 kHz.
+  enum { kSampleCapacity = 4096 };
+
+  // The servo thread queues every press and release of the button, so
+  // clicks shorter than the application's polling are not lost. Returns
+  // false once every queued event has been taken.
+  bool PopButtonEvent(ButtonEvent* event);
+  int pending_button_events() const { return button_events_.size(); }
+  // Number of events that did not fit because nobody took them in time.
+  int dropped_button_events() const {
+    return AcquireLoad(&dropped_button_events_);
+  }
+
+  // Button events kept, 128 clicks.
+  enum { kButtonEventCapacity = 256 };
+
+  // Sets the function the servo thread calls to announce new state. Must be
+  // set before the device is started.
+  void set_state_notifier(StateNotifier notifier, hpointer data) {
+    state_notifier_ = notifier;
+    state_notifier_data_ = data;
+  }
+
+  // Sets the function the DeviceManager calls, on a background thread, once
+  // it is done opening the devices for an asynchronous start.
+  void set_start_notifier(StateNotifier notifier, hpointer data) {
+    start_notifier_ = notifier;
+    start_notifier_data_ = data;
+  }
+  void NotifyStartFinished() {
+    if (start_notifier_)
+      start_notifier_(start_notifier_data_);
+  }
+
+  // Starts or stops notifications. At most |rate_hz| notifications per second
+  // are sent, and only once the state changed by more than |min_delta|.
+  void Subscribe(double rate_hz, double min_delta);
+  void Unsubscribe();
+
+  // Only one notification is outstanding at a time; the application calls
+  // this once it has handled it so the next one can be sent.
+  void AcknowledgeStateNotification();
+  bool state_notification_pending() const {
+    return AcquireLoad(&state_notification_pending_) != 0;
+  }
+
+  // Queues |count| keyframes, sorted by time. They replace the queued
+  // keyframes at or after the first of them, so the page can send
+  // overlapping windows of forces. Their force is added to the one from
+  // SendForce. Returns how many fit; until the servo thread drops the
+  // replaced keyframes, they still take room in the queue.
+  int ScheduleForces(const ForceKeyframe* keyframes, int count);
+  // Drops every queued keyframe and stops holding the last one.
+  void ClearScheduledForces();
+
+  // Keyframes that can be queued at once, two seconds at 1 kHz.
+  enum { kKeyframeCapacity = 2048 };
+
+  // Edits the force field rendered in the servo loop. Changes take effect on
+  // the next servo tick.
+  int AddForcePrimitive(const ForcePrimitive& primitive);
+  bool RemoveForcePrimitive(int id);
+  void ClearForcePrimitives();
+  double damping() const { return force_field_.damping(); }
+  void set_damping(double damping);
+
+  // Edits the layered effects rendered in the servo loop, see
+  // EffectLibrary. Changes take effect on the next servo tick.
+  int AddEffect(const HapticEffect& effect);
+  bool RemoveEffect(int id);
+  void ClearEffects();
+
+  // Replaces the touchable mesh with the triangles of |indices| into
+  // |vertices|, pushed out of the tool with |stiffness| N/m. The hierarchy is
+  // built here, the servo thread only swaps the finished mesh in. Returns the
+  // number of triangles kept, or -1 if the data is malformed.
+  int UploadMesh(const std::vector<double>& vertices,
+                 const std::vector<double>& indices,
+                 double stiffness);
+  void ClearMesh();
+
+  // Replaces the touchable signed distance volume, see SdfVolume. |values|
+  // holds every sample of |grid|, or with |bricked| set only the bricks
+  // near the surface. Returns the number of bricks stored sample by sample,
+  // or -1 if the data is malformed.
+  int UploadVolume(const VolumeGrid& grid,
+                   const std::vector<double>& values,
+                   bool bricked,
+                   double stiffness);
+  void ClearVolume();
+
+  // Replaces the deformable body the tool touches, see MassSpringBody for
+  // |nodes|, |springs| and |damping|. The tool is a sphere of |tool_radius|
+  // pushing nodes out with |contact_stiffness| N/m each. The body is
+  // simulated on its own thread, see DeformableSimulation. Returns the
+  // number of nodes, or -1 if the data is malformed or the body too stiff
+  // for its masses.
+  int UploadDeformable(const std::vector<double>& nodes,
+                       const std::vector<double>& springs,
+                       double damping,
+                       double tool_radius,
+                       double contact_stiffness);
+  void ClearDeformable();
+  // Returns the latest positions of the deformable body's nodes, x, y, z
+  // per node, or NULL if there is no body.
+  const std::vector<double>* GetDeformablePositions();
+
+  // Timing of the servo loop, see ServoStats.
+  void GetStats(ServoStatsSnapshot* snapshot) const {
+    stats_.GetSnapshot(snapshot);
+  }
+  void ResetStats() { stats_.Reset(); }
+
   // Accessor to check if the device has been initialized.
   bool initialized() const { return initialized_; }
 private:
-  void CheckError(const char* message) const;
-  
-  HAPTIC_CALLBACK(HapticsDevice, HDLServoOpExitCode, OnContact);
-  HAPTIC_CALLBACK(HapticsDevice, HDLServoOpExitCode, OnState);
+  // Hands a copy of |force_field_| to the servo thread.
+  void PublishForceField();
+  // Hands a copy of |effects_| to the servo thread.
+  void PublishEffects();
+  // Hands the mapping for |position| to the servo thread.
+  void PublishWorkspaceMapping(const AffineTransform& position,
+                               bool identity);
+
+  // Adds the force scheduled for |now| through ScheduleForces.
+  void AddScheduledForce(int64_t now, double force[3]);
+
+  // Decides on the servo thread whether the application should be told
+  // about the state of this tick.
+  void NotifyStateIfChanged(int64_t now);
 
   // Checks if the device is initialized successfully.
   bool initialized_;
 
-  // Variables used only by servo thread
-  double position_servo_[3];
+  // Variables used only by servo thread. They start on their own cache line
+  // so the devices serviced by the same thread never share one.
+  HAPTICS_CACHE_ALIGNED double position_servo_[3];
   bool button_servo_;
-  double force_servo_[3];
+  ForceCommand force_servo_;
+  MotionFilter motion_servo_;
+  unsigned int tick_servo_;
+  int64_t notified_time_servo_;
+  double notified_position_servo_[3];
+  bool notified_button_servo_;
+  // When the command picked up on this tick was sent, 0 if none was.
+  int64_t force_sent_servo_;
+  // MonotonicMicroseconds() when this tick started.
+  int64_t started_servo_;
+  // Last keyframe reached, held until the next one.
+  ForceKeyframe keyframe_servo_;
+  bool has_keyframe_servo_;
+  Atomic32 schedule_generation_servo_;
+  GodObject god_object_;
 
   // Variables used only by application thread
-  double position_[3];
-  bool button_;
+  ForceField force_field_;
+  EffectLibrary effects_;
+  // Keyframes queued that the servo thread may not have reached yet, and
+  // the last one it did, to queue again when a batch replaces the rest.
+  std::vector<ForceKeyframe> scheduled_;
+  // Workspace reported by OnStarted(), and the box SetWorkspace() maps it
+  // onto when |has_app_workspace_| is set.
+  double haptic_workspace_[6];
+  bool has_app_workspace_;
+  double app_workspace_[6];
+  bool uniform_workspace_;
+  // Latest simulation handed to the servo thread, for its frames.
+  DeformableSimulation* deformable_;
+
+  // Channels between the two threads. The servo thread writes |state_buffer_|
+  // and reads |force_buffer_|, the application thread does the opposite.
+  TripleBuffer<ServoState> state_buffer_;
+  TripleBuffer<ForceCommand> force_buffer_;
+  TripleBuffer<ForceField> force_field_buffer_;
+  TripleBuffer<EffectLibrary> effects_buffer_;
+  TripleBuffer<StateSubscription> subscription_buffer_;
+  TripleBuffer<WorkspaceMapping> mapping_buffer_;
+  TripleBuffer<MotionFilterSettings> motion_settings_buffer_;
+  ObjectHandoff<TriangleMesh> mesh_handoff_;
+  ObjectHandoff<SdfVolume> volume_handoff_;
+  ObjectHandoff<DeformableSimulation> deformable_handoff_;
+
+  RingBuffer<ServoSample, kSampleCapacity> samples_;
+  HAPTICS_CACHE_ALIGNED volatile Atomic32 dropped_samples_;
+
+  RingBuffer<ButtonEvent, kButtonEventCapacity> button_events_;
+  HAPTICS_CACHE_ALIGNED volatile Atomic32 dropped_button_events_;
+
+  RingBuffer<ForceKeyframe, kKeyframeCapacity> keyframes_;
+  // Bumped by ClearScheduledForces() and by batches that replace keyframes.
+  HAPTICS_CACHE_ALIGNED volatile Atomic32 schedule_generation_;
+
+  ServoStats stats_;
 
-  // Transformation from Device coordinates to Application coordinates
-  double transformation_matrix_[16];
+  StateNotifier state_notifier_;
+  hpointer state_notifier_data_;
+  StateNotifier start_notifier_;
+  hpointer start_notifier_data_;
+  // Set by the servo thread when it notifies, cleared by the application.
+  HAPTICS_CACHE_ALIGNED volatile Atomic32 state_notification_pending_;
 
-  HDLServoOpExitCode servo_callback_;
-  HDLDeviceHandle device_handle_;
+  // Set while the servo thread runs this client, and its priority.
+  HAPTICS_CACHE_ALIGNED volatile Atomic32 running_;
+  volatile Atomic32 priority_;
 };
 
 }  // namespace haptics
@@ -4,42 +4,223 @@
 
 #include "haptics_service.h"
 
+#include <math.h>
+#include <stdio.h>
+
+#include <string>
+
+#include "packed_array.h"
+#include "platform_thread.h"
 #include "scripting_bridge.h"
+#include "trajectory_recorder.h"
 
 using haptics::ScriptingBridge;
 using haptics::HapticsDevice;
 
 namespace haptics {
 
-HapticsService::HapticsService(NPP npp)
+namespace {
+
+// Identifiers used on the hot paths, looked up once per process.
+// Enough for the 4x4 matrices setWorkspaceTransform takes.
+NPIdentifier g_index_identifiers[16];
+NPIdentifier g_length_identifier;
+NPIdentifier g_console_identifier;
+NPIdentifier g_debug_identifier;
+
+void InitializeServiceIdentifiers() {
+  if (g_length_identifier != NULL)
+    return;
+  for (int i = 0; i < 16; i++)
+    g_index_identifiers[i] = NPN_GetIntIdentifier(i);
+  g_length_identifier = NPN_GetStringIdentifier("length");
+  g_console_identifier = NPN_GetStringIdentifier("console");
+  g_debug_identifier = NPN_GetStringIdentifier("debug");
+}
+
+// Appends |histogram| to |json| as a JSON object.
+void AppendHistogram(const char* name,
+                     const DurationHistogram& histogram,
+                     std::string* json) {
+  char number[32];
+  sprintf(number, "%d", histogram.count);
+  *json += "\"";
+  *json += name;
+  *json += "\":{\"count\":";
+  *json += number;
+  sprintf(number, "%d", histogram.max_us);
+  *json += ",\"maxUs\":";
+  *json += number;
+  *json += ",\"buckets\":[";
+  for (int i = 0; i < DurationHistogram::kBuckets; i++) {
+    sprintf(number, i == 0 ? "%d" : ",%d", histogram.buckets[i]);
+    *json += number;
+  }
+  *json += "]}";
+}
+
+// Name handed to the page for each DeviceStatus.
+const char* DeviceStatusName(DeviceStatus status) {
+  switch (status) {
+    case DEVICE_OK:
+      return "ok";
+    case DEVICE_STARTING:
+      return "starting";
+    case DEVICE_OPEN_FAILED:
+      return "no-device";
+    case DEVICE_SERVO_FAILED:
+      return "servo-failed";
+    case DEVICE_BUSY:
+      return "busy";
+    case DEVICE_STOPPED:
+      return "stopped";
+  }
+  return "unknown";
+}
+
+// Script times past this many milliseconds, about 30 years, are refused:
+// they would never come, and in microseconds they could overflow int64_t.
+const double kMaxScriptMilliseconds = 1e12;
+
+// Whether |ms| converts safely to microseconds. NaN fails every comparison,
+// so it is refused too.
+bool IsScriptTime(double ms) {
+  return ms >= -kMaxScriptMilliseconds && ms <= kMaxScriptMilliseconds;
+}
+
+}  // namespace
+
+// A console flush waiting to run on the plugin thread. The service may be
+// destroyed before the browser gets to it, in which case |service| is
+// cleared and the flush only frees itself.
+struct HapticsService::ConsoleFlush {
+  HapticsService* service;
+};
+
+// Handle for state deliveries scheduled from the servo thread. It outlives
+// the service if a delivery is still in flight when the service goes away.
+struct HapticsService::StateDelivery {
+  HapticsService* service;
+};
+
+// Handle for start deliveries scheduled from the opener thread or from
+// StartDevice. Like StateDelivery it outlives the service while deliveries
+// are in flight, and the last one frees it.
+struct HapticsService::StartDelivery {
+  HapticsService* service;
+  volatile Atomic32 in_flight;
+};
+
+HapticsService::HapticsService(NPP npp,
+                               HapticsService* primary,
+                               int device_index)
     : npp_(npp),
       scriptable_object_(NULL),
+      window_object_(NULL),
+      position_object_(NULL),
+      velocity_object_(NULL),
+      acceleration_object_(NULL),
+      primary_(primary ? primary : this),
+      manager_(primary ? primary->manager_ : NULL),
+      device_index_(device_index),
       device_(NULL),
-      debug_(false) {
-  ScriptingBridge::InitializeIdentifiers();
+      devices_object_(NULL),
+      debug_(false),
+      console_object_(NULL),
+      dropped_console_messages_(0),
+      pending_flush_(NULL),
+      state_callback_(NULL),
+      state_delivery_(NULL),
+      start_pending_(false),
+      start_delivery_(NULL) {
+  InitializeServiceIdentifiers();
 
-  NPObject* window = NULL;
   NPN_GetValue(npp_, NPNVWindowNPObject, &window_object_);
 
-  device_ = new HapticsDevice();
+  state_delivery_ = new StateDelivery;
+  state_delivery_->service = this;
+
+  start_delivery_ = new StartDelivery;
+  start_delivery_->service = this;
+  start_delivery_->in_flight = 0;
+
+  if (primary_ == this)
+    manager_ = DeviceManager::Acquire();
+  device_ = new HapticsDevice;
+  device_->set_state_notifier(NotifyStateThunk, this);
+  device_->set_start_notifier(NotifyStartThunk, this);
+  // When too many instances share the device this client is never felt,
+  // and StartDevice leaves it uninitialized.
+  manager_->AddClient(device_index_, device_);
+
+  if (primary_ == this) {
+    for (int i = 1; i < manager_->device_count(); i++)
+      device_services_.push_back(new HapticsService(npp_, this, i));
+  }
 }
 
 HapticsService::~HapticsService() {
-  if (scriptable_object_)
+  for (size_t i = 0; i < device_services_.size(); i++)
+    delete device_services_[i];
+
+  // Detach from the servo thread first so nothing schedules new deliveries.
+  // A servo thread stuck in a tick may still use the device, so then it is
+  // leaked rather than freed under it.
+  bool detached = manager_->RemoveClient(device_);
+
+  if (device_->state_notification_pending())
+    state_delivery_->service = NULL;
+  else
+    delete state_delivery_;
+
+  // RemoveClient waited for the opener thread, so no start delivery is
+  // scheduled from now on.
+  if (AcquireLoad(&start_delivery_->in_flight) > 0)
+    start_delivery_->service = NULL;
+  else
+    delete start_delivery_;
+  for (size_t i = 0; i < start_callbacks_.size(); i++)
+    NPN_ReleaseObject(start_callbacks_[i]);
+
+  if (state_callback_)
+    NPN_ReleaseObject(state_callback_);
+
+  if (devices_object_)
+    NPN_ReleaseObject(devices_object_);
+
+  if (scriptable_object_) {
+    static_cast<ScriptingBridge*>(scriptable_object_)->set_service(NULL);
     NPN_ReleaseObject(scriptable_object_);
+  }
+
+  if (position_object_)
+    NPN_ReleaseObject(position_object_);
+  if (velocity_object_)
+    NPN_ReleaseObject(velocity_object_);
+  if (acceleration_object_)
+    NPN_ReleaseObject(acceleration_object_);
+
+  if (console_object_)
+    NPN_ReleaseObject(console_object_);
+
+  if (pending_flush_)
+    pending_flush_->service = NULL;
 
   if (window_object_)
     NPN_ReleaseObject(window_object_);
 
-  if (device_) {
+  if (detached)
     delete device_;
-    device_ = NULL;
-  }
+  if (primary_ == this)
+    manager_->Release();
 }
 
 NPObject* HapticsService::GetScriptableObject() {
-  if (scriptable_object_ == NULL)
+  if (scriptable_object_ == NULL) {
     scriptable_object_ = NPN_CreateObject(npp_, &ScriptingBridge::np_class);
+    if (scriptable_object_)
+      static_cast<ScriptingBridge*>(scriptable_object_)->set_service(this);
+  }
 
   if (scriptable_object_)
     NPN_RetainObject(scriptable_object_);
@@ -47,103 +228,767 @@ NPObject* HapticsService::GetScriptableObject() {
   return scriptable_object_;
 }
 
+NPObject* HapticsService::CreateArray() {
+  NPVariant variant;
+  NPString npstr;
+  npstr.UTF8Characters = "new Array();";
+  npstr.UTF8Length = static_cast<uint32_t>(strlen(npstr.UTF8Characters));
+  if (!NPN_Evaluate(npp_, window_object_, &npstr, &variant))
+    return NULL;
+  if (!NPVARIANT_IS_OBJECT(variant)) {
+    NPN_ReleaseVariantValue(&variant);
+    return NULL;
+  }
+  // Hand over the reference the evaluation gave us.
+  return NPVARIANT_TO_OBJECT(variant);
+}
+
 bool HapticsService::SendForce(NPObject* force_object) {
   SendConsole("SetForce::BEGIN");
-  NPVariant length_variant;
-  NPN_GetProperty(npp_,
-                  force_object,
-                  NPN_GetStringIdentifier("length"),
-                  &length_variant);
-  int length = NPVARIANT_TO_INT32(length_variant);
-  if (length != 3)
+  double force[3];
+  if (!ReadNumbers(force_object, 3, force))
     return false;
+  device_->SendForce(force);
+  return true;
+}
 
+bool HapticsService::SendForce(NPObject* force_object,
+                               NPObject* anchor_object,
+                               const NPVariant& stiffness_variant,
+                               const NPVariant* damping_variant) {
+  SendConsole("SetForce::BEGIN");
   double force[3];
-  for (int i = 0; i < 3; i++) {
+  double anchor[3];
+  double stiffness[9];
+  double damping[9] = { 0.0 };
+  if (!ReadNumbers(force_object, 3, force) ||
+      !ReadNumbers(anchor_object, 3, anchor) ||
+      !ReadMatrix(stiffness_variant, stiffness)) {
+    return false;
+  }
+  if (damping_variant && !ReadMatrix(*damping_variant, damping))
+    return false;
+  device_->SendForce(force, anchor, stiffness, damping);
+  return true;
+}
+
+bool HapticsService::ReadNumbers(NPObject* array_object,
+                                 int count,
+                                 double* values) {
+  NPVariant length_variant;
+  if (!NPN_GetProperty(npp_, array_object, g_length_identifier,
+                       &length_variant)) {
+    return false;
+  }
+  double length = 0;
+  NPVariantToDouble(length_variant, &length);
+  NPN_ReleaseVariantValue(&length_variant);
+  if (length != count)
+    return false;
+
+  for (int i = 0; i < count; i++) {
     NPVariant val;
-    NPN_GetProperty(npp_, force_object, NPN_GetIntIdentifier(i), &val);
-    force[i] = NPVARIANT_TO_DOUBLE(val);
+    if (!NPN_GetProperty(npp_, array_object, g_index_identifiers[i], &val))
+      return false;
+    // Whole numbers such as 10.0 arrive as int32 variants.
+    bool is_number = NPVariantToDouble(val, &values[i]);
+    NPN_ReleaseVariantValue(&val);
+    if (!is_number)
+      return false;
+  }
+  return true;
+}
+
+bool HapticsService::ReadMatrix(const NPVariant& variant, double matrix[9]) {
+  double scale;
+  if (NPVariantToDouble(variant, &scale)) {
+    for (int i = 0; i < 9; i++)
+      matrix[i] = i % 4 == 0 ? scale : 0.0;
+    return true;
   }
+  if (!NPVARIANT_IS_OBJECT(variant))
+    return false;
+  return ReadNumbers(NPVARIANT_TO_OBJECT(variant), 9, matrix);
+}
+
+bool HapticsService::SendForce3(double x, double y, double z) {
+  double force[3] = { x, y, z };
   device_->SendForce(force);
   return true;
 }
 
-bool HapticsService::StartDevice(NPVariant* result_variant) {
+bool HapticsService::SendForces(const NPString& forces,
+                                double period_ms,
+                                NPVariant* result_variant) {
+  NULL_TO_NPVARIANT(*result_variant);
+
+  std::vector<double> values;
+  if (!ParsePackedArray(forces, &values) || values.size() % 3 != 0)
+    return true;
+  int count = static_cast<int>(values.size() / 3);
+  if (!(period_ms >= 0) || !IsScriptTime(period_ms * count))
+    return true;
+  std::vector<ForceKeyframe> batch(count);
+  int64_t start = device_->Now();
+  for (int i = 0; i < count; i++) {
+    batch[i].time_us = start + static_cast<int64_t>(i * period_ms * 1000.0);
+    for (int j = 0; j < 3; j++)
+      batch[i].force[j] = values[i * 3 + j];
+  }
+
+  int queued = count > 0 ? device_->ScheduleForces(&batch[0], count) : 0;
+  INT32_TO_NPVARIANT(queued, *result_variant);
+  return true;
+}
+
+bool HapticsService::ScheduleForces(const NPString& keyframes,
+                                    NPVariant* result_variant) {
+  SendConsole("ScheduleForces::BEGIN");
+  NULL_TO_NPVARIANT(*result_variant);
+
+  std::vector<double> values;
+  if (!ParsePackedArray(keyframes, &values) ||
+      values.size() % kKeyframeStride != 0) {
+    return true;
+  }
+  int count = static_cast<int>(values.size() / kKeyframeStride);
+  std::vector<ForceKeyframe> batch(count);
+  for (int i = 0; i < count; i++) {
+    const double* value = &values[i * kKeyframeStride];
+    if (!IsScriptTime(value[0]))
+      return true;
+    batch[i].time_us = static_cast<int64_t>(value[0] * 1000.0);
+    if (i > 0 && batch[i].time_us < batch[i - 1].time_us)
+      return true;
+    for (int j = 0; j < 3; j++)
+      batch[i].force[j] = value[j + 1];
+  }
+
+  int queued = count > 0 ? device_->ScheduleForces(&batch[0], count) : 0;
+  INT32_TO_NPVARIANT(queued, *result_variant);
+  return true;
+}
+
+bool HapticsService::ClearScheduledForces(NPVariant* result_variant) {
+  SendConsole("ClearScheduledForces::BEGIN");
+  device_->ClearScheduledForces();
+  VOID_TO_NPVARIANT(*result_variant);
+  return true;
+}
+
+bool HapticsService::SetWorkspace(const double app_workspace[6],
+                                  bool uniform,
+                                  NPVariant* result_variant) {
+  SendConsole("SetWorkspace::BEGIN");
+  device_->SetWorkspace(app_workspace, uniform);
+  VOID_TO_NPVARIANT(*result_variant);
+  return true;
+}
+
+bool HapticsService::SetWorkspaceTransform(NPObject* matrix_object,
+                                           NPVariant* result_variant) {
+  SendConsole("SetWorkspaceTransform::BEGIN");
+  if (matrix_object == NULL) {
+    device_->ResetWorkspace();
+    BOOLEAN_TO_NPVARIANT(true, *result_variant);
+    return true;
+  }
+  double matrix[16];
+  if (!ReadNumbers(matrix_object, 16, matrix))
+    return false;
+  bool accepted = device_->SetWorkspaceTransform(AffineTransform(matrix));
+  BOOLEAN_TO_NPVARIANT(accepted, *result_variant);
+  return true;
+}
+
+bool HapticsService::StartDevice(NPObject* callback,
+                                 NPVariant* result_variant) {
   SendConsole("StartDevice::BEGIN");
-  device_->StartDevice();
+  if (callback)
+    start_callbacks_.push_back(NPN_RetainObject(callback));
+
+  // The callbacks always run later from the plugin thread, even when the
+  // outcome is known right away, so pages see a single order of events.
+  if (!start_pending_) {
+    start_pending_ = true;
+    if (manager_->StartClient(device_) != DEVICE_STARTING)
+      PostStartDelivery();
+  }
   GetInitialized(result_variant);
   return true;
 }
 
 bool HapticsService::StopDevice(NPVariant* result_variant) {
   SendConsole("StopDevice::BEGIN");
-  device_->StopDevice();
+  manager_->StopClient(device_);
+  if (start_pending_) {
+    start_pending_ = false;
+    ResolveStart(DEVICE_STOPPED);
+  }
   GetInitialized(result_variant);
   return true;
 }
 
+void HapticsService::NotifyStartThunk(hpointer data) {
+  reinterpret_cast<HapticsService*>(data)->PostStartDelivery();
+}
+
+void HapticsService::PostStartDelivery() {
+  AtomicIncrement(&start_delivery_->in_flight, 1);
+  NPN_PluginThreadAsyncCall(npp_, DeliverStartThunk, start_delivery_);
+}
+
+void HapticsService::DeliverStartThunk(void* data) {
+  StartDelivery* delivery = static_cast<StartDelivery*>(data);
+  bool last = AtomicIncrement(&delivery->in_flight, -1) == 0;
+  if (delivery->service == NULL) {
+    if (last)
+      delete delivery;
+    return;
+  }
+  delivery->service->DeliverStart();
+}
+
+void HapticsService::DeliverStart() {
+  if (!start_pending_)
+    return;
+  DeviceStatus status = manager_->FinishStart(device_);
+  // Another attempt to open the devices is under way, it will notify us.
+  if (status == DEVICE_STARTING)
+    return;
+  start_pending_ = false;
+  ResolveStart(status);
+}
+
+void HapticsService::ResolveStart(DeviceStatus status) {
+  std::vector<NPObject*> callbacks;
+  callbacks.swap(start_callbacks_);
+
+  const char* name = DeviceStatusName(status);
+  NPVariant args[1];
+  STRINGZ_TO_NPVARIANT(name, args[0]);
+  for (size_t i = 0; i < callbacks.size(); i++) {
+    NPVariant result;
+    if (NPN_InvokeDefault(npp_, callbacks[i], args,
+                          sizeof(args) / sizeof(args[0]), &result)) {
+      NPN_ReleaseVariantValue(&result);
+    }
+    NPN_ReleaseObject(callbacks[i]);
+  }
+}
+
+void HapticsService::GetDeformableNodes(NPVariant* nodes_variant) {
+  const std::vector<double>* positions = device_->GetDeformablePositions();
+  if (positions == NULL) {
+    NULL_TO_NPVARIANT(*nodes_variant);
+    return;
+  }
+  int count = static_cast<int>(positions->size());
+  PackedArrayWriter writer(count);
+  for (int i = 0; i < count; i++)
+    writer.Append((*positions)[i]);
+  writer.Finish(nodes_variant);
+}
+
+void HapticsService::DrainSamples(NPVariant* samples_variant) {
+  // The servo thread keeps adding samples while we drain, only take the ones
+  // we made room for.
+  int count = device_->pending_samples();
+  PackedArrayWriter writer(count * kSampleStride);
+  ServoSample sample;
+  for (int i = 0; i < count && device_->PopSample(&sample); i++) {
+    writer.Append(sample.time_us / 1000.0);
+    writer.Append(sample.position[0]);
+    writer.Append(sample.position[1]);
+    writer.Append(sample.position[2]);
+    writer.Append(sample.button ? 1 : 0);
+    writer.Append(sample.force[0]);
+    writer.Append(sample.force[1]);
+    writer.Append(sample.force[2]);
+  }
+  writer.Finish(samples_variant);
+}
+
+void HapticsService::DrainEvents(NPVariant* events_variant) {
+  int count = device_->pending_button_events();
+  PackedArrayWriter writer(count * kButtonEventStride);
+  ButtonEvent event;
+  for (int i = 0; i < count && device_->PopButtonEvent(&event); i++) {
+    writer.Append(event.time_us / 1000.0);
+    writer.Append(event.pressed ? 1 : 0);
+    writer.Append(event.position[0]);
+    writer.Append(event.position[1]);
+    writer.Append(event.position[2]);
+  }
+  writer.Finish(events_variant);
+}
+
+bool HapticsService::StartRecording(const NPString& name,
+                                    NPVariant* result_variant) {
+  SendConsole("StartRecording::BEGIN");
+  std::string path = TrajectoryRecorder::PathForName(
+      std::string(name.UTF8Characters, name.UTF8Length));
+  bool started = !path.empty() && manager_->StartRecording(path);
+  BOOLEAN_TO_NPVARIANT(started, *result_variant);
+  return true;
+}
+
+bool HapticsService::StopRecording(NPVariant* result_variant) {
+  SendConsole("StopRecording::BEGIN");
+  int64_t record_count = manager_->StopRecording();
+  if (record_count < 0)
+    NULL_TO_NPVARIANT(*result_variant);
+  else
+    DOUBLE_TO_NPVARIANT(static_cast<double>(record_count), *result_variant);
+  return true;
+}
+
+bool HapticsService::SetStateCallback(NPObject* callback,
+                                      double rate_hz,
+                                      double min_delta,
+                                      NPVariant* result_variant) {
+  SendConsole("SetStateCallback::BEGIN");
+  if (callback)
+    NPN_RetainObject(callback);
+  if (state_callback_)
+    NPN_ReleaseObject(state_callback_);
+  state_callback_ = callback;
+
+  if (callback)
+    device_->Subscribe(rate_hz, min_delta);
+  else
+    device_->Unsubscribe();
+
+  VOID_TO_NPVARIANT(*result_variant);
+  return true;
+}
+
+void HapticsService::NotifyStateThunk(hpointer data) {
+  HapticsService* service = reinterpret_cast<HapticsService*>(data);
+  NPN_PluginThreadAsyncCall(service->npp_, DeliverStateThunk,
+                            service->state_delivery_);
+}
+
+void HapticsService::DeliverStateThunk(void* data) {
+  StateDelivery* delivery = static_cast<StateDelivery*>(data);
+  if (delivery->service == NULL) {
+    delete delivery;
+    return;
+  }
+  delivery->service->DeliverState();
+}
+
+void HapticsService::DeliverState() {
+  // Allow the servo thread to schedule the next delivery right away; it will
+  // only do so once the state changed again.
+  device_->AcknowledgeStateNotification();
+  if (state_callback_ == NULL)
+    return;
+
+  ServoState state;
+  device_->GetState(&state);
+
+  NPVariant args[4];
+  DOUBLE_TO_NPVARIANT(state.position[0], args[0]);
+  DOUBLE_TO_NPVARIANT(state.position[1], args[1]);
+  DOUBLE_TO_NPVARIANT(state.position[2], args[2]);
+  BOOLEAN_TO_NPVARIANT(state.button, args[3]);
+
+  // The callback may unsubscribe itself, keep it alive during the call.
+  NPObject* callback = NPN_RetainObject(state_callback_);
+  NPVariant result;
+  if (NPN_InvokeDefault(npp_, callback, args,
+                        sizeof(args) / sizeof(args[0]), &result)) {
+    NPN_ReleaseVariantValue(&result);
+  }
+  NPN_ReleaseObject(callback);
+}
+
 void HapticsService::SendConsole(const char* message) {
   if (!debug_)
     return;
 
-  // Get console object.
-  NPVariant consoleVar;
-  NPIdentifier id = NPN_GetStringIdentifier("console");
-  NPN_GetProperty(npp_, window_object_, id, &consoleVar);
-  NPObject* console = NPVARIANT_TO_OBJECT(consoleVar);
-
-  // Get the debug object.
-  id = NPN_GetStringIdentifier("debug");
+  ConsoleMessage* slot = console_messages_.BeginWrite();
+  if (slot == NULL) {
+    dropped_console_messages_++;
+  } else {
+    strncpy(slot->text, message, kMaxConsoleMessage - 1);
+    slot->text[kMaxConsoleMessage - 1] = '\0';
+    console_messages_.EndWrite();
+  }
 
-  // Invoke the call with the message!
-  NPVariant type;
-  STRINGZ_TO_NPVARIANT(message, type);
-  NPVariant args[] = { type };
-  NPVariant voidResponse;
-  NPN_Invoke(npp_, console, id, args,
-             sizeof(args) / sizeof(args[0]),
-             &voidResponse);
+  // One flush drains everything queued until it runs.
+  if (pending_flush_ == NULL) {
+    pending_flush_ = new ConsoleFlush;
+    pending_flush_->service = this;
+    NPN_PluginThreadAsyncCall(npp_, FlushConsoleThunk, pending_flush_);
+  }
+}
 
-  // Cleanup all allocated objects, otherwise, reference count and
-  // memory leaks will happen.
-  NPN_ReleaseVariantValue(&consoleVar);
-  NPN_ReleaseVariantValue(&voidResponse);
+void HapticsService::FlushConsoleThunk(void* data) {
+  ConsoleFlush* flush = static_cast<ConsoleFlush*>(data);
+  if (flush->service) {
+    flush->service->pending_flush_ = NULL;
+    flush->service->FlushConsole();
+  }
+  delete flush;
 }
 
+void HapticsService::FlushConsole() {
+  std::string batch;
+  const ConsoleMessage* message;
+  while ((message = console_messages_.Front()) != NULL) {
+    if (!batch.empty())
+      batch += '\n';
+    batch += message->text;
+    console_messages_.PopFront();
+  }
+  if (dropped_console_messages_ > 0) {
+    char dropped[64];
+    sprintf(dropped, "\n(%d debug messages dropped)",
+            dropped_console_messages_);
+    batch += dropped;
+    dropped_console_messages_ = 0;
+  }
+  if (batch.empty())
+    return;
+
+  // Get console object, it stays valid for the lifetime of the page.
+  if (console_object_ == NULL) {
+    NPVariant console_variant;
+    if (!NPN_GetProperty(npp_, window_object_, g_console_identifier,
+                         &console_variant)) {
+      return;
+    }
+    if (!NPVARIANT_IS_OBJECT(console_variant)) {
+      NPN_ReleaseVariantValue(&console_variant);
+      return;
+    }
+    // Keep the reference the lookup gave us.
+    console_object_ = NPVARIANT_TO_OBJECT(console_variant);
+  }
+
+  // Invoke the call with the message!
+  NPVariant args[1];
+  STRINGN_TO_NPVARIANT(batch.c_str(), batch.size(), args[0]);
+  NPVariant void_response;
+  if (NPN_Invoke(npp_, console_object_, g_debug_identifier, args,
+                 sizeof(args) / sizeof(args[0]), &void_response)) {
+    NPN_ReleaseVariantValue(&void_response);
+  }
+}
 
 void HapticsService::GetPosition(NPVariant* position_variant) {
   SendConsole("GetPosition::BEGIN");
+  // Get the current device position.
+  double pos[3];
+  device_->GetPosition(pos);
+  ReturnVector(pos, &position_object_, position_variant);
+}
+
+void HapticsService::GetVelocity(NPVariant* velocity_variant) {
+  ServoState state;
+  device_->GetState(&state);
+  ReturnVector(state.velocity, &velocity_object_, velocity_variant);
+}
+
+void HapticsService::GetAcceleration(NPVariant* acceleration_variant) {
+  ServoState state;
+  device_->GetState(&state);
+  ReturnVector(state.acceleration, &acceleration_object_,
+               acceleration_variant);
+}
+
+bool HapticsService::SetMotionFilter(double velocity_cutoff_hz,
+                                     double acceleration_cutoff_hz,
+                                     NPVariant* result_variant) {
+  SendConsole("SetMotionFilter::BEGIN");
+  if (velocity_cutoff_hz < 0.0 || acceleration_cutoff_hz < 0.0)
+    return false;
+  MotionFilterSettings settings;
+  settings.velocity_cutoff_hz = velocity_cutoff_hz;
+  settings.acceleration_cutoff_hz = acceleration_cutoff_hz;
+  device_->SetMotionFilter(settings);
+  VOID_TO_NPVARIANT(*result_variant);
+  return true;
+}
+
+void HapticsService::ReturnVector(const double values[3],
+                                  NPObject** array_object,
+                                  NPVariant* result_variant) {
   // Initialize the return value.
-  NULL_TO_NPVARIANT(*position_variant);
-  NPVariant variant;
-  NPString npstr;
-  npstr.UTF8Characters = "new Array();";
-  npstr.UTF8Length = static_cast<uint32_t>(strlen(npstr.UTF8Characters));
-  if (!NPN_Evaluate(npp_, window_object_, &npstr, &variant) ||
-      !NPVARIANT_IS_OBJECT(variant)) {
-    return;
+  NULL_TO_NPVARIANT(*result_variant);
+
+  // Create the array once, it is reused by every following call.
+  if (*array_object == NULL) {
+    *array_object = CreateArray();
+    if (*array_object == NULL)
+      return;
   }
 
-  // Get the current device position.
+  // Set the properties for the vector on the array.
+  NPVariant value;
+  for (int i = 0; i < 3; i++) {
+    DOUBLE_TO_NPVARIANT(values[i], value);
+    NPN_SetProperty(npp_, *array_object, g_index_identifiers[i], &value);
+  }
+
+  // The browser releases the returned variant, so hand out a new reference.
+  NPN_RetainObject(*array_object);
+  OBJECT_TO_NPVARIANT(*array_object, *result_variant);
+}
+
+void HapticsService::GetPositionAxis(int axis, NPVariant* value_variant) {
   double pos[3];
   device_->GetPosition(pos);
+  DOUBLE_TO_NPVARIANT(pos[axis], *value_variant);
+}
+
+void HapticsService::GetDevices(NPVariant* devices_variant) {
+  if (primary_ != this) {
+    primary_->GetDevices(devices_variant);
+    return;
+  }
+  NULL_TO_NPVARIANT(*devices_variant);
 
-  // Set the properties for the position on the array.
-  NPObject* object = NPVARIANT_TO_OBJECT(variant);
-  if (object) {
-    NPVariant value;
-    DOUBLE_TO_NPVARIANT(pos[0], value);
-    NPN_SetProperty(npp_, object, NPN_GetIntIdentifier(0), &value);
-    DOUBLE_TO_NPVARIANT(pos[1], value);
-    NPN_SetProperty(npp_, object, NPN_GetIntIdentifier(1), &value);
-    DOUBLE_TO_NPVARIANT(pos[2], value);
-    NPN_SetProperty(npp_, object, NPN_GetIntIdentifier(2), &value);
-    OBJECT_TO_NPVARIANT(object, *position_variant);
+  if (devices_object_ == NULL) {
+    devices_object_ = CreateArray();
+    if (devices_object_ == NULL)
+      return;
+    for (int i = 0; i < manager_->device_count(); i++) {
+      HapticsService* service = i == 0 ? this : device_services_[i - 1];
+      NPObject* device_object = service->GetScriptableObject();
+      if (device_object == NULL)
+        continue;
+      NPVariant value;
+      OBJECT_TO_NPVARIANT(device_object, value);
+      NPN_SetProperty(npp_, devices_object_, NPN_GetIntIdentifier(i), &value);
+      NPN_ReleaseObject(device_object);
+    }
   }
+
+  // The browser releases the returned variant, so hand out a new reference.
+  NPN_RetainObject(devices_object_);
+  OBJECT_TO_NPVARIANT(devices_object_, *devices_variant);
+}
+
+void HapticsService::GetStats(NPVariant* stats_variant) {
+  NULL_TO_NPVARIANT(*stats_variant);
+
+  ServoStatsSnapshot stats;
+  device_->GetStats(&stats);
+  std::string script = "({";
+  AppendHistogram("period", stats.period, &script);
+  script += ",";
+  AppendHistogram("execution", stats.execution, &script);
+  script += ",";
+  AppendHistogram("forceAge", stats.force_age, &script);
+  script += "})";
+
+  // Diagnostics only, so a fresh object per read is fine here.
+  NPString npstr;
+  npstr.UTF8Characters = script.c_str();
+  npstr.UTF8Length = static_cast<uint32_t>(script.length());
+  NPVariant variant;
+  if (!NPN_Evaluate(npp_, window_object_, &npstr, &variant))
+    return;
+  *stats_variant = variant;
+}
+
+bool HapticsService::ResetStats(NPVariant* result_variant) {
+  device_->ResetStats();
+  VOID_TO_NPVARIANT(*result_variant);
+  return true;
 }
 
 void HapticsService::GetInitialized(NPVariant* initialized_variant) {
   BOOLEAN_TO_NPVARIANT(device_->initialized(), *initialized_variant);
 }
 
+void HapticsService::GetPriority(NPVariant* priority_variant) {
+  INT32_TO_NPVARIANT(device_->priority(), *priority_variant);
+}
+
+void HapticsService::SetPriority(int priority) {
+  device_->set_priority(priority);
+}
+
+bool HapticsService::AddForcePrimitive(const ForcePrimitive& primitive,
+                                       NPVariant* id_variant) {
+  SendConsole("AddForcePrimitive::BEGIN");
+  int id = device_->AddForcePrimitive(primitive);
+  if (id < 0) {
+    NULL_TO_NPVARIANT(*id_variant);
+    return true;
+  }
+  INT32_TO_NPVARIANT(id, *id_variant);
+  return true;
+}
+
+bool HapticsService::RemoveForcePrimitive(int id, NPVariant* result_variant) {
+  SendConsole("RemoveForcePrimitive::BEGIN");
+  BOOLEAN_TO_NPVARIANT(device_->RemoveForcePrimitive(id), *result_variant);
+  return true;
+}
+
+bool HapticsService::ClearForcePrimitives(NPVariant* result_variant) {
+  SendConsole("ClearForcePrimitives::BEGIN");
+  device_->ClearForcePrimitives();
+  VOID_TO_NPVARIANT(*result_variant);
+  return true;
+}
+
+void HapticsService::GetDamping(NPVariant* damping_variant) {
+  DOUBLE_TO_NPVARIANT(device_->damping(), *damping_variant);
+}
+
+void HapticsService::SetDamping(double damping) {
+  device_->set_damping(damping);
+}
+
+bool HapticsService::AddEffect(EffectType type,
+                               NPObject* params_object,
+                               double start_ms,
+                               double duration_ms,
+                               NPVariant* id_variant) {
+  SendConsole("AddEffect::BEGIN");
+  NULL_TO_NPVARIANT(*id_variant);
+
+  if (!IsScriptTime(start_ms) || !IsScriptTime(duration_ms))
+    return false;
+
+  HapticEffect effect;
+  effect.type = type;
+  if (!ReadNumbers(params_object, HapticEffect::ParamCount(type),
+                   effect.params)) {
+    return false;
+  }
+  effect.start_us = start_ms < 0 ?
+      device_->Now() : static_cast<int64_t>(start_ms * 1000.0);
+  effect.stop_us = duration_ms > 0 ?
+      effect.start_us + static_cast<int64_t>(duration_ms * 1000.0) : 0;
+
+  int id = device_->AddEffect(effect);
+  if (id >= 0)
+    INT32_TO_NPVARIANT(id, *id_variant);
+  return true;
+}
+
+bool HapticsService::RemoveEffect(int id, NPVariant* result_variant) {
+  SendConsole("RemoveEffect::BEGIN");
+  BOOLEAN_TO_NPVARIANT(device_->RemoveEffect(id), *result_variant);
+  return true;
+}
+
+bool HapticsService::ClearEffects(NPVariant* result_variant) {
+  SendConsole("ClearEffects::BEGIN");
+  device_->ClearEffects();
+  VOID_TO_NPVARIANT(*result_variant);
+  return true;
+}
+
+void HapticsService::GetTime(NPVariant* time_variant) {
+  DOUBLE_TO_NPVARIANT(device_->Now() / 1000.0, *time_variant);
+}
+
+bool HapticsService::UploadMesh(const NPString& vertices,
+                                const NPString& indices,
+                                double stiffness,
+                                NPVariant* result_variant) {
+  SendConsole("UploadMesh::BEGIN");
+  std::vector<double> vertex_values;
+  std::vector<double> index_values;
+  int triangle_count = -1;
+  if (ParsePackedArray(vertices, &vertex_values) &&
+      ParsePackedArray(indices, &index_values)) {
+    triangle_count = device_->UploadMesh(vertex_values, index_values,
+                                         stiffness);
+  }
+  if (triangle_count < 0) {
+    NULL_TO_NPVARIANT(*result_variant);
+    return true;
+  }
+  INT32_TO_NPVARIANT(triangle_count, *result_variant);
+  return true;
+}
+
+bool HapticsService::ClearMesh(NPVariant* result_variant) {
+  SendConsole("ClearMesh::BEGIN");
+  device_->ClearMesh();
+  VOID_TO_NPVARIANT(*result_variant);
+  return true;
+}
+
+bool HapticsService::UploadVolume(const NPString& grid,
+                                  const NPString& values,
+                                  bool bricked,
+                                  double stiffness,
+                                  NPVariant* result_variant) {
+  SendConsole("UploadVolume::BEGIN");
+  NULL_TO_NPVARIANT(*result_variant);
+
+  std::vector<double> grid_values;
+  if (!ParsePackedArray(grid, &grid_values) || grid_values.size() != 7)
+    return true;
+  VolumeGrid volume_grid;
+  for (int i = 0; i < 3; i++) {
+    // Keeps the size an int; SdfVolume caps the grid as a whole.
+    double size = grid_values[i];
+    if (size < 2 || size > 65536 || size != floor(size))
+      return true;
+    volume_grid.size[i] = static_cast<int>(size);
+    volume_grid.origin[i] = grid_values[i + 3];
+  }
+  volume_grid.spacing = grid_values[6];
+
+  std::vector<double> volume_values;
+  if (!ParsePackedArray(values, &volume_values))
+    return true;
+  int stored_bricks = device_->UploadVolume(volume_grid, volume_values,
+                                            bricked, stiffness);
+  if (stored_bricks >= 0)
+    INT32_TO_NPVARIANT(stored_bricks, *result_variant);
+  return true;
+}
+
+bool HapticsService::UploadDeformable(const NPString& nodes,
+                                      const NPString& springs,
+                                      double damping,
+                                      double tool_radius,
+                                      double contact_stiffness,
+                                      NPVariant* result_variant) {
+  SendConsole("UploadDeformable::BEGIN");
+  std::vector<double> node_values;
+  std::vector<double> spring_values;
+  int node_count = -1;
+  if (ParsePackedArray(nodes, &node_values) &&
+      ParsePackedArray(springs, &spring_values) &&
+      node_values.size() % kDeformableNodeStride == 0 &&
+      spring_values.size() % kDeformableSpringStride == 0) {
+    node_count = device_->UploadDeformable(node_values, spring_values,
+                                           damping, tool_radius,
+                                           contact_stiffness);
+  }
+  if (node_count < 0) {
+    NULL_TO_NPVARIANT(*result_variant);
+    return true;
+  }
+  INT32_TO_NPVARIANT(node_count, *result_variant);
+  return true;
+}
+
+bool HapticsService::ClearDeformable(NPVariant* result_variant) {
+  SendConsole("ClearDeformable::BEGIN");
+  device_->ClearDeformable();
+  VOID_TO_NPVARIANT(*result_variant);
+  return true;
+}
+
+bool HapticsService::ClearVolume(NPVariant* result_variant) {
+  SendConsole("ClearVolume::BEGIN");
+  device_->ClearVolume();
+  VOID_TO_NPVARIANT(*result_variant);
+  return true;
+}
+
 }  // namespace desktop_service
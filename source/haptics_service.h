@@ -6,38 +6,285 @@
 #define HAPTICS_SERVICE_H_
 #pragma once
 
+#include <vector>
+
 #include "npfunctions.h"
 
+#include "atomic_ops.h"
+#include "device_manager.h"
 #include "haptics_device.h"
+#include "ring_buffer.h"
 
 namespace haptics {
 
+// Scripting side of one haptic device, attached to it as a client of the
+// process-wide DeviceManager. The plugin instance gets the service of the
+// first device, which owns the services of the other devices.
 class HapticsService {
  public:
-  HapticsService(NPP npp);
+  HAPTICS_CACHE_ALIGNED_NEW
+
+  // Creates the service of the plugin instance |npp|, or with |primary| set
+  // the one of its device |device_index|. The bridge must have been set up
+  // with ScriptingBridge::InitializeIdentifiers().
+  explicit HapticsService(NPP npp,
+                          HapticsService* primary = NULL,
+                          int device_index = 0);
   ~HapticsService();
 
   NPObject* GetScriptableObject();
 
   bool SendForce(NPObject* force_object);
-  bool StartDevice(NPVariant* result_variant);
+  // Sends the force with its stiffness and optional damping around
+  // |anchor_object|, see ForceCommand. The matrices are either arrays of 9
+  // numbers, row-major, or a single number for the same value on every axis.
+  bool SendForce(NPObject* force_object,
+                 NPObject* anchor_object,
+                 const NPVariant& stiffness_variant,
+                 const NPVariant* damping_variant);
+  // Starts the device without blocking the page. |callback|, if any, is
+  // called from the plugin thread with the outcome as a string, "ok" or an
+  // error, see DeviceStatusName. Returns whether it is already initialized.
+  bool StartDevice(NPObject* callback, NPVariant* result_variant);
   bool StopDevice(NPVariant* result_variant);
   
+  // Sends a constant force given as three numbers, without touching any
+  // script object.
+  bool SendForce3(double x, double y, double z);
+  // Queues a packed array of fx, fy, fz forces, one every |period_ms|
+  // starting now. Returns the number queued, or null if the data is
+  // malformed.
+  bool SendForces(const NPString& forces,
+                  double period_ms,
+                  NPVariant* result_variant);
+
+  // Queues force keyframes given as a packed array of time (ms, on the
+  // GetTime() clock), fx, fy, fz per keyframe, sorted by time. Returns the
+  // number of keyframes queued, or null if the data is malformed.
+  bool ScheduleForces(const NPString& keyframes, NPVariant* result_variant);
+  bool ClearScheduledForces(NPVariant* result_variant);
+  enum { kKeyframeStride = 4 };
+
+  // Maps device coordinates to the page's, see HapticsDevice::SetWorkspace.
+  // |matrix_object| is a column-major 4x4 array, or NULL for the device's
+  // own coordinates; the result is false if the matrix is not invertible.
+  bool SetWorkspace(const double app_workspace[6],
+                    bool uniform,
+                    NPVariant* result_variant);
+  bool SetWorkspaceTransform(NPObject* matrix_object,
+                             NPVariant* result_variant);
+
+  // Returns the position as an array. The same array object is handed out on
+  // every call and refreshed in place, so polling allocates nothing.
   void GetPosition(NPVariant* position_variant);
+  // Returns a single coordinate (0 = x, 1 = y, 2 = z) as a number.
+  void GetPositionAxis(int axis, NPVariant* value_variant);
+  // Return the filtered velocity and acceleration the same way, per second
+  // and per second squared, see MotionFilter.
+  void GetVelocity(NPVariant* velocity_variant);
+  void GetAcceleration(NPVariant* acceleration_variant);
+  // Sets the cutoff of the velocity and acceleration filters; zero turns a
+  // filter off.
+  bool SetMotionFilter(double velocity_cutoff_hz,
+                       double acceleration_cutoff_hz,
+                       NPVariant* result_variant);
   void GetInitialized(NPVariant* initialized_variant);
 
+  // Priority of this client of the device, see DeviceManager.
+  void GetPriority(NPVariant* priority_variant);
+  void SetPriority(int priority);
+
+  // Natively rendered force field.
+  bool AddForcePrimitive(const ForcePrimitive& primitive,
+                         NPVariant* id_variant);
+  bool RemoveForcePrimitive(int id, NPVariant* result_variant);
+  bool ClearForcePrimitives(NPVariant* result_variant);
+  void GetDamping(NPVariant* damping_variant);
+  void SetDamping(double damping);
+
+  // Layered effects, see EffectLibrary. |params_object| is an array of
+  // HapticEffect::ParamCount(type) numbers. Times are in milliseconds on the
+  // clock GetTime() reads; a negative |start_ms| starts the effect now and a
+  // |duration_ms| of 0 keeps it running until it is removed.
+  bool AddEffect(EffectType type,
+                 NPObject* params_object,
+                 double start_ms,
+                 double duration_ms,
+                 NPVariant* id_variant);
+  bool RemoveEffect(int id, NPVariant* result_variant);
+  bool ClearEffects(NPVariant* result_variant);
+  // Milliseconds on the servo clock, to schedule effects against.
+  void GetTime(NPVariant* time_variant);
+
+  // Replaces the touchable triangle mesh. |vertices| and |indices| are
+  // packed arrays, see ParsePackedArray. Returns the number of triangles
+  // kept, or null if the data is malformed.
+  bool UploadMesh(const NPString& vertices,
+                  const NPString& indices,
+                  double stiffness,
+                  NPVariant* result_variant);
+  bool ClearMesh(NPVariant* result_variant);
+
+  // Replaces the touchable signed distance volume. |grid| is a packed array
+  // of sizeX, sizeY, sizeZ, originX, originY, originZ, spacing and |values|
+  // one of samples or, with |bricked| set, of bricks. Returns the number of
+  // bricks stored, or null if the data is malformed.
+  bool UploadVolume(const NPString& grid,
+                    const NPString& values,
+                    bool bricked,
+                    double stiffness,
+                    NPVariant* result_variant);
+  bool ClearVolume(NPVariant* result_variant);
+
+  // Replaces the deformable body, see HapticsDevice::UploadDeformable.
+  // |nodes| and |springs| are packed arrays of kDeformableNodeStride and
+  // kDeformableSpringStride numbers per item. Returns the number of nodes,
+  // or null if the data is malformed.
+  bool UploadDeformable(const NPString& nodes,
+                        const NPString& springs,
+                        double damping,
+                        double tool_radius,
+                        double contact_stiffness,
+                        NPVariant* result_variant);
+  bool ClearDeformable(NPVariant* result_variant);
+  enum {
+    kDeformableNodeStride = 4,
+    kDeformableSpringStride = 3
+  };
+  // Returns the latest node positions of the deformable body as a packed
+  // array of x, y, z per node, or null if there is none.
+  void GetDeformableNodes(NPVariant* nodes_variant);
+
+  // Returns every servo tick recorded since the last call as a packed
+  // array, see PackedArrayWriter, with kSampleStride numbers per tick:
+  // time in milliseconds, x, y, z, button (0 or 1), force x, y, z.
+  void DrainSamples(NPVariant* samples_variant);
+  enum { kSampleStride = 8 };
+
+  // Returns every button press and release since the last call as a packed
+  // array with kButtonEventStride numbers per event: time in milliseconds,
+  // pressed (0 or 1), x, y, z.
+  void DrainEvents(NPVariant* events_variant);
+  enum { kButtonEventStride = 5 };
+
+  // Records every servo tick of every device to the file |name|, see
+  // TrajectoryRecorder::PathForName, until StopRecording. The devices must
+  // be started. Returns whether the recording started.
+  bool StartRecording(const NPString& name, NPVariant* result_variant);
+  // Returns the number of ticks recorded, or null if there was no
+  // recording.
+  bool StopRecording(NPVariant* result_variant);
+
+  // Returns an array holding the scriptable object of every device, this
+  // plugin's own first. Like the position array, it is created once.
+  void GetDevices(NPVariant* devices_variant);
+
+  // Returns the servo loop timing as an object holding the |period|,
+  // |execution| and |forceAge| histograms, see ServoStatsSnapshot. Each has
+  // |count|, |maxUs| and |buckets|, bucket i counting durations below
+  // 2^(i+1) microseconds.
+  void GetStats(NPVariant* stats_variant);
+  bool ResetStats(NPVariant* result_variant);
+
+  // Calls |callback| with (x, y, z, button) from the plugin thread whenever
+  // the device state changes by more than |min_delta|, at most |rate_hz|
+  // times per second. A NULL |callback| cancels the subscription.
+  bool SetStateCallback(NPObject* callback,
+                        double rate_hz,
+                        double min_delta,
+                        NPVariant* result_variant);
+
   bool debug() const { return debug_; }
   void set_debug(bool debug) { debug_ = debug; }
 
-  // Send debug messages to the background.html page within chrome.
+  // Send debug messages to the background.html page within chrome. Messages
+  // are queued and written to the console in batches, so this is cheap
+  // enough for the haptic loop.
   void SendConsole(const char* message);
 
  private:
+  struct ConsoleFlush;
+  struct StateDelivery;
+  struct StartDelivery;
+
+  // Longest message SendConsole keeps, including the terminator.
+  enum { kMaxConsoleMessage = 96 };
+
+  struct ConsoleMessage {
+    char text[kMaxConsoleMessage];
+  };
+
+  // Runs on the servo thread, schedules DeliverState on the plugin thread.
+  static void NotifyStateThunk(hpointer data);
+  static void DeliverStateThunk(void* data);
+  // Hands the latest device state to the subscribed callback.
+  void DeliverState();
+
+  // Runs on the opener thread, schedules DeliverStart on the plugin thread.
+  static void NotifyStartThunk(hpointer data);
+  static void DeliverStartThunk(void* data);
+  void PostStartDelivery();
+  // Finishes a pending start once the devices are open.
+  void DeliverStart();
+  // Calls and drops every callback passed to StartDevice.
+  void ResolveStart(DeviceStatus status);
+
+  // Evaluates a new, empty script array. Returns NULL on failure.
+  NPObject* CreateArray();
+  // Refreshes the array in |*array_object|, created on first use, with
+  // |values| and returns it in |result_variant|.
+  void ReturnVector(const double values[3],
+                    NPObject** array_object,
+                    NPVariant* result_variant);
+
+  // Reads an array of exactly |count| numbers.
+  bool ReadNumbers(NPObject* array_object, int count, double* values);
+  // Reads a 3x3 matrix given as 9 numbers or as one number for its diagonal.
+  bool ReadMatrix(const NPVariant& variant, double matrix[9]);
+
+  // Writes every queued debug message to console.debug in a single call.
+  void FlushConsole();
+  static void FlushConsoleThunk(void* data);
+
   NPP npp_;
   NPObject* scriptable_object_;
   NPObject* window_object_;
+  // Arrays returned by GetPosition, GetVelocity and GetAcceleration,
+  // created on first use.
+  NPObject* position_object_;
+  NPObject* velocity_object_;
+  NPObject* acceleration_object_;
+  // The service of the plugin instance, this one for the first device.
+  HapticsService* primary_;
+  // Acquired by the primary service and shared by the others.
+  DeviceManager* manager_;
+  int device_index_;
+  // This service's client of the device.
   HapticsDevice* device_;
+  // Owned by the primary service: the services of devices 1 and up, and the
+  // array returned by GetDevices, created on first use.
+  std::vector<HapticsService*> device_services_;
+  NPObject* devices_object_;
   bool debug_;
+
+  // The page's console object, looked up on the first flush.
+  NPObject* console_object_;
+  RingBuffer<ConsoleMessage, 256> console_messages_;
+  int dropped_console_messages_;
+  // Flush scheduled through NPN_PluginThreadAsyncCall, if any.
+  ConsoleFlush* pending_flush_;
+
+  // Function subscribed through SetStateCallback.
+  NPObject* state_callback_;
+  // Passed to every NPN_PluginThreadAsyncCall that delivers state.
+  StateDelivery* state_delivery_;
+
+  // Set while StartDevice waits for the devices to open, with the callbacks
+  // to call once they are.
+  bool start_pending_;
+  std::vector<NPObject*> start_callbacks_;
+  // Passed to every NPN_PluginThreadAsyncCall that delivers a start.
+  StartDelivery* start_delivery_;
 };
 
 }  // namespace haptics
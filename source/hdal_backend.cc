@@ -0,0 +1,161 @@
+// Copyright 2010 Mohamed Mansour. All rights reserved.
+// Use of this source code is governed by a GPL license that can
+// be found in the LICENSE file.
+
+#include "hdal_backend.h"
+
+#include "windows.h"
+
+#include <iostream>
+#include <string>
+
+#include "workspace_cache.h"
+
+namespace haptics {
+
+HdalBackend::HdalBackend()
+    : servo_op_(NULL),
+      servo_data_(NULL),
+      started_(false),
+      servo_callback_(HDL_INVALID_HANDLE) {
+}
+
+HdalBackend::~HdalBackend() {
+  Stop();
+  Close();
+}
+
+int HdalBackend::CountDevices() {
+  // Without any device, HDAL still opens the default one and reports why it
+  // could not.
+  int count = hdlCountDevices();
+  return count < 1 ? 1 : count;
+}
+
+bool HdalBackend::Open(int device_count) {
+  int count = CountDevices();
+  if (count != device_count) {
+    std::cout << "Device Failure: Devices were attached or removed.";
+    return false;
+  }
+
+  WorkspaceCache cache(WorkspaceCache::DefaultPath());
+  cache.Load();
+
+  for (int i = 0; i < count; i++) {
+    // A lone device is the one the hdal.ini file from the driver names as
+    // the default, so the configuration keeps working as it did.
+    HDLDeviceHandle handle = count == 1 ? hdlInitNamedDevice((const char*)0)
+                                        : hdlInitIndexedDevice(i);
+    if (handle == HDL_INVALID_HANDLE || !CheckError("hdlInitDevice")) {
+      std::cout << "Device Failure: Could not open device.";
+      Close();
+      return false;
+    }
+    device_handles_.push_back(handle);
+
+    // Only ask models the cache does not know about for their workspace.
+    hdlMakeCurrent(handle);
+    const char* model = hdlDeviceModel();
+    if (!CheckError("hdlDeviceModel")) {
+      Close();
+      return false;
+    }
+    std::string model_name = model ? model : "";
+    double workspace[6];
+    if (!cache.Lookup(model_name, workspace)) {
+      hdlDeviceWorkspace(workspace);
+      if (!CheckError("hdlDeviceWorkspace")) {
+        Close();
+        return false;
+      }
+      cache.Store(model_name, workspace);
+    }
+    workspaces_.insert(workspaces_.end(), workspace, workspace + 6);
+  }
+  cache.Save();
+  return true;
+}
+
+void HdalBackend::Close() {
+  for (size_t i = 0; i < device_handles_.size(); i++)
+    hdlUninitDevice(device_handles_[i]);
+  device_handles_.clear();
+  workspaces_.clear();
+}
+
+bool HdalBackend::Start(ServoOp op, hpointer data) {
+  servo_op_ = op;
+  servo_data_ = data;
+
+  // Now that the device is fully initialized, start the servo thread.
+  // Failing to do this will result in a non-funtional haptics application.
+  hdlStart();
+  if (!CheckError("hdlStart"))
+    return false;
+  started_ = true;
+
+  // Setup the callback function.
+  servo_callback_ = hdlCreateServoOp(ServoThunk, this, false);
+  if (servo_callback_ == HDL_INVALID_HANDLE ||
+      !CheckError("hdlCreateServoOp")) {
+    std::cout << "Device Failure: Invalid servo operation.";
+    Stop();
+    return false;
+  }
+  return true;
+}
+
+void HdalBackend::Stop() {
+  if (servo_callback_ != HDL_INVALID_HANDLE) {
+    hdlDestroyServoOp(servo_callback_);
+    servo_callback_ = HDL_INVALID_HANDLE;
+  }
+  if (started_) {
+    hdlStop();
+    started_ = false;
+  }
+}
+
+void HdalBackend::GetWorkspace(int device, double workspace[6]) {
+  for (int i = 0; i < 6; i++)
+    workspace[i] = workspaces_[device * 6 + i];
+}
+
+void HdalBackend::MakeCurrent(int device) {
+  // All subsequent calls are directed towards the current device.
+  hdlMakeCurrent(device_handles_[device]);
+}
+
+void HdalBackend::GetToolPosition(double position[3]) {
+  hdlToolPosition(position);
+}
+
+void HdalBackend::GetToolButton(bool* button) {
+  hdlToolButton(button);
+}
+
+void HdalBackend::SetToolForce(const double force[3]) {
+  // HDAL doesn't take a const pointer but never writes to it.
+  hdlSetToolForce(const_cast<double*>(force));
+}
+
+bool HdalBackend::CheckError(const char* message) const {
+  HDLError err = hdlGetError();
+  if (err != HDL_NO_ERROR) {
+    // Runs inside the browser, so report the failure to the caller rather
+    // than stopping the whole process.
+    std::cout << "HDAL ERROR: " << message << " (" << err << ")";
+    return false;
+  }
+  return true;
+}
+
+HDLServoOpExitCode HdalBackend::ServoThunk(void* data) {
+  HdalBackend* backend = reinterpret_cast<HdalBackend*>(data);
+  if (backend->servo_op_(backend->servo_data_) == SERVOOP_EXIT)
+    return HDL_SERVOOP_EXIT;
+  return HDL_SERVOOP_CONTINUE;
+}
+
+}  // namespace haptics
@@ -0,0 +1,56 @@
+// Copyright 2010 Mohamed Mansour. All rights reserved.
+// Use of this source code is governed by a GPL license that can
+// be found in the LICENSE file.
+
+#ifndef HDAL_BACKEND_H_
+#define HDAL_BACKEND_H_
+#pragma once
+
+#include <hdl/hdl.h>
+
+#include <vector>
+
+#include "device_backend.h"
+
+namespace haptics {
+
+// Backend for Novint Falcons through the Haptic Device Abstraction Layer.
+// HDAL runs a single servo thread for every device it opened.
+class HdalBackend : public DeviceBackend {
+ public:
+  HdalBackend();
+  virtual ~HdalBackend();
+
+  virtual int CountDevices();
+  virtual bool Open(int device_count);
+  virtual void Close();
+  virtual bool Start(ServoOp op, hpointer data);
+  virtual void Stop();
+  virtual void GetWorkspace(int device, double workspace[6]);
+  virtual void MakeCurrent(int device);
+  virtual void GetToolPosition(double position[3]);
+  virtual void GetToolButton(bool* button);
+  virtual void SetToolForce(const double force[3]);
+
+ private:
+  // Returns false, after logging |message|, if the last HDAL call failed.
+  bool CheckError(const char* message) const;
+
+  // Adapts our servo operation to the HDAL calling convention.
+  static HDLServoOpExitCode ServoThunk(void* data);
+
+  ServoOp servo_op_;
+  hpointer servo_data_;
+  bool started_;
+
+  HDLOpHandle servo_callback_;
+  std::vector<HDLDeviceHandle> device_handles_;
+  // Workspace of every device, read while opening them since HDAL only
+  // reports the one of the current device, or taken from the
+  // WorkspaceCache.
+  std::vector<double> workspaces_;
+};
+
+}  // namespace haptics
+
+#endif  // HDAL_BACKEND_H_
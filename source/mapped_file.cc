@@ -0,0 +1,156 @@
+// Copyright 2010 Mohamed Mansour. All rights reserved.
+// Use of this source code is governed by a GPL license that can
+// be found in the LICENSE file.
+
+#include "mapped_file.h"
+
+#if defined(_WIN32)
+#include "windows.h"
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace haptics {
+
+#if defined(_WIN32)
+
+MappedFile::MappedFile()
+    : writable_(false),
+      handle_(INVALID_HANDLE_VALUE) {
+}
+
+bool MappedFile::Create(const char* path) {
+  Close();
+  handle_ = CreateFileA(path, GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ,
+                        NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+  writable_ = true;
+  return is_open();
+}
+
+bool MappedFile::Open(const char* path) {
+  Close();
+  handle_ = CreateFileA(path, GENERIC_READ, FILE_SHARE_READ, NULL,
+                        OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+  writable_ = false;
+  return is_open();
+}
+
+void MappedFile::Close() {
+  if (is_open())
+    CloseHandle(handle_);
+  handle_ = INVALID_HANDLE_VALUE;
+}
+
+bool MappedFile::is_open() const {
+  return handle_ != INVALID_HANDLE_VALUE;
+}
+
+int64_t MappedFile::size() const {
+  LARGE_INTEGER size;
+  if (!is_open() || !GetFileSizeEx(handle_, &size))
+    return 0;
+  return size.QuadPart;
+}
+
+bool MappedFile::Resize(int64_t size) {
+  LARGE_INTEGER position;
+  position.QuadPart = size;
+  return is_open() &&
+         SetFilePointerEx(handle_, position, NULL, FILE_BEGIN) &&
+         SetEndOfFile(handle_);
+}
+
+void* MappedFile::Map(int64_t offset, size_t length) {
+  if (!is_open())
+    return NULL;
+  // A mapping object of the full extent grows the file. The view keeps the
+  // object alive, so the handle can go right away.
+  uint64_t end = offset + length;
+  HANDLE mapping = CreateFileMapping(
+      handle_, NULL, writable_ ? PAGE_READWRITE : PAGE_READONLY,
+      static_cast<DWORD>(end >> 32), static_cast<DWORD>(end), NULL);
+  if (mapping == NULL)
+    return NULL;
+  void* address = MapViewOfFile(
+      mapping, writable_ ? FILE_MAP_WRITE : FILE_MAP_READ,
+      static_cast<DWORD>(static_cast<uint64_t>(offset) >> 32),
+      static_cast<DWORD>(offset), length);
+  CloseHandle(mapping);
+  return address;
+}
+
+void MappedFile::Unmap(void* address, size_t length) {
+  if (address)
+    UnmapViewOfFile(address);
+}
+
+#else
+
+MappedFile::MappedFile()
+    : writable_(false),
+      fd_(-1) {
+}
+
+bool MappedFile::Create(const char* path) {
+  Close();
+  fd_ = open(path, O_RDWR | O_CREAT | O_TRUNC, 0644);
+  writable_ = true;
+  return is_open();
+}
+
+bool MappedFile::Open(const char* path) {
+  Close();
+  fd_ = open(path, O_RDONLY);
+  writable_ = false;
+  return is_open();
+}
+
+void MappedFile::Close() {
+  if (is_open())
+    close(fd_);
+  fd_ = -1;
+}
+
+bool MappedFile::is_open() const {
+  return fd_ >= 0;
+}
+
+int64_t MappedFile::size() const {
+  struct stat info;
+  if (!is_open() || fstat(fd_, &info) != 0)
+    return 0;
+  return info.st_size;
+}
+
+bool MappedFile::Resize(int64_t size) {
+  return is_open() && ftruncate(fd_, size) == 0;
+}
+
+void* MappedFile::Map(int64_t offset, size_t length) {
+  if (!is_open())
+    return NULL;
+  if (writable_ && size() < static_cast<int64_t>(offset + length) &&
+      !Resize(offset + length)) {
+    return NULL;
+  }
+  void* address = mmap(NULL, length,
+                       writable_ ? PROT_READ | PROT_WRITE : PROT_READ,
+                       MAP_SHARED, fd_, offset);
+  return address == MAP_FAILED ? NULL : address;
+}
+
+void MappedFile::Unmap(void* address, size_t length) {
+  if (address)
+    munmap(address, length);
+}
+
+#endif
+
+MappedFile::~MappedFile() {
+  Close();
+}
+
+}  // namespace haptics
@@ -0,0 +1,55 @@
+// Copyright 2010 Mohamed Mansour. All rights reserved.
+// Use of this source code is governed by a GPL license that can
+// be found in the LICENSE file.
+
+#ifndef MAPPED_FILE_H_
+#define MAPPED_FILE_H_
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+
+namespace haptics {
+
+// Thin wrapper around a file whose contents are accessed through memory
+// mappings, so the servo thread can read or write them without syscalls.
+class MappedFile {
+ public:
+  // Mapping offsets are multiples of this, the allocation granularity of
+  // Windows and a multiple of the page size everywhere else.
+  enum { kGranularity = 65536 };
+
+  MappedFile();
+  ~MappedFile();
+
+  // Creates |path|, or empties it, for reading and writing.
+  bool Create(const char* path);
+  // Opens an existing |path| for reading only.
+  bool Open(const char* path);
+  void Close();
+  bool is_open() const;
+
+  int64_t size() const;
+  // Grows or truncates the file. Every mapping must be gone when shrinking.
+  bool Resize(int64_t size);
+
+  // Maps |length| bytes at |offset|, a multiple of kGranularity. A writable
+  // file grows to cover them. Returns NULL on failure.
+  void* Map(int64_t offset, size_t length);
+  static void Unmap(void* address, size_t length);
+
+ private:
+  bool writable_;
+#if defined(_WIN32)
+  void* handle_;
+#else
+  int fd_;
+#endif
+
+  MappedFile(const MappedFile&);
+  void operator=(const MappedFile&);
+};
+
+}  // namespace haptics
+
+#endif  // MAPPED_FILE_H_
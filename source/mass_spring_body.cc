@@ -0,0 +1,346 @@
+// Copyright 2010 Mohamed Mansour. All rights reserved.
+// Use of this source code is governed by a GPL license that can
+// be found in the LICENSE file.
+
+#include "mass_spring_body.h"
+
+#include <math.h>
+
+#include <algorithm>
+
+#include "simd_ops.h"
+
+namespace haptics {
+
+namespace {
+
+// Springs shorter than this have no direction to push along.
+const double kMinLength = 1e-9;
+
+// Step returned by StableTimeStep for a body that cannot move.
+const double kUnboundedTimeStep = 1.0;
+
+bool IsIndex(double value, int count) {
+  return value >= 0 && value < count && value == floor(value);
+}
+
+}  // namespace
+
+MassSpringBody::MassSpringBody()
+    : damping_(0.0),
+      max_stiffness_per_mass_(0.0),
+      max_damping_per_mass_(0.0),
+      max_inverse_mass_(0.0) {
+}
+
+bool MassSpringBody::Build(const std::vector<double>& nodes,
+                           const std::vector<double>& springs,
+                           double damping) {
+  if (nodes.empty() || nodes.size() % 4 != 0 || springs.size() % 3 != 0 ||
+      !(damping >= 0.0)) {
+    return false;
+  }
+  int node_count = static_cast<int>(nodes.size() / 4);
+  int spring_count = static_cast<int>(springs.size() / 3);
+
+  x_.resize(node_count);
+  y_.resize(node_count);
+  z_.resize(node_count);
+  inverse_mass_.resize(node_count);
+  for (int i = 0; i < node_count; i++) {
+    const double* node = &nodes[i * 4];
+    if (!(node[3] >= 0.0))
+      return false;
+    x_[i] = node[0];
+    y_[i] = node[1];
+    z_[i] = node[2];
+    inverse_mass_[i] = node[3] > 0.0 ? 1.0 / node[3] : 0.0;
+  }
+  vx_.assign(node_count, 0.0);
+  vy_.assign(node_count, 0.0);
+  vz_.assign(node_count, 0.0);
+  fx_.assign(node_count, 0.0);
+  fy_.assign(node_count, 0.0);
+  fz_.assign(node_count, 0.0);
+
+  first_.resize(spring_count);
+  second_.resize(spring_count);
+  rest_length_.resize(spring_count);
+  stiffness_.resize(spring_count);
+  std::vector<double> stiffness_sum(node_count, 0.0);
+  std::vector<double> damping_sum(node_count, 0.0);
+  for (int i = 0; i < spring_count; i++) {
+    const double* spring = &springs[i * 3];
+    if (!IsIndex(spring[0], node_count) || !IsIndex(spring[1], node_count) ||
+        spring[0] == spring[1] || !(spring[2] >= 0.0)) {
+      return false;
+    }
+    int a = static_cast<int>(spring[0]);
+    int b = static_cast<int>(spring[1]);
+    double dx = x_[b] - x_[a];
+    double dy = y_[b] - y_[a];
+    double dz = z_[b] - z_[a];
+    double length = sqrt(dx * dx + dy * dy + dz * dz);
+    if (length < kMinLength)
+      return false;
+    first_[i] = a;
+    second_[i] = b;
+    rest_length_[i] = length;
+    stiffness_[i] = spring[2];
+    stiffness_sum[a] += spring[2];
+    stiffness_sum[b] += spring[2];
+    damping_sum[a] += damping;
+    damping_sum[b] += damping;
+  }
+  damping_ = damping;
+
+  max_stiffness_per_mass_ = 0.0;
+  max_damping_per_mass_ = 0.0;
+  max_inverse_mass_ = 0.0;
+  for (int i = 0; i < node_count; i++) {
+    double inverse_mass = inverse_mass_[i];
+    max_stiffness_per_mass_ =
+        std::max(max_stiffness_per_mass_, stiffness_sum[i] * inverse_mass);
+    max_damping_per_mass_ =
+        std::max(max_damping_per_mass_, damping_sum[i] * inverse_mass);
+    max_inverse_mass_ = std::max(max_inverse_mass_, inverse_mass);
+  }
+  return true;
+}
+
+double MassSpringBody::StableTimeStep(double contact_stiffness) const {
+  // Every eigenvalue of the mass-weighted stiffness is below twice the
+  // largest row sum, and semi-implicit Euler is stable for steps under
+  // 2 / sqrt(eigenvalue). Keep half of that as margin, and the same for the
+  // damping.
+  double omega_squared = 2.0 * max_stiffness_per_mass_ +
+                         contact_stiffness * max_inverse_mass_;
+  double step = kUnboundedTimeStep;
+  if (omega_squared > 0.0)
+    step = std::min(step, 1.0 / sqrt(omega_squared));
+  if (max_damping_per_mass_ > 0.0)
+    step = std::min(step, 0.5 / max_damping_per_mass_);
+  return step;
+}
+
+void MassSpringBody::Step(double dt,
+                          const DeformableTool* tool,
+                          DeformableContact* contact) {
+  AccumulateSpringForces();
+  if (contact) {
+    for (int i = 0; i < 3; i++) {
+      contact->force[i] = 0.0;
+      contact->anchor[i] = tool ? tool->position[i] : 0.0;
+    }
+    for (int i = 0; i < 9; i++)
+      contact->stiffness[i] = 0.0;
+    contact->node_count = 0;
+  }
+  if (tool)
+    AccumulateContactForces(*tool, contact);
+  Integrate(dt);
+}
+
+void MassSpringBody::AccumulateSpringForces() {
+  std::fill(fx_.begin(), fx_.end(), 0.0);
+  std::fill(fy_.begin(), fy_.end(), 0.0);
+  std::fill(fz_.begin(), fz_.end(), 0.0);
+  const double* x = &x_[0];
+  const double* y = &y_[0];
+  const double* z = &z_[0];
+  const double* vx = &vx_[0];
+  const double* vy = &vy_[0];
+  const double* vz = &vz_[0];
+  double* fx = &fx_[0];
+  double* fy = &fy_[0];
+  double* fz = &fz_[0];
+
+  // Each spring pulls its first node towards the second in proportion to
+  // how far it is stretched and how fast it is stretching, and the second
+  // node the other way.
+  int count = spring_count();
+  int i = 0;
+#if defined(HAPTICS_SSE2)
+  // Two springs per iteration: the node data is gathered into the lanes,
+  // the forces are scattered back one by one since the two springs may
+  // share a node.
+  const __m128d damping = _mm_set1_pd(damping_);
+  const __m128d min_length = _mm_set1_pd(kMinLength);
+  const __m128d one = _mm_set1_pd(1.0);
+  for (; i + 1 < count; i += 2) {
+    int a0 = first_[i];
+    int a1 = first_[i + 1];
+    int b0 = second_[i];
+    int b1 = second_[i + 1];
+    __m128d dx = _mm_sub_pd(_mm_set_pd(x[b1], x[b0]),
+                            _mm_set_pd(x[a1], x[a0]));
+    __m128d dy = _mm_sub_pd(_mm_set_pd(y[b1], y[b0]),
+                            _mm_set_pd(y[a1], y[a0]));
+    __m128d dz = _mm_sub_pd(_mm_set_pd(z[b1], z[b0]),
+                            _mm_set_pd(z[a1], z[a0]));
+    __m128d dvx = _mm_sub_pd(_mm_set_pd(vx[b1], vx[b0]),
+                             _mm_set_pd(vx[a1], vx[a0]));
+    __m128d dvy = _mm_sub_pd(_mm_set_pd(vy[b1], vy[b0]),
+                             _mm_set_pd(vy[a1], vy[a0]));
+    __m128d dvz = _mm_sub_pd(_mm_set_pd(vz[b1], vz[b0]),
+                             _mm_set_pd(vz[a1], vz[a0]));
+
+    __m128d length_squared = _mm_add_pd(
+        _mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy)),
+        _mm_mul_pd(dz, dz));
+    __m128d length = _mm_max_pd(_mm_sqrt_pd(length_squared), min_length);
+    __m128d inverse_length = _mm_div_pd(one, length);
+    __m128d stretch_speed = _mm_mul_pd(
+        _mm_add_pd(_mm_add_pd(_mm_mul_pd(dvx, dx), _mm_mul_pd(dvy, dy)),
+                   _mm_mul_pd(dvz, dz)),
+        inverse_length);
+    __m128d stretch = _mm_sub_pd(length, _mm_loadu_pd(&rest_length_[i]));
+    __m128d magnitude = _mm_add_pd(
+        _mm_mul_pd(_mm_loadu_pd(&stiffness_[i]), stretch),
+        _mm_mul_pd(damping, stretch_speed));
+    __m128d scale = _mm_mul_pd(magnitude, inverse_length);
+
+    double force_x[2], force_y[2], force_z[2];
+    _mm_storeu_pd(force_x, _mm_mul_pd(scale, dx));
+    _mm_storeu_pd(force_y, _mm_mul_pd(scale, dy));
+    _mm_storeu_pd(force_z, _mm_mul_pd(scale, dz));
+    fx[a0] += force_x[0];
+    fy[a0] += force_y[0];
+    fz[a0] += force_z[0];
+    fx[b0] -= force_x[0];
+    fy[b0] -= force_y[0];
+    fz[b0] -= force_z[0];
+    fx[a1] += force_x[1];
+    fy[a1] += force_y[1];
+    fz[a1] += force_z[1];
+    fx[b1] -= force_x[1];
+    fy[b1] -= force_y[1];
+    fz[b1] -= force_z[1];
+  }
+#endif
+  for (; i < count; i++) {
+    int a = first_[i];
+    int b = second_[i];
+    double dx = x[b] - x[a];
+    double dy = y[b] - y[a];
+    double dz = z[b] - z[a];
+    double length = std::max(sqrt(dx * dx + dy * dy + dz * dz), kMinLength);
+    double inverse_length = 1.0 / length;
+    double stretch_speed = ((vx[b] - vx[a]) * dx + (vy[b] - vy[a]) * dy +
+                            (vz[b] - vz[a]) * dz) * inverse_length;
+    double magnitude = stiffness_[i] * (length - rest_length_[i]) +
+                       damping_ * stretch_speed;
+    double scale = magnitude * inverse_length;
+    fx[a] += scale * dx;
+    fy[a] += scale * dy;
+    fz[a] += scale * dz;
+    fx[b] -= scale * dx;
+    fy[b] -= scale * dy;
+    fz[b] -= scale * dz;
+  }
+}
+
+void MassSpringBody::AccumulateContactForces(const DeformableTool& tool,
+                                             DeformableContact* contact) {
+  const double* center = tool.position;
+  double radius_squared = tool.radius * tool.radius;
+  int count = node_count();
+  for (int i = 0; i < count; i++) {
+#if defined(HAPTICS_SSE2)
+    // Almost every node is out of reach, so test two at a time and only
+    // look closer at a pair with a node inside.
+    if (i + 1 < count) {
+      __m128d dx = _mm_sub_pd(_mm_loadu_pd(&x_[i]), _mm_set1_pd(center[0]));
+      __m128d dy = _mm_sub_pd(_mm_loadu_pd(&y_[i]), _mm_set1_pd(center[1]));
+      __m128d dz = _mm_sub_pd(_mm_loadu_pd(&z_[i]), _mm_set1_pd(center[2]));
+      __m128d distance_squared = _mm_add_pd(
+          _mm_add_pd(_mm_mul_pd(dx, dx), _mm_mul_pd(dy, dy)),
+          _mm_mul_pd(dz, dz));
+      if (_mm_movemask_pd(_mm_cmplt_pd(distance_squared,
+                                       _mm_set1_pd(radius_squared))) == 0) {
+        i++;
+        continue;
+      }
+    }
+#endif
+    double offset[3] = {
+      x_[i] - center[0],
+      y_[i] - center[1],
+      z_[i] - center[2]
+    };
+    double distance_squared = offset[0] * offset[0] +
+                              offset[1] * offset[1] +
+                              offset[2] * offset[2];
+    if (distance_squared >= radius_squared)
+      continue;
+    double distance = sqrt(distance_squared);
+    if (distance < kMinLength)
+      continue;
+
+    double normal[3];
+    for (int j = 0; j < 3; j++)
+      normal[j] = offset[j] / distance;
+    double push = tool.stiffness * (tool.radius - distance);
+    fx_[i] += push * normal[0];
+    fy_[i] += push * normal[1];
+    fz_[i] += push * normal[2];
+    if (contact == NULL)
+      continue;
+
+    // The tool gets the reaction. Only the normal part of its Jacobian is
+    // kept, which never pushes the tool further in.
+    for (int j = 0; j < 3; j++) {
+      contact->force[j] -= push * normal[j];
+      for (int k = 0; k < 3; k++)
+        contact->stiffness[j * 3 + k] -= tool.stiffness * normal[j] * normal[k];
+    }
+    contact->node_count++;
+  }
+}
+
+void MassSpringBody::Integrate(double dt) {
+  int count = node_count();
+  int i = 0;
+#if defined(HAPTICS_SSE2)
+  const __m128d step = _mm_set1_pd(dt);
+  for (; i + 1 < count; i += 2) {
+    __m128d impulse = _mm_mul_pd(_mm_loadu_pd(&inverse_mass_[i]), step);
+    __m128d vx = _mm_add_pd(_mm_loadu_pd(&vx_[i]),
+                            _mm_mul_pd(impulse, _mm_loadu_pd(&fx_[i])));
+    __m128d vy = _mm_add_pd(_mm_loadu_pd(&vy_[i]),
+                            _mm_mul_pd(impulse, _mm_loadu_pd(&fy_[i])));
+    __m128d vz = _mm_add_pd(_mm_loadu_pd(&vz_[i]),
+                            _mm_mul_pd(impulse, _mm_loadu_pd(&fz_[i])));
+    _mm_storeu_pd(&vx_[i], vx);
+    _mm_storeu_pd(&vy_[i], vy);
+    _mm_storeu_pd(&vz_[i], vz);
+    _mm_storeu_pd(&x_[i], _mm_add_pd(_mm_loadu_pd(&x_[i]),
+                                     _mm_mul_pd(step, vx)));
+    _mm_storeu_pd(&y_[i], _mm_add_pd(_mm_loadu_pd(&y_[i]),
+                                     _mm_mul_pd(step, vy)));
+    _mm_storeu_pd(&z_[i], _mm_add_pd(_mm_loadu_pd(&z_[i]),
+                                     _mm_mul_pd(step, vz)));
+  }
+#endif
+  for (; i < count; i++) {
+    double impulse = inverse_mass_[i] * dt;
+    vx_[i] += impulse * fx_[i];
+    vy_[i] += impulse * fy_[i];
+    vz_[i] += impulse * fz_[i];
+    x_[i] += dt * vx_[i];
+    y_[i] += dt * vy_[i];
+    z_[i] += dt * vz_[i];
+  }
+}
+
+void MassSpringBody::GetPositions(std::vector<double>* positions) const {
+  int count = node_count();
+  positions->reserve(positions->size() + count * 3);
+  for (int i = 0; i < count; i++) {
+    positions->push_back(x_[i]);
+    positions->push_back(y_[i]);
+    positions->push_back(z_[i]);
+  }
+}
+
+}  // namespace haptics
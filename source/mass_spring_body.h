@@ -0,0 +1,101 @@
+// Copyright 2010 Mohamed Mansour. All rights reserved.
+// Use of this source code is governed by a GPL license that can
+// be found in the LICENSE file.
+
+#ifndef MASS_SPRING_BODY_H_
+#define MASS_SPRING_BODY_H_
+#pragma once
+
+#include <vector>
+
+namespace haptics {
+
+// The haptic tool as the body feels it: a sphere that pushes nodes out of
+// it with a linear spring.
+struct DeformableTool {
+  double position[3];
+  double radius;
+  // N/m per node in contact.
+  double stiffness;
+};
+
+// Force of the body on the tool, as a local linear model the servo thread
+// evaluates on every tick between two simulation steps:
+//   force + stiffness * (position - anchor)
+// where |stiffness| is a row-major 3x3 Jacobian, like in ForceCommand.
+struct DeformableContact {
+  double force[3];
+  double anchor[3];
+  double stiffness[9];
+  // Nodes inside the tool. Without any there is no force.
+  int node_count;
+};
+
+// Deformable object made of point masses joined by damped springs. Nodes and
+// springs are stored as structures of arrays, so the spring forces are
+// computed two springs at a time with SSE2 and integration streams through
+// memory. Built once on the application thread, then only stepped by the
+// thread that simulates it.
+class MassSpringBody {
+ public:
+  MassSpringBody();
+
+  // Builds the body from |nodes|, x, y, z and mass per node, and |springs|,
+  // the indices of two nodes and a stiffness in N/m per spring. Springs are
+  // at rest in the given shape. Nodes with a mass of 0 are pinned in place.
+  // |damping| in N.s/m resists the stretching of every spring. Returns false
+  // if the data is malformed.
+  bool Build(const std::vector<double>& nodes,
+             const std::vector<double>& springs,
+             double damping);
+
+  int node_count() const { return static_cast<int>(x_.size()); }
+  int spring_count() const { return static_cast<int>(first_.size()); }
+
+  // Longest step the integration stays stable with while a tool pushing
+  // with |contact_stiffness| touches the body.
+  double StableTimeStep(double contact_stiffness) const;
+
+  // Advances the body by |dt| seconds, with |tool| pushing nodes if it is
+  // not NULL. |contact|, if not NULL, receives the force the nodes push the
+  // tool with at the start of the step.
+  void Step(double dt,
+            const DeformableTool* tool,
+            DeformableContact* contact);
+
+  // Appends the position of every node to |positions|, x, y, z per node.
+  void GetPositions(std::vector<double>* positions) const;
+
+ private:
+  // Sets |fx_|, |fy_| and |fz_| to the spring forces.
+  void AccumulateSpringForces();
+  // Adds the push of |tool| to the forces, and its reaction to |contact|.
+  void AccumulateContactForces(const DeformableTool& tool,
+                               DeformableContact* contact);
+  // Semi-implicit Euler: velocities from the forces, then positions from
+  // the new velocities.
+  void Integrate(double dt);
+
+  // Per node.
+  std::vector<double> x_, y_, z_;
+  std::vector<double> vx_, vy_, vz_;
+  std::vector<double> fx_, fy_, fz_;
+  // Zero for pinned nodes.
+  std::vector<double> inverse_mass_;
+
+  // Per spring.
+  std::vector<int> first_, second_;
+  std::vector<double> rest_length_;
+  std::vector<double> stiffness_;
+  double damping_;
+
+  // Bounds for StableTimeStep: the largest spring stiffness and damping
+  // around a node over its mass, and the largest inverse mass.
+  double max_stiffness_per_mass_;
+  double max_damping_per_mass_;
+  double max_inverse_mass_;
+};
+
+}  // namespace haptics
+
+#endif  // MASS_SPRING_BODY_H_
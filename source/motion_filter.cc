@@ -0,0 +1,108 @@
+// Copyright 2010 Mohamed Mansour. All rights reserved.
+// Use of this source code is governed by a GPL license that can
+// be found in the LICENSE file.
+
+#include "motion_filter.h"
+
+#include "simd_ops.h"
+
+namespace haptics {
+
+namespace {
+
+const double kPi = 3.14159265358979323846;
+
+double TimeConstant(double cutoff_hz) {
+  return cutoff_hz > 0.0 ? 1.0 / (2.0 * kPi * cutoff_hz) : 0.0;
+}
+
+// Share of the new value a first-order low-pass with |time_constant| lets
+// through after |dt| seconds.
+double Gain(double time_constant, double dt) {
+  return dt / (time_constant + dt);
+}
+
+}  // namespace
+
+MotionFilter::MotionFilter()
+    : velocity_time_constant_(TimeConstant(100.0)),
+      acceleration_time_constant_(TimeConstant(20.0)) {
+  Reset();
+}
+
+void MotionFilter::Configure(const MotionFilterSettings& settings) {
+  velocity_time_constant_ = TimeConstant(settings.velocity_cutoff_hz);
+  acceleration_time_constant_ = TimeConstant(settings.acceleration_cutoff_hz);
+}
+
+void MotionFilter::Reset() {
+  for (int i = 0; i < 4; i++) {
+    position_[i] = 0.0;
+    velocity_[i] = 0.0;
+    acceleration_[i] = 0.0;
+  }
+  time_ = 0;
+  samples_ = 0;
+}
+
+void MotionFilter::Update(int64_t now, const double position[3]) {
+  if (samples_ > 0 && now <= time_)
+    return;
+  if (samples_ == 0) {
+    for (int i = 0; i < 3; i++)
+      position_[i] = position[i];
+    time_ = now;
+    samples_ = 1;
+    return;
+  }
+
+  double dt = (now - time_) / 1000000.0;
+  double inverse_dt = 1.0 / dt;
+  double velocity_gain = Gain(velocity_time_constant_, dt);
+  // The first velocity jumps from rest, which is no acceleration.
+  double acceleration_gain =
+      samples_ > 1 ? Gain(acceleration_time_constant_, dt) : 0.0;
+  time_ = now;
+  samples_ = 2;
+
+#if defined(HAPTICS_SSE2)
+  __m128d inverse = _mm_set1_pd(inverse_dt);
+  __m128d velocity_alpha = _mm_set1_pd(velocity_gain);
+  __m128d acceleration_alpha = _mm_set1_pd(acceleration_gain);
+  __m128d current[2] = { _mm_loadu_pd(position), _mm_load_sd(position + 2) };
+  for (int i = 0; i < 2; i++) {
+    __m128d last_position = _mm_loadu_pd(position_ + i * 2);
+    __m128d last_velocity = _mm_loadu_pd(velocity_ + i * 2);
+    __m128d last_acceleration = _mm_loadu_pd(acceleration_ + i * 2);
+
+    __m128d raw_velocity =
+        _mm_mul_pd(_mm_sub_pd(current[i], last_position), inverse);
+    __m128d velocity = _mm_add_pd(
+        last_velocity,
+        _mm_mul_pd(velocity_alpha, _mm_sub_pd(raw_velocity, last_velocity)));
+    __m128d raw_acceleration =
+        _mm_mul_pd(_mm_sub_pd(velocity, last_velocity), inverse);
+    __m128d acceleration = _mm_add_pd(
+        last_acceleration,
+        _mm_mul_pd(acceleration_alpha,
+                   _mm_sub_pd(raw_acceleration, last_acceleration)));
+
+    _mm_storeu_pd(position_ + i * 2, current[i]);
+    _mm_storeu_pd(velocity_ + i * 2, velocity);
+    _mm_storeu_pd(acceleration_ + i * 2, acceleration);
+  }
+#else
+  for (int i = 0; i < 3; i++) {
+    double raw_velocity = (position[i] - position_[i]) * inverse_dt;
+    double velocity =
+        velocity_[i] + velocity_gain * (raw_velocity - velocity_[i]);
+    double raw_acceleration = (velocity - velocity_[i]) * inverse_dt;
+    acceleration_[i] +=
+        acceleration_gain * (raw_acceleration - acceleration_[i]);
+    velocity_[i] = velocity;
+    position_[i] = position[i];
+  }
+#endif
+}
+
+}  // namespace haptics
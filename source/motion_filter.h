@@ -0,0 +1,61 @@
+// Copyright 2010 Mohamed Mansour. All rights reserved.
+// Use of this source code is governed by a GPL license that can
+// be found in the LICENSE file.
+
+#ifndef MOTION_FILTER_H_
+#define MOTION_FILTER_H_
+#pragma once
+
+#include <stdint.h>
+
+namespace haptics {
+
+// Cutoff frequencies of the low-pass filters MotionFilter runs, in Hz. Zero
+// turns a filter off and leaves the plain finite difference.
+struct MotionFilterSettings {
+  double velocity_cutoff_hz;
+  double acceleration_cutoff_hz;
+};
+
+// Estimates the velocity and acceleration of the tool from the position of
+// every servo tick. Each is the finite difference of the stage before it,
+// smoothed by a first-order low-pass whose gain follows the real time
+// between ticks, so an irregular servo rate does not show up as motion.
+// Every update costs the same, and the three axes are filtered together.
+class MotionFilter {
+ public:
+  // Smoothed at 100 Hz and 20 Hz, enough to hide the encoder steps of a
+  // Falcon at 1 kHz without delaying damping by more than a couple of ticks.
+  MotionFilter();
+
+  void Configure(const MotionFilterSettings& settings);
+
+  // Forgets the motion so far. The next update starts from rest.
+  void Reset();
+
+  // Takes the position sampled at |now|, in microseconds on the clock of the
+  // servo loop, DeviceBackend::Now(), which a replay runs at its own pace.
+  void Update(int64_t now, const double position[3]);
+
+  // Units of position per second, and per second squared.
+  const double* velocity() const { return velocity_; }
+  const double* acceleration() const { return acceleration_; }
+
+ private:
+  // Time constants of the filters, in seconds.
+  double velocity_time_constant_;
+  double acceleration_time_constant_;
+
+  // x, y, z and an unused fourth lane, so each vector fills two SSE2
+  // registers.
+  double position_[4];
+  double velocity_[4];
+  double acceleration_[4];
+  int64_t time_;
+  // Number of positions seen since the last reset, up to 2.
+  int samples_;
+};
+
+}  // namespace haptics
+
+#endif  // MOTION_FILTER_H_
@@ -8,8 +8,10 @@
 #include "npapi.h"
 
 #include "haptics_service.h"
+#include "scripting_bridge.h"
 
 using haptics::HapticsService;
+using haptics::ScriptingBridge;
 
 // This file implements functions that the plugin is expected to implement so
 // that the browser can call them.
@@ -19,18 +21,23 @@ using haptics::HapticsService;
 // information for the plugin instance that is being allocated.
 // Declaration: npapi.h
 // Documentation URL: https://developer.mozilla.org/en/NPP_New
-NPError NPP_New(NPMIMEType mime_type,
+NPError NPP_New(NPMIMEType /* mime_type */,
                 NPP instance,
-                uint16_t mode,
-                int16_t argc,
-                char* argn[],
-                char* argv[],
-                NPSavedData* saved) {    
+                uint16_t /* mode */,
+                int16_t /* argc */,
+                char* /* argn */[],
+                char* /* argv */[],
+                NPSavedData* /* saved */) {    
   extern NPNetscapeFuncs* GetNetscapeFuncs();
   if (instance == NULL) {
     return NPERR_INVALID_INSTANCE_ERROR;
   }
 
+  // Without its dispatch tables the bridge cannot answer any call.
+  if (!ScriptingBridge::InitializeIdentifiers()) {
+    return NPERR_GENERIC_ERROR;
+  }
+
   HapticsService* haptics_service =
       new(std::nothrow) HapticsService(instance);
   if (haptics_service == NULL) {
@@ -47,7 +54,7 @@ NPError NPP_New(NPMIMEType mime_type,
 // note that browser may choose to throw it away.
 // Declaration: npapi.h
 // Documentation URL: https://developer.mozilla.org/en/NPP_Destroy
-NPError NPP_Destroy(NPP instance, NPSavedData** save) {
+NPError NPP_Destroy(NPP instance, NPSavedData** /* save */) {
   if (instance == NULL) {
     return NPERR_INVALID_INSTANCE_ERROR;
   }
@@ -98,7 +105,7 @@ NPError NPP_GetValue(NPP instance, NPPVariable variable, void *value) {
 // ignored.
 // Declaration: npapi.h
 // Documentation URL: https://developer.mozilla.org/en/NPP_HandleEvent
-int16_t NPP_HandleEvent(NPP instance, void* event) {
+int16_t NPP_HandleEvent(NPP /* instance */, void* /* event */) {
   return 0;
 }
 
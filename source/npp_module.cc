@@ -2,11 +2,32 @@
 // Use of this source code is governed by a GPL license that can
 // be found in the LICENSE file.
 
+#include <string.h>
+
 #include "npapi.h"
 #include "npfunctions.h"
 
 extern NPNetscapeFuncs* npnfuncs;
 
+namespace {
+
+// Keeps the table of browser functions every NPN_* call goes through.
+NPError InitializeNetscapeFuncs(NPNetscapeFuncs* npnf) {
+  if(npnf == NULL)
+    return NPERR_INVALID_FUNCTABLE_ERROR;
+
+  if((npnf->version >> 8) > NP_VERSION_MAJOR)
+    return NPERR_INCOMPATIBLE_VERSION_ERROR;
+
+  if(npnf->size < sizeof(NPNetscapeFuncs)) 
+    return NPERR_INVALID_FUNCTABLE_ERROR; 
+
+  npnfuncs = npnf;
+  return NPERR_NO_ERROR;
+}
+
+}  // namespace
+
 extern "C" {
 // When the browser calls NP_Initialize the plugin needs to return a list
 // of functions that have been implemented so that the browser can
@@ -23,22 +44,48 @@ NPError OSCALL NP_GetEntryPoints(NPPluginFuncs *plugin_functions) {
   return NPERR_NO_ERROR;
 }
 
+#if defined(XP_UNIX)
+// Unix browsers never call NP_GetEntryPoints, they hand over both tables
+// here instead.
+// Declaration: npfunctions.h
+// Documentation URL: https://developer.mozilla.org/en/NP_Initialize
+NPError NP_Initialize(NPNetscapeFuncs* npnf,
+                      NPPluginFuncs* plugin_functions) {
+  NPError error = InitializeNetscapeFuncs(npnf);
+  if (error != NPERR_NO_ERROR)
+    return error;
+  return NP_GetEntryPoints(plugin_functions);
+}
+
+// The MIME type the plugin handles, the MIMEType of resource_plugin.rc.
+// Documentation URL: https://developer.mozilla.org/en/NP_GetMIMEDescription
+const char* NP_GetMIMEDescription() {
+  return "application/x-vnd-haptics::Haptics Plugin";
+}
+
+// Name and description of the plugin, from resource_plugin.rc on Windows.
+// Documentation URL: https://developer.mozilla.org/en/NP_GetValue
+NPError NP_GetValue(void* /* future */, NPPVariable variable, void* value) {
+  switch (variable) {
+    case NPPVpluginNameString:
+      *static_cast<const char**>(value) = "Haptics Plugin";
+      return NPERR_NO_ERROR;
+    case NPPVpluginDescriptionString:
+      *static_cast<const char**>(value) =
+          "NPAPI Plugin that communicates to the haptics device";
+      return NPERR_NO_ERROR;
+    default:
+      return NPERR_INVALID_PARAM;
+  }
+}
+#else
 // Provides global initialization for a plug-in.
 // Declaration: npapi.h
 // Documentation URL: https://developer.mozilla.org/en/NP_Initialize
 NPError OSCALL NP_Initialize(NPNetscapeFuncs *npnf) {
-  if(npnf == NULL)
-    return NPERR_INVALID_FUNCTABLE_ERROR;
-
-  if(HIBYTE(npnf->version) > NP_VERSION_MAJOR)
-    return NPERR_INCOMPATIBLE_VERSION_ERROR;
-
-  if(npnf->size < sizeof(NPNetscapeFuncs)) 
-    return NPERR_INVALID_FUNCTABLE_ERROR; 
-
-  npnfuncs = npnf;
-  return NPERR_NO_ERROR;
+  return InitializeNetscapeFuncs(npnf);
 }
+#endif
 
 // Provides global deinitialization for a plug-in.
 // Declaration: npapi.h
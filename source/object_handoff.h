@@ -0,0 +1,76 @@
+// Copyright 2010 Mohamed Mansour. All rights reserved.
+// Use of this source code is governed by a GPL license that can
+// be found in the LICENSE file.
+
+#ifndef OBJECT_HANDOFF_H_
+#define OBJECT_HANDOFF_H_
+#pragma once
+
+#include <stddef.h>
+
+#include "atomic_ops.h"
+
+namespace haptics {
+
+// Passes ownership of large, heap allocated objects (meshes, volumes) from
+// the application thread to the servo thread without copying them and
+// without the servo thread ever allocating, freeing or waiting.
+//
+// The application publishes a new object, the servo thread swaps it in at the
+// start of its next tick and hands the object it replaced back through the
+// |retired_| slot, where the application frees it on its next publish. The
+// servo thread only swaps while that slot is empty, so no object is ever lost
+// and no object is freed while the servo thread may still use it.
+//
+// To remove an object, publish an empty one rather than NULL.
+template <typename T>
+class ObjectHandoff {
+ public:
+  ObjectHandoff() : pending_(NULL), retired_(NULL), active_(NULL) {}
+
+  // Only safe once the servo thread no longer calls Acquire().
+  ~ObjectHandoff() {
+    delete static_cast<T*>(pending_);
+    delete static_cast<T*>(retired_);
+    delete active_;
+  }
+
+  // Application thread: hands |object| to the servo thread.
+  void Publish(T* object) {
+    delete static_cast<T*>(AtomicExchangePointer(&retired_, NULL));
+    // An object the servo thread never picked up can go right away.
+    delete static_cast<T*>(AtomicExchangePointer(&pending_, object));
+  }
+
+  // Servo thread: returns the object to use for this tick, or NULL if none
+  // was ever published. Sets |*changed| when a new object was swapped in.
+  T* Acquire(bool* changed) {
+    *changed = false;
+    if (AcquireLoadPointer(&pending_) == NULL ||
+        AcquireLoadPointer(&retired_) != NULL) {
+      return active_;
+    }
+    T* object = static_cast<T*>(AtomicExchangePointer(&pending_, NULL));
+    if (object) {
+      AtomicExchangePointer(&retired_, active_);
+      active_ = object;
+      *changed = true;
+    }
+    return active_;
+  }
+
+ private:
+  // Published by the application, not yet picked up by the servo thread.
+  HAPTICS_CACHE_ALIGNED void* volatile pending_;
+  // Replaced by the servo thread, not yet freed by the application.
+  HAPTICS_CACHE_ALIGNED void* volatile retired_;
+  // In use by the servo thread.
+  HAPTICS_CACHE_ALIGNED T* active_;
+
+  ObjectHandoff(const ObjectHandoff&);
+  void operator=(const ObjectHandoff&);
+};
+
+}  // namespace haptics
+
+#endif  // OBJECT_HANDOFF_H_
@@ -0,0 +1,140 @@
+// Copyright 2010 Mohamed Mansour. All rights reserved.
+// Use of this source code is governed by a GPL license that can
+// be found in the LICENSE file.
+
+#include "packed_array.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <string>
+
+namespace {
+
+// Longest text a single value takes: "%.15g" plus the separator.
+const int kMaxValueLength = 24;
+
+const char* SkipSpace(const char* cursor) {
+  while (*cursor == ' ' || *cursor == '\n' || *cursor == '\r' ||
+         *cursor == '\t') {
+    cursor++;
+  }
+  return cursor;
+}
+
+bool IsDigit(char c) {
+  return c >= '0' && c <= '9';
+}
+
+const char* SkipDigits(const char* cursor) {
+  while (IsDigit(*cursor))
+    cursor++;
+  return cursor;
+}
+
+// Returns the end of the JSON number at |cursor|, or NULL if there is none.
+// strtod alone also takes "nan", "inf", hex and a leading '+'.
+const char* ScanNumber(const char* cursor) {
+  if (*cursor == '-')
+    cursor++;
+  if (!IsDigit(*cursor))
+    return NULL;
+  cursor = *cursor == '0' ? cursor + 1 : SkipDigits(cursor);
+  if (*cursor == '.') {
+    if (!IsDigit(*++cursor))
+      return NULL;
+    cursor = SkipDigits(cursor);
+  }
+  if (*cursor == 'e' || *cursor == 'E') {
+    cursor++;
+    if (*cursor == '+' || *cursor == '-')
+      cursor++;
+    if (!IsDigit(*cursor))
+      return NULL;
+    cursor = SkipDigits(cursor);
+  }
+  return cursor;
+}
+
+}  // namespace
+
+namespace haptics {
+
+PackedArrayWriter::PackedArrayWriter(int max_values)
+    : buffer_(NULL),
+      length_(0),
+      count_(0),
+      max_values_(max_values) {
+  // Brackets and the terminator.
+  uint32_t size = static_cast<uint32_t>(max_values * kMaxValueLength + 3);
+  buffer_ = static_cast<char*>(NPN_MemAlloc(size));
+  if (buffer_)
+    buffer_[length_++] = '[';
+}
+
+PackedArrayWriter::~PackedArrayWriter() {
+  if (buffer_)
+    NPN_MemFree(buffer_);
+}
+
+void PackedArrayWriter::Append(double value) {
+  if (buffer_ == NULL || count_ == max_values_)
+    return;
+  if (count_ > 0)
+    buffer_[length_++] = ',';
+  // JSON has no representation for NaN or infinities.
+  if (value != value || value - value != 0.0)
+    value = 0.0;
+  length_ += sprintf(buffer_ + length_, "%.15g", value);
+  count_++;
+}
+
+void PackedArrayWriter::Finish(NPVariant* variant) {
+  if (buffer_ == NULL) {
+    NULL_TO_NPVARIANT(*variant);
+    return;
+  }
+  buffer_[length_++] = ']';
+  buffer_[length_] = '\0';
+  STRINGN_TO_NPVARIANT(buffer_, length_, *variant);
+  // The browser owns the buffer now.
+  buffer_ = NULL;
+}
+
+bool ParsePackedArray(const NPString& text, std::vector<double>* values) {
+  values->clear();
+  // NPStrings aren't terminated, strtod needs a terminated copy.
+  std::string copy(text.UTF8Characters, text.UTF8Length);
+  const char* cursor = SkipSpace(copy.c_str());
+  // Where the text ends, even if it holds a '\0' of its own.
+  const char* text_end = copy.c_str() + copy.size();
+
+  bool bracketed = *cursor == '[';
+  if (bracketed)
+    cursor = SkipSpace(cursor + 1);
+
+  bool empty = bracketed ? *cursor == ']' : cursor == text_end;
+  while (!empty) {
+    const char* end = ScanNumber(cursor);
+    if (end == NULL)
+      return false;
+    double value = strtod(cursor, NULL);
+    // Numbers too large for a double come back as infinities.
+    if (value - value != 0.0)
+      return false;
+    values->push_back(value);
+    cursor = SkipSpace(end);
+    if (*cursor != ',')
+      break;
+    cursor = SkipSpace(cursor + 1);
+  }
+
+  if (bracketed) {
+    if (*cursor != ']')
+      return false;
+    cursor = SkipSpace(cursor + 1);
+  }
+  return cursor == text_end;
+}
+
+}  // namespace haptics
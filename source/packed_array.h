@@ -0,0 +1,49 @@
+// Copyright 2010 Mohamed Mansour. All rights reserved.
+// Use of this source code is governed by a GPL license that can
+// be found in the LICENSE file.
+
+#ifndef PACKED_ARRAY_H_
+#define PACKED_ARRAY_H_
+#pragma once
+
+#include <vector>
+
+#include "npfunctions.h"
+
+namespace haptics {
+
+// Bulk data crosses the bridge as the text of a flat JSON array of numbers,
+// "[1,2.5,3]", which the page turns into numbers with a single JSON.parse.
+// That is one NPVariant per batch instead of one per value.
+class PackedArrayWriter {
+ public:
+  // Reserves room for |max_values| numbers.
+  explicit PackedArrayWriter(int max_values);
+  ~PackedArrayWriter();
+
+  // Appends |value|. Values beyond |max_values| are ignored.
+  void Append(double value);
+
+  // Moves the text into |variant|, which the browser frees. Sets null if the
+  // buffer could not be allocated.
+  void Finish(NPVariant* variant);
+
+ private:
+  char* buffer_;
+  int length_;
+  int count_;
+  int max_values_;
+
+  PackedArrayWriter(const PackedArrayWriter&);
+  void operator=(const PackedArrayWriter&);
+};
+
+// Parses the text of a flat numeric array, as produced by JSON.stringify on
+// an array of numbers, into |values|. The brackets are optional. Returns
+// false unless |text| is a comma separated list of JSON numbers, so NaN,
+// infinities, hex and anything after the array are refused.
+bool ParsePackedArray(const NPString& text, std::vector<double>* values);
+
+}  // namespace haptics
+
+#endif  // PACKED_ARRAY_H_
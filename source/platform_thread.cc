@@ -0,0 +1,150 @@
+// Copyright 2010 Mohamed Mansour. All rights reserved.
+// Use of this source code is governed by a GPL license that can
+// be found in the LICENSE file.
+
+#include "platform_thread.h"
+
+#if defined(_WIN32)
+#include "windows.h"
+#else
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#endif
+
+namespace {
+
+// Remaining wait below which SleepUntilMicroseconds() stops sleeping and
+// spins instead. Covers the usual timer slack of the OS scheduler.
+const int64_t kSpinThresholdMicroseconds = 200;
+
+// Carries the thread entry point across the native thread boundary.
+struct ThreadStart {
+  haptics::ThreadMain main;
+  hpointer data;
+};
+
+#if defined(_WIN32)
+DWORD WINAPI ThreadFunc(LPVOID param) {
+  ThreadStart* start = static_cast<ThreadStart*>(param);
+  haptics::ThreadMain main = start->main;
+  hpointer data = start->data;
+  delete start;
+  main(data);
+  return 0;
+}
+#else
+void* ThreadFunc(void* param) {
+  ThreadStart* start = static_cast<ThreadStart*>(param);
+  haptics::ThreadMain main = start->main;
+  hpointer data = start->data;
+  delete start;
+  main(data);
+  return NULL;
+}
+#endif
+
+}  // namespace
+
+namespace haptics {
+
+PlatformThread::PlatformThread()
+    : running_(false),
+      handle_(0) {
+}
+
+PlatformThread::~PlatformThread() {
+  Join();
+}
+
+bool PlatformThread::Start(ThreadMain main, hpointer data) {
+  if (running_)
+    return false;
+
+  ThreadStart* start = new ThreadStart;
+  start->main = main;
+  start->data = data;
+
+#if defined(_WIN32)
+  handle_ = CreateThread(NULL, 0, ThreadFunc, start, 0, NULL);
+  if (handle_ == NULL) {
+    delete start;
+    return false;
+  }
+#else
+  pthread_t thread;
+  if (pthread_create(&thread, NULL, ThreadFunc, start) != 0) {
+    delete start;
+    return false;
+  }
+  handle_ = thread;
+#endif
+
+  running_ = true;
+  return true;
+}
+
+void PlatformThread::Join() {
+  if (!running_)
+    return;
+
+#if defined(_WIN32)
+  WaitForSingleObject(handle_, INFINITE);
+  CloseHandle(handle_);
+  handle_ = NULL;
+#else
+  pthread_join(static_cast<pthread_t>(handle_), NULL);
+  handle_ = 0;
+#endif
+  running_ = false;
+}
+
+void PlatformThread::RaiseCurrentThreadPriority() {
+#if defined(_WIN32)
+  SetThreadPriority(GetCurrentThread(), THREAD_PRIORITY_TIME_CRITICAL);
+#else
+  // Real-time scheduling needs privileges we usually don't have, in which
+  // case the thread simply stays at normal priority.
+  sched_param param;
+  param.sched_priority = sched_get_priority_min(SCHED_FIFO);
+  pthread_setschedparam(pthread_self(), SCHED_FIFO, &param);
+#endif
+}
+
+int64_t MonotonicMicroseconds() {
+#if defined(_WIN32)
+  static LARGE_INTEGER frequency = { 0 };
+  if (frequency.QuadPart == 0)
+    QueryPerformanceFrequency(&frequency);
+  LARGE_INTEGER now;
+  QueryPerformanceCounter(&now);
+  // Split the division so the multiplication can't overflow on long uptimes.
+  int64_t seconds = now.QuadPart / frequency.QuadPart;
+  int64_t remainder = now.QuadPart % frequency.QuadPart;
+  return seconds * 1000000 + remainder * 1000000 / frequency.QuadPart;
+#else
+  timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return static_cast<int64_t>(now.tv_sec) * 1000000 + now.tv_nsec / 1000;
+#endif
+}
+
+void SleepUntilMicroseconds(int64_t deadline) {
+  int64_t remaining = deadline - MonotonicMicroseconds();
+  if (remaining > kSpinThresholdMicroseconds) {
+#if defined(_WIN32)
+    Sleep(static_cast<DWORD>((remaining - kSpinThresholdMicroseconds) / 1000));
+#else
+    int64_t wake = deadline - kSpinThresholdMicroseconds;
+    timespec until;
+    until.tv_sec = static_cast<time_t>(wake / 1000000);
+    until.tv_nsec = static_cast<long>((wake % 1000000) * 1000);
+    clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &until, NULL);
+#endif
+  }
+  while (MonotonicMicroseconds() < deadline) {
+    // Spin for the last few hundred microseconds.
+  }
+}
+
+}  // namespace haptics
@@ -0,0 +1,57 @@
+// Copyright 2010 Mohamed Mansour. All rights reserved.
+// Use of this source code is governed by a GPL license that can
+// be found in the LICENSE file.
+
+#ifndef PLATFORM_THREAD_H_
+#define PLATFORM_THREAD_H_
+#pragma once
+
+#include <stdint.h>
+
+#include "haptics_signal.h"
+
+namespace haptics {
+
+typedef void (*ThreadMain)(hpointer data);
+
+// Thin wrapper around a native thread.
+class PlatformThread {
+ public:
+  PlatformThread();
+  ~PlatformThread();
+
+  // Runs |main| with |data| on a new thread. Returns false if the thread
+  // could not be created or is already running.
+  bool Start(ThreadMain main, hpointer data);
+
+  // Waits for the thread to finish.
+  void Join();
+
+  bool running() const { return running_; }
+
+  // Asks the OS to schedule the calling thread ahead of normal threads.
+  static void RaiseCurrentThreadPriority();
+
+ private:
+  bool running_;
+#if defined(_WIN32)
+  void* handle_;
+#else
+  unsigned long handle_;
+#endif
+
+  PlatformThread(const PlatformThread&);
+  void operator=(const PlatformThread&);
+};
+
+// Monotonic clock in microseconds, suitable for measuring servo periods.
+int64_t MonotonicMicroseconds();
+
+// Blocks the calling thread until MonotonicMicroseconds() reaches
+// |deadline|. Sleeps for most of the wait and spins for the last stretch,
+// since OS sleeps are too coarse for kilohertz loops.
+void SleepUntilMicroseconds(int64_t deadline);
+
+}  // namespace haptics
+
+#endif  // PLATFORM_THREAD_H_
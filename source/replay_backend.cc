@@ -0,0 +1,191 @@
+// Copyright 2010 Mohamed Mansour. All rights reserved.
+// Use of this source code is governed by a GPL license that can
+// be found in the LICENSE file.
+
+#include "replay_backend.h"
+
+#include <string.h>
+
+namespace haptics {
+
+namespace {
+
+// Servo period once the recording has ended.
+const int64_t kIdlePeriodMicroseconds = 1000;
+
+}  // namespace
+
+ReplayBackend::ReplayBackend(const std::string& path, double speed)
+    : path_(path),
+      speed_(speed > 0.0 ? speed : 0.0),
+      data_(NULL),
+      data_size_(0),
+      device_count_(0),
+      records_(NULL),
+      record_count_(0),
+      servo_op_(NULL),
+      servo_data_(NULL),
+      stop_requested_(0),
+      current_(&tools_[0]),
+      now_(0) {
+  for (int i = 0; i < kMaxDevices; i++) {
+    for (int j = 0; j < 3; j++)
+      tools_[i].position[j] = 0.0;
+    tools_[i].button = false;
+  }
+}
+
+ReplayBackend::~ReplayBackend() {
+  Stop();
+  Close();
+}
+
+bool ReplayBackend::ReadHeader() {
+  if (data_)
+    return true;
+  if (!file_.Open(path_.c_str()))
+    return false;
+  int64_t size = file_.size();
+  if (size < kTrajectoryBlockSize ||
+      size != static_cast<int64_t>(static_cast<size_t>(size))) {
+    file_.Close();
+    return false;
+  }
+  data_size_ = static_cast<size_t>(size);
+  data_ = static_cast<const char*>(file_.Map(0, data_size_));
+  if (data_ == NULL) {
+    file_.Close();
+    return false;
+  }
+
+  const TrajectoryHeader* header =
+      reinterpret_cast<const TrajectoryHeader*>(data_);
+  int64_t blocks = size / kTrajectoryBlockSize;
+  if (memcmp(header->magic, kTrajectoryMagic, sizeof(header->magic)) != 0 ||
+      header->version != kTrajectoryVersion ||
+      header->block_size != kTrajectoryBlockSize ||
+      header->device_count < 1 || header->device_count > kMaxDevices ||
+      1 + header->device_count > blocks) {
+    Close();
+    return false;
+  }
+
+  device_count_ = header->device_count;
+  const TrajectoryWorkspace* workspace =
+      reinterpret_cast<const TrajectoryWorkspace*>(header + 1);
+  for (int i = 0; i < device_count_; i++, workspace++) {
+    for (int j = 0; j < 6; j++)
+      workspaces_[i][j] = workspace->workspace[j];
+  }
+  // A recording that was cut short has no count, its records end at the
+  // first one with a zero time.
+  records_ = reinterpret_cast<const TrajectoryRecord*>(workspace);
+  record_count_ = blocks - 1 - device_count_;
+  if (header->record_count > 0 && header->record_count < record_count_)
+    record_count_ = header->record_count;
+  return true;
+}
+
+int ReplayBackend::CountDevices() {
+  return ReadHeader() ? device_count_ : 1;
+}
+
+bool ReplayBackend::Open(int device_count) {
+  return ReadHeader() && device_count == device_count_;
+}
+
+void ReplayBackend::Close() {
+  MappedFile::Unmap(const_cast<char*>(data_), data_size_);
+  file_.Close();
+  data_ = NULL;
+  data_size_ = 0;
+  records_ = NULL;
+  record_count_ = 0;
+}
+
+bool ReplayBackend::Start(ServoOp op, hpointer data) {
+  if (data_ == NULL || thread_.running())
+    return false;
+
+  servo_op_ = op;
+  servo_data_ = data;
+  ReleaseStore(&stop_requested_, 0);
+  return thread_.Start(ReplayLoopThunk, this);
+}
+
+void ReplayBackend::Stop() {
+  ReleaseStore(&stop_requested_, 1);
+  thread_.Join();
+}
+
+void ReplayBackend::GetWorkspace(int device, double workspace[6]) {
+  for (int i = 0; i < 6; i++)
+    workspace[i] = workspaces_[device][i];
+}
+
+void ReplayBackend::MakeCurrent(int device) {
+  current_ = &tools_[device];
+}
+
+void ReplayBackend::GetToolPosition(double position[3]) {
+  position[0] = current_->position[0];
+  position[1] = current_->position[1];
+  position[2] = current_->position[2];
+}
+
+void ReplayBackend::GetToolButton(bool* button) {
+  *button = current_->button;
+}
+
+void ReplayBackend::SetToolForce(const double /* force */[3]) {
+}
+
+int64_t ReplayBackend::Now() {
+  return now_;
+}
+
+void ReplayBackend::ReplayLoop() {
+  PlatformThread::RaiseCurrentThreadPriority();
+
+  const int64_t start = MonotonicMicroseconds();
+  const int64_t first_time = record_count_ > 0 ? records_[0].time_us : 0;
+  int64_t end = record_count_;
+  int64_t index = 0;
+  int64_t idle_deadline = start;
+  now_ = start;
+
+  while (!AcquireLoad(&stop_requested_)) {
+    if (index < end && records_[index].time_us == 0)
+      end = index;
+
+    if (index < end) {
+      // Every device of a tick shares its time.
+      int64_t time = records_[index].time_us;
+      for (; index < end && records_[index].time_us == time; index++) {
+        const TrajectoryRecord& record = records_[index];
+        if (record.device < 0 || record.device >= device_count_)
+          continue;
+        Tool* tool = &tools_[record.device];
+        for (int i = 0; i < 3; i++)
+          tool->position[i] = record.position[i];
+        tool->button = record.button != 0;
+      }
+      now_ = start + (time - first_time);
+      if (speed_ > 0.0) {
+        SleepUntilMicroseconds(
+            start + static_cast<int64_t>((time - first_time) / speed_));
+      }
+      idle_deadline = MonotonicMicroseconds();
+    } else {
+      // Hold the last tick and keep the servo loop alive.
+      now_ += kIdlePeriodMicroseconds;
+      idle_deadline += kIdlePeriodMicroseconds;
+      SleepUntilMicroseconds(idle_deadline);
+    }
+
+    if (servo_op_(servo_data_) == SERVOOP_EXIT)
+      break;
+  }
+}
+
+}  // namespace haptics
@@ -0,0 +1,87 @@
+// Copyright 2010 Mohamed Mansour. All rights reserved.
+// Use of this source code is governed by a GPL license that can
+// be found in the LICENSE file.
+
+#ifndef REPLAY_BACKEND_H_
+#define REPLAY_BACKEND_H_
+#pragma once
+
+#include <stdint.h>
+
+#include <string>
+
+#include "atomic_ops.h"
+#include "device_backend.h"
+#include "mapped_file.h"
+#include "platform_thread.h"
+#include "trajectory_recorder.h"
+
+namespace haptics {
+
+// Plays a file written by TrajectoryRecorder back through the servo loop as
+// if the devices moved that way, for regression tests and user studies.
+// Forces are computed as usual but go nowhere.
+//
+// The servo clock, Now(), runs on the time of the recording, so everything
+// the servo loop derives from time is reproduced whatever the |speed|. Once
+// the recording ends the devices hold still and the servo loop carries on
+// at 1 kHz of real time.
+class ReplayBackend : public DeviceBackend {
+ public:
+  // Plays |path| |speed| times faster than it was recorded, or as fast as
+  // the servo operation runs when |speed| is 0.
+  ReplayBackend(const std::string& path, double speed);
+  virtual ~ReplayBackend();
+
+  virtual int CountDevices();
+  virtual bool Open(int device_count);
+  virtual void Close();
+  virtual bool Start(ServoOp op, hpointer data);
+  virtual void Stop();
+  virtual void GetWorkspace(int device, double workspace[6]);
+  virtual void MakeCurrent(int device);
+  virtual void GetToolPosition(double position[3]);
+  virtual void GetToolButton(bool* button);
+  virtual void SetToolForce(const double force[3]);
+  virtual int64_t Now();
+
+  static const int kMaxDevices = 16;
+
+ private:
+  struct Tool {
+    double position[3];
+    bool button;
+  };
+
+  HAPTIC_CALLBACK(ReplayBackend, void, ReplayLoop);
+
+  // Reads the header of the file, if not done yet. Returns false if the
+  // file is not a trajectory.
+  bool ReadHeader();
+
+  std::string path_;
+  double speed_;
+
+  MappedFile file_;
+  // The whole file, mapped by Open().
+  const char* data_;
+  size_t data_size_;
+  int device_count_;
+  double workspaces_[kMaxDevices][6];
+  const TrajectoryRecord* records_;
+  int64_t record_count_;
+
+  ServoOp servo_op_;
+  hpointer servo_data_;
+  PlatformThread thread_;
+  volatile Atomic32 stop_requested_;
+
+  // Variables used only by servo thread
+  Tool tools_[kMaxDevices];
+  Tool* current_;
+  int64_t now_;
+};
+
+}  // namespace haptics
+
+#endif  // REPLAY_BACKEND_H_
@@ -0,0 +1,103 @@
+// Copyright 2010 Mohamed Mansour. All rights reserved.
+// Use of this source code is governed by a GPL license that can
+// be found in the LICENSE file.
+
+#ifndef RING_BUFFER_H_
+#define RING_BUFFER_H_
+#pragma once
+
+#include <stddef.h>
+
+#include "atomic_ops.h"
+
+namespace haptics {
+
+// Bounded, wait-free single producer / single consumer queue. Unlike the
+// TripleBuffer, which only keeps the newest value, every element pushed is
+// delivered exactly once unless the queue is full, in which case the push
+// fails and the producer decides what to drop.
+//
+// |kCapacity| must be a power of two. One slot is always kept free to tell a
+// full queue from an empty one, so at most kCapacity - 1 elements are queued.
+//
+// The producer thread may only call BeginWrite(), EndWrite() and Push(), the
+// consumer thread may only call Front(), PopFront() and Pop(). size() may be
+// called from either side and is exact only on the consumer.
+template <typename T, int kCapacity>
+class RingBuffer {
+ public:
+  RingBuffer() : head_(0), tail_(0) {}
+
+  // Returns the slot the next element goes into so the producer can fill it
+  // in place, or NULL if the queue is full. Commit it with EndWrite().
+  T* BeginWrite() {
+    Atomic32 head = head_;
+    if (((head + 1) & kMask) == AcquireLoad(&tail_))
+      return NULL;
+    return &slots_[head];
+  }
+
+  // Makes the slot returned by BeginWrite() visible to the consumer.
+  void EndWrite() {
+    ReleaseStore(&head_, (head_ + 1) & kMask);
+  }
+
+  // Copies |value| into the queue. Returns false if the queue is full.
+  bool Push(const T& value) {
+    T* slot = BeginWrite();
+    if (slot == NULL)
+      return false;
+    *slot = value;
+    EndWrite();
+    return true;
+  }
+
+  // Returns the oldest element without removing it, or NULL if the queue is
+  // empty.
+  const T* Front() const {
+    Atomic32 tail = tail_;
+    if (tail == AcquireLoad(&head_))
+      return NULL;
+    return &slots_[tail];
+  }
+
+  // Removes the element returned by Front().
+  void PopFront() {
+    ReleaseStore(&tail_, (tail_ + 1) & kMask);
+  }
+
+  // Moves the oldest element into |value|. Returns false if the queue is
+  // empty.
+  bool Pop(T* value) {
+    const T* front = Front();
+    if (front == NULL)
+      return false;
+    *value = *front;
+    PopFront();
+    return true;
+  }
+
+  int size() const {
+    return (AcquireLoad(&head_) - AcquireLoad(&tail_)) & kMask;
+  }
+
+  static int capacity() { return kCapacity - 1; }
+
+ private:
+  enum { kMask = kCapacity - 1 };
+  typedef char CapacityMustBeAPowerOfTwo[(kCapacity & kMask) == 0 ? 1 : -1];
+
+  // Next slot to write, only advanced by the producer.
+  HAPTICS_CACHE_ALIGNED volatile Atomic32 head_;
+  // Next slot to read, only advanced by the consumer.
+  HAPTICS_CACHE_ALIGNED volatile Atomic32 tail_;
+
+  HAPTICS_CACHE_ALIGNED T slots_[kCapacity];
+
+  RingBuffer(const RingBuffer&);
+  void operator=(const RingBuffer&);
+};
+
+}  // namespace haptics
+
+#endif  // RING_BUFFER_H_
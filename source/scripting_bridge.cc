@@ -4,104 +4,283 @@
 
 #include "scripting_bridge.h"
 
+#include <limits.h>
+#include <math.h>
+#include <string.h>
+
 #include "haptics_service.h"
 
 namespace haptics {
 
 NPIdentifier ScriptingBridge::id_debug;
 NPIdentifier ScriptingBridge::id_position;
+NPIdentifier ScriptingBridge::id_position_x;
+NPIdentifier ScriptingBridge::id_position_y;
+NPIdentifier ScriptingBridge::id_position_z;
 NPIdentifier ScriptingBridge::id_initialized;
 NPIdentifier ScriptingBridge::id_start_device;
 NPIdentifier ScriptingBridge::id_stop_device;
 NPIdentifier ScriptingBridge::id_send_force;
+NPIdentifier ScriptingBridge::id_send_force3;
+NPIdentifier ScriptingBridge::id_send_forces;
+NPIdentifier ScriptingBridge::id_add_plane;
+NPIdentifier ScriptingBridge::id_add_sphere;
+NPIdentifier ScriptingBridge::id_add_box;
+NPIdentifier ScriptingBridge::id_add_spring;
+NPIdentifier ScriptingBridge::id_remove_primitive;
+NPIdentifier ScriptingBridge::id_clear_primitives;
+NPIdentifier ScriptingBridge::id_damping;
+NPIdentifier ScriptingBridge::id_on_state;
+NPIdentifier ScriptingBridge::id_drain_samples;
+NPIdentifier ScriptingBridge::id_drain_events;
+NPIdentifier ScriptingBridge::id_start_recording;
+NPIdentifier ScriptingBridge::id_stop_recording;
+NPIdentifier ScriptingBridge::id_upload_mesh;
+NPIdentifier ScriptingBridge::id_clear_mesh;
+NPIdentifier ScriptingBridge::id_upload_volume;
+NPIdentifier ScriptingBridge::id_upload_volume_bricks;
+NPIdentifier ScriptingBridge::id_clear_volume;
+NPIdentifier ScriptingBridge::id_stats;
+NPIdentifier ScriptingBridge::id_reset_stats;
+NPIdentifier ScriptingBridge::id_add_effect;
+NPIdentifier ScriptingBridge::id_remove_effect;
+NPIdentifier ScriptingBridge::id_clear_effects;
+NPIdentifier ScriptingBridge::id_time;
+NPIdentifier ScriptingBridge::id_schedule_forces;
+NPIdentifier ScriptingBridge::id_clear_scheduled_forces;
+NPIdentifier ScriptingBridge::id_set_workspace;
+NPIdentifier ScriptingBridge::id_set_workspace_transform;
+NPIdentifier ScriptingBridge::id_velocity;
+NPIdentifier ScriptingBridge::id_acceleration;
+NPIdentifier ScriptingBridge::id_set_motion_filter;
+NPIdentifier ScriptingBridge::id_devices;
+NPIdentifier ScriptingBridge::id_priority;
+NPIdentifier ScriptingBridge::id_upload_deformable;
+NPIdentifier ScriptingBridge::id_clear_deformable;
+NPIdentifier ScriptingBridge::id_deformable_nodes;
 
 // Method table for use by HasMethod and Invoke.
-std::map<NPIdentifier, ScriptingBridge::MethodSelector>*
-    ScriptingBridge::method_table;
+ScriptingBridge::MethodTable ScriptingBridge::method_table;
 
 // Property table for use by {Has|Get}Property.
-std::map<NPIdentifier, ScriptingBridge::GetPropertySelector>*
-    ScriptingBridge::get_property_table;
+ScriptingBridge::GetPropertyTable ScriptingBridge::get_property_table;
 
 // Property table for use by {Set}Property.
-std::map<NPIdentifier, ScriptingBridge::SetPropertySelector>*
-    ScriptingBridge::set_property_table;
+ScriptingBridge::SetPropertyTable ScriptingBridge::set_property_table;
+
+bool NPVariantToDouble(const NPVariant& variant, double* value) {
+  if (NPVARIANT_IS_DOUBLE(variant)) {
+    *value = NPVARIANT_TO_DOUBLE(variant);
+    return *value - *value == 0.0;
+  }
+  if (NPVARIANT_IS_INT32(variant)) {
+    *value = NPVARIANT_TO_INT32(variant);
+    return true;
+  }
+  return false;
+}
+
+bool NPVariantToInt(const NPVariant& variant, int* value) {
+  double number;
+  if (!NPVariantToDouble(variant, &number))
+    return false;
+  // Every comparison with NaN is false, so it fails the range check too.
+  if (!(number >= INT_MIN && number <= INT_MAX) || number != floor(number))
+    return false;
+  *value = static_cast<int>(number);
+  return true;
+}
+
+namespace {
+
+// Names addEffect accepts for each EffectType.
+const struct {
+  const char* name;
+  EffectType type;
+} kEffectNames[] = {
+  { "spring", EFFECT_SPRING },
+  { "damper", EFFECT_DAMPER },
+  { "constant", EFFECT_CONSTANT },
+  { "ramp", EFFECT_RAMP },
+  { "sine", EFFECT_SINE },
+  { "square", EFFECT_SQUARE },
+  { "saw", EFFECT_SAW },
+  { "friction", EFFECT_FRICTION },
+  { "impulse", EFFECT_IMPULSE },
+};
+
+bool EffectTypeFromName(const NPString& name, EffectType* type) {
+  for (size_t i = 0; i < sizeof(kEffectNames) / sizeof(kEffectNames[0]);
+       i++) {
+    if (strlen(kEffectNames[i].name) == name.UTF8Length &&
+        strncmp(kEffectNames[i].name, name.UTF8Characters,
+                name.UTF8Length) == 0) {
+      *type = kEffectNames[i].type;
+      return true;
+    }
+  }
+  return false;
+}
+
+}  // namespace
 
 // Creates the plugin-side instance of NPObject.
 // Called by NPN_CreateObject, declared in npruntime.h
 // Documentation URL: https://developer.mozilla.org/en/NPClass
-NPObject* Allocate(NPP npp, NPClass* npclass) {
+NPObject* Allocate(NPP npp, NPClass* /* npclass */) {
   return new ScriptingBridge(npp);
 }
 
 ScriptingBridge::~ScriptingBridge() {
 }
 
-// Sets up method_table and property_table.
+// Sets up method_table and the property tables. They are shared by every
+// instance, so only the first call builds them.
 bool ScriptingBridge::InitializeIdentifiers() {
+  // The tables are built once for the process, so the outcome of the first
+  // call holds for every later one.
+  static bool attempted = false;
+  static bool succeeded = false;
+  if (attempted)
+    return succeeded;
+  attempted = true;
+
   id_debug = NPN_GetStringIdentifier("debug");
   id_position = NPN_GetStringIdentifier("position");
+  id_position_x = NPN_GetStringIdentifier("positionX");
+  id_position_y = NPN_GetStringIdentifier("positionY");
+  id_position_z = NPN_GetStringIdentifier("positionZ");
   id_initialized = NPN_GetStringIdentifier("initialized");
   id_start_device = NPN_GetStringIdentifier("startDevice");
   id_stop_device = NPN_GetStringIdentifier("stopDevice");
   id_send_force = NPN_GetStringIdentifier("sendForce");
+  id_send_force3 = NPN_GetStringIdentifier("sendForce3");
+  id_send_forces = NPN_GetStringIdentifier("sendForces");
+  id_add_plane = NPN_GetStringIdentifier("addPlane");
+  id_add_sphere = NPN_GetStringIdentifier("addSphere");
+  id_add_box = NPN_GetStringIdentifier("addBox");
+  id_add_spring = NPN_GetStringIdentifier("addSpring");
+  id_remove_primitive = NPN_GetStringIdentifier("removePrimitive");
+  id_clear_primitives = NPN_GetStringIdentifier("clearPrimitives");
+  id_damping = NPN_GetStringIdentifier("damping");
+  id_on_state = NPN_GetStringIdentifier("onState");
+  id_drain_samples = NPN_GetStringIdentifier("drainSamples");
+  id_drain_events = NPN_GetStringIdentifier("drainEvents");
+  id_start_recording = NPN_GetStringIdentifier("startRecording");
+  id_stop_recording = NPN_GetStringIdentifier("stopRecording");
+  id_upload_mesh = NPN_GetStringIdentifier("uploadMesh");
+  id_clear_mesh = NPN_GetStringIdentifier("clearMesh");
+  id_upload_volume = NPN_GetStringIdentifier("uploadVolume");
+  id_upload_volume_bricks = NPN_GetStringIdentifier("uploadVolumeBricks");
+  id_clear_volume = NPN_GetStringIdentifier("clearVolume");
+  id_stats = NPN_GetStringIdentifier("stats");
+  id_reset_stats = NPN_GetStringIdentifier("resetStats");
+  id_add_effect = NPN_GetStringIdentifier("addEffect");
+  id_remove_effect = NPN_GetStringIdentifier("removeEffect");
+  id_clear_effects = NPN_GetStringIdentifier("clearEffects");
+  id_time = NPN_GetStringIdentifier("time");
+  id_schedule_forces = NPN_GetStringIdentifier("scheduleForces");
+  id_clear_scheduled_forces =
+      NPN_GetStringIdentifier("clearScheduledForces");
+  id_set_workspace = NPN_GetStringIdentifier("setWorkspace");
+  id_set_workspace_transform =
+      NPN_GetStringIdentifier("setWorkspaceTransform");
+  id_velocity = NPN_GetStringIdentifier("velocity");
+  id_acceleration = NPN_GetStringIdentifier("acceleration");
+  id_set_motion_filter = NPN_GetStringIdentifier("setMotionFilter");
+  id_devices = NPN_GetStringIdentifier("devices");
+  id_priority = NPN_GetStringIdentifier("priority");
+  id_upload_deformable = NPN_GetStringIdentifier("uploadDeformable");
+  id_clear_deformable = NPN_GetStringIdentifier("clearDeformable");
+  id_deformable_nodes = NPN_GetStringIdentifier("deformableNodes");
 
-  method_table =
-      new(std::nothrow) std::map<NPIdentifier, MethodSelector>;
-  if (method_table == NULL)
-    return false;
-
-  method_table->insert(
-      std::pair<NPIdentifier, MethodSelector>(
-          id_start_device, &ScriptingBridge::StartDevice));
-  method_table->insert(
-      std::pair<NPIdentifier, MethodSelector>(
-          id_stop_device, &ScriptingBridge::StopDevice));
-  method_table->insert(
-      std::pair<NPIdentifier, MethodSelector>(
-         id_send_force, &ScriptingBridge::SendForce));
+  method_table.Add(id_start_device, &ScriptingBridge::StartDevice);
+  method_table.Add(id_stop_device, &ScriptingBridge::StopDevice);
+  method_table.Add(id_send_force, &ScriptingBridge::SendForce);
+  method_table.Add(id_send_force3, &ScriptingBridge::SendForce3);
+  method_table.Add(id_send_forces, &ScriptingBridge::SendForces);
+  method_table.Add(id_add_plane, &ScriptingBridge::AddPlane);
+  method_table.Add(id_add_sphere, &ScriptingBridge::AddSphere);
+  method_table.Add(id_add_box, &ScriptingBridge::AddBox);
+  method_table.Add(id_add_spring, &ScriptingBridge::AddSpring);
+  method_table.Add(id_remove_primitive, &ScriptingBridge::RemovePrimitive);
+  method_table.Add(id_clear_primitives, &ScriptingBridge::ClearPrimitives);
+  method_table.Add(id_on_state, &ScriptingBridge::OnState);
+  method_table.Add(id_drain_samples, &ScriptingBridge::DrainSamples);
+  method_table.Add(id_drain_events, &ScriptingBridge::DrainEvents);
+  method_table.Add(id_start_recording, &ScriptingBridge::StartRecording);
+  method_table.Add(id_stop_recording, &ScriptingBridge::StopRecording);
+  method_table.Add(id_upload_mesh, &ScriptingBridge::UploadMesh);
+  method_table.Add(id_clear_mesh, &ScriptingBridge::ClearMesh);
+  method_table.Add(id_upload_volume, &ScriptingBridge::UploadVolume);
+  method_table.Add(id_upload_volume_bricks,
+                   &ScriptingBridge::UploadVolumeBricks);
+  method_table.Add(id_clear_volume, &ScriptingBridge::ClearVolume);
+  method_table.Add(id_upload_deformable, &ScriptingBridge::UploadDeformable);
+  method_table.Add(id_clear_deformable, &ScriptingBridge::ClearDeformable);
+  method_table.Add(id_reset_stats, &ScriptingBridge::ResetStats);
+  method_table.Add(id_add_effect, &ScriptingBridge::AddEffect);
+  method_table.Add(id_remove_effect, &ScriptingBridge::RemoveEffect);
+  method_table.Add(id_clear_effects, &ScriptingBridge::ClearEffects);
+  method_table.Add(id_schedule_forces, &ScriptingBridge::ScheduleForces);
+  method_table.Add(id_clear_scheduled_forces,
+                   &ScriptingBridge::ClearScheduledForces);
+  method_table.Add(id_set_workspace, &ScriptingBridge::SetWorkspace);
+  method_table.Add(id_set_workspace_transform,
+                   &ScriptingBridge::SetWorkspaceTransform);
+  method_table.Add(id_set_motion_filter, &ScriptingBridge::SetMotionFilter);
 
-  get_property_table =
-      new(std::nothrow) std::map<NPIdentifier, GetPropertySelector>;
-  if (get_property_table == NULL) {
-    return false;
-  }
-  set_property_table =
-      new(std::nothrow) std::map<NPIdentifier, SetPropertySelector>;
-  if (set_property_table == NULL) {
-    return false;
-  }
+  get_property_table.Add(id_debug, &ScriptingBridge::GetDebug);
+  set_property_table.Add(id_debug, &ScriptingBridge::SetDebug);
 
-  get_property_table->insert(
-      std::pair<NPIdentifier, GetPropertySelector>(
-          id_debug, &ScriptingBridge::GetDebug));
-  set_property_table->insert(
-      std::pair<NPIdentifier, SetPropertySelector>(
-          id_debug, &ScriptingBridge::SetDebug));
+  get_property_table.Add(id_position, &ScriptingBridge::GetPosition);
+  get_property_table.Add(id_position_x, &ScriptingBridge::GetPositionX);
+  get_property_table.Add(id_position_y, &ScriptingBridge::GetPositionY);
+  get_property_table.Add(id_position_z, &ScriptingBridge::GetPositionZ);
+  get_property_table.Add(id_velocity, &ScriptingBridge::GetVelocity);
+  get_property_table.Add(id_acceleration, &ScriptingBridge::GetAcceleration);
+  get_property_table.Add(id_initialized, &ScriptingBridge::GetInitialized);
+  get_property_table.Add(id_damping, &ScriptingBridge::GetDamping);
+  set_property_table.Add(id_damping, &ScriptingBridge::SetDamping);
+  get_property_table.Add(id_stats, &ScriptingBridge::GetStats);
+  get_property_table.Add(id_deformable_nodes,
+                         &ScriptingBridge::GetDeformableNodes);
+  get_property_table.Add(id_time, &ScriptingBridge::GetTime);
+  get_property_table.Add(id_devices, &ScriptingBridge::GetDevices);
+  get_property_table.Add(id_priority, &ScriptingBridge::GetPriority);
+  set_property_table.Add(id_priority, &ScriptingBridge::SetPriority);
 
-  get_property_table->insert(
-      std::pair<NPIdentifier, GetPropertySelector>(
-          id_position, &ScriptingBridge::GetPosition));
-  get_property_table->insert(
-      std::pair<NPIdentifier, GetPropertySelector>(
-          id_initialized, &ScriptingBridge::GetInitialized));
-
-  return true;
+  bool methods_fit = method_table.Seal();
+  bool getters_fit = get_property_table.Seal();
+  bool setters_fit = set_property_table.Seal();
+  succeeded = methods_fit && getters_fit && setters_fit;
+  return succeeded;
 }
 
 bool ScriptingBridge::StartDevice(const NPVariant* args,
                                   uint32_t arg_count,
                                   NPVariant* result) {
-  HapticsService* haptics_service = static_cast<HapticsService*>(npp_->pdata);
+  if (arg_count > 1)
+    return false;
+
+  NPObject* callback = NULL;
+  if (arg_count == 1) {
+    if (NPVARIANT_IS_OBJECT(args[0]))
+      callback = NPVARIANT_TO_OBJECT(args[0]);
+    else if (!NPVARIANT_IS_NULL(args[0]) && !NPVARIANT_IS_VOID(args[0]))
+      return false;
+  }
+
+  HapticsService* haptics_service = service_;
   if (haptics_service)
-    return haptics_service->StartDevice(result);
+    return haptics_service->StartDevice(callback, result);
   return false;
 }
 
-bool ScriptingBridge::StopDevice(const NPVariant* args,
-                                 uint32_t arg_count,
+bool ScriptingBridge::StopDevice(const NPVariant* /* args */,
+                                 uint32_t /* arg_count */,
                                  NPVariant* result) {
-  HapticsService* haptics_service = static_cast<HapticsService*>(npp_->pdata);
+  HapticsService* haptics_service = service_;
   if (haptics_service)
     return haptics_service->StopDevice(result);
   return false;
@@ -109,9 +288,9 @@ bool ScriptingBridge::StopDevice(const NPVariant* args,
 
 bool ScriptingBridge::SendForce(const NPVariant* args,
                                 uint32_t arg_count,
-                                NPVariant* result) {
-  // Fail silently if signature doesn't have 1 parameter.
-  if (arg_count != 1)
+                                NPVariant* /* result */) {
+  // Fail silently if signature doesn't have 1, 3 or 4 parameters.
+  if (arg_count != 1 && arg_count != 3 && arg_count != 4)
     return false;
 
   const NPVariant force_argument = args[0];
@@ -119,14 +298,463 @@ bool ScriptingBridge::SendForce(const NPVariant* args,
     return false;
 
   NPObject* force_object = NPVARIANT_TO_OBJECT(force_argument);
-  HapticsService* haptics_service = static_cast<HapticsService*>(npp_->pdata);
-  if (haptics_service)
+  HapticsService* haptics_service = service_;
+  if (!haptics_service)
+    return false;
+  if (arg_count == 1)
     return haptics_service->SendForce(force_object);
+
+  if (!NPVARIANT_IS_OBJECT(args[1]))
+    return false;
+  return haptics_service->SendForce(force_object,
+                                    NPVARIANT_TO_OBJECT(args[1]),
+                                    args[2],
+                                    arg_count == 4 ? &args[3] : NULL);
+}
+
+bool ScriptingBridge::SendForce3(const NPVariant* args,
+                                 uint32_t arg_count,
+                                 NPVariant* /* result */) {
+  double force[3];
+  if (arg_count != 3 ||
+      !NPVariantToDouble(args[0], &force[0]) ||
+      !NPVariantToDouble(args[1], &force[1]) ||
+      !NPVariantToDouble(args[2], &force[2])) {
+    return false;
+  }
+
+  HapticsService* haptics_service = service_;
+  if (haptics_service)
+    return haptics_service->SendForce3(force[0], force[1], force[2]);
+  return false;
+}
+
+bool ScriptingBridge::SendForces(const NPVariant* args,
+                                 uint32_t arg_count,
+                                 NPVariant* result) {
+  if (arg_count < 1 || arg_count > 2 || !NPVARIANT_IS_STRING(args[0]))
+    return false;
+  double period_ms = 1.0;
+  if (arg_count == 2 && !NPVariantToDouble(args[1], &period_ms))
+    return false;
+
+  HapticsService* haptics_service = service_;
+  if (haptics_service) {
+    return haptics_service->SendForces(NPVARIANT_TO_STRING(args[0]),
+                                       period_ms, result);
+  }
+  return false;
+}
+
+bool ScriptingBridge::ScheduleForces(const NPVariant* args,
+                                     uint32_t arg_count,
+                                     NPVariant* result) {
+  if (arg_count != 1 || !NPVARIANT_IS_STRING(args[0]))
+    return false;
+
+  HapticsService* haptics_service = service_;
+  if (haptics_service)
+    return haptics_service->ScheduleForces(NPVARIANT_TO_STRING(args[0]),
+                                           result);
+  return false;
+}
+
+bool ScriptingBridge::ClearScheduledForces(const NPVariant* /* args */,
+                                           uint32_t /* arg_count */,
+                                           NPVariant* result) {
+  HapticsService* haptics_service = service_;
+  if (haptics_service)
+    return haptics_service->ClearScheduledForces(result);
+  return false;
+}
+
+bool ScriptingBridge::SetMotionFilter(const NPVariant* args,
+                                      uint32_t arg_count,
+                                      NPVariant* result) {
+  double velocity_cutoff_hz;
+  double acceleration_cutoff_hz;
+  if (arg_count != 2 ||
+      !NPVariantToDouble(args[0], &velocity_cutoff_hz) ||
+      !NPVariantToDouble(args[1], &acceleration_cutoff_hz)) {
+    return false;
+  }
+
+  HapticsService* haptics_service = service_;
+  if (haptics_service) {
+    return haptics_service->SetMotionFilter(velocity_cutoff_hz,
+                                            acceleration_cutoff_hz, result);
+  }
+  return false;
+}
+
+bool ScriptingBridge::SetWorkspace(const NPVariant* args,
+                                   uint32_t arg_count,
+                                   NPVariant* result) {
+  if (arg_count != 6 && arg_count != 7)
+    return false;
+  double app_workspace[6];
+  for (int i = 0; i < 6; i++) {
+    if (!NPVariantToDouble(args[i], &app_workspace[i]))
+      return false;
+  }
+  bool uniform = true;
+  if (arg_count == 7) {
+    if (!NPVARIANT_IS_BOOLEAN(args[6]))
+      return false;
+    uniform = NPVARIANT_TO_BOOLEAN(args[6]);
+  }
+
+  HapticsService* haptics_service = service_;
+  if (haptics_service)
+    return haptics_service->SetWorkspace(app_workspace, uniform, result);
+  return false;
+}
+
+bool ScriptingBridge::SetWorkspaceTransform(const NPVariant* args,
+                                            uint32_t arg_count,
+                                            NPVariant* result) {
+  if (arg_count != 1)
+    return false;
+  NPObject* matrix_object = NULL;
+  if (NPVARIANT_IS_OBJECT(args[0]))
+    matrix_object = NPVARIANT_TO_OBJECT(args[0]);
+  else if (!NPVARIANT_IS_NULL(args[0]))
+    return false;
+
+  HapticsService* haptics_service = service_;
+  if (haptics_service)
+    return haptics_service->SetWorkspaceTransform(matrix_object, result);
+  return false;
+}
+
+bool ScriptingBridge::AddPrimitive(ForcePrimitiveType type,
+                                   const NPVariant* args,
+                                   uint32_t arg_count,
+                                   NPVariant* result) {
+  // The shape parameters are followed by the stiffness.
+  int param_count = ForcePrimitive::ParamCount(type);
+  if (arg_count != static_cast<uint32_t>(param_count + 1))
+    return false;
+
+  ForcePrimitive primitive;
+  primitive.type = type;
+  for (int i = 0; i < param_count; i++) {
+    if (!NPVariantToDouble(args[i], &primitive.params[i]))
+      return false;
+  }
+  if (!NPVariantToDouble(args[param_count], &primitive.stiffness))
+    return false;
+
+  HapticsService* haptics_service = service_;
+  if (haptics_service)
+    return haptics_service->AddForcePrimitive(primitive, result);
+  return false;
+}
+
+bool ScriptingBridge::AddPlane(const NPVariant* args,
+                               uint32_t arg_count,
+                               NPVariant* result) {
+  return AddPrimitive(FORCE_PLANE, args, arg_count, result);
+}
+
+bool ScriptingBridge::AddSphere(const NPVariant* args,
+                                uint32_t arg_count,
+                                NPVariant* result) {
+  return AddPrimitive(FORCE_SPHERE, args, arg_count, result);
+}
+
+bool ScriptingBridge::AddBox(const NPVariant* args,
+                             uint32_t arg_count,
+                             NPVariant* result) {
+  return AddPrimitive(FORCE_BOX, args, arg_count, result);
+}
+
+bool ScriptingBridge::AddSpring(const NPVariant* args,
+                                uint32_t arg_count,
+                                NPVariant* result) {
+  return AddPrimitive(FORCE_SPRING, args, arg_count, result);
+}
+
+bool ScriptingBridge::RemovePrimitive(const NPVariant* args,
+                                      uint32_t arg_count,
+                                      NPVariant* result) {
+  if (arg_count != 1)
+    return false;
+  int id;
+  if (!NPVariantToInt(args[0], &id)) {
+    NPN_SetException(this, "removePrimitive: id must be an integer");
+    return false;
+  }
+
+  HapticsService* haptics_service = service_;
+  if (haptics_service)
+    return haptics_service->RemoveForcePrimitive(id, result);
+  return false;
+}
+
+bool ScriptingBridge::ClearPrimitives(const NPVariant* /* args */,
+                                      uint32_t /* arg_count */,
+                                      NPVariant* result) {
+  HapticsService* haptics_service = service_;
+  if (haptics_service)
+    return haptics_service->ClearForcePrimitives(result);
+  return false;
+}
+
+bool ScriptingBridge::AddEffect(const NPVariant* args,
+                                uint32_t arg_count,
+                                NPVariant* result) {
+  if (arg_count < 2 || arg_count > 4)
+    return false;
+
+  EffectType type;
+  if (!NPVARIANT_IS_STRING(args[0]) ||
+      !EffectTypeFromName(NPVARIANT_TO_STRING(args[0]), &type)) {
+    return false;
+  }
+  if (!NPVARIANT_IS_OBJECT(args[1]))
+    return false;
+
+  double start_ms = -1;
+  if (arg_count > 2 && !NPVARIANT_IS_NULL(args[2]) &&
+      !NPVariantToDouble(args[2], &start_ms)) {
+    return false;
+  }
+  double duration_ms = 0;
+  if (arg_count > 3 && !NPVariantToDouble(args[3], &duration_ms))
+    return false;
+
+  HapticsService* haptics_service = service_;
+  if (haptics_service) {
+    return haptics_service->AddEffect(type, NPVARIANT_TO_OBJECT(args[1]),
+                                      start_ms, duration_ms, result);
+  }
+  return false;
+}
+
+bool ScriptingBridge::RemoveEffect(const NPVariant* args,
+                                   uint32_t arg_count,
+                                   NPVariant* result) {
+  if (arg_count != 1)
+    return false;
+  int id;
+  if (!NPVariantToInt(args[0], &id)) {
+    NPN_SetException(this, "removeEffect: id must be an integer");
+    return false;
+  }
+
+  HapticsService* haptics_service = service_;
+  if (haptics_service)
+    return haptics_service->RemoveEffect(id, result);
+  return false;
+}
+
+bool ScriptingBridge::ClearEffects(const NPVariant* /* args */,
+                                   uint32_t /* arg_count */,
+                                   NPVariant* result) {
+  HapticsService* haptics_service = service_;
+  if (haptics_service)
+    return haptics_service->ClearEffects(result);
+  return false;
+}
+
+bool ScriptingBridge::UploadMesh(const NPVariant* args,
+                                 uint32_t arg_count,
+                                 NPVariant* result) {
+  if (arg_count != 3 ||
+      !NPVARIANT_IS_STRING(args[0]) ||
+      !NPVARIANT_IS_STRING(args[1])) {
+    return false;
+  }
+  double stiffness;
+  if (!NPVariantToDouble(args[2], &stiffness))
+    return false;
+
+  HapticsService* haptics_service = service_;
+  if (haptics_service) {
+    return haptics_service->UploadMesh(NPVARIANT_TO_STRING(args[0]),
+                                       NPVARIANT_TO_STRING(args[1]),
+                                       stiffness,
+                                       result);
+  }
+  return false;
+}
+
+bool ScriptingBridge::ClearMesh(const NPVariant* /* args */,
+                                uint32_t /* arg_count */,
+                                NPVariant* result) {
+  HapticsService* haptics_service = service_;
+  if (haptics_service)
+    return haptics_service->ClearMesh(result);
+  return false;
+}
+
+bool ScriptingBridge::UploadVolumeData(bool bricked,
+                                       const NPVariant* args,
+                                       uint32_t arg_count,
+                                       NPVariant* result) {
+  if (arg_count != 3 ||
+      !NPVARIANT_IS_STRING(args[0]) ||
+      !NPVARIANT_IS_STRING(args[1])) {
+    return false;
+  }
+  double stiffness;
+  if (!NPVariantToDouble(args[2], &stiffness))
+    return false;
+
+  HapticsService* haptics_service = service_;
+  if (haptics_service) {
+    return haptics_service->UploadVolume(NPVARIANT_TO_STRING(args[0]),
+                                         NPVARIANT_TO_STRING(args[1]),
+                                         bricked,
+                                         stiffness,
+                                         result);
+  }
+  return false;
+}
+
+bool ScriptingBridge::UploadVolume(const NPVariant* args,
+                                   uint32_t arg_count,
+                                   NPVariant* result) {
+  return UploadVolumeData(false, args, arg_count, result);
+}
+
+bool ScriptingBridge::UploadVolumeBricks(const NPVariant* args,
+                                         uint32_t arg_count,
+                                         NPVariant* result) {
+  return UploadVolumeData(true, args, arg_count, result);
+}
+
+bool ScriptingBridge::ClearVolume(const NPVariant* /* args */,
+                                  uint32_t /* arg_count */,
+                                  NPVariant* result) {
+  HapticsService* haptics_service = service_;
+  if (haptics_service)
+    return haptics_service->ClearVolume(result);
+  return false;
+}
+
+bool ScriptingBridge::UploadDeformable(const NPVariant* args,
+                                       uint32_t arg_count,
+                                       NPVariant* result) {
+  if (arg_count != 5 ||
+      !NPVARIANT_IS_STRING(args[0]) ||
+      !NPVARIANT_IS_STRING(args[1])) {
+    return false;
+  }
+  double damping;
+  double tool_radius;
+  double contact_stiffness;
+  if (!NPVariantToDouble(args[2], &damping) ||
+      !NPVariantToDouble(args[3], &tool_radius) ||
+      !NPVariantToDouble(args[4], &contact_stiffness)) {
+    return false;
+  }
+
+  HapticsService* haptics_service = service_;
+  if (haptics_service) {
+    return haptics_service->UploadDeformable(NPVARIANT_TO_STRING(args[0]),
+                                             NPVARIANT_TO_STRING(args[1]),
+                                             damping,
+                                             tool_radius,
+                                             contact_stiffness,
+                                             result);
+  }
+  return false;
+}
+
+bool ScriptingBridge::ClearDeformable(const NPVariant* /* args */,
+                                      uint32_t /* arg_count */,
+                                      NPVariant* result) {
+  HapticsService* haptics_service = service_;
+  if (haptics_service)
+    return haptics_service->ClearDeformable(result);
+  return false;
+}
+
+bool ScriptingBridge::DrainSamples(const NPVariant* /* args */,
+                                   uint32_t /* arg_count */,
+                                   NPVariant* result) {
+  HapticsService* haptics_service = service_;
+  if (haptics_service) {
+    haptics_service->DrainSamples(result);
+    return true;
+  }
+  return false;
+}
+
+bool ScriptingBridge::DrainEvents(const NPVariant* /* args */,
+                                  uint32_t /* arg_count */,
+                                  NPVariant* result) {
+  HapticsService* haptics_service = service_;
+  if (haptics_service) {
+    haptics_service->DrainEvents(result);
+    return true;
+  }
+  return false;
+}
+
+bool ScriptingBridge::StartRecording(const NPVariant* args,
+                                     uint32_t arg_count,
+                                     NPVariant* result) {
+  if (arg_count != 1 || !NPVARIANT_IS_STRING(args[0]))
+    return false;
+
+  HapticsService* haptics_service = service_;
+  if (haptics_service)
+    return haptics_service->StartRecording(NPVARIANT_TO_STRING(args[0]),
+                                           result);
+  return false;
+}
+
+bool ScriptingBridge::StopRecording(const NPVariant* /* args */,
+                                    uint32_t /* arg_count */,
+                                    NPVariant* result) {
+  HapticsService* haptics_service = service_;
+  if (haptics_service)
+    return haptics_service->StopRecording(result);
+  return false;
+}
+
+bool ScriptingBridge::ResetStats(const NPVariant* /* args */,
+                                 uint32_t /* arg_count */,
+                                 NPVariant* result) {
+  HapticsService* haptics_service = service_;
+  if (haptics_service)
+    return haptics_service->ResetStats(result);
+  return false;
+}
+
+bool ScriptingBridge::OnState(const NPVariant* args,
+                              uint32_t arg_count,
+                              NPVariant* result) {
+  if (arg_count < 1 || arg_count > 3)
+    return false;
+
+  NPObject* callback = NULL;
+  if (NPVARIANT_IS_OBJECT(args[0]))
+    callback = NPVARIANT_TO_OBJECT(args[0]);
+  else if (!NPVARIANT_IS_NULL(args[0]) && !NPVARIANT_IS_VOID(args[0]))
+    return false;
+
+  // By default deliver every change, as fast as the servo loop runs.
+  double rate_hz = 1000.0;
+  double min_delta = 0.0;
+  if (arg_count > 1 && !NPVariantToDouble(args[1], &rate_hz))
+    return false;
+  if (arg_count > 2 && !NPVariantToDouble(args[2], &min_delta))
+    return false;
+
+  HapticsService* haptics_service = service_;
+  if (haptics_service) {
+    return haptics_service->SetStateCallback(callback, rate_hz, min_delta,
+                                             result);
+  }
   return false;
 }
 
 bool ScriptingBridge::GetDebug(NPVariant* value) {
-  HapticsService* haptics_service = static_cast<HapticsService*>(npp_->pdata);
+  HapticsService* haptics_service = service_;
   if (haptics_service) {
     BOOLEAN_TO_NPVARIANT(haptics_service->debug(), *value);
     return true;
@@ -136,7 +764,7 @@ bool ScriptingBridge::GetDebug(NPVariant* value) {
 }
 
 bool ScriptingBridge::SetDebug(const NPVariant* value) {
-  HapticsService* haptics_service = static_cast<HapticsService*>(npp_->pdata);
+  HapticsService* haptics_service = service_;
   if (!haptics_service)
     return false;
 
@@ -148,7 +776,7 @@ bool ScriptingBridge::SetDebug(const NPVariant* value) {
 }
 
 bool ScriptingBridge::GetPosition(NPVariant* value) {
-  HapticsService* haptics_service = static_cast<HapticsService*>(npp_->pdata);
+  HapticsService* haptics_service = service_;
   if (haptics_service) {
     haptics_service->GetPosition(value);
     return true;
@@ -157,8 +785,138 @@ bool ScriptingBridge::GetPosition(NPVariant* value) {
   return false;
 }
 
+bool ScriptingBridge::GetPositionAxis(int axis, NPVariant* value) {
+  HapticsService* haptics_service = service_;
+  if (haptics_service) {
+    haptics_service->GetPositionAxis(axis, value);
+    return true;
+  }
+  VOID_TO_NPVARIANT(*value);
+  return false;
+}
+
+bool ScriptingBridge::GetPositionX(NPVariant* value) {
+  return GetPositionAxis(0, value);
+}
+
+bool ScriptingBridge::GetPositionY(NPVariant* value) {
+  return GetPositionAxis(1, value);
+}
+
+bool ScriptingBridge::GetPositionZ(NPVariant* value) {
+  return GetPositionAxis(2, value);
+}
+
+bool ScriptingBridge::GetVelocity(NPVariant* value) {
+  HapticsService* haptics_service = service_;
+  if (haptics_service) {
+    haptics_service->GetVelocity(value);
+    return true;
+  }
+  VOID_TO_NPVARIANT(*value);
+  return false;
+}
+
+bool ScriptingBridge::GetAcceleration(NPVariant* value) {
+  HapticsService* haptics_service = service_;
+  if (haptics_service) {
+    haptics_service->GetAcceleration(value);
+    return true;
+  }
+  VOID_TO_NPVARIANT(*value);
+  return false;
+}
+
+bool ScriptingBridge::GetTime(NPVariant* value) {
+  HapticsService* haptics_service = service_;
+  if (haptics_service) {
+    haptics_service->GetTime(value);
+    return true;
+  }
+  VOID_TO_NPVARIANT(*value);
+  return false;
+}
+
+bool ScriptingBridge::GetDevices(NPVariant* value) {
+  HapticsService* haptics_service = service_;
+  if (haptics_service) {
+    haptics_service->GetDevices(value);
+    return true;
+  }
+  VOID_TO_NPVARIANT(*value);
+  return false;
+}
+
+bool ScriptingBridge::GetStats(NPVariant* value) {
+  HapticsService* haptics_service = service_;
+  if (haptics_service) {
+    haptics_service->GetStats(value);
+    return true;
+  }
+  VOID_TO_NPVARIANT(*value);
+  return false;
+}
+
+bool ScriptingBridge::GetDeformableNodes(NPVariant* value) {
+  HapticsService* haptics_service = service_;
+  if (haptics_service) {
+    haptics_service->GetDeformableNodes(value);
+    return true;
+  }
+  VOID_TO_NPVARIANT(*value);
+  return false;
+}
+
+bool ScriptingBridge::GetDamping(NPVariant* value) {
+  HapticsService* haptics_service = service_;
+  if (haptics_service) {
+    haptics_service->GetDamping(value);
+    return true;
+  }
+  VOID_TO_NPVARIANT(*value);
+  return false;
+}
+
+bool ScriptingBridge::SetDamping(const NPVariant* value) {
+  HapticsService* haptics_service = service_;
+  if (!haptics_service)
+    return false;
+
+  double damping;
+  if (!NPVariantToDouble(*value, &damping))
+    return false;
+
+  haptics_service->SetDamping(damping);
+  return true;
+}
+
+bool ScriptingBridge::GetPriority(NPVariant* value) {
+  HapticsService* haptics_service = service_;
+  if (haptics_service) {
+    haptics_service->GetPriority(value);
+    return true;
+  }
+  VOID_TO_NPVARIANT(*value);
+  return false;
+}
+
+bool ScriptingBridge::SetPriority(const NPVariant* value) {
+  HapticsService* haptics_service = service_;
+  if (!haptics_service)
+    return false;
+
+  int priority;
+  if (!NPVariantToInt(*value, &priority)) {
+    NPN_SetException(this, "priority must be an integer");
+    return false;
+  }
+
+  haptics_service->SetPriority(priority);
+  return true;
+}
+
 bool ScriptingBridge::GetInitialized(NPVariant* value) {
-  HapticsService* haptics_service = static_cast<HapticsService*>(npp_->pdata);
+  HapticsService* haptics_service = service_;
   if (haptics_service) {
     haptics_service->GetInitialized(value);
     return true;
@@ -176,53 +934,45 @@ bool ScriptingBridge::GetInitialized(NPVariant* value) {
 // Class-specific implementation of HasMethod, used by the C-style one
 // below.
 bool ScriptingBridge::HasMethod(NPIdentifier name) {
-  std::map<NPIdentifier, MethodSelector>::iterator i;
-  i = method_table->find(name);
-  return i != method_table->end();
+  return method_table.Find(name, NULL);
 }
 
 // Class-specific implementation of HasProperty, used by the C-style one
 // below.
 bool ScriptingBridge::HasProperty(NPIdentifier name) {
-  std::map<NPIdentifier, GetPropertySelector>::iterator i;
-  i = get_property_table->find(name);
-  return i != get_property_table->end();
+  return get_property_table.Find(name, NULL);
 }
 
 // Class-specific implementation of GetProperty, used by the C-style one
 // below.
 bool ScriptingBridge::GetProperty(NPIdentifier name, NPVariant *value) {
   VOID_TO_NPVARIANT(*value);
-  std::map<NPIdentifier, GetPropertySelector>::iterator i;
-  i = get_property_table->find(name);
-  if (i != get_property_table->end()) {
-    return (this->*(i->second))(value);
-  }
+  GetPropertySelector selector;
+  if (get_property_table.Find(name, &selector))
+    return (this->*selector)(value);
   return false;
 }
 
 // Class-specific implementation of SetProperty, used by the C-style one
 // below.
 bool ScriptingBridge::SetProperty(NPIdentifier name, const NPVariant* value) {
-  std::map<NPIdentifier, SetPropertySelector>::iterator i;
-  i = set_property_table->find(name);
-  if (i != set_property_table->end()) {
-    return (this->*(i->second))(value);
-  }
+  SetPropertySelector selector;
+  if (set_property_table.Find(name, &selector))
+    return (this->*selector)(value);
   return false;
 }
 
 // Class-specific implementation of RemoveProperty, used by the C-style one
 // below.
-bool ScriptingBridge::RemoveProperty(NPIdentifier name) {
+bool ScriptingBridge::RemoveProperty(NPIdentifier /* name */) {
   return false;  // Not implemented.
 }
 
 // Class-specific implementation of InvokeDefault, used by the C-style one
 // below.
-bool ScriptingBridge::InvokeDefault(const NPVariant* args,
-                                    uint32_t arg_count,
-                                    NPVariant* result) {
+bool ScriptingBridge::InvokeDefault(const NPVariant* /* args */,
+                                    uint32_t /* arg_count */,
+                                    NPVariant* /* result */) {
   return false;  // Not implemented.
 }
 
@@ -231,11 +981,9 @@ bool ScriptingBridge::InvokeDefault(const NPVariant* args,
 bool ScriptingBridge::Invoke(NPIdentifier name,
                              const NPVariant* args, uint32_t arg_count,
                              NPVariant* result) {
-  std::map<NPIdentifier, MethodSelector>::iterator i;
-  i = method_table->find(name);
-  if (i != method_table->end()) {
-    return (this->*(i->second))(args, arg_count, result);
-  }
+  MethodSelector selector;
+  if (method_table.Find(name, &selector))
+    return (this->*selector)(args, arg_count, result);
   return false;
 }
 
@@ -343,5 +1091,7 @@ NPClass haptics::ScriptingBridge::np_class = {
   haptics::HasProperty,
   haptics::GetProperty,
   haptics::SetProperty,
-  haptics::RemoveProperty
+  haptics::RemoveProperty,
+  NULL,  // enumerate
+  NULL   // construct
 };
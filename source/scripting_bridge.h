@@ -6,13 +6,27 @@
 #define SCRIPTING_BRIDGE_H_
 #pragma once
 
-#include <map>
-
 #include "npapi.h"
 #include "npfunctions.h"
 
+#include "dispatch_table.h"
+#include "effect_library.h"
+#include "force_field.h"
+
 namespace haptics {
-  
+
+class HapticsService;
+
+// Reads a JavaScript number, which arrives either as an int32 or as a double
+// variant. Returns false if |variant| is not a number, or is NaN or an
+// infinity, which would otherwise end up in the forces.
+bool NPVariantToDouble(const NPVariant& variant, double* value);
+
+// Reads a JavaScript number that must be a whole number in the range of int,
+// such as an id. Returns false for anything else, including NaN, infinities
+// and fractions, whose conversion to int would be undefined.
+bool NPVariantToInt(const NPVariant& variant, int* value);
+
 // The class that gets exposed to the browser code.
 class ScriptingBridge : public NPObject {
  public:
@@ -21,10 +35,17 @@ class ScriptingBridge : public NPObject {
                                                   NPVariant* result);
   typedef bool (ScriptingBridge::*GetPropertySelector)(NPVariant* value);
   typedef bool (ScriptingBridge::*SetPropertySelector)(const NPVariant* result);
+  typedef DispatchTable<MethodSelector, 64> MethodTable;
+  typedef DispatchTable<GetPropertySelector, 32> GetPropertyTable;
+  typedef DispatchTable<SetPropertySelector, 32> SetPropertyTable;
 
-  explicit ScriptingBridge(NPP npp): npp_(npp) {}
+  explicit ScriptingBridge(NPP npp): npp_(npp), service_(NULL) {}
   virtual ~ScriptingBridge();
 
+  // The service, and so the device, this object scripts. Cleared when the
+  // service goes away, after which every call fails.
+  void set_service(HapticsService* service) { service_ = service; }
+
   // These methods represent the NPObject implementation.  The browser calls
   // these methods by calling functions in the |np_class| struct.
   virtual void Invalidate();
@@ -41,7 +62,10 @@ class ScriptingBridge : public NPObject {
   virtual bool SetProperty(NPIdentifier name, const NPVariant* value);
   virtual bool RemoveProperty(NPIdentifier name);
 
-  // Initializes all the bridge identifiers from JavaScript land.
+  // Initializes all the bridge identifiers from JavaScript land and builds
+  // the dispatch tables shared by every instance. Returns false if a table
+  // is too small, on this and every later call, in which case no instance
+  // can be scripted.
   static bool InitializeIdentifiers();
 
   static NPClass np_class;
@@ -51,16 +75,167 @@ class ScriptingBridge : public NPObject {
   // the broswer sees. Each of these methods wraps a method in the associated
   // HapticService object, which is where the actual implementation lies.
 
-  // Starts the haptic device.
+  // Starts the haptic device without blocking the page:
+  //   startDevice([callback(status)])
+  // The callback gets "ok" once forces are rendered, or why they are not:
+  // "no-device", "servo-failed", "busy" or "stopped".
   bool StartDevice(const NPVariant* args, uint32_t arg_count,
                    NPVariant* result);
   // Stops the haptic device.
   bool StopDevice(const NPVariant* args, uint32_t arg_count,
                   NPVariant* result);
-  // Sends force to the haptic device.
+  // Sends force to the haptic device:
+  //   sendForce(force)
+  //   sendForce(force, anchor, stiffness, [damping])
+  // The second form also says how the force changes as the tool moves away
+  // from |anchor|, so the servo loop can update it between calls.
   bool SendForce(const NPVariant* args, uint32_t arg_count,
                  NPVariant* result);
 
+  // Cheaper forms of sendForce that skip reading a script array:
+  //   sendForce3(x, y, z)
+  //   sendForces(forces, [periodMs])
+  // sendForces takes the JSON text of a flat fx, fy, fz array and plays one
+  // force every |periodMs| (1 by default) from now on, through the same
+  // queue as scheduleForces. It returns the number of forces queued.
+  bool SendForce3(const NPVariant* args, uint32_t arg_count,
+                  NPVariant* result);
+  bool SendForces(const NPVariant* args, uint32_t arg_count,
+                  NPVariant* result);
+
+  // Queues force keyframes the servo loop interpolates between:
+  //   scheduleForces(keyframes)
+  // where |keyframes| is the JSON text of a flat array of time (ms, on the
+  // clock of the time property), fx, fy, fz per keyframe, sorted by time.
+  // Returns the number queued, or null if the data is malformed.
+  bool ScheduleForces(const NPVariant* args, uint32_t arg_count,
+                      NPVariant* result);
+  // Drops the queued keyframes and releases the held one.
+  bool ClearScheduledForces(const NPVariant* args, uint32_t arg_count,
+                            NPVariant* result);
+
+  // Chooses the coordinates of positions, forces and native shapes:
+  //   setWorkspace(minx, miny, minz, maxx, maxy, maxz, [uniform])
+  // fits the device workspace into the box, with the same scale on every
+  // axis unless |uniform| is false.
+  //   setWorkspaceTransform(matrix)
+  // maps device coordinates through a column-major 4x4 array instead, for
+  // rotations; null goes back to device coordinates. Returns false if the
+  // matrix is not invertible.
+  bool SetWorkspace(const NPVariant* args, uint32_t arg_count,
+                    NPVariant* result);
+  bool SetWorkspaceTransform(const NPVariant* args, uint32_t arg_count,
+                             NPVariant* result);
+
+  // Sets how the velocity and acceleration properties are smoothed:
+  //   setMotionFilter(velocityCutoffHz, accelerationCutoffHz)
+  // Zero turns a filter off.
+  bool SetMotionFilter(const NPVariant* args, uint32_t arg_count,
+                       NPVariant* result);
+
+  // Adds a primitive to the native force field and returns its id, or null
+  // if the field is full. Signatures:
+  //   addPlane(nx, ny, nz, offset, stiffness)
+  //   addSphere(cx, cy, cz, radius, stiffness)
+  //   addBox(cx, cy, cz, half_x, half_y, half_z, stiffness)
+  //   addSpring(x, y, z, stiffness)
+  bool AddPlane(const NPVariant* args, uint32_t arg_count, NPVariant* result);
+  bool AddSphere(const NPVariant* args, uint32_t arg_count,
+                 NPVariant* result);
+  bool AddBox(const NPVariant* args, uint32_t arg_count, NPVariant* result);
+  bool AddSpring(const NPVariant* args, uint32_t arg_count,
+                 NPVariant* result);
+  // Removes the primitive with the given id.
+  bool RemovePrimitive(const NPVariant* args, uint32_t arg_count,
+                       NPVariant* result);
+  // Removes every primitive from the force field.
+  bool ClearPrimitives(const NPVariant* args, uint32_t arg_count,
+                       NPVariant* result);
+
+  // Layers an effect on top of everything else and returns its id, or null
+  // if it is malformed or too many effects are running:
+  //   addEffect(type, params, [startMs], [durationMs])
+  // |type| is one of "spring", "damper", "constant", "ramp", "sine",
+  // "square", "saw", "friction" or "impulse" and |params| the array of
+  // numbers described at EffectType. |startMs| is on the clock of the time
+  // property, omitted or null for now; |durationMs| omitted or 0 runs the
+  // effect until it is removed.
+  bool AddEffect(const NPVariant* args, uint32_t arg_count,
+                 NPVariant* result);
+  // Removes the effect with the given id.
+  bool RemoveEffect(const NPVariant* args, uint32_t arg_count,
+                    NPVariant* result);
+  // Removes every effect.
+  bool ClearEffects(const NPVariant* args, uint32_t arg_count,
+                    NPVariant* result);
+
+  // Replaces the touchable triangle mesh:
+  //   uploadMesh(vertices, indices, stiffness)
+  // where |vertices| is the JSON text of a flat array of xyz coordinates and
+  // |indices| that of a flat array of vertex index triples. Returns the
+  // number of triangles, or null if the data is malformed.
+  bool UploadMesh(const NPVariant* args, uint32_t arg_count,
+                  NPVariant* result);
+  // Removes the mesh.
+  bool ClearMesh(const NPVariant* args, uint32_t arg_count,
+                 NPVariant* result);
+
+  // Replaces the touchable signed distance volume:
+  //   uploadVolume(grid, values, stiffness)
+  //   uploadVolumeBricks(grid, bricks, stiffness)
+  // where |grid| is the JSON text of [sizeX, sizeY, sizeZ, originX, originY,
+  // originZ, spacing], |values| that of every sample, x fastest, and
+  // |bricks| that of the 8x8x8 sample bricks near the surface, each as its
+  // brick x, y, z followed by its samples. Returns the number of bricks
+  // stored, or null if the data is malformed.
+  bool UploadVolume(const NPVariant* args, uint32_t arg_count,
+                    NPVariant* result);
+  bool UploadVolumeBricks(const NPVariant* args, uint32_t arg_count,
+                          NPVariant* result);
+  // Removes the volume.
+  bool ClearVolume(const NPVariant* args, uint32_t arg_count,
+                   NPVariant* result);
+
+  // Replaces the deformable body, simulated natively on its own thread:
+  //   uploadDeformable(nodes, springs, damping, toolRadius, contactStiffness)
+  // where |nodes| is the JSON text of a flat array of x, y, z, mass per node,
+  // mass 0 pinning the node, and |springs| that of the two node indices and
+  // the stiffness of every spring. Returns the number of nodes, or null if
+  // the data is malformed or the body too stiff for its masses.
+  bool UploadDeformable(const NPVariant* args, uint32_t arg_count,
+                        NPVariant* result);
+  // Removes the deformable body.
+  bool ClearDeformable(const NPVariant* args, uint32_t arg_count,
+                       NPVariant* result);
+
+  // Returns the text of a flat array holding every servo tick since the last
+  // call, 8 numbers per tick: time (ms), x, y, z, button, fx, fy, fz.
+  bool DrainSamples(const NPVariant* args, uint32_t arg_count,
+                    NPVariant* result);
+  // Returns the text of a flat array holding every button press and release
+  // since the last call, 5 numbers per event: time (ms), pressed, x, y, z.
+  bool DrainEvents(const NPVariant* args, uint32_t arg_count,
+                   NPVariant* result);
+
+  // Records every servo tick to a binary file for replay:
+  //   startRecording(name)
+  // where |name| is a plain file name, created in HAPTICS_RECORD_DIR or the
+  // temporary directory. Returns whether it started. stopRecording()
+  // returns the number of ticks recorded, or null.
+  bool StartRecording(const NPVariant* args, uint32_t arg_count,
+                      NPVariant* result);
+  bool StopRecording(const NPVariant* args, uint32_t arg_count,
+                     NPVariant* result);
+
+  // Clears the servo loop timing returned by the stats property.
+  bool ResetStats(const NPVariant* args, uint32_t arg_count,
+                  NPVariant* result);
+
+  // Subscribes a function to device state changes:
+  //   onState(callback(x, y, z, button), [rateHz], [minDelta])
+  // Passing null as the callback cancels the subscription.
+  bool OnState(const NPVariant* args, uint32_t arg_count, NPVariant* result);
+
   // Accessor/mutator for the debug property.
   bool GetDebug(NPVariant* value);
   bool SetDebug(const NPVariant* value);
@@ -68,20 +243,107 @@ class ScriptingBridge : public NPObject {
 
   // Position accessor.
   bool GetPosition(NPVariant* value);
+  // Scalar position accessors, cheaper than the array when polled.
+  bool GetPositionX(NPVariant* value);
+  bool GetPositionY(NPVariant* value);
+  bool GetPositionZ(NPVariant* value);
+  // Filtered tool velocity and acceleration, as arrays like position.
+  bool GetVelocity(NPVariant* value);
+  bool GetAcceleration(NPVariant* value);
+
+  // Milliseconds on the clock effects are scheduled against.
+  bool GetTime(NPVariant* value);
+
+  // Servo loop timing, see HapticsService::GetStats.
+  bool GetStats(NPVariant* value);
+
+  // Text of a flat array of the latest x, y, z of every node of the
+  // deformable body, or null if there is none.
+  bool GetDeformableNodes(NPVariant* value);
+
+  // Array with an object per attached device, each scripting that device
+  // with the same methods and properties as this one. The plugin object
+  // itself is the first.
+  bool GetDevices(NPVariant* value);
+
+  // Accessor/mutator for the priority of this page on the device. Every
+  // page embedding the plugin shares the device; only the started pages
+  // with the highest priority are felt, and their forces add up.
+  bool GetPriority(NPVariant* value);
+  bool SetPriority(const NPVariant* value);
+
+  // Accessor/mutator for the viscous damping of the force field.
+  bool GetDamping(NPVariant* value);
+  bool SetDamping(const NPVariant* value);
 
  private:
+  bool GetPositionAxis(int axis, NPVariant* value);
+
+  // Shared implementation of the add{Plane|Sphere|Box|Spring} methods.
+  bool AddPrimitive(ForcePrimitiveType type,
+                    const NPVariant* args,
+                    uint32_t arg_count,
+                    NPVariant* result);
+
+  // Shared implementation of the uploadVolume{Bricks} methods.
+  bool UploadVolumeData(bool bricked,
+                        const NPVariant* args,
+                        uint32_t arg_count,
+                        NPVariant* result);
+
   NPP npp_;
+  HapticsService* service_;
 
   static NPIdentifier id_debug;
   static NPIdentifier id_position;
+  static NPIdentifier id_position_x;
+  static NPIdentifier id_position_y;
+  static NPIdentifier id_position_z;
   static NPIdentifier id_initialized;
   static NPIdentifier id_start_device;
   static NPIdentifier id_stop_device;
   static NPIdentifier id_send_force;
+  static NPIdentifier id_send_force3;
+  static NPIdentifier id_send_forces;
+  static NPIdentifier id_add_plane;
+  static NPIdentifier id_add_sphere;
+  static NPIdentifier id_add_box;
+  static NPIdentifier id_add_spring;
+  static NPIdentifier id_remove_primitive;
+  static NPIdentifier id_clear_primitives;
+  static NPIdentifier id_damping;
+  static NPIdentifier id_on_state;
+  static NPIdentifier id_drain_samples;
+  static NPIdentifier id_drain_events;
+  static NPIdentifier id_start_recording;
+  static NPIdentifier id_stop_recording;
+  static NPIdentifier id_upload_mesh;
+  static NPIdentifier id_clear_mesh;
+  static NPIdentifier id_upload_volume;
+  static NPIdentifier id_upload_volume_bricks;
+  static NPIdentifier id_clear_volume;
+  static NPIdentifier id_stats;
+  static NPIdentifier id_reset_stats;
+  static NPIdentifier id_add_effect;
+  static NPIdentifier id_remove_effect;
+  static NPIdentifier id_clear_effects;
+  static NPIdentifier id_time;
+  static NPIdentifier id_schedule_forces;
+  static NPIdentifier id_clear_scheduled_forces;
+  static NPIdentifier id_set_workspace;
+  static NPIdentifier id_set_workspace_transform;
+  static NPIdentifier id_velocity;
+  static NPIdentifier id_acceleration;
+  static NPIdentifier id_set_motion_filter;
+  static NPIdentifier id_devices;
+  static NPIdentifier id_priority;
+  static NPIdentifier id_upload_deformable;
+  static NPIdentifier id_clear_deformable;
+  static NPIdentifier id_deformable_nodes;
 
-  static std::map<NPIdentifier, MethodSelector>* method_table;
-  static std::map<NPIdentifier, GetPropertySelector>* get_property_table;
-  static std::map<NPIdentifier, SetPropertySelector>* set_property_table;
+  static MethodTable method_table;
+  static GetPropertyTable get_property_table;
+  static SetPropertyTable set_property_table;
 };
 
 }  // namespace haptics
@@ -0,0 +1,315 @@
+// Copyright 2010 Mohamed Mansour. All rights reserved.
+// Use of this source code is governed by a GPL license that can
+// be found in the LICENSE file.
+
+#include "sdf_volume.h"
+
+#include <float.h>
+#include <math.h>
+#include <stddef.h>
+
+#include <algorithm>
+
+// Like HAPTICS_SSE2, but single precision only needs SSE.
+#if !defined(HAPTICS_NO_SIMD) && \
+    (defined(__SSE__) || defined(_M_X64) || \
+     (defined(_M_IX86_FP) && _M_IX86_FP >= 1))
+#define SDF_VOLUME_USE_SSE 1
+#include <xmmintrin.h>
+#endif
+
+namespace haptics {
+
+// Where Build() gets the samples from.
+class SdfVolume::Source {
+ public:
+  virtual ~Source() {}
+  // Whether the brick at |brick| holds any data.
+  virtual bool HasBrick(const int brick[3]) const = 0;
+  // Value of the sample at |sample|, which is inside the grid, while filling
+  // the brick at |brick|.
+  virtual double At(const int sample[3], const int brick[3]) const = 0;
+};
+
+namespace {
+
+int BrickCount(int samples) {
+  return (samples + SdfVolume::kBrickSize - 1) / SdfVolume::kBrickSize;
+}
+
+bool IsValidGrid(const VolumeGrid& grid) {
+  if (grid.size[0] < 2 || grid.size[1] < 2 || grid.size[2] < 2)
+    return false;
+  double samples = static_cast<double>(grid.size[0]) * grid.size[1] *
+      grid.size[2];
+  return samples <= SdfVolume::kMaxSamples;
+}
+
+// Every sample of the grid, x fastest.
+class DenseSource : public SdfVolume::Source {
+ public:
+  DenseSource(const VolumeGrid& grid, const std::vector<double>& values)
+      : grid_(grid), values_(values) {}
+
+  virtual bool HasBrick(const int /* brick */[3]) const { return true; }
+
+  virtual double At(const int sample[3], const int /* brick */[3]) const {
+    size_t index = (static_cast<size_t>(sample[2]) * grid_.size[1] +
+                    sample[1]) * grid_.size[0] + sample[0];
+    return values_[index];
+  }
+
+ private:
+  const VolumeGrid& grid_;
+  const std::vector<double>& values_;
+};
+
+// The bricks the page chose to send, see SdfVolume::BuildSparse.
+class SparseSource : public SdfVolume::Source {
+ public:
+  SparseSource(const VolumeGrid& grid, const std::vector<double>& bricks)
+      : bricks_(bricks) {
+    for (int k = 0; k < 3; k++)
+      brick_count_[k] = BrickCount(grid.size[k]);
+    offsets_.assign(static_cast<size_t>(brick_count_[0]) * brick_count_[1] *
+                    brick_count_[2], -1);
+  }
+
+  // Indexes the bricks. Returns false if a brick is malformed, out of the
+  // grid or given twice.
+  bool Index() {
+    const size_t stride = 3 + SdfVolume::kBrickSamples;
+    if (bricks_.size() % stride != 0)
+      return false;
+    for (size_t offset = 0; offset < bricks_.size(); offset += stride) {
+      int brick[3];
+      for (int k = 0; k < 3; k++) {
+        double coordinate = bricks_[offset + k];
+        if (coordinate < 0 || coordinate >= brick_count_[k] ||
+            coordinate != floor(coordinate)) {
+          return false;
+        }
+        brick[k] = static_cast<int>(coordinate);
+      }
+      ptrdiff_t& slot = offsets_[TableIndex(brick)];
+      if (slot >= 0)
+        return false;
+      slot = static_cast<ptrdiff_t>(offset + 3);
+    }
+    return true;
+  }
+
+  virtual bool HasBrick(const int brick[3]) const {
+    return offsets_[TableIndex(brick)] >= 0;
+  }
+
+  virtual double At(const int sample[3], const int brick[3]) const {
+    int owner[3];
+    int clamped[3];
+    for (int k = 0; k < 3; k++) {
+      owner[k] = sample[k] / SdfVolume::kBrickSize;
+      clamped[k] = sample[k];
+    }
+    if (!HasBrick(owner)) {
+      // Nothing was sent next to this brick, continue its own border.
+      for (int k = 0; k < 3; k++) {
+        owner[k] = brick[k];
+        clamped[k] = std::min(sample[k],
+                              (brick[k] + 1) * SdfVolume::kBrickSize - 1);
+      }
+    }
+    int local[3];
+    for (int k = 0; k < 3; k++)
+      local[k] = clamped[k] - owner[k] * SdfVolume::kBrickSize;
+    return bricks_[offsets_[TableIndex(owner)] +
+                   (local[2] * SdfVolume::kBrickSize + local[1]) *
+                       SdfVolume::kBrickSize + local[0]];
+  }
+
+ private:
+  size_t TableIndex(const int brick[3]) const {
+    return (static_cast<size_t>(brick[2]) * brick_count_[1] + brick[1]) *
+        brick_count_[0] + brick[0];
+  }
+
+  const std::vector<double>& bricks_;
+  int brick_count_[3];
+  std::vector<ptrdiff_t> offsets_;
+};
+
+}  // namespace
+
+SdfVolume::SdfVolume()
+    : stiffness_(0.0) {
+  for (int k = 0; k < 3; k++) {
+    grid_.size[k] = 0;
+    grid_.origin[k] = 0.0;
+    bricks_[k] = 0;
+  }
+  grid_.spacing = 0.0;
+}
+
+bool SdfVolume::BuildDense(const VolumeGrid& grid,
+                           const std::vector<double>& values) {
+  if (!IsValidGrid(grid))
+    return false;
+  if (values.size() != static_cast<size_t>(grid.size[0]) * grid.size[1] *
+                           grid.size[2]) {
+    return false;
+  }
+  return Build(grid, DenseSource(grid, values));
+}
+
+bool SdfVolume::BuildSparse(const VolumeGrid& grid,
+                            const std::vector<double>& bricks) {
+  if (!IsValidGrid(grid))
+    return false;
+  SparseSource source(grid, bricks);
+  if (!source.Index())
+    return false;
+  return Build(grid, source);
+}
+
+bool SdfVolume::Build(const VolumeGrid& grid, const Source& source) {
+  if (!(grid.spacing > 0.0))
+    return false;
+
+  grid_ = grid;
+  // Bricks hold cells, and there is one cell less than samples per axis.
+  for (int k = 0; k < 3; k++)
+    bricks_[k] = BrickCount(grid.size[k] - 1);
+  size_t brick_count = static_cast<size_t>(bricks_[0]) * bricks_[1] *
+      bricks_[2];
+  brick_table_.assign(brick_count, -1);
+  brick_values_.assign(brick_count, 0.0f);
+  samples_.clear();
+
+  // What the servo thread reads for bricks nobody sent.
+  const float empty_space = static_cast<float>(kBrickSize * grid.spacing);
+
+  std::vector<float> brick_samples(kStoredSamples);
+  int brick[3];
+  size_t index = 0;
+  for (brick[2] = 0; brick[2] < bricks_[2]; brick[2]++) {
+    for (brick[1] = 0; brick[1] < bricks_[1]; brick[1]++) {
+      for (brick[0] = 0; brick[0] < bricks_[0]; brick[0]++, index++) {
+        if (!source.HasBrick(brick)) {
+          brick_values_[index] = empty_space;
+          continue;
+        }
+
+        // Samples past the end of the grid repeat the last one.
+        float lowest = FLT_MAX;
+        float* out = &brick_samples[0];
+        int sample[3];
+        for (int z = 0; z < kStoredSize; z++) {
+          sample[2] = std::min(brick[2] * kBrickSize + z, grid.size[2] - 1);
+          for (int y = 0; y < kStoredSize; y++) {
+            sample[1] = std::min(brick[1] * kBrickSize + y,
+                                 grid.size[1] - 1);
+            for (int x = 0; x < kStoredSize; x++) {
+              sample[0] = std::min(brick[0] * kBrickSize + x,
+                                   grid.size[0] - 1);
+              *out = static_cast<float>(source.At(sample, brick));
+              lowest = std::min(lowest, *out);
+              out++;
+            }
+          }
+        }
+
+        // Interpolating samples that are all outside never gives a contact,
+        // so the brick only needs one value.
+        if (lowest >= 0.0f) {
+          brick_values_[index] = lowest;
+          continue;
+        }
+        brick_table_[index] = stored_bricks();
+        samples_.insert(samples_.end(), brick_samples.begin(),
+                        brick_samples.end());
+      }
+    }
+  }
+  return true;
+}
+
+bool SdfVolume::Sample(const double position[3],
+                       double* distance,
+                       double gradient[3]) const {
+  if (brick_table_.empty())
+    return false;
+
+  // Find the cell and the position inside it.
+  int cell[3];
+  float fraction[3];
+  for (int k = 0; k < 3; k++) {
+    double coordinate = (position[k] - grid_.origin[k]) / grid_.spacing;
+    if (!(coordinate >= 0.0 && coordinate <= grid_.size[k] - 1))
+      return false;
+    cell[k] = std::min(static_cast<int>(coordinate), grid_.size[k] - 2);
+    fraction[k] = static_cast<float>(coordinate - cell[k]);
+  }
+
+  size_t index = (static_cast<size_t>(cell[2] / kBrickSize) * bricks_[1] +
+                  cell[1] / kBrickSize) * bricks_[0] + cell[0] / kBrickSize;
+  int stored = brick_table_[index];
+  if (stored < 0) {
+    *distance = brick_values_[index];
+    gradient[0] = gradient[1] = gradient[2] = 0.0;
+    return true;
+  }
+
+  const float* corner = &samples_[static_cast<size_t>(stored) *
+                                  kStoredSamples];
+  corner += ((cell[2] % kBrickSize) * kStoredSize + cell[1] % kBrickSize) *
+      kStoredSize + cell[0] % kBrickSize;
+  const int dy = kStoredSize;
+  const int dz = kStoredSize * kStoredSize;
+
+  // The four z edges of the cell are interpolated side by side, ordered
+  // (x0 y0), (x1 y0), (x0 y1), (x1 y1). Then the x edges of those, kept
+  // together with their z slopes, and finally y on the scalars.
+  //   along_x: value at y0, value at y1, z slope at y0, z slope at y1
+  //   slope_x: x slope of the same four
+  float along_x[4];
+  float slope_x[4];
+#if defined(SDF_VOLUME_USE_SSE)
+  __m128 low = _mm_set_ps(corner[dy + 1], corner[dy], corner[1], corner[0]);
+  __m128 high = _mm_set_ps(corner[dz + dy + 1], corner[dz + dy],
+                           corner[dz + 1], corner[dz]);
+  __m128 slope_z = _mm_sub_ps(high, low);
+  __m128 along_z = _mm_add_ps(low,
+                              _mm_mul_ps(_mm_set1_ps(fraction[2]), slope_z));
+  __m128 x0 = _mm_shuffle_ps(along_z, slope_z, _MM_SHUFFLE(2, 0, 2, 0));
+  __m128 x1 = _mm_shuffle_ps(along_z, slope_z, _MM_SHUFFLE(3, 1, 3, 1));
+  __m128 slope = _mm_sub_ps(x1, x0);
+  _mm_storeu_ps(slope_x, slope);
+  _mm_storeu_ps(along_x,
+                _mm_add_ps(x0, _mm_mul_ps(_mm_set1_ps(fraction[0]), slope)));
+#else
+  const int offsets[4] = { 0, 1, dy, dy + 1 };
+  float along_z[4];
+  float slope_z[4];
+  for (int i = 0; i < 4; i++) {
+    float low = corner[offsets[i]];
+    slope_z[i] = corner[dz + offsets[i]] - low;
+    along_z[i] = low + fraction[2] * slope_z[i];
+  }
+  for (int i = 0; i < 2; i++) {
+    slope_x[i] = along_z[2 * i + 1] - along_z[2 * i];
+    slope_x[i + 2] = slope_z[2 * i + 1] - slope_z[2 * i];
+    along_x[i] = along_z[2 * i] + fraction[0] * slope_x[i];
+    along_x[i + 2] = slope_z[2 * i] + fraction[0] * slope_x[i + 2];
+  }
+#endif
+
+  const double scale = 1.0 / grid_.spacing;
+  *distance = along_x[0] + fraction[1] * (along_x[1] - along_x[0]);
+  gradient[0] = (slope_x[0] + fraction[1] * (slope_x[1] - slope_x[0])) *
+      scale;
+  gradient[1] = (along_x[1] - along_x[0]) * scale;
+  gradient[2] = (along_x[2] + fraction[1] * (along_x[3] - along_x[2])) *
+      scale;
+  return true;
+}
+
+}  // namespace haptics
@@ -0,0 +1,93 @@
+// Copyright 2010 Mohamed Mansour. All rights reserved.
+// Use of this source code is governed by a GPL license that can
+// be found in the LICENSE file.
+
+#ifndef SDF_VOLUME_H_
+#define SDF_VOLUME_H_
+#pragma once
+
+#include <vector>
+
+namespace haptics {
+
+// Placement of a signed distance grid in application coordinates.
+struct VolumeGrid {
+  // Samples along each axis, at least 2, and no more than
+  // SdfVolume::kMaxSamples in all.
+  int size[3];
+  // Position of sample (0, 0, 0).
+  double origin[3];
+  // Distance between neighbouring samples.
+  double spacing;
+};
+
+// Touchable volume given by a regular grid of signed distances, negative
+// inside the object. Built once on the application thread and only read by
+// the servo thread afterwards.
+//
+// The grid is stored in bricks of kBrickSize^3 cells. Each brick also keeps
+// the samples on its far faces, duplicated from its neighbours, so the eight
+// corners of any cell are always in the same 3 KB block and a query costs the
+// same wherever it lands. Bricks that lie entirely outside the object are
+// stored as a single value, which is what keeps large volumes in memory.
+class SdfVolume {
+ public:
+  enum { kBrickSize = 8 };
+  enum { kBrickSamples = kBrickSize * kBrickSize * kBrickSize };
+  // Largest grid accepted, 512^3 samples. Even sparse volumes need a table
+  // entry per brick, so larger grids are refused before anything is
+  // allocated.
+  enum { kMaxSamples = 512 * 512 * 512 };
+
+  // Supplies the samples while the volume is built.
+  class Source;
+
+  SdfVolume();
+
+  // Builds the volume from every sample of |grid|, x fastest. Returns false
+  // if the data is malformed or the grid too large.
+  bool BuildDense(const VolumeGrid& grid, const std::vector<double>& values);
+
+  // Builds the volume from the bricks that are given, each as its brick
+  // coordinates followed by its kBrickSamples samples, x fastest. Bricks
+  // left out are empty space. Returns false if the data is malformed or the
+  // grid too large.
+  bool BuildSparse(const VolumeGrid& grid, const std::vector<double>& bricks);
+
+  bool empty() const { return brick_table_.empty(); }
+  // Number of bricks stored sample by sample.
+  int stored_bricks() const {
+    return static_cast<int>(samples_.size() / kStoredSamples);
+  }
+
+  // N/m.
+  double stiffness() const { return stiffness_; }
+  void set_stiffness(double stiffness) { stiffness_ = stiffness; }
+
+  // Interpolates the distance and its gradient at |position|. Returns false
+  // if |position| is outside the grid.
+  bool Sample(const double position[3],
+              double* distance,
+              double gradient[3]) const;
+
+ private:
+  // Samples kept per brick, with the duplicated far faces.
+  enum { kStoredSize = kBrickSize + 1 };
+  enum { kStoredSamples = kStoredSize * kStoredSize * kStoredSize };
+
+  bool Build(const VolumeGrid& grid, const Source& source);
+
+  VolumeGrid grid_;
+  int bricks_[3];
+  // Per brick, its index into |samples_| in units of kStoredSamples, or -1
+  // if the brick is uniform.
+  std::vector<int> brick_table_;
+  // Per brick, the value of uniform bricks.
+  std::vector<float> brick_values_;
+  std::vector<float> samples_;
+  double stiffness_;
+};
+
+}  // namespace haptics
+
+#endif  // SDF_VOLUME_H_
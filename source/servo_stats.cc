@@ -0,0 +1,94 @@
+// Copyright 2010 Mohamed Mansour. All rights reserved.
+// Use of this source code is governed by a GPL license that can
+// be found in the LICENSE file.
+
+#include "servo_stats.h"
+
+namespace haptics {
+
+namespace {
+
+int BucketFor(int64_t duration_us) {
+  int bucket = 0;
+  while (duration_us >= 2 && bucket < DurationHistogram::kBuckets - 1) {
+    duration_us >>= 1;
+    bucket++;
+  }
+  return bucket;
+}
+
+}  // namespace
+
+ServoStats::ServoStats()
+    : last_tick_(0),
+      resets_seen_(0),
+      resets_requested_(0) {
+  Clear(&period_);
+  Clear(&execution_);
+  Clear(&force_age_);
+}
+
+void ServoStats::BeginTick(int64_t now) {
+  Atomic32 resets_requested = AcquireLoad(&resets_requested_);
+  if (resets_requested != resets_seen_) {
+    resets_seen_ = resets_requested;
+    Clear(&period_);
+    Clear(&execution_);
+    Clear(&force_age_);
+    last_tick_ = 0;
+  }
+
+  if (last_tick_ != 0)
+    Record(&period_, now - last_tick_);
+  last_tick_ = now;
+}
+
+void ServoStats::RecordForceAge(int64_t sent, int64_t now) {
+  Record(&force_age_, now - sent);
+}
+
+void ServoStats::EndTick(int64_t start, int64_t end) {
+  Record(&execution_, end - start);
+}
+
+void ServoStats::Reset() {
+  AtomicIncrement(&resets_requested_, 1);
+}
+
+void ServoStats::GetSnapshot(ServoStatsSnapshot* snapshot) const {
+  Read(period_, &snapshot->period);
+  Read(execution_, &snapshot->execution);
+  Read(force_age_, &snapshot->force_age);
+}
+
+// static
+void ServoStats::Record(Histogram* histogram, int64_t duration_us) {
+  if (duration_us < 0)
+    duration_us = 0;
+  // Only the servo thread writes, so read-modify-write needs no atomics.
+  volatile Atomic32* bucket = &histogram->buckets[BucketFor(duration_us)];
+  ReleaseStore(bucket, *bucket + 1);
+  ReleaseStore(&histogram->count, histogram->count + 1);
+  Atomic32 clamped = duration_us > 0x7fffffff ?
+      0x7fffffff : static_cast<Atomic32>(duration_us);
+  if (clamped > histogram->max_us)
+    ReleaseStore(&histogram->max_us, clamped);
+}
+
+// static
+void ServoStats::Clear(Histogram* histogram) {
+  ReleaseStore(&histogram->count, 0);
+  ReleaseStore(&histogram->max_us, 0);
+  for (int i = 0; i < DurationHistogram::kBuckets; i++)
+    ReleaseStore(&histogram->buckets[i], 0);
+}
+
+// static
+void ServoStats::Read(const Histogram& histogram, DurationHistogram* out) {
+  out->count = AcquireLoad(&histogram.count);
+  out->max_us = AcquireLoad(&histogram.max_us);
+  for (int i = 0; i < DurationHistogram::kBuckets; i++)
+    out->buckets[i] = AcquireLoad(&histogram.buckets[i]);
+}
+
+}  // namespace haptics
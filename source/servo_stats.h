@@ -0,0 +1,81 @@
+// Copyright 2010 Mohamed Mansour. All rights reserved.
+// Use of this source code is governed by a GPL license that can
+// be found in the LICENSE file.
+
+#ifndef SERVO_STATS_H_
+#define SERVO_STATS_H_
+#pragma once
+
+#include <stdint.h>
+
+#include "atomic_ops.h"
+
+namespace haptics {
+
+// Distribution of a duration in microseconds. Bucket 0 counts values below
+// 2 us, bucket i > 0 values in [2^i, 2^(i+1)) us, the last bucket everything
+// longer.
+struct DurationHistogram {
+  enum { kBuckets = 20 };
+
+  int count;
+  int max_us;
+  int buckets[kBuckets];
+};
+
+// Health of the servo loop as seen by the application.
+struct ServoStatsSnapshot {
+  // Time between the starts of consecutive ticks.
+  DurationHistogram period;
+  // Time spent inside a tick.
+  DurationHistogram execution;
+  // Time from SendForce() until the servo thread hands the force to the
+  // device. Only counted once per command.
+  DurationHistogram force_age;
+};
+
+// Counters kept by the servo thread and read by the application thread
+// without locks. Each counter has a single writer, so the servo thread pays
+// plain stores; a snapshot reads every counter atomically but not all of
+// them at the same instant, so totals may be off by a tick.
+class ServoStats {
+ public:
+  ServoStats();
+
+  // Servo thread: a tick started at |now|.
+  void BeginTick(int64_t now);
+  // Servo thread: a force sent at |sent| was handed to the device at |now|.
+  void RecordForceAge(int64_t sent, int64_t now);
+  // Servo thread: the tick that started at |start| is done at |end|.
+  void EndTick(int64_t start, int64_t end);
+
+  // Application thread: clears every counter. Takes effect on the next
+  // servo tick.
+  void Reset();
+  void GetSnapshot(ServoStatsSnapshot* snapshot) const;
+
+ private:
+  struct Histogram {
+    volatile Atomic32 count;
+    volatile Atomic32 max_us;
+    volatile Atomic32 buckets[DurationHistogram::kBuckets];
+  };
+
+  static void Record(Histogram* histogram, int64_t duration_us);
+  static void Clear(Histogram* histogram);
+  static void Read(const Histogram& histogram, DurationHistogram* out);
+
+  // Written by the servo thread only.
+  HAPTICS_CACHE_ALIGNED Histogram period_;
+  Histogram execution_;
+  Histogram force_age_;
+  int64_t last_tick_;
+  Atomic32 resets_seen_;
+
+  // Bumped by the application to ask for a reset.
+  HAPTICS_CACHE_ALIGNED volatile Atomic32 resets_requested_;
+};
+
+}  // namespace haptics
+
+#endif  // SERVO_STATS_H_
@@ -0,0 +1,167 @@
+// Copyright 2010 Mohamed Mansour. All rights reserved.
+// Use of this source code is governed by a GPL license that can
+// be found in the LICENSE file.
+
+#include "shared_memory.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <string>
+
+#if defined(_WIN32)
+#include "windows.h"
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace haptics {
+
+#if defined(_WIN32)
+
+namespace {
+
+// Names in the session namespace need no privilege, unlike Global\ ones.
+std::string MappingName(const char* name) {
+  return std::string("Local\\") + name;
+}
+
+}  // namespace
+
+SharedMemory::SharedMemory()
+    : memory_(NULL),
+      size_(0),
+      handle_(NULL) {
+}
+
+bool SharedMemory::Create(const char* name, size_t size) {
+  Close();
+  uint64_t size64 = size;
+  handle_ = CreateFileMappingA(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE,
+                               static_cast<DWORD>(size64 >> 32),
+                               static_cast<DWORD>(size64),
+                               MappingName(name).c_str());
+  if (handle_ == NULL)
+    return false;
+  // A mapping kept alive by a reader is taken over as it is, so it may still
+  // hold what an earlier process wrote.
+  bool existed = GetLastError() == ERROR_ALREADY_EXISTS;
+  memory_ = MapViewOfFile(handle_, FILE_MAP_WRITE, 0, 0, size);
+  if (memory_ == NULL) {
+    Close();
+    return false;
+  }
+  if (existed)
+    memset(memory_, 0, size);
+  size_ = size;
+  return true;
+}
+
+bool SharedMemory::Open(const char* name) {
+  Close();
+  handle_ = OpenFileMappingA(FILE_MAP_READ, FALSE, MappingName(name).c_str());
+  if (handle_ == NULL)
+    return false;
+  memory_ = MapViewOfFile(handle_, FILE_MAP_READ, 0, 0, 0);
+  MEMORY_BASIC_INFORMATION info;
+  if (memory_ == NULL ||
+      VirtualQuery(memory_, &info, sizeof(info)) != sizeof(info)) {
+    Close();
+    return false;
+  }
+  // Whole pages, which may be a little more than was created.
+  size_ = info.RegionSize;
+  return true;
+}
+
+void SharedMemory::Close() {
+  if (memory_)
+    UnmapViewOfFile(memory_);
+  if (handle_)
+    CloseHandle(handle_);
+  memory_ = NULL;
+  size_ = 0;
+  handle_ = NULL;
+}
+
+#else
+
+namespace {
+
+std::string ObjectName(const char* name) {
+  return std::string("/") + name;
+}
+
+}  // namespace
+
+SharedMemory::SharedMemory()
+    : memory_(NULL),
+      size_(0),
+      owned_name_(NULL) {
+}
+
+bool SharedMemory::Create(const char* name, size_t size) {
+  Close();
+  std::string object_name = ObjectName(name);
+  // Unlinking first leaves a stale object, or one still used by another
+  // process, to whoever has it mapped and gives readers this one.
+  shm_unlink(object_name.c_str());
+  int fd = shm_open(object_name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0644);
+  if (fd < 0)
+    return false;
+  void* address = MAP_FAILED;
+  if (ftruncate(fd, size) == 0) {
+    address = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  }
+  close(fd);
+  if (address == MAP_FAILED) {
+    shm_unlink(object_name.c_str());
+    return false;
+  }
+  memory_ = address;
+  size_ = size;
+  owned_name_ = strdup(object_name.c_str());
+  return true;
+}
+
+bool SharedMemory::Open(const char* name) {
+  Close();
+  int fd = shm_open(ObjectName(name).c_str(), O_RDONLY, 0);
+  if (fd < 0)
+    return false;
+  struct stat info;
+  void* address = MAP_FAILED;
+  if (fstat(fd, &info) == 0 && info.st_size > 0) {
+    address = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+  }
+  close(fd);
+  if (address == MAP_FAILED)
+    return false;
+  memory_ = address;
+  size_ = info.st_size;
+  return true;
+}
+
+void SharedMemory::Close() {
+  if (memory_)
+    munmap(memory_, size_);
+  if (owned_name_) {
+    shm_unlink(owned_name_);
+    free(owned_name_);
+  }
+  memory_ = NULL;
+  size_ = 0;
+  owned_name_ = NULL;
+}
+
+#endif
+
+SharedMemory::~SharedMemory() {
+  Close();
+}
+
+}  // namespace haptics
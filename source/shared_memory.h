@@ -0,0 +1,51 @@
+// Copyright 2010 Mohamed Mansour. All rights reserved.
+// Use of this source code is governed by a GPL license that can
+// be found in the LICENSE file.
+
+#ifndef SHARED_MEMORY_H_
+#define SHARED_MEMORY_H_
+#pragma once
+
+#include <stddef.h>
+
+namespace haptics {
+
+// A block of memory other processes can map by name: a POSIX shared memory
+// object, or a named file mapping backed by the page file on Windows. The
+// process that creates it writes to it, the others map it read-only.
+class SharedMemory {
+ public:
+  SharedMemory();
+  ~SharedMemory();
+
+  // Creates |name|, a plain name without slashes, holding |size| zeroed
+  // bytes, and maps it for writing. A POSIX object left behind by an earlier
+  // process is replaced, a Windows mapping that some reader keeps alive is
+  // cleared and reused.
+  bool Create(const char* name, size_t size);
+  // Maps the existing |name| for reading only.
+  bool Open(const char* name);
+  // Unmaps the memory. The creator also removes the name, processes that
+  // have it mapped keep it until they let go.
+  void Close();
+
+  void* memory() const { return memory_; }
+  size_t size() const { return size_; }
+
+ private:
+  void* memory_;
+  size_t size_;
+#if defined(_WIN32)
+  void* handle_;
+#else
+  // Name to unlink on Close, set by Create only.
+  char* owned_name_;
+#endif
+
+  SharedMemory(const SharedMemory&);
+  void operator=(const SharedMemory&);
+};
+
+}  // namespace haptics
+
+#endif  // SHARED_MEMORY_H_
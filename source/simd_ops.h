@@ -0,0 +1,20 @@
+// Copyright 2010 Mohamed Mansour. All rights reserved.
+// Use of this source code is governed by a GPL license that can
+// be found in the LICENSE file.
+
+#ifndef SIMD_OPS_H_
+#define SIMD_OPS_H_
+#pragma once
+
+// Every x64 compiler and 32-bit builds with /arch:SSE2 or -msse2 have the
+// SSE2 double precision instructions the servo kernels use. Kernels check
+// HAPTICS_SSE2 and keep a scalar version for the other builds. Defining
+// HAPTICS_NO_SIMD builds the scalar versions anyway, to compare the two.
+#if !defined(HAPTICS_NO_SIMD) && \
+    (defined(__SSE2__) || defined(_M_X64) || \
+     (defined(_M_IX86_FP) && _M_IX86_FP >= 2))
+#define HAPTICS_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#endif  // SIMD_OPS_H_
@@ -0,0 +1,241 @@
+// Copyright 2010 Mohamed Mansour. All rights reserved.
+// Use of this source code is governed by a GPL license that can
+// be found in the LICENSE file.
+
+#include "simulated_backend.h"
+
+#include <math.h>
+#include <stdio.h>
+
+namespace {
+
+const double kPi = 3.14159265358979323846;
+
+// Roughly the extents HDAL reports for a Falcon, in meters.
+const double kWorkspace[6] = { -0.06, -0.06, -0.06, 0.06, 0.06, 0.06 };
+
+// Effective mass of the grip and the hand holding it, in kg.
+const double kToolMass = 0.15;
+
+// The simulated hand pulls the grip towards a slowly wandering target with
+// this stiffness (N/m) and damping (N*s/m).
+const double kHandStiffness = 200.0;
+const double kHandDamping = 5.0;
+
+// The Falcon can't push harder than this, in newtons.
+const double kMaxForce = 9.0;
+
+// How far behind the previous one each simulated device runs, in seconds.
+const double kDeviceTimeOffset = 0.25;
+
+double Clamp(double value, double low, double high) {
+  return value < low ? low : (value > high ? high : value);
+}
+
+}  // namespace
+
+namespace haptics {
+
+SimulatedBackend::SimulatedBackend(int rate_hz, int device_count)
+    : rate_hz_(rate_hz < kMinRateHz ? kMinRateHz :
+               (rate_hz > kMaxRateHz ? kMaxRateHz : rate_hz)),
+      open_(false),
+      servo_op_(NULL),
+      servo_data_(NULL),
+      stop_requested_(0),
+      tick_(0),
+      current_(NULL) {
+  Tool tool;
+  for (int i = 0; i < 3; i++) {
+    tool.position[i] = 0.0;
+    tool.velocity[i] = 0.0;
+    tool.force[i] = 0.0;
+  }
+  tool.button = false;
+  tool.script_cursor = 0;
+  tools_.resize(device_count < 1 ? 1 :
+                (device_count > kMaxDevices ? kMaxDevices : device_count),
+                tool);
+  current_ = &tools_[0];
+}
+
+SimulatedBackend::~SimulatedBackend() {
+  Stop();
+  Close();
+}
+
+bool SimulatedBackend::LoadScript(const char* path) {
+  FILE* file = fopen(path, "r");
+  if (!file)
+    return false;
+
+  std::vector<Keyframe> script;
+  char line[256];
+  while (fgets(line, sizeof(line), file)) {
+    if (line[0] == '#')
+      continue;
+    Keyframe frame;
+    int button = 0;
+    int fields = sscanf(line, "%lf %lf %lf %lf %d", &frame.time,
+                        &frame.position[0], &frame.position[1],
+                        &frame.position[2], &button);
+    if (fields < 4)
+      continue;
+    frame.button = button != 0;
+    script.push_back(frame);
+  }
+  fclose(file);
+
+  if (script.empty())
+    return false;
+  script_.swap(script);
+  for (size_t i = 0; i < tools_.size(); i++)
+    tools_[i].script_cursor = 0;
+  return true;
+}
+
+int SimulatedBackend::CountDevices() {
+  return static_cast<int>(tools_.size());
+}
+
+bool SimulatedBackend::Open(int device_count) {
+  if (device_count != CountDevices())
+    return false;
+  open_ = true;
+  return true;
+}
+
+void SimulatedBackend::Close() {
+  open_ = false;
+}
+
+bool SimulatedBackend::Start(ServoOp op, hpointer data) {
+  if (!open_ || thread_.running())
+    return false;
+
+  servo_op_ = op;
+  servo_data_ = data;
+  tick_ = 0;
+  ReleaseStore(&stop_requested_, 0);
+  return thread_.Start(ServoLoopThunk, this);
+}
+
+void SimulatedBackend::Stop() {
+  ReleaseStore(&stop_requested_, 1);
+  thread_.Join();
+}
+
+void SimulatedBackend::GetWorkspace(int /* device */, double workspace[6]) {
+  for (int i = 0; i < 6; i++)
+    workspace[i] = kWorkspace[i];
+}
+
+void SimulatedBackend::MakeCurrent(int device) {
+  current_ = &tools_[device];
+}
+
+void SimulatedBackend::GetToolPosition(double position[3]) {
+  position[0] = current_->position[0];
+  position[1] = current_->position[1];
+  position[2] = current_->position[2];
+}
+
+void SimulatedBackend::GetToolButton(bool* button) {
+  *button = current_->button;
+}
+
+void SimulatedBackend::SetToolForce(const double force[3]) {
+  current_->force[0] = Clamp(force[0], -kMaxForce, kMaxForce);
+  current_->force[1] = Clamp(force[1], -kMaxForce, kMaxForce);
+  current_->force[2] = Clamp(force[2], -kMaxForce, kMaxForce);
+}
+
+void SimulatedBackend::ServoLoop() {
+  PlatformThread::RaiseCurrentThreadPriority();
+
+  const int64_t period = 1000000 / rate_hz_;
+  const double dt = 1.0 / rate_hz_;
+  int64_t deadline = MonotonicMicroseconds();
+
+  while (!AcquireLoad(&stop_requested_)) {
+    for (size_t i = 0; i < tools_.size(); i++) {
+      // Keep the tools apart so each device reports its own motion.
+      double time = tick_ * dt + kDeviceTimeOffset * i;
+      if (script_.empty())
+        StepPhysics(&tools_[i], time, dt);
+      else
+        StepScript(&tools_[i], time);
+    }
+    ++tick_;
+
+    if (servo_op_(servo_data_) == SERVOOP_EXIT)
+      break;
+
+    // Keep a steady rate. If we fell more than a full period behind, start
+    // over from now rather than firing a burst of ticks to catch up.
+    deadline += period;
+    int64_t now = MonotonicMicroseconds();
+    if (now > deadline + period)
+      deadline = now;
+    else
+      SleepUntilMicroseconds(deadline);
+  }
+}
+
+void SimulatedBackend::StepPhysics(Tool* tool, double time, double dt) {
+  // The hand wanders along a Lissajous curve through the workspace.
+  double target[3];
+  target[0] = 0.03 * sin(2.0 * kPi * 0.5 * time);
+  target[1] = 0.03 * sin(2.0 * kPi * 0.7 * time);
+  target[2] = 0.02 * sin(2.0 * kPi * 0.3 * time);
+
+  // Semi-implicit Euler keeps the hand spring stable at servo rates.
+  for (int i = 0; i < 3; i++) {
+    double hand = kHandStiffness * (target[i] - tool->position[i]) -
+                  kHandDamping * tool->velocity[i];
+    tool->velocity[i] += (tool->force[i] + hand) / kToolMass * dt;
+    tool->position[i] += tool->velocity[i] * dt;
+
+    // The mechanical end stops.
+    double clamped = Clamp(tool->position[i], kWorkspace[i],
+                           kWorkspace[i + 3]);
+    if (clamped != tool->position[i]) {
+      tool->position[i] = clamped;
+      tool->velocity[i] = 0.0;
+    }
+  }
+}
+
+void SimulatedBackend::StepScript(Tool* tool, double time) {
+  const double duration = script_.back().time;
+  if (duration > 0.0)
+    time = fmod(time, duration);
+
+  // Ticks only move forward in time, so the cursor only has to rewind when
+  // the script loops.
+  if (time < script_[tool->script_cursor].time)
+    tool->script_cursor = 0;
+  while (tool->script_cursor + 1 < script_.size() &&
+         script_[tool->script_cursor + 1].time <= time) {
+    ++tool->script_cursor;
+  }
+
+  const Keyframe& from = script_[tool->script_cursor];
+  if (tool->script_cursor + 1 == script_.size()) {
+    for (int i = 0; i < 3; i++)
+      tool->position[i] = from.position[i];
+    tool->button = from.button;
+    return;
+  }
+
+  const Keyframe& to = script_[tool->script_cursor + 1];
+  double span = to.time - from.time;
+  double alpha = span > 0.0 ? (time - from.time) / span : 0.0;
+  for (int i = 0; i < 3; i++) {
+    tool->position[i] = from.position[i] +
+                        alpha * (to.position[i] - from.position[i]);
+  }
+  tool->button = from.button;
+}
+
+}  // namespace haptics
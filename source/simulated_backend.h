@@ -0,0 +1,96 @@
+// Copyright 2010 Mohamed Mansour. All rights reserved.
+// Use of this source code is governed by a GPL license that can
+// be found in the LICENSE file.
+
+#ifndef SIMULATED_BACKEND_H_
+#define SIMULATED_BACKEND_H_
+#pragma once
+
+#include <stddef.h>
+
+#include <vector>
+
+#include "atomic_ops.h"
+#include "device_backend.h"
+#include "platform_thread.h"
+
+namespace haptics {
+
+// Software stand-in for one or more Falcons. Runs its own servo thread at a
+// fixed rate and moves each tool either along a scripted trajectory or with a
+// simple physics model of a hand holding the grip, which reacts to the forces
+// the servo operation commands.
+//
+// The simulation advances by exactly one period per tick no matter how late
+// the thread wakes up, so a given script and force program always produce
+// the same tool trajectory.
+class SimulatedBackend : public DeviceBackend {
+ public:
+  // |rate_hz| is clamped to [kMinRateHz, kMaxRateHz] and |device_count| to
+  // [1, kMaxDevices].
+  SimulatedBackend(int rate_hz, int device_count);
+  virtual ~SimulatedBackend();
+
+  // Replays the trajectory in |path| instead of the physics model. Each line
+  // holds "time x y z [button]" with time in seconds and position in meters;
+  // lines starting with '#' are ignored. The script loops once it ends.
+  // Every device follows it, each a quarter of a second behind the last.
+  bool LoadScript(const char* path);
+
+  virtual int CountDevices();
+  virtual bool Open(int device_count);
+  virtual void Close();
+  virtual bool Start(ServoOp op, hpointer data);
+  virtual void Stop();
+  virtual void GetWorkspace(int device, double workspace[6]);
+  virtual void MakeCurrent(int device);
+  virtual void GetToolPosition(double position[3]);
+  virtual void GetToolButton(bool* button);
+  virtual void SetToolForce(const double force[3]);
+
+  int rate_hz() const { return rate_hz_; }
+
+  static const int kMinRateHz = 1000;
+  static const int kMaxRateHz = 10000;
+  static const int kMaxDevices = 16;
+
+ private:
+  struct Keyframe {
+    double time;
+    double position[3];
+    bool button;
+  };
+
+  // State of one simulated grip, used only by the servo thread.
+  struct Tool {
+    double position[3];
+    double velocity[3];
+    double force[3];
+    bool button;
+    size_t script_cursor;
+  };
+
+  HAPTIC_CALLBACK(SimulatedBackend, void, ServoLoop);
+
+  // Advances |tool| by one tick of |dt| seconds.
+  void StepPhysics(Tool* tool, double time, double dt);
+  void StepScript(Tool* tool, double time);
+
+  int rate_hz_;
+  std::vector<Keyframe> script_;
+
+  bool open_;
+  ServoOp servo_op_;
+  hpointer servo_data_;
+  PlatformThread thread_;
+  volatile Atomic32 stop_requested_;
+
+  // Variables used only by servo thread
+  uint64_t tick_;
+  std::vector<Tool> tools_;
+  Tool* current_;
+};
+
+}  // namespace haptics
+
+#endif  // SIMULATED_BACKEND_H_
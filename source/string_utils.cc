@@ -4,6 +4,10 @@
 
 #include "string_utils.h"
 
+// The conversions go through the code page functions of Windows, and no
+// other platform needs them.
+#if defined(_WIN32)
+
 #include "windows.h"
 
 namespace string_utils {
@@ -57,4 +61,6 @@ std::string SysWideToMultiByte(const std::wstring& wide,
   return mb;
 }
 
-}
\ No newline at end of file
+}  // namespace string_utils
+
+#endif  // defined(_WIN32)
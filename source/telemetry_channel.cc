@@ -0,0 +1,175 @@
+// Copyright 2010 Mohamed Mansour. All rights reserved.
+// Use of this source code is governed by a GPL license that can
+// be found in the LICENSE file.
+
+#include "telemetry_channel.h"
+
+#include <string.h>
+
+#include "platform_thread.h"
+
+namespace haptics {
+
+const char kTelemetryMagic[8] = { 'H', 'A', 'P', 'T', 'E', 'L', 'E', 0 };
+
+namespace {
+
+// Records never share a cache line, and the header is one of its own.
+typedef char HeaderSizeCheck[
+    sizeof(TelemetryHeader) == HAPTICS_CACHE_LINE_SIZE ? 1 : -1];
+typedef char RecordSizeCheck[
+    sizeof(TelemetryRecord) == kTelemetryRecordSize ? 1 : -1];
+
+const size_t kChannelBytes =
+    sizeof(TelemetryHeader) + kTelemetrySlotCount * sizeof(TelemetryRecord);
+
+bool IsPlainName(const std::string& name) {
+  return !name.empty() && name.find_first_of("/\\:") == std::string::npos;
+}
+
+}  // namespace
+
+TelemetryPublisher::TelemetryPublisher()
+    : header_(NULL),
+      records_(NULL),
+      published_(0),
+      current_(NULL) {
+}
+
+TelemetryPublisher::~TelemetryPublisher() {
+  Close();
+}
+
+bool TelemetryPublisher::Open(const std::string& name, int device_count) {
+  Close();
+  if (!IsPlainName(name) || !memory_.Create(name.c_str(), kChannelBytes))
+    return false;
+
+  // Writing every page now keeps page faults off the servo thread.
+  memset(memory_.memory(), 0, kChannelBytes);
+  header_ = static_cast<TelemetryHeader*>(memory_.memory());
+  records_ = reinterpret_cast<TelemetryRecord*>(header_ + 1);
+  header_->version = kTelemetryVersion;
+  header_->record_size = kTelemetryRecordSize;
+  header_->slot_count = kTelemetrySlotCount;
+  header_->device_count = device_count;
+  header_->session = MonotonicMicroseconds();
+  published_ = 0;
+  // The magic goes last, readers that see it see the rest.
+  AtomicExchange(&header_->published, 0);
+  memcpy(header_->magic, kTelemetryMagic, sizeof(header_->magic));
+  return true;
+}
+
+void TelemetryPublisher::Close() {
+  memory_.Close();
+  header_ = NULL;
+  records_ = NULL;
+  current_ = NULL;
+}
+
+TelemetryRecord* TelemetryPublisher::BeginRecord() {
+  current_ = &records_[published_ & (kTelemetrySlotCount - 1)];
+  // A full barrier, so no reader can see the new fields with the old
+  // sequence.
+  AtomicExchange(&current_->sequence,
+                 static_cast<Atomic32>(2 * published_ + 1));
+  return current_;
+}
+
+void TelemetryPublisher::EndRecord() {
+  published_++;
+  ReleaseStore(&current_->sequence, static_cast<Atomic32>(2 * published_));
+  ReleaseStore(&header_->published, static_cast<Atomic32>(published_));
+}
+
+TelemetryReader::TelemetryReader()
+    : header_(NULL),
+      records_(NULL),
+      slot_mask_(0),
+      session_(0),
+      next_(0),
+      lost_records_(0) {
+}
+
+TelemetryReader::~TelemetryReader() {
+  Close();
+}
+
+bool TelemetryReader::Open(const std::string& name) {
+  Close();
+  if (!IsPlainName(name) || !memory_.Open(name.c_str()))
+    return false;
+
+  const TelemetryHeader* header =
+      static_cast<const TelemetryHeader*>(memory_.memory());
+  int slot_count = 0;
+  if (memory_.size() >= sizeof(TelemetryHeader) &&
+      memcmp(header->magic, kTelemetryMagic, sizeof(header->magic)) == 0 &&
+      header->version == kTelemetryVersion &&
+      header->record_size == kTelemetryRecordSize) {
+    slot_count = header->slot_count;
+  }
+  if (slot_count <= 0 || (slot_count & (slot_count - 1)) != 0 ||
+      memory_.size() < sizeof(TelemetryHeader) +
+                       slot_count * sizeof(TelemetryRecord)) {
+    Close();
+    return false;
+  }
+
+  header_ = header;
+  records_ = reinterpret_cast<const TelemetryRecord*>(header + 1);
+  slot_mask_ = slot_count - 1;
+  session_ = header->session;
+  next_ = static_cast<uint32_t>(AcquireLoad(&header->published));
+  lost_records_ = 0;
+  return true;
+}
+
+void TelemetryReader::Close() {
+  memory_.Close();
+  header_ = NULL;
+  records_ = NULL;
+}
+
+int TelemetryReader::device_count() const {
+  return header_ ? header_->device_count : 0;
+}
+
+int TelemetryReader::Read(TelemetryRecord* records, int max_records) {
+  if (header_ == NULL)
+    return 0;
+
+  // A restarted plugin counts from zero again.
+  if (header_->session != session_) {
+    session_ = header_->session;
+    next_ = 0;
+  }
+  uint32_t published = static_cast<uint32_t>(AcquireLoad(&header_->published));
+  uint32_t behind = published - next_;
+  if (behind > slot_mask_ + 1) {
+    lost_records_ += behind - (slot_mask_ + 1);
+    next_ = published - (slot_mask_ + 1);
+  }
+
+  int count = 0;
+  while (count < max_records && next_ != published) {
+    const TelemetryRecord& slot = records_[next_ & slot_mask_];
+    Atomic32 sequence = static_cast<Atomic32>(2 * (next_ + 1));
+    next_++;
+    // The sequence only moves on if the servo thread lapped us while we
+    // copied, in which case the record is gone.
+    if (AcquireLoad(&slot.sequence) == sequence) {
+      records[count] = slot;
+      AcquireFence();
+      if (AcquireLoad(&slot.sequence) == sequence) {
+        count++;
+        continue;
+      }
+    }
+    lost_records_++;
+  }
+  return count;
+}
+
+}  // namespace haptics
@@ -0,0 +1,132 @@
+// Copyright 2010 Mohamed Mansour. All rights reserved.
+// Use of this source code is governed by a GPL license that can
+// be found in the LICENSE file.
+
+#ifndef TELEMETRY_CHANNEL_H_
+#define TELEMETRY_CHANNEL_H_
+#pragma once
+
+#include <stdint.h>
+
+#include <string>
+
+#include "atomic_ops.h"
+#include "shared_memory.h"
+
+namespace haptics {
+
+// A telemetry channel is a block of shared memory in the byte order of the
+// machine: a TelemetryHeader followed by a ring of kTelemetrySlotCount
+// TelemetryRecords, which the servo thread overwrites round and round.
+struct TelemetryHeader {
+  // kTelemetryMagic.
+  char magic[8];
+  int32_t version;
+  int32_t record_size;
+  int32_t slot_count;
+  int32_t device_count;
+  // Differs between two channels created under the same name, so readers
+  // can tell the plugin was restarted.
+  int64_t session;
+  // Records published so far, wrapping around at 2^32. Record n is in slot
+  // n % slot_count.
+  volatile Atomic32 published;
+  char reserved[28];
+};
+
+// One device on one servo tick, guarded by its own sequence lock.
+struct TelemetryRecord {
+  // Odd while the servo thread writes the slot, 2 * (n + 1) once it holds
+  // record n, modulo 2^32.
+  volatile Atomic32 sequence;
+  int32_t device;
+  // Time of the tick, on the clock of the servo loop.
+  int64_t time_us;
+  int32_t button;
+  // Running clients of the device.
+  int32_t client_count;
+  // As read from the device, before any workspace mapping.
+  double position[3];
+  // Total force the device was sent.
+  double force[3];
+  // The previous tick of the servo loop, measured on the wall clock: the
+  // time between its start and the start of the one before, and the time
+  // spent in it.
+  int32_t period_us;
+  int32_t execution_us;
+  char reserved[48];
+};
+
+extern const char kTelemetryMagic[8];
+enum {
+  kTelemetryVersion = 1,
+  kTelemetryRecordSize = 128,
+  // Eight seconds of one device at 1 kHz. A power of two.
+  kTelemetrySlotCount = 8192
+};
+
+// Writes the servo ticks of every device to a telemetry channel, for any
+// number of processes to read at their own pace. The servo thread writes
+// each record in place, so publishing is a few stores with no syscall,
+// fault or wait, and readers never slow it down: one that falls more than
+// kTelemetrySlotCount records behind just loses the oldest.
+class TelemetryPublisher {
+ public:
+  TelemetryPublisher();
+  ~TelemetryPublisher();
+
+  // Creates the channel |name| for |device_count| devices. |name| must be a
+  // plain name, without slashes or colons.
+  bool Open(const std::string& name, int device_count);
+  void Close();
+
+  // Servo thread only. Returns the record to fill in, all but its sequence,
+  // which stays invisible to readers until EndRecord().
+  TelemetryRecord* BeginRecord();
+  void EndRecord();
+
+ private:
+  SharedMemory memory_;
+  TelemetryHeader* header_;
+  TelemetryRecord* records_;
+
+  // Variables used only by servo thread
+  uint32_t published_;
+  TelemetryRecord* current_;
+};
+
+// Reads a telemetry channel from another process. Records are copied out of
+// the shared ring one by one and kept only if the servo thread did not touch
+// them meanwhile, so a reader sees every record whole or not at all.
+class TelemetryReader {
+ public:
+  TelemetryReader();
+  ~TelemetryReader();
+
+  // Maps the channel |name|. Reading starts with the next record published.
+  bool Open(const std::string& name);
+  void Close();
+
+  int device_count() const;
+
+  // Copies up to |max_records| records published since the last call, oldest
+  // first, and returns their number.
+  int Read(TelemetryRecord* records, int max_records);
+
+  // Records overwritten before they were read.
+  int64_t lost_records() const { return lost_records_; }
+
+ private:
+  SharedMemory memory_;
+  const TelemetryHeader* header_;
+  const TelemetryRecord* records_;
+  uint32_t slot_mask_;
+  int64_t session_;
+  // Number of the record Read() copies next.
+  uint32_t next_;
+  int64_t lost_records_;
+};
+
+}  // namespace haptics
+
+#endif  // TELEMETRY_CHANNEL_H_
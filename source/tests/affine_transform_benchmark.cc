@@ -0,0 +1,78 @@
+// Copyright 2010 Mohamed Mansour. All rights reserved.
+// Use of this source code is governed by a GPL license that can
+// be found in the LICENSE file.
+
+#include "affine_transform.h"
+
+#include <vector>
+
+#include "benchmark/benchmark.h"
+
+namespace haptics {
+
+namespace {
+
+// The Falcon workspace mapped onto a page's box, as SetWorkspace does.
+AffineTransform PageMapping() {
+  const double from[6] = { -0.06, -0.06, -0.06, 0.06, 0.06, 0.06 };
+  const double to[6] = { -1.0, -0.5, -2.0, 3.0, 0.5, 0.0 };
+  AffineTransform transform;
+  transform.SetBoxMapping(from, to, false);
+  return transform;
+}
+
+// Positions along a tool path, so each call gets different input.
+std::vector<double> ToolPath() {
+  std::vector<double> path;
+  for (int tick = 0; tick < 1024; tick++) {
+    path.push_back(0.00005 * (tick % 97));
+    path.push_back(-0.00003 * (tick % 89));
+    path.push_back(0.00002 * (tick % 83));
+  }
+  return path;
+}
+
+void BM_AffineTransformPoint(benchmark::State& state) {
+  const AffineTransform transform = PageMapping();
+  const std::vector<double> path = ToolPath();
+  size_t next = 0;
+  double out[3];
+  for (auto _ : state) {
+    transform.TransformPoint(&path[next], out);
+    benchmark::DoNotOptimize(out);
+    next = next + 3 == path.size() ? 0 : next + 3;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_AffineTransformPoint);
+
+// What the servo loop maps on every tick: the tool position into the page,
+// the page's force back to the device, and the sent force for recording,
+// the last two in place.
+void BM_AffineServoTick(benchmark::State& state) {
+  const AffineTransform position = PageMapping();
+  AffineTransform inverse;
+  position.Invert(&inverse);
+  const AffineTransform force_to_device = inverse.LinearPart(1.0);
+  const AffineTransform force_to_app = position.LinearPart(1.0);
+  const std::vector<double> path = ToolPath();
+  size_t next = 0;
+  double mapped[3];
+  double force[3];
+  for (auto _ : state) {
+    position.TransformPoint(&path[next], mapped);
+    force[0] = -mapped[0];
+    force[1] = -mapped[1];
+    force[2] = -mapped[2];
+    force_to_device.TransformVector(force, force);
+    force_to_app.TransformVector(force, force);
+    benchmark::DoNotOptimize(force);
+    next = next + 3 == path.size() ? 0 : next + 3;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_AffineServoTick);
+
+}  // namespace
+
+}  // namespace haptics
@@ -0,0 +1,66 @@
+// Copyright 2010 Mohamed Mansour. All rights reserved.
+// Use of this source code is governed by a GPL license that can
+// be found in the LICENSE file.
+
+#include "affine_transform.h"
+
+#include "gtest/gtest.h"
+
+namespace haptics {
+
+namespace {
+
+const double kDevice[6] = { -0.06, -0.05, -0.04, 0.06, 0.05, 0.04 };
+
+void ExpectPoint(const AffineTransform& transform, double x, double y,
+                 double z, double to_x, double to_y, double to_z) {
+  const double in[3] = { x, y, z };
+  double out[3];
+  transform.TransformPoint(in, out);
+  EXPECT_NEAR(to_x, out[0], 1e-9);
+  EXPECT_NEAR(to_y, out[1], 1e-9);
+  EXPECT_NEAR(to_z, out[2], 1e-9);
+}
+
+}  // namespace
+
+TEST(AffineTransformTest, BoxMappingMapsCornerOntoCorner) {
+  const double app[6] = { 0.0, 0.0, -100.0, 800.0, 600.0, 100.0 };
+  AffineTransform transform;
+  transform.SetBoxMapping(kDevice, app, false);
+  ExpectPoint(transform, -0.06, -0.05, -0.04, 0.0, 0.0, -100.0);
+  ExpectPoint(transform, 0.06, 0.05, 0.04, 800.0, 600.0, 100.0);
+  ExpectPoint(transform, 0.06, -0.05, 0.04, 800.0, 0.0, 100.0);
+  ExpectPoint(transform, 0.0, 0.0, 0.0, 400.0, 300.0, 0.0);
+}
+
+// The smallest scale that fits is used on every axis and the device is
+// centered in the box, so only the tightest axis reaches its corners.
+TEST(AffineTransformTest, UniformBoxMappingKeepsProportions) {
+  const double app[6] = { 0.0, 0.0, -100.0, 800.0, 600.0, 100.0 };
+  AffineTransform transform;
+  transform.SetBoxMapping(kDevice, app, true);
+  // z is the tightest axis, 200 over 0.08.
+  const double scale = 2500.0;
+  ExpectPoint(transform, 0.0, 0.0, 0.0, 400.0, 300.0, 0.0);
+  ExpectPoint(transform, 0.06, 0.05, 0.04,
+              400.0 + 0.06 * scale, 300.0 + 0.05 * scale, 100.0);
+  ExpectPoint(transform, -0.06, -0.05, -0.04,
+              400.0 - 0.06 * scale, 300.0 - 0.05 * scale, -100.0);
+}
+
+TEST(AffineTransformTest, InverseUndoesTheMapping) {
+  const double app[6] = { -1.0, 2.0, 3.0, 1.0, 5.0, 9.0 };
+  AffineTransform transform;
+  transform.SetBoxMapping(kDevice, app, false);
+  AffineTransform inverse;
+  ASSERT_TRUE(transform.Invert(&inverse));
+  const double point[3] = { 0.01, -0.02, 0.03 };
+  double mapped[3];
+  transform.TransformPoint(point, mapped);
+  inverse.TransformPoint(mapped, mapped);
+  for (int i = 0; i < 3; i++)
+    EXPECT_NEAR(point[i], mapped[i], 1e-12);
+}
+
+}  // namespace haptics
@@ -0,0 +1,378 @@
+// Copyright 2010 Mohamed Mansour. All rights reserved.
+// Use of this source code is governed by a GPL license that can
+// be found in the LICENSE file.
+
+// Cost of each scripting bridge entry point as a page sees it, measured
+// through the stand-in browser against the simulated device. Besides the
+// mean, every benchmark reports the median and 99th percentile of single
+// calls and what each call allocates: heap blocks on the plugin side, and
+// objects and NPN_MemAlloc blocks on the browser side.
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <new>
+#include <string>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+#include "fake_browser.h"
+
+namespace {
+
+// Every heap allocation in the process, servo thread included.
+std::atomic<int64_t> g_heap_allocations(0);
+
+// Out of line, so the compiler does not pair the free() with the operator
+// new it was inlined next to.
+__attribute__((noinline)) void FreeBlock(void* block) {
+  free(block);
+}
+
+}  // namespace
+
+void* operator new(size_t size) {
+  g_heap_allocations.fetch_add(1, std::memory_order_relaxed);
+  void* block = malloc(size ? size : 1);
+  if (block == NULL)
+    throw std::bad_alloc();
+  return block;
+}
+
+void operator delete(void* block) noexcept {
+  FreeBlock(block);
+}
+
+void operator delete(void* block, size_t /* size */) noexcept {
+  FreeBlock(block);
+}
+
+namespace haptics {
+
+namespace {
+
+// A page holding one plugin instance with its device started.
+class Page {
+ public:
+  Page() : npp_(NULL), plugin_(NULL), started_(false) {
+    setenv("HAPTICS_DEVICE", "simulated", 1);
+    npp_ = browser_.CreateInstance();
+    if (npp_ == NULL)
+      return;
+    plugin_ = browser_.GetScriptableObject(npp_);
+    NPObject* callback = browser_.NewFunction();
+    NPVariant args[1];
+    OBJECT_TO_NPVARIANT(callback, args[0]);
+    NPVariant result;
+    if (browser_.Invoke(plugin_, "startDevice", args, 1, &result))
+      FakeBrowser::ReleaseVariantValue(&result);
+    for (int waited = 0;
+         FakeBrowser::CallCount(callback) == 0 && waited < 5000;
+         waited += 10) {
+      browser_.WaitForPendingCalls(10);
+    }
+    started_ = FakeBrowser::LastString(callback) == "ok";
+    FakeBrowser::ReleaseObject(callback);
+  }
+
+  bool started() const { return plugin_ != NULL && started_; }
+  FakeBrowser* browser() { return &browser_; }
+  NPP npp() { return npp_; }
+  NPObject* plugin() { return plugin_; }
+
+  bool Get(const char* name) {
+    NPVariant result;
+    if (!browser_.GetProperty(plugin_, name, &result))
+      return false;
+    FakeBrowser::ReleaseVariantValue(&result);
+    return true;
+  }
+
+  bool Call(const char* method, const NPVariant* args, uint32_t count) {
+    NPVariant result;
+    if (!browser_.Invoke(plugin_, method, args, count, &result))
+      return false;
+    FakeBrowser::ReleaseVariantValue(&result);
+    return true;
+  }
+
+ private:
+  FakeBrowser browser_;
+  NPP npp_;
+  NPObject* plugin_;
+  bool started_;
+};
+
+// Times single calls and counts what they allocate, then reports both as
+// counters of |state|.
+class CallRecorder {
+ public:
+  explicit CallRecorder(FakeBrowser* browser)
+      : browser_(browser),
+        heap_allocations_(g_heap_allocations.load()),
+        browser_objects_(browser->objects_created()),
+        browser_allocations_(browser->memory_allocations()),
+        calls_(0) {
+    samples_.reserve(1 << 20);
+  }
+
+  void Begin() { start_ = std::chrono::steady_clock::now(); }
+
+  void End() {
+    int64_t ns = std::chrono::duration_cast<std::chrono::nanoseconds>(
+        std::chrono::steady_clock::now() - start_).count();
+    if (samples_.size() < samples_.capacity())
+      samples_.push_back(ns);
+    calls_++;
+  }
+
+  void Report(benchmark::State& state) {
+    if (samples_.empty() || calls_ == 0)
+      return;
+    std::sort(samples_.begin(), samples_.end());
+    double calls = static_cast<double>(calls_);
+    state.counters["p50_ns"] = samples_[samples_.size() / 2];
+    state.counters["p99_ns"] = samples_[samples_.size() * 99 / 100];
+    state.counters["heap_allocs"] =
+        (g_heap_allocations.load() - heap_allocations_) / calls;
+    state.counters["npobjects"] =
+        (browser_->objects_created() - browser_objects_) / calls;
+    state.counters["npn_allocs"] =
+        (browser_->memory_allocations() - browser_allocations_) / calls;
+  }
+
+ private:
+  FakeBrowser* browser_;
+  int64_t heap_allocations_;
+  int64_t browser_objects_;
+  int64_t browser_allocations_;
+  int64_t calls_;
+  std::vector<int64_t> samples_;
+  std::chrono::steady_clock::time_point start_;
+};
+
+void BM_Position(benchmark::State& state) {
+  Page page;
+  if (!page.started()) {
+    state.SkipWithError("the simulated device did not start");
+    return;
+  }
+  // The array is created on the first read and reused after that.
+  page.Get("position");
+  CallRecorder recorder(page.browser());
+  for (auto _ : state) {
+    recorder.Begin();
+    benchmark::DoNotOptimize(page.Get("position"));
+    recorder.End();
+  }
+  recorder.Report(state);
+}
+BENCHMARK(BM_Position);
+
+// What reading the position used to cost: the plugin evaluated
+// "new Array();" and looked up its index identifiers on every read. The
+// bridge dispatch and device read are those of positionX, the rest is the
+// old GetPosition line for line.
+void BM_PositionNewArrayPerCall(benchmark::State& state) {
+  Page page;
+  if (!page.started()) {
+    state.SkipWithError("the simulated device did not start");
+    return;
+  }
+  NPObject* window = NULL;
+  NPN_GetValue(page.npp(), NPNVWindowNPObject, &window);
+  CallRecorder recorder(page.browser());
+  for (auto _ : state) {
+    recorder.Begin();
+    page.Get("positionX");
+    NPVariant variant;
+    NPString npstr;
+    npstr.UTF8Characters = "new Array();";
+    npstr.UTF8Length = static_cast<uint32_t>(strlen(npstr.UTF8Characters));
+    if (NPN_Evaluate(page.npp(), window, &npstr, &variant)) {
+      NPObject* object = NPVARIANT_TO_OBJECT(variant);
+      NPVariant value;
+      for (int i = 0; i < 3; i++) {
+        DOUBLE_TO_NPVARIANT(0.0, value);
+        NPN_SetProperty(page.npp(), object, NPN_GetIntIdentifier(i), &value);
+      }
+      FakeBrowser::ReleaseVariantValue(&variant);
+    }
+    recorder.End();
+  }
+  recorder.Report(state);
+  FakeBrowser::ReleaseObject(window);
+}
+BENCHMARK(BM_PositionNewArrayPerCall);
+
+// A single coordinate, without any array.
+void BM_PositionX(benchmark::State& state) {
+  Page page;
+  if (!page.started()) {
+    state.SkipWithError("the simulated device did not start");
+    return;
+  }
+  CallRecorder recorder(page.browser());
+  for (auto _ : state) {
+    recorder.Begin();
+    benchmark::DoNotOptimize(page.Get("positionX"));
+    recorder.End();
+  }
+  recorder.Report(state);
+}
+BENCHMARK(BM_PositionX);
+
+void BM_SendForceArray(benchmark::State& state) {
+  Page page;
+  if (!page.started()) {
+    state.SkipWithError("the simulated device did not start");
+    return;
+  }
+  const double force[3] = { 0.1, 0.2, 0.3 };
+  NPObject* array = page.browser()->NewArray(force, 3);
+  NPVariant args[1];
+  OBJECT_TO_NPVARIANT(array, args[0]);
+  CallRecorder recorder(page.browser());
+  for (auto _ : state) {
+    recorder.Begin();
+    benchmark::DoNotOptimize(page.Call("sendForce", args, 1));
+    recorder.End();
+  }
+  recorder.Report(state);
+  state.SetItemsProcessed(state.iterations());
+  FakeBrowser::ReleaseObject(array);
+}
+BENCHMARK(BM_SendForceArray);
+
+// The same force as three numbers, without an array to walk.
+void BM_SendForce3(benchmark::State& state) {
+  Page page;
+  if (!page.started()) {
+    state.SkipWithError("the simulated device did not start");
+    return;
+  }
+  NPVariant args[3];
+  DOUBLE_TO_NPVARIANT(0.1, args[0]);
+  DOUBLE_TO_NPVARIANT(0.2, args[1]);
+  DOUBLE_TO_NPVARIANT(0.3, args[2]);
+  CallRecorder recorder(page.browser());
+  for (auto _ : state) {
+    recorder.Begin();
+    benchmark::DoNotOptimize(page.Call("sendForce3", args, 3));
+    recorder.End();
+  }
+  recorder.Report(state);
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_SendForce3);
+
+// |state.range(0)| forces packed in one string, one per millisecond. Items
+// are forces, so items_per_second compares with the calls per second of
+// the single force entry points. Once the device's queue is full the batch
+// is still decoded but only partly queued, see queued_per_call.
+void BM_SendForces(benchmark::State& state) {
+  Page page;
+  if (!page.started()) {
+    state.SkipWithError("the simulated device did not start");
+    return;
+  }
+  std::string packed = "[";
+  for (int64_t i = 0; i < state.range(0); i++)
+    packed += i == 0 ? "0.1,0.2,0.3" : ",0.1,0.2,0.3";
+  packed += "]";
+  NPVariant args[2];
+  STRINGN_TO_NPVARIANT(packed.c_str(), packed.size(), args[0]);
+  DOUBLE_TO_NPVARIANT(1.0, args[1]);
+  int64_t queued = 0;
+  CallRecorder recorder(page.browser());
+  for (auto _ : state) {
+    NPVariant result;
+    recorder.Begin();
+    bool called = page.browser()->Invoke(page.plugin(), "sendForces", args, 2,
+                                         &result);
+    recorder.End();
+    if (called) {
+      if (NPVARIANT_IS_INT32(result))
+        queued += NPVARIANT_TO_INT32(result);
+      FakeBrowser::ReleaseVariantValue(&result);
+    }
+  }
+  recorder.Report(state);
+  state.counters["queued_per_call"] =
+      static_cast<double>(queued) / state.iterations();
+  state.SetItemsProcessed(state.iterations() * state.range(0));
+}
+BENCHMARK(BM_SendForces)->Arg(1)->Arg(16)->Arg(256);
+
+// The page's haptic loop at |state.range(0)| frames per second: read the
+// position, answer with a force, and let the browser run what the plugin
+// posted in between. Percentiles are per frame.
+void BM_PageLoop(benchmark::State& state) {
+  Page page;
+  if (!page.started()) {
+    state.SkipWithError("the simulated device did not start");
+    return;
+  }
+  const std::chrono::nanoseconds frame(1000000000 / state.range(0));
+  const double force[3] = { 0.1, 0.2, 0.3 };
+  NPObject* array = page.browser()->NewArray(force, 3);
+  NPVariant args[1];
+  OBJECT_TO_NPVARIANT(array, args[0]);
+  page.Get("position");
+  CallRecorder recorder(page.browser());
+  std::chrono::steady_clock::time_point next =
+      std::chrono::steady_clock::now();
+  for (auto _ : state) {
+    recorder.Begin();
+    page.Get("position");
+    page.Call("sendForce", args, 1);
+    page.browser()->RunPendingCalls();
+    recorder.End();
+    next += frame;
+    while (std::chrono::steady_clock::now() < next) {
+    }
+  }
+  recorder.Report(state);
+  FakeBrowser::ReleaseObject(array);
+}
+BENCHMARK(BM_PageLoop)->Arg(100)->Arg(1000)->UseRealTime();
+
+// Opening and closing the device, as a page does on load and unload.
+void BM_StartStopDevice(benchmark::State& state) {
+  Page page;
+  if (!page.started()) {
+    state.SkipWithError("the simulated device did not start");
+    return;
+  }
+  CallRecorder recorder(page.browser());
+  for (auto _ : state) {
+    recorder.Begin();
+    page.Call("stopDevice", NULL, 0);
+    NPObject* callback = page.browser()->NewFunction();
+    NPVariant args[1];
+    OBJECT_TO_NPVARIANT(callback, args[0]);
+    page.Call("startDevice", args, 1);
+    for (int waited = 0;
+         FakeBrowser::CallCount(callback) == 0 && waited < 5000;
+         waited += 10) {
+      page.browser()->WaitForPendingCalls(10);
+    }
+    bool started = FakeBrowser::LastString(callback) == "ok";
+    FakeBrowser::ReleaseObject(callback);
+    recorder.End();
+    if (!started) {
+      state.SkipWithError("the simulated device did not restart");
+      break;
+    }
+  }
+  recorder.Report(state);
+}
+BENCHMARK(BM_StartStopDevice)->UseRealTime();
+
+}  // namespace
+
+}  // namespace haptics
@@ -0,0 +1,132 @@
+// Copyright 2010 Mohamed Mansour. All rights reserved.
+// Use of this source code is governed by a GPL license that can
+// be found in the LICENSE file.
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include "device_manager.h"
+#include "haptics_device.h"
+#include "gtest/gtest.h"
+#include "servo_stats.h"
+
+namespace haptics {
+
+namespace {
+
+const int kDeviceCount = 4;
+const int kRateHz = 1000;
+const int kStartTimeoutMs = 5000;
+const int kWindowMs = 300;
+
+// Every device follows the same slow sweep along x, each a quarter second
+// behind the one before, so each reads 2.5 mm further along.
+const char kScript[] =
+    "0 -0.05 0 0\n"
+    "10 0.05 0 0\n";
+const double kSpacing = 0.01 * 0.25;
+
+class DeviceManagerTest : public testing::Test {
+ protected:
+  virtual void SetUp() {
+    script_path_ = testing::TempDir() + "device_manager_script.txt";
+    FILE* file = fopen(script_path_.c_str(), "w");
+    ASSERT_TRUE(file != NULL);
+    fputs(kScript, file);
+    fclose(file);
+
+    setenv("HAPTICS_DEVICE", "simulated", 1);
+    setenv("HAPTICS_SIMULATED_DEVICES", "4", 1);
+    setenv("HAPTICS_SIMULATED_RATE", "1000", 1);
+    setenv("HAPTICS_SIMULATED_SCRIPT", script_path_.c_str(), 1);
+    manager_ = DeviceManager::Acquire();
+    for (int i = 0; i < kDeviceCount; i++)
+      clients_[i] = new HapticsDevice;
+  }
+
+  virtual void TearDown() {
+    for (int i = 0; i < kDeviceCount; i++) {
+      if (clients_[i]->running())
+        manager_->StopClient(clients_[i]);
+      manager_->RemoveClient(clients_[i]);
+      delete clients_[i];
+    }
+    manager_->Release();
+    unsetenv("HAPTICS_SIMULATED_DEVICES");
+    unsetenv("HAPTICS_SIMULATED_RATE");
+    unsetenv("HAPTICS_SIMULATED_SCRIPT");
+    remove(script_path_.c_str());
+  }
+
+  // Starts |client| and waits for the devices to open.
+  DeviceStatus Start(HapticsDevice* client) {
+    DeviceStatus status = manager_->StartClient(client);
+    for (int waited = 0;
+         status == DEVICE_STARTING && waited < kStartTimeoutMs;
+         waited++) {
+      std::this_thread::sleep_for(std::chrono::milliseconds(1));
+      status = manager_->FinishStart(client);
+    }
+    return status;
+  }
+
+  std::string script_path_;
+  DeviceManager* manager_;
+  HapticsDevice* clients_[kDeviceCount];
+};
+
+}  // namespace
+
+TEST_F(DeviceManagerTest, EachClientGetsItsOwnDevice) {
+  ASSERT_EQ(kDeviceCount, manager_->device_count());
+  for (int i = 0; i < kDeviceCount; i++) {
+    ASSERT_TRUE(manager_->AddClient(i, clients_[i]));
+    ASSERT_EQ(DEVICE_OK, Start(clients_[i]));
+  }
+
+  // Let every device tick a few times.
+  std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  double positions[kDeviceCount][3];
+  for (int i = 0; i < kDeviceCount; i++)
+    clients_[i]->GetPosition(positions[i]);
+
+  // Reads happen a few microseconds apart, a millimeter is plenty of slack.
+  for (int i = 1; i < kDeviceCount; i++) {
+    EXPECT_NEAR(kSpacing, positions[i][0] - positions[i - 1][0], 0.001)
+        << "device " << i;
+    EXPECT_NEAR(0.0, positions[i][1], 1e-9);
+  }
+}
+
+// The one servo thread services the devices back to back; adding devices
+// must not slow any of them down.
+TEST_F(DeviceManagerTest, EveryDeviceTicksAtFullRate) {
+  for (int i = 0; i < kDeviceCount; i++) {
+    ASSERT_TRUE(manager_->AddClient(i, clients_[i]));
+    ASSERT_EQ(DEVICE_OK, Start(clients_[i]));
+  }
+
+  for (int i = 0; i < kDeviceCount; i++)
+    clients_[i]->ResetStats();
+  std::chrono::steady_clock::time_point begin =
+      std::chrono::steady_clock::now();
+  std::this_thread::sleep_for(std::chrono::milliseconds(kWindowMs));
+  double elapsed = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - begin).count();
+
+  // Half the rate leaves room for a loaded machine while still catching
+  // a loop that serves only one device per tick.
+  const double expected = kRateHz * elapsed;
+  for (int i = 0; i < kDeviceCount; i++) {
+    ServoStatsSnapshot stats;
+    clients_[i]->GetStats(&stats);
+    EXPECT_GT(stats.period.count, expected / 2) << "device " << i;
+    EXPECT_LE(stats.period.count, expected * 1.1) << "device " << i;
+  }
+}
+
+}  // namespace haptics
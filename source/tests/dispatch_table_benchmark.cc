@@ -0,0 +1,95 @@
+// Copyright 2010 Mohamed Mansour. All rights reserved.
+// Use of this source code is governed by a GPL license that can
+// be found in the LICENSE file.
+
+#include "dispatch_table.h"
+
+#include <stdlib.h>
+
+#include <algorithm>
+#include <map>
+#include <vector>
+
+#include "benchmark/benchmark.h"
+
+namespace haptics {
+
+namespace {
+
+typedef int Selector;
+
+// Stand-ins for interned identifiers: separate heap blocks, like the
+// browser's, so the addresses are scattered.
+std::vector<NPIdentifier> MakeIdentifiers(int count) {
+  std::vector<NPIdentifier> identifiers;
+  for (int i = 0; i < count; i++)
+    identifiers.push_back(new int[4]);
+  return identifiers;
+}
+
+void FreeIdentifiers(const std::vector<NPIdentifier>& identifiers) {
+  for (size_t i = 0; i < identifiers.size(); i++)
+    delete[] static_cast<int*>(identifiers[i]);
+}
+
+// The names a page looks up, in a fixed shuffled order.
+std::vector<NPIdentifier> MakeLookups(
+    const std::vector<NPIdentifier>& identifiers) {
+  std::vector<NPIdentifier> lookups;
+  for (int round = 0; round < 16; round++)
+    lookups.insert(lookups.end(), identifiers.begin(), identifiers.end());
+  srand(1);
+  for (size_t i = lookups.size() - 1; i > 0; i--)
+    std::swap(lookups[i], lookups[rand() % (i + 1)]);
+  return lookups;
+}
+
+// The table ScriptingBridge dispatches through, with |state.range(0)|
+// entries. The bridge has a few dozen methods and properties.
+void BM_DispatchTableFind(benchmark::State& state) {
+  std::vector<NPIdentifier> identifiers =
+      MakeIdentifiers(static_cast<int>(state.range(0)));
+  DispatchTable<Selector, 64>* table = new DispatchTable<Selector, 64>;
+  for (size_t i = 0; i < identifiers.size(); i++)
+    table->Add(identifiers[i], static_cast<Selector>(i));
+  table->Seal();
+  std::vector<NPIdentifier> lookups = MakeLookups(identifiers);
+  size_t next = 0;
+  for (auto _ : state) {
+    Selector selector = -1;
+    benchmark::DoNotOptimize(table->Find(lookups[next], &selector));
+    benchmark::DoNotOptimize(selector);
+    if (++next == lookups.size())
+      next = 0;
+  }
+  state.SetItemsProcessed(state.iterations());
+  delete table;
+  FreeIdentifiers(identifiers);
+}
+BENCHMARK(BM_DispatchTableFind)->Arg(8)->Arg(32)->Arg(64);
+
+// The std::map the bridge used before, for comparison. Its nodes are
+// allocated back to back here and stay in cache, which is its best case.
+void BM_StdMapFind(benchmark::State& state) {
+  std::vector<NPIdentifier> identifiers =
+      MakeIdentifiers(static_cast<int>(state.range(0)));
+  std::map<NPIdentifier, Selector> table;
+  for (size_t i = 0; i < identifiers.size(); i++)
+    table[identifiers[i]] = static_cast<Selector>(i);
+  std::vector<NPIdentifier> lookups = MakeLookups(identifiers);
+  size_t next = 0;
+  for (auto _ : state) {
+    std::map<NPIdentifier, Selector>::const_iterator it =
+        table.find(lookups[next]);
+    benchmark::DoNotOptimize(it != table.end() ? it->second : -1);
+    if (++next == lookups.size())
+      next = 0;
+  }
+  state.SetItemsProcessed(state.iterations());
+  FreeIdentifiers(identifiers);
+}
+BENCHMARK(BM_StdMapFind)->Arg(8)->Arg(32)->Arg(64);
+
+}  // namespace
+
+}  // namespace haptics
@@ -0,0 +1,79 @@
+// Copyright 2010 Mohamed Mansour. All rights reserved.
+// Use of this source code is governed by a GPL license that can
+// be found in the LICENSE file.
+
+#include "effect_library.h"
+
+#include <math.h>
+
+#include "benchmark/benchmark.h"
+
+namespace haptics {
+
+namespace {
+
+// Adds an effect of |type| that starts at 0 and stops at |stop_us|.
+void AddEffect(EffectType type,
+               const double* params,
+               int64_t stop_us,
+               EffectLibrary* library) {
+  HapticEffect effect = HapticEffect();
+  effect.type = type;
+  for (int i = 0; i < HapticEffect::ParamCount(type); i++)
+    effect.params[i] = params[i];
+  effect.start_us = 0;
+  effect.stop_us = stop_us;
+  library->Add(effect, 0);
+}
+
+// One servo tick of twelve mixed effects, every type at least once, on a
+// tool moving along a smooth path.
+void BM_EffectLibraryEvaluate(benchmark::State& state) {
+  // Long enough that nothing stops while the benchmark runs.
+  const int64_t kStop = 1000000000000LL;
+  const double spring[] = { 0.01, 0.0, -0.01, 200.0 };
+  const double damper[] = { 2.0 };
+  const double constant[] = { 0.0, -0.5, 0.0 };
+  const double ramp[] = { 0.0, 0.0, 0.0, 1.0, 0.5, 0.0 };
+  const double sine[] = { 0.3, 0.0, 0.0, 80.0 };
+  const double square[] = { 0.0, 0.2, 0.0, 30.0 };
+  const double saw[] = { 0.0, 0.0, 0.1, 12.0 };
+  const double friction[] = { 0.4, 0.002 };
+  const double impulse[] = { 0.0, 1.0, 0.0, 0.005, 0.02 };
+  EffectLibrary library;
+  AddEffect(EFFECT_SPRING, spring, 0, &library);
+  AddEffect(EFFECT_SPRING, spring, kStop, &library);
+  AddEffect(EFFECT_DAMPER, damper, 0, &library);
+  AddEffect(EFFECT_CONSTANT, constant, 0, &library);
+  AddEffect(EFFECT_RAMP, ramp, kStop, &library);
+  AddEffect(EFFECT_SINE, sine, 0, &library);
+  AddEffect(EFFECT_SINE, sine, kStop, &library);
+  AddEffect(EFFECT_SQUARE, square, 0, &library);
+  AddEffect(EFFECT_SAW, saw, 0, &library);
+  AddEffect(EFFECT_FRICTION, friction, 0, &library);
+  AddEffect(EFFECT_IMPULSE, impulse, 0, &library);
+  AddEffect(EFFECT_IMPULSE, impulse, kStop, &library);
+  if (library.count() != 12) {
+    state.SkipWithError("could not add the effects");
+    return;
+  }
+
+  int64_t now = 0;
+  for (auto _ : state) {
+    now += 1000;
+    double t = now * 1e-6;
+    double position[3] = { 0.03 * sin(2.0 * t), 0.02 * cos(3.0 * t),
+                           0.01 * sin(5.0 * t) };
+    double velocity[3] = { 0.06 * cos(2.0 * t), -0.06 * sin(3.0 * t),
+                           0.05 * cos(5.0 * t) };
+    double force[3] = { 0.0, 0.0, 0.0 };
+    library.Evaluate(now, position, velocity, force);
+    benchmark::DoNotOptimize(force);
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_EffectLibraryEvaluate);
+
+}  // namespace
+
+}  // namespace haptics
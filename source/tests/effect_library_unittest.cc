@@ -0,0 +1,140 @@
+// Copyright 2010 Mohamed Mansour. All rights reserved.
+// Use of this source code is governed by a GPL license that can
+// be found in the LICENSE file.
+
+#include "effect_library.h"
+
+#include "gtest/gtest.h"
+
+namespace haptics {
+
+namespace {
+
+const double kOrigin[3] = { 0.0, 0.0, 0.0 };
+const double kStill[3] = { 0.0, 0.0, 0.0 };
+
+HapticEffect MakeEffect(EffectType type, int64_t start_us, int64_t stop_us) {
+  HapticEffect effect = HapticEffect();
+  effect.type = type;
+  effect.start_us = start_us;
+  effect.stop_us = stop_us;
+  return effect;
+}
+
+// The force of |library| at |now| on a still tool at the origin.
+void ForceAt(const EffectLibrary& library, int64_t now, double force[3]) {
+  force[0] = force[1] = force[2] = 0.0;
+  library.Evaluate(now, kOrigin, kStill, force);
+}
+
+}  // namespace
+
+TEST(EffectLibraryTest, EffectIsFeltFromStartUntilStop) {
+  HapticEffect effect = MakeEffect(EFFECT_CONSTANT, 1000, 2000);
+  effect.params[0] = 1.0;
+  effect.params[1] = -2.0;
+  EffectLibrary library;
+  ASSERT_LT(0, library.Add(effect, 0));
+
+  double force[3];
+  ForceAt(library, 999, force);
+  EXPECT_EQ(0.0, force[0]);
+  ForceAt(library, 1000, force);
+  EXPECT_EQ(1.0, force[0]);
+  EXPECT_EQ(-2.0, force[1]);
+  ForceAt(library, 1999, force);
+  EXPECT_EQ(1.0, force[0]);
+  ForceAt(library, 2000, force);
+  EXPECT_EQ(0.0, force[0]);
+  EXPECT_EQ(0.0, force[1]);
+}
+
+TEST(EffectLibraryTest, EffectWithoutStopTimeLastsForEver) {
+  HapticEffect effect = MakeEffect(EFFECT_CONSTANT, 1000, 0);
+  effect.params[2] = 0.5;
+  EffectLibrary library;
+  ASSERT_LT(0, library.Add(effect, 0));
+
+  double force[3];
+  ForceAt(library, 1000000000000LL, force);
+  EXPECT_EQ(0.5, force[2]);
+}
+
+TEST(EffectLibraryTest, FinishedEffectsAreDroppedOnAdd) {
+  HapticEffect effect = MakeEffect(EFFECT_CONSTANT, 0, 1000);
+  EffectLibrary library;
+  ASSERT_LT(0, library.Add(effect, 0));
+  ASSERT_LT(0, library.Add(effect, 500));
+  EXPECT_EQ(2, library.count());
+  ASSERT_LT(0, library.Add(effect, 1000));
+  EXPECT_EQ(1, library.count());
+}
+
+TEST(EffectLibraryTest, RampNeedsStopTime) {
+  EffectLibrary library;
+  EXPECT_EQ(-1, library.Add(MakeEffect(EFFECT_RAMP, 0, 0), 0));
+  EXPECT_EQ(0, library.count());
+}
+
+TEST(EffectLibraryTest, RampGoesLinearlyBetweenItsForces) {
+  HapticEffect effect = MakeEffect(EFFECT_RAMP, 1000000, 2000000);
+  const double params[6] = { 0.0, 1.0, -1.0, 2.0, -3.0, -1.0 };
+  for (int i = 0; i < 6; i++)
+    effect.params[i] = params[i];
+  EffectLibrary library;
+  ASSERT_LT(0, library.Add(effect, 0));
+
+  double force[3];
+  ForceAt(library, 1000000, force);
+  EXPECT_DOUBLE_EQ(0.0, force[0]);
+  EXPECT_DOUBLE_EQ(1.0, force[1]);
+  EXPECT_DOUBLE_EQ(-1.0, force[2]);
+  ForceAt(library, 1250000, force);
+  EXPECT_DOUBLE_EQ(0.5, force[0]);
+  EXPECT_DOUBLE_EQ(0.0, force[1]);
+  EXPECT_DOUBLE_EQ(-1.0, force[2]);
+  ForceAt(library, 1999000, force);
+  EXPECT_NEAR(2.0, force[0], 1e-2);
+  EXPECT_NEAR(-3.0, force[1], 1e-2);
+}
+
+// An impulse of 2 N along x that takes 100 ms to fade in and 200 ms to
+// fade out before it stops at 1 s.
+TEST(EffectLibraryTest, ImpulseFollowsItsEnvelope) {
+  HapticEffect effect = MakeEffect(EFFECT_IMPULSE, 0, 1000000);
+  effect.params[0] = 2.0;
+  effect.params[3] = 0.1;
+  effect.params[4] = 0.2;
+  EffectLibrary library;
+  ASSERT_LT(0, library.Add(effect, 0));
+
+  double force[3];
+  ForceAt(library, 0, force);
+  EXPECT_DOUBLE_EQ(0.0, force[0]);
+  ForceAt(library, 50000, force);
+  EXPECT_DOUBLE_EQ(1.0, force[0]);
+  ForceAt(library, 500000, force);
+  EXPECT_DOUBLE_EQ(2.0, force[0]);
+  ForceAt(library, 900000, force);
+  EXPECT_DOUBLE_EQ(1.0, force[0]);
+  ForceAt(library, 1000000, force);
+  EXPECT_EQ(0.0, force[0]);
+  EXPECT_EQ(0.0, force[1]);
+}
+
+TEST(EffectLibraryTest, ImpulseWithoutStopTimeHolds) {
+  HapticEffect effect = MakeEffect(EFFECT_IMPULSE, 0, 0);
+  effect.params[1] = 1.0;
+  effect.params[3] = 0.1;
+  effect.params[4] = 0.2;
+  EffectLibrary library;
+  ASSERT_LT(0, library.Add(effect, 0));
+
+  double force[3];
+  ForceAt(library, 25000, force);
+  EXPECT_DOUBLE_EQ(0.25, force[1]);
+  ForceAt(library, 60000000, force);
+  EXPECT_DOUBLE_EQ(1.0, force[1]);
+}
+
+}  // namespace haptics
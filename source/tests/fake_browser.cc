@@ -0,0 +1,700 @@
+// Copyright 2010 Mohamed Mansour. All rights reserved.
+// Use of this source code is governed by a GPL license that can
+// be found in the LICENSE file.
+
+#include "fake_browser.h"
+
+#include <math.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <chrono>
+#include <map>
+
+namespace haptics {
+
+// The NPNetscapeFuncs entries, acting on the one FakeBrowser. Streams,
+// windows and Java are never used by the plugin and stay NULL.
+struct FakeBrowserFunctions {
+  static NPError GetValue(NPP instance, NPNVariable variable, void* value);
+  static NPError SetValue(NPP instance, NPPVariable variable, void* value);
+  static void* MemAlloc(uint32_t size);
+  static void MemFree(void* ptr);
+  static NPIdentifier GetStringIdentifier(const NPUTF8* name);
+  static void GetStringIdentifiers(const NPUTF8** names, int32_t name_count,
+                                   NPIdentifier* identifiers);
+  static NPIdentifier GetIntIdentifier(int32_t intid);
+  static bool IdentifierIsString(NPIdentifier identifier);
+  static NPUTF8* UTF8FromIdentifier(NPIdentifier identifier);
+  static int32_t IntFromIdentifier(NPIdentifier identifier);
+  static NPObject* CreateObject(NPP npp, NPClass* npclass);
+  static NPObject* RetainObject(NPObject* object);
+  static void ReleaseObject(NPObject* object);
+  static bool Invoke(NPP npp, NPObject* object, NPIdentifier name,
+                     const NPVariant* args, uint32_t arg_count,
+                     NPVariant* result);
+  static bool InvokeDefault(NPP npp, NPObject* object, const NPVariant* args,
+                            uint32_t arg_count, NPVariant* result);
+  static bool Evaluate(NPP npp, NPObject* object, NPString* script,
+                       NPVariant* result);
+  static bool GetProperty(NPP npp, NPObject* object, NPIdentifier name,
+                          NPVariant* result);
+  static bool SetProperty(NPP npp, NPObject* object, NPIdentifier name,
+                          const NPVariant* value);
+  static bool RemoveProperty(NPP npp, NPObject* object, NPIdentifier name);
+  static bool HasProperty(NPP npp, NPObject* object, NPIdentifier name);
+  static bool HasMethod(NPP npp, NPObject* object, NPIdentifier name);
+  static void ReleaseVariantValue(NPVariant* variant);
+  static void SetException(NPObject* object, const NPUTF8* message);
+  static bool Enumerate(NPP npp, NPObject* object, NPIdentifier** identifiers,
+                        uint32_t* count);
+  static bool Construct(NPP npp, NPObject* object, const NPVariant* args,
+                        uint32_t arg_count, NPVariant* result);
+  static void PluginThreadAsyncCall(NPP instance, void (*function)(void*),
+                                    void* data);
+
+  // For console.debug and console.log.
+  static void LogToConsole(const std::string& message);
+};
+
+namespace {
+
+// The browser the NPN functions act on, see FakeBrowser.
+FakeBrowser* g_browser = NULL;
+
+// An interned identifier. They are never freed, the plugin caches them in
+// statics that outlive any one browser.
+struct Identifier {
+  bool is_string;
+  std::string name;
+  int32_t number;
+};
+
+std::mutex g_identifier_lock;
+std::map<std::string, Identifier*>* g_string_identifiers = NULL;
+std::map<int32_t, Identifier*>* g_int_identifiers = NULL;
+
+Identifier* ToIdentifier(NPIdentifier identifier) {
+  return static_cast<Identifier*>(identifier);
+}
+
+bool IsLength(NPIdentifier name) {
+  return ToIdentifier(name)->is_string && ToIdentifier(name)->name == "length";
+}
+
+// Copies |from| the way a browser hands out a value: strings are duplicated
+// and objects retained, so |to| is released on its own.
+void CopyVariant(const NPVariant& from, NPVariant* to) {
+  *to = from;
+  if (NPVARIANT_IS_STRING(from)) {
+    const NPString& string = NPVARIANT_TO_STRING(from);
+    char* copy = static_cast<char*>(malloc(string.UTF8Length + 1));
+    memcpy(copy, string.UTF8Characters, string.UTF8Length);
+    copy[string.UTF8Length] = '\0';
+    to->value.stringValue.UTF8Characters = copy;
+  } else if (NPVARIANT_IS_OBJECT(from)) {
+    FakeBrowserFunctions::RetainObject(NPVARIANT_TO_OBJECT(from));
+  }
+}
+
+// What a script object stands for.
+enum ScriptKind {
+  SCRIPT_OBJECT,
+  SCRIPT_ARRAY,
+  SCRIPT_FUNCTION,
+  // console.debug and console.log, which record their message.
+  SCRIPT_CONSOLE_FUNCTION
+};
+
+typedef std::map<NPIdentifier, NPVariant> PropertyMap;
+
+struct ScriptObject : NPObject {
+  ScriptKind kind;
+  PropertyMap properties;
+  int calls;
+  std::vector<double> last_numbers;
+  std::string last_string;
+};
+
+NPObject* ScriptAllocate(NPP /* npp */, NPClass* /* npclass */) {
+  ScriptObject* object = new ScriptObject;
+  object->kind = SCRIPT_OBJECT;
+  object->calls = 0;
+  return object;
+}
+
+void ScriptDeallocate(NPObject* npobj) {
+  ScriptObject* object = static_cast<ScriptObject*>(npobj);
+  for (PropertyMap::iterator it = object->properties.begin();
+       it != object->properties.end(); ++it) {
+    FakeBrowserFunctions::ReleaseVariantValue(&it->second);
+  }
+  delete object;
+}
+
+bool ScriptHasProperty(NPObject* npobj, NPIdentifier name) {
+  ScriptObject* object = static_cast<ScriptObject*>(npobj);
+  if (object->kind == SCRIPT_ARRAY && IsLength(name))
+    return true;
+  return object->properties.count(name) != 0;
+}
+
+bool ScriptGetProperty(NPObject* npobj, NPIdentifier name,
+                       NPVariant* result) {
+  ScriptObject* object = static_cast<ScriptObject*>(npobj);
+  if (object->kind == SCRIPT_ARRAY && IsLength(name)) {
+    int32_t length = 0;
+    for (PropertyMap::iterator it = object->properties.begin();
+         it != object->properties.end(); ++it) {
+      Identifier* identifier = ToIdentifier(it->first);
+      if (!identifier->is_string && identifier->number >= length)
+        length = identifier->number + 1;
+    }
+    INT32_TO_NPVARIANT(length, *result);
+    return true;
+  }
+  PropertyMap::iterator it = object->properties.find(name);
+  if (it == object->properties.end()) {
+    VOID_TO_NPVARIANT(*result);
+    return true;
+  }
+  CopyVariant(it->second, result);
+  return true;
+}
+
+bool ScriptSetProperty(NPObject* npobj, NPIdentifier name,
+                       const NPVariant* value) {
+  ScriptObject* object = static_cast<ScriptObject*>(npobj);
+  NPVariant copy;
+  CopyVariant(*value, &copy);
+  PropertyMap::iterator it = object->properties.find(name);
+  if (it != object->properties.end()) {
+    FakeBrowserFunctions::ReleaseVariantValue(&it->second);
+    it->second = copy;
+  } else {
+    object->properties[name] = copy;
+  }
+  return true;
+}
+
+bool ScriptRemoveProperty(NPObject* npobj, NPIdentifier name) {
+  ScriptObject* object = static_cast<ScriptObject*>(npobj);
+  PropertyMap::iterator it = object->properties.find(name);
+  if (it == object->properties.end())
+    return false;
+  FakeBrowserFunctions::ReleaseVariantValue(&it->second);
+  object->properties.erase(it);
+  return true;
+}
+
+bool ScriptInvokeDefault(NPObject* npobj, const NPVariant* args,
+                         uint32_t arg_count, NPVariant* result) {
+  ScriptObject* object = static_cast<ScriptObject*>(npobj);
+  VOID_TO_NPVARIANT(*result);
+  if (object->kind == SCRIPT_CONSOLE_FUNCTION) {
+    std::string message;
+    for (uint32_t i = 0; i < arg_count; i++) {
+      if (!NPVARIANT_IS_STRING(args[i]))
+        continue;
+      const NPString& string = NPVARIANT_TO_STRING(args[i]);
+      message.append(string.UTF8Characters, string.UTF8Length);
+    }
+    FakeBrowserFunctions::LogToConsole(message);
+    return true;
+  }
+  if (object->kind != SCRIPT_FUNCTION)
+    return false;
+  object->calls++;
+  object->last_numbers.clear();
+  object->last_string.clear();
+  for (uint32_t i = 0; i < arg_count; i++) {
+    double value = NAN;
+    if (NPVARIANT_IS_DOUBLE(args[i])) {
+      value = NPVARIANT_TO_DOUBLE(args[i]);
+    } else if (NPVARIANT_IS_INT32(args[i])) {
+      value = NPVARIANT_TO_INT32(args[i]);
+    } else if (NPVARIANT_IS_STRING(args[i])) {
+      const NPString& string = NPVARIANT_TO_STRING(args[i]);
+      object->last_string.append(string.UTF8Characters, string.UTF8Length);
+    }
+    object->last_numbers.push_back(value);
+  }
+  return true;
+}
+
+bool ScriptHasMethod(NPObject* npobj, NPIdentifier name) {
+  ScriptObject* object = static_cast<ScriptObject*>(npobj);
+  PropertyMap::iterator it = object->properties.find(name);
+  return it != object->properties.end() && NPVARIANT_IS_OBJECT(it->second);
+}
+
+bool ScriptInvoke(NPObject* npobj, NPIdentifier name, const NPVariant* args,
+                  uint32_t arg_count, NPVariant* result) {
+  if (!ScriptHasMethod(npobj, name))
+    return false;
+  ScriptObject* object = static_cast<ScriptObject*>(npobj);
+  return FakeBrowserFunctions::InvokeDefault(
+      NULL, NPVARIANT_TO_OBJECT(object->properties[name]), args, arg_count,
+      result);
+}
+
+NPClass g_script_class = {
+  NP_CLASS_STRUCT_VERSION,
+  ScriptAllocate,
+  ScriptDeallocate,
+  NULL,  // invalidate
+  ScriptHasMethod,
+  ScriptInvoke,
+  ScriptInvokeDefault,
+  ScriptHasProperty,
+  ScriptGetProperty,
+  ScriptSetProperty,
+  ScriptRemoveProperty,
+  NULL,  // enumerate
+  NULL   // construct
+};
+
+ScriptObject* ToScriptObject(NPObject* object) {
+  if (object == NULL || object->_class != &g_script_class)
+    return NULL;
+  return static_cast<ScriptObject*>(object);
+}
+
+ScriptObject* NewScriptObject(ScriptKind kind) {
+  ScriptObject* object = static_cast<ScriptObject*>(
+      FakeBrowserFunctions::CreateObject(NULL, &g_script_class));
+  object->kind = kind;
+  return object;
+}
+
+}  // namespace
+
+NPError FakeBrowserFunctions::GetValue(NPP /* instance */,
+                                       NPNVariable variable,
+                                       void* value) {
+  if (variable != NPNVWindowNPObject)
+    return NPERR_GENERIC_ERROR;
+  *static_cast<NPObject**>(value) = RetainObject(g_browser->window_);
+  return NPERR_NO_ERROR;
+}
+
+NPError FakeBrowserFunctions::SetValue(NPP /* instance */,
+                                       NPPVariable /* variable */,
+                                       void* /* value */) {
+  return NPERR_GENERIC_ERROR;
+}
+
+void* FakeBrowserFunctions::MemAlloc(uint32_t size) {
+  g_browser->memory_allocations_++;
+  return malloc(size);
+}
+
+void FakeBrowserFunctions::MemFree(void* ptr) {
+  free(ptr);
+}
+
+NPIdentifier FakeBrowserFunctions::GetStringIdentifier(const NPUTF8* name) {
+  std::lock_guard<std::mutex> lock(g_identifier_lock);
+  if (g_string_identifiers == NULL)
+    g_string_identifiers = new std::map<std::string, Identifier*>;
+  Identifier*& identifier = (*g_string_identifiers)[name];
+  if (identifier == NULL) {
+    identifier = new Identifier;
+    identifier->is_string = true;
+    identifier->name = name;
+    identifier->number = 0;
+  }
+  return identifier;
+}
+
+void FakeBrowserFunctions::GetStringIdentifiers(const NPUTF8** names,
+                                                int32_t name_count,
+                                                NPIdentifier* identifiers) {
+  for (int32_t i = 0; i < name_count; i++)
+    identifiers[i] = GetStringIdentifier(names[i]);
+}
+
+NPIdentifier FakeBrowserFunctions::GetIntIdentifier(int32_t intid) {
+  std::lock_guard<std::mutex> lock(g_identifier_lock);
+  if (g_int_identifiers == NULL)
+    g_int_identifiers = new std::map<int32_t, Identifier*>;
+  Identifier*& identifier = (*g_int_identifiers)[intid];
+  if (identifier == NULL) {
+    identifier = new Identifier;
+    identifier->is_string = false;
+    identifier->number = intid;
+  }
+  return identifier;
+}
+
+bool FakeBrowserFunctions::IdentifierIsString(NPIdentifier identifier) {
+  return ToIdentifier(identifier)->is_string;
+}
+
+NPUTF8* FakeBrowserFunctions::UTF8FromIdentifier(NPIdentifier identifier) {
+  if (!ToIdentifier(identifier)->is_string)
+    return NULL;
+  const std::string& name = ToIdentifier(identifier)->name;
+  NPUTF8* copy = static_cast<NPUTF8*>(MemAlloc(name.size() + 1));
+  memcpy(copy, name.c_str(), name.size() + 1);
+  return copy;
+}
+
+int32_t FakeBrowserFunctions::IntFromIdentifier(NPIdentifier identifier) {
+  return ToIdentifier(identifier)->number;
+}
+
+NPObject* FakeBrowserFunctions::CreateObject(NPP npp, NPClass* npclass) {
+  NPObject* object = npclass->allocate
+      ? npclass->allocate(npp, npclass)
+      : static_cast<NPObject*>(malloc(sizeof(NPObject)));
+  if (object == NULL)
+    return NULL;
+  object->_class = npclass;
+  object->referenceCount = 1;
+  g_browser->objects_created_++;
+  g_browser->live_objects_++;
+  return object;
+}
+
+NPObject* FakeBrowserFunctions::RetainObject(NPObject* object) {
+  if (object)
+    object->referenceCount++;
+  return object;
+}
+
+void FakeBrowserFunctions::ReleaseObject(NPObject* object) {
+  if (object == NULL || --object->referenceCount > 0)
+    return;
+  g_browser->live_objects_--;
+  if (object->_class->deallocate)
+    object->_class->deallocate(object);
+  else
+    free(object);
+}
+
+bool FakeBrowserFunctions::Invoke(NPP /* npp */,
+                                  NPObject* object,
+                                  NPIdentifier name,
+                                  const NPVariant* args,
+                                  uint32_t arg_count,
+                                  NPVariant* result) {
+  if (object->_class->invoke == NULL)
+    return false;
+  return object->_class->invoke(object, name, args, arg_count, result);
+}
+
+bool FakeBrowserFunctions::InvokeDefault(NPP /* npp */,
+                                         NPObject* object,
+                                         const NPVariant* args,
+                                         uint32_t arg_count,
+                                         NPVariant* result) {
+  if (object->_class->invokeDefault == NULL)
+    return false;
+  return object->_class->invokeDefault(object, args, arg_count, result);
+}
+
+// Only understands the script the plugin creates its arrays with.
+bool FakeBrowserFunctions::Evaluate(NPP /* npp */,
+                                    NPObject* /* object */,
+                                    NPString* script,
+                                    NPVariant* result) {
+  g_browser->evaluations_++;
+  std::string source(script->UTF8Characters, script->UTF8Length);
+  if (source != "new Array();" && source != "new Array()")
+    return false;
+  OBJECT_TO_NPVARIANT(NewScriptObject(SCRIPT_ARRAY), *result);
+  return true;
+}
+
+bool FakeBrowserFunctions::GetProperty(NPP /* npp */,
+                                       NPObject* object,
+                                       NPIdentifier name,
+                                       NPVariant* result) {
+  if (object->_class->getProperty == NULL)
+    return false;
+  return object->_class->getProperty(object, name, result);
+}
+
+bool FakeBrowserFunctions::SetProperty(NPP /* npp */,
+                                       NPObject* object,
+                                       NPIdentifier name,
+                                       const NPVariant* value) {
+  if (object->_class->setProperty == NULL)
+    return false;
+  return object->_class->setProperty(object, name, value);
+}
+
+bool FakeBrowserFunctions::RemoveProperty(NPP /* npp */,
+                                          NPObject* object,
+                                          NPIdentifier name) {
+  if (object->_class->removeProperty == NULL)
+    return false;
+  return object->_class->removeProperty(object, name);
+}
+
+bool FakeBrowserFunctions::HasProperty(NPP /* npp */,
+                                       NPObject* object,
+                                       NPIdentifier name) {
+  return object->_class->hasProperty &&
+         object->_class->hasProperty(object, name);
+}
+
+bool FakeBrowserFunctions::HasMethod(NPP /* npp */,
+                                     NPObject* object,
+                                     NPIdentifier name) {
+  return object->_class->hasMethod &&
+         object->_class->hasMethod(object, name);
+}
+
+void FakeBrowserFunctions::ReleaseVariantValue(NPVariant* variant) {
+  if (NPVARIANT_IS_STRING(*variant)) {
+    MemFree(const_cast<NPUTF8*>(
+        NPVARIANT_TO_STRING(*variant).UTF8Characters));
+  } else if (NPVARIANT_IS_OBJECT(*variant)) {
+    ReleaseObject(NPVARIANT_TO_OBJECT(*variant));
+  }
+  VOID_TO_NPVARIANT(*variant);
+}
+
+void FakeBrowserFunctions::SetException(NPObject* /* object */,
+                                        const NPUTF8* message) {
+  g_browser->last_exception_ = message;
+}
+
+bool FakeBrowserFunctions::Enumerate(NPP /* npp */,
+                                     NPObject* /* object */,
+                                     NPIdentifier** /* identifiers */,
+                                     uint32_t* /* count */) {
+  return false;
+}
+
+bool FakeBrowserFunctions::Construct(NPP /* npp */,
+                                     NPObject* /* object */,
+                                     const NPVariant* /* args */,
+                                     uint32_t /* arg_count */,
+                                     NPVariant* /* result */) {
+  return false;
+}
+
+// Called from the servo and opener threads, so it only queues the call.
+void FakeBrowserFunctions::PluginThreadAsyncCall(NPP /* instance */,
+                                                 void (*function)(void*),
+                                                 void* data) {
+  FakeBrowser::AsyncCall call = { function, data };
+  std::lock_guard<std::mutex> lock(g_browser->async_lock_);
+  g_browser->async_calls_.push_back(call);
+  g_browser->async_ready_.notify_all();
+}
+
+void FakeBrowserFunctions::LogToConsole(const std::string& message) {
+  g_browser->console_messages_.push_back(message);
+}
+
+FakeBrowser::FakeBrowser()
+    : init_error_(NPERR_GENERIC_ERROR),
+      window_(NULL),
+      console_(NULL),
+      objects_created_(0),
+      memory_allocations_(0),
+      evaluations_(0),
+      live_objects_(0) {
+  g_browser = this;
+
+  // The page: window.console with debug and log.
+  window_ = NewObject();
+  console_ = NewObject();
+  const char* const kConsoleFunctions[] = { "debug", "log" };
+  for (int i = 0; i < 2; i++) {
+    NPVariant function;
+    OBJECT_TO_NPVARIANT(NewScriptObject(SCRIPT_CONSOLE_FUNCTION), function);
+    SetProperty(console_, kConsoleFunctions[i], function);
+    ReleaseVariantValue(&function);
+  }
+  NPVariant console;
+  OBJECT_TO_NPVARIANT(console_, console);
+  SetProperty(window_, "console", console);
+
+  memset(&browser_functions_, 0, sizeof(browser_functions_));
+  browser_functions_.size = sizeof(browser_functions_);
+  browser_functions_.version = (NP_VERSION_MAJOR << 8) | NP_VERSION_MINOR;
+  browser_functions_.memalloc = FakeBrowserFunctions::MemAlloc;
+  browser_functions_.memfree = FakeBrowserFunctions::MemFree;
+  browser_functions_.getvalue = FakeBrowserFunctions::GetValue;
+  browser_functions_.setvalue = FakeBrowserFunctions::SetValue;
+  browser_functions_.getstringidentifier =
+      FakeBrowserFunctions::GetStringIdentifier;
+  browser_functions_.getstringidentifiers =
+      FakeBrowserFunctions::GetStringIdentifiers;
+  browser_functions_.getintidentifier = FakeBrowserFunctions::GetIntIdentifier;
+  browser_functions_.identifierisstring =
+      FakeBrowserFunctions::IdentifierIsString;
+  browser_functions_.utf8fromidentifier =
+      FakeBrowserFunctions::UTF8FromIdentifier;
+  browser_functions_.intfromidentifier =
+      FakeBrowserFunctions::IntFromIdentifier;
+  browser_functions_.createobject = FakeBrowserFunctions::CreateObject;
+  browser_functions_.retainobject = FakeBrowserFunctions::RetainObject;
+  browser_functions_.releaseobject = FakeBrowserFunctions::ReleaseObject;
+  browser_functions_.invoke = FakeBrowserFunctions::Invoke;
+  browser_functions_.invokeDefault = FakeBrowserFunctions::InvokeDefault;
+  browser_functions_.evaluate = FakeBrowserFunctions::Evaluate;
+  browser_functions_.getproperty = FakeBrowserFunctions::GetProperty;
+  browser_functions_.setproperty = FakeBrowserFunctions::SetProperty;
+  browser_functions_.removeproperty = FakeBrowserFunctions::RemoveProperty;
+  browser_functions_.hasproperty = FakeBrowserFunctions::HasProperty;
+  browser_functions_.hasmethod = FakeBrowserFunctions::HasMethod;
+  browser_functions_.releasevariantvalue =
+      FakeBrowserFunctions::ReleaseVariantValue;
+  browser_functions_.setexception = FakeBrowserFunctions::SetException;
+  browser_functions_.enumerate = FakeBrowserFunctions::Enumerate;
+  browser_functions_.pluginthreadasynccall =
+      FakeBrowserFunctions::PluginThreadAsyncCall;
+  browser_functions_.construct = FakeBrowserFunctions::Construct;
+
+  memset(&plugin_functions_, 0, sizeof(plugin_functions_));
+  plugin_functions_.size = sizeof(plugin_functions_);
+  init_error_ = NP_Initialize(&browser_functions_, &plugin_functions_);
+}
+
+FakeBrowser::~FakeBrowser() {
+  while (!instances_.empty())
+    DestroyInstance(&instances_.back()->npp);
+  // Deliveries the plugin scheduled before it went away free themselves
+  // when they run.
+  RunPendingCalls();
+  if (init_error_ == NPERR_NO_ERROR)
+    NP_Shutdown();
+  ReleaseObject(console_);
+  ReleaseObject(window_);
+  g_browser = NULL;
+}
+
+NPP FakeBrowser::CreateInstance() {
+  if (init_error_ != NPERR_NO_ERROR)
+    return NULL;
+  Instance* instance = new Instance;
+  memset(&instance->npp, 0, sizeof(instance->npp));
+  instance->scriptable = NULL;
+  char mime_type[] = "application/x-vnd-haptics";
+  if (plugin_functions_.newp(mime_type, &instance->npp, NP_EMBED, 0, NULL,
+                             NULL, NULL) != NPERR_NO_ERROR) {
+    delete instance;
+    return NULL;
+  }
+  instances_.push_back(instance);
+  return &instance->npp;
+}
+
+NPError FakeBrowser::DestroyInstance(NPP npp) {
+  for (size_t i = 0; i < instances_.size(); i++) {
+    Instance* instance = instances_[i];
+    if (&instance->npp != npp)
+      continue;
+    ReleaseObject(instance->scriptable);
+    NPError error = plugin_functions_.destroy(npp, NULL);
+    instances_.erase(instances_.begin() + i);
+    delete instance;
+    return error;
+  }
+  return NPERR_INVALID_INSTANCE_ERROR;
+}
+
+NPObject* FakeBrowser::GetScriptableObject(NPP npp) {
+  for (size_t i = 0; i < instances_.size(); i++) {
+    Instance* instance = instances_[i];
+    if (&instance->npp != npp)
+      continue;
+    if (instance->scriptable == NULL) {
+      plugin_functions_.getvalue(npp, NPPVpluginScriptableNPObject,
+                                 &instance->scriptable);
+    }
+    return instance->scriptable;
+  }
+  return NULL;
+}
+
+int FakeBrowser::RunPendingCalls() {
+  {
+    std::lock_guard<std::mutex> lock(async_lock_);
+    running_calls_.swap(async_calls_);
+  }
+  int count = static_cast<int>(running_calls_.size());
+  for (int i = 0; i < count; i++)
+    running_calls_[i].function(running_calls_[i].data);
+  running_calls_.clear();
+  return count;
+}
+
+int FakeBrowser::WaitForPendingCalls(int timeout_ms) {
+  {
+    std::unique_lock<std::mutex> lock(async_lock_);
+    async_ready_.wait_for(lock, std::chrono::milliseconds(timeout_ms),
+                          [this] { return !async_calls_.empty(); });
+  }
+  return RunPendingCalls();
+}
+
+bool FakeBrowser::Invoke(NPObject* object, const char* method,
+                         const NPVariant* args, uint32_t arg_count,
+                         NPVariant* result) {
+  return FakeBrowserFunctions::Invoke(
+      NULL, object, FakeBrowserFunctions::GetStringIdentifier(method), args,
+      arg_count, result);
+}
+
+bool FakeBrowser::GetProperty(NPObject* object, const char* name,
+                              NPVariant* result) {
+  return FakeBrowserFunctions::GetProperty(
+      NULL, object, FakeBrowserFunctions::GetStringIdentifier(name), result);
+}
+
+bool FakeBrowser::SetProperty(NPObject* object, const char* name,
+                              const NPVariant& value) {
+  return FakeBrowserFunctions::SetProperty(
+      NULL, object, FakeBrowserFunctions::GetStringIdentifier(name), &value);
+}
+
+void FakeBrowser::ReleaseObject(NPObject* object) {
+  FakeBrowserFunctions::ReleaseObject(object);
+}
+
+void FakeBrowser::ReleaseVariantValue(NPVariant* variant) {
+  FakeBrowserFunctions::ReleaseVariantValue(variant);
+}
+
+NPObject* FakeBrowser::NewObject() {
+  return NewScriptObject(SCRIPT_OBJECT);
+}
+
+NPObject* FakeBrowser::NewArray(const double* values, int count) {
+  ScriptObject* array = NewScriptObject(SCRIPT_ARRAY);
+  for (int i = 0; i < count; i++) {
+    NPVariant value;
+    DOUBLE_TO_NPVARIANT(values[i], value);
+    ScriptSetProperty(array, FakeBrowserFunctions::GetIntIdentifier(i),
+                      &value);
+  }
+  return array;
+}
+
+NPObject* FakeBrowser::NewFunction() {
+  return NewScriptObject(SCRIPT_FUNCTION);
+}
+
+int FakeBrowser::CallCount(NPObject* function) {
+  ScriptObject* object = ToScriptObject(function);
+  return object ? object->calls : 0;
+}
+
+std::vector<double> FakeBrowser::LastNumbers(NPObject* function) {
+  ScriptObject* object = ToScriptObject(function);
+  return object ? object->last_numbers : std::vector<double>();
+}
+
+std::string FakeBrowser::LastString(NPObject* function) {
+  ScriptObject* object = ToScriptObject(function);
+  return object ? object->last_string : std::string();
+}
+
+}  // namespace haptics
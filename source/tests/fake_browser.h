@@ -0,0 +1,133 @@
+// Copyright 2010 Mohamed Mansour. All rights reserved.
+// Use of this source code is governed by a GPL license that can
+// be found in the LICENSE file.
+
+#ifndef TESTS_FAKE_BROWSER_H_
+#define TESTS_FAKE_BROWSER_H_
+#pragma once
+
+#include <stdint.h>
+
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "npapi.h"
+#include "npfunctions.h"
+
+namespace haptics {
+
+// In-process stand-in for the browser side of NPAPI. It hands the plugin an
+// NPNetscapeFuncs table through NP_Initialize, like a Unix browser, and
+// drives NPP_New, the scriptable object and NPP_Destroy the way a page would.
+//
+// Script values are just enough JavaScript for the plugin: objects with
+// properties, arrays with a length, functions that record their calls, a
+// window with a console, and "new Array()" for NPN_Evaluate. Calls the
+// plugin queues with NPN_PluginThreadAsyncCall run when the test pumps them,
+// standing in for the browser's event loop.
+//
+// The NPN functions have no context, so only one FakeBrowser may exist at a
+// time. Identifiers are interned for the whole process, since the plugin
+// keeps them across instances.
+class FakeBrowser {
+ public:
+  FakeBrowser();
+  ~FakeBrowser();
+
+  // The result of NP_Initialize.
+  NPError init_error() const { return init_error_; }
+
+  // Creates a plugin instance with NPP_New. Returns NULL if it failed.
+  NPP CreateInstance();
+  // Releases the scriptable object of |instance| and calls NPP_Destroy.
+  NPError DestroyInstance(NPP instance);
+  // The scriptable object of |instance|, owned by the browser.
+  NPObject* GetScriptableObject(NPP instance);
+
+  // Runs the calls queued with NPN_PluginThreadAsyncCall. Returns how many
+  // ran.
+  int RunPendingCalls();
+  // Waits up to |timeout_ms| for a queued call, then runs the queue.
+  int WaitForPendingCalls(int timeout_ms);
+
+  // Script helpers, as the page would call them. Results are released by
+  // the caller with ReleaseVariantValue().
+  bool Invoke(NPObject* object, const char* method, const NPVariant* args,
+              uint32_t arg_count, NPVariant* result);
+  bool GetProperty(NPObject* object, const char* name, NPVariant* result);
+  bool SetProperty(NPObject* object, const char* name,
+                   const NPVariant& value);
+  static void ReleaseObject(NPObject* object);
+  static void ReleaseVariantValue(NPVariant* variant);
+
+  // New script objects, with one reference for the caller.
+  NPObject* NewObject();
+  NPObject* NewArray(const double* values, int count);
+  NPObject* NewFunction();
+
+  // Calls made to a function from NewFunction(), and the arguments of the
+  // last one: numbers as doubles with NaN for anything else, and the string
+  // arguments joined.
+  static int CallCount(NPObject* function);
+  static std::vector<double> LastNumbers(NPObject* function);
+  static std::string LastString(NPObject* function);
+
+  // Messages the plugin logged through console.debug, in order.
+  const std::vector<std::string>& console_messages() const {
+    return console_messages_;
+  }
+  // The last message passed to NPN_SetException.
+  const std::string& last_exception() const { return last_exception_; }
+
+  // What the plugin cost the browser so far, for the benchmarks.
+  int64_t objects_created() const { return objects_created_; }
+  int64_t memory_allocations() const { return memory_allocations_; }
+  int64_t evaluations() const { return evaluations_; }
+  // Objects alive now, on both sides of the bridge.
+  int live_objects() const { return live_objects_; }
+
+ private:
+  struct AsyncCall {
+    void (*function)(void*);
+    void* data;
+  };
+
+  friend struct FakeBrowserFunctions;
+
+  NPNetscapeFuncs browser_functions_;
+  NPPluginFuncs plugin_functions_;
+  NPError init_error_;
+
+  NPObject* window_;
+  NPObject* console_;
+
+  struct Instance {
+    NPP_t npp;
+    NPObject* scriptable;
+  };
+  std::vector<Instance*> instances_;
+
+  std::mutex async_lock_;
+  std::condition_variable async_ready_;
+  std::vector<AsyncCall> async_calls_;
+  // The calls being run, swapped with |async_calls_| so that pumping an
+  // idle queue allocates nothing.
+  std::vector<AsyncCall> running_calls_;
+
+  std::vector<std::string> console_messages_;
+  std::string last_exception_;
+
+  int64_t objects_created_;
+  int64_t memory_allocations_;
+  int64_t evaluations_;
+  int live_objects_;
+
+  FakeBrowser(const FakeBrowser&);
+  void operator=(const FakeBrowser&);
+};
+
+}  // namespace haptics
+
+#endif  // TESTS_FAKE_BROWSER_H_
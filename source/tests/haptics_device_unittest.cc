@@ -0,0 +1,173 @@
+// Copyright 2010 Mohamed Mansour. All rights reserved.
+// Use of this source code is governed by a GPL license that can
+// be found in the LICENSE file.
+
+#include "haptics_device.h"
+
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace haptics {
+
+namespace {
+
+const double kWorkspace[6] = { -0.06, -0.06, -0.06, 0.06, 0.06, 0.06 };
+
+// A client driven tick by tick the way DeviceManager does, without a servo
+// thread or a device.
+class HapticsDeviceTest : public testing::Test {
+ protected:
+  HapticsDeviceTest() : device_(new HapticsDevice), now_(0) {
+    device_->OnStarted(kWorkspace);
+  }
+
+  virtual ~HapticsDeviceTest() {
+    delete device_;
+  }
+
+  // Runs one tick, a millisecond after the last, with the tool at |x| on
+  // the x axis. Returns the client's force along x.
+  double Tick(double x, bool button) {
+    now_ += 1000;
+    const double position[3] = { x, 0.0, 0.0 };
+    double force[3] = { 0.0, 0.0, 0.0 };
+    device_->ServoTick(now_, position, button, force);
+    device_->FinishTick(now_, force);
+    return force[0];
+  }
+
+  // Queues keyframes along x, given as pairs of time in ms and force.
+  int Schedule(const double* keyframes, int count) {
+    std::vector<ForceKeyframe> batch(count);
+    for (int i = 0; i < count; i++) {
+      batch[i].time_us = static_cast<int64_t>(keyframes[2 * i] * 1000.0);
+      batch[i].force[0] = keyframes[2 * i + 1];
+      batch[i].force[1] = batch[i].force[2] = 0.0;
+    }
+    return device_->ScheduleForces(&batch[0], count);
+  }
+
+  HapticsDevice* device_;
+  int64_t now_;
+};
+
+}  // namespace
+
+TEST_F(HapticsDeviceTest, QueuesEveryButtonEdge) {
+  Tick(0.01, false);
+  Tick(0.02, true);
+  Tick(0.03, true);
+  // Pressed and released within one poll of the page.
+  Tick(0.04, false);
+  Tick(0.05, true);
+
+  ASSERT_EQ(3, device_->pending_button_events());
+  ButtonEvent event;
+  ASSERT_TRUE(device_->PopButtonEvent(&event));
+  EXPECT_TRUE(event.pressed);
+  EXPECT_EQ(2000, event.time_us);
+  EXPECT_EQ(0.02, event.position[0]);
+  ASSERT_TRUE(device_->PopButtonEvent(&event));
+  EXPECT_FALSE(event.pressed);
+  EXPECT_EQ(4000, event.time_us);
+  ASSERT_TRUE(device_->PopButtonEvent(&event));
+  EXPECT_TRUE(event.pressed);
+  EXPECT_EQ(5000, event.time_us);
+  EXPECT_FALSE(device_->PopButtonEvent(&event));
+  EXPECT_EQ(0, device_->dropped_button_events());
+}
+
+// Nobody drains the queue: the oldest events are kept and the rest counted.
+TEST_F(HapticsDeviceTest, KeepsOldestButtonEventsWhenFull) {
+  const int kEdges = 300;
+  for (int i = 1; i <= kEdges; i++)
+    Tick(0.0, i % 2 != 0);
+
+  int kept = device_->pending_button_events();
+  EXPECT_EQ(kEdges, kept + device_->dropped_button_events());
+  ButtonEvent event;
+  ASSERT_TRUE(device_->PopButtonEvent(&event));
+  EXPECT_EQ(1000, event.time_us);
+  EXPECT_TRUE(event.pressed);
+  for (int i = 1; i < kept; i++)
+    ASSERT_TRUE(device_->PopButtonEvent(&event));
+  EXPECT_EQ(kept * 1000, event.time_us);
+}
+
+TEST_F(HapticsDeviceTest, InterpolatesBetweenKeyframes) {
+  Tick(0.0, false);
+  const double keyframes[] = { 2, 0.0, 6, 4.0 };
+  ASSERT_EQ(2, Schedule(keyframes, 2));
+  EXPECT_EQ(0.0, Tick(0.0, false));
+  EXPECT_DOUBLE_EQ(1.0, Tick(0.0, false));
+  EXPECT_DOUBLE_EQ(2.0, Tick(0.0, false));
+  EXPECT_DOUBLE_EQ(3.0, Tick(0.0, false));
+  EXPECT_DOUBLE_EQ(4.0, Tick(0.0, false));
+  // The last keyframe holds once the queue runs dry.
+  EXPECT_DOUBLE_EQ(4.0, Tick(0.0, false));
+}
+
+TEST_F(HapticsDeviceTest, AppendsBatchesThatStartAfterTheQueue) {
+  Tick(0.0, false);
+  const double first[] = { 2, 0.0, 3, 1.0 };
+  ASSERT_EQ(2, Schedule(first, 2));
+  const double second[] = { 5, 3.0 };
+  ASSERT_EQ(1, Schedule(second, 1));
+  EXPECT_EQ(0.0, Tick(0.0, false));
+  EXPECT_DOUBLE_EQ(1.0, Tick(0.0, false));
+  EXPECT_DOUBLE_EQ(2.0, Tick(0.0, false));
+  EXPECT_DOUBLE_EQ(3.0, Tick(0.0, false));
+}
+
+// A batch that overlaps the queue replaces the keyframes from its first one
+// on, while the servo thread is between two keyframes it keeps.
+TEST_F(HapticsDeviceTest, ReplacesKeyframesAtOrAfterTheFirstOfABatch) {
+  Tick(0.0, false);
+  const double first[] = { 2, 0.0, 10, 8.0 };
+  ASSERT_EQ(2, Schedule(first, 2));
+  EXPECT_EQ(0.0, Tick(0.0, false));
+  EXPECT_DOUBLE_EQ(1.0, Tick(0.0, false));
+
+  const double second[] = { 4, 1.0, 6, -1.0 };
+  ASSERT_EQ(2, Schedule(second, 2));
+  EXPECT_DOUBLE_EQ(1.0, Tick(0.0, false));
+  EXPECT_DOUBLE_EQ(0.0, Tick(0.0, false));
+  EXPECT_DOUBLE_EQ(-1.0, Tick(0.0, false));
+  // Not the 8 N the first batch was heading for.
+  EXPECT_DOUBLE_EQ(-1.0, Tick(0.0, false));
+  EXPECT_DOUBLE_EQ(-1.0, Tick(0.0, false));
+}
+
+// With a workspace box set, positions come out in the box and forces go in
+// along its axes. The force the device got is reported back in the box's
+// coordinates as the one the page sent.
+TEST_F(HapticsDeviceTest, MapsPositionsAndForcesThroughTheWorkspaceBox) {
+  const double app[6] = { 0.0, 0.0, -100.0, 800.0, 600.0, 100.0 };
+  device_->SetWorkspace(app, false);
+  double force[3] = { 1.0, -2.0, 3.0 };
+  device_->SendForce(force);
+
+  // The far corner of the device workspace.
+  const double position[3] = { kWorkspace[3], kWorkspace[4], kWorkspace[5] };
+  double device_force[3] = { 0.0, 0.0, 0.0 };
+  now_ += 1000;
+  device_->ServoTick(now_, position, false, device_force);
+  device_->FinishTick(now_, device_force);
+
+  // A non-uniform box stretches forces too, so the device gets a different
+  // one, with the same signs.
+  EXPECT_NE(force[0], device_force[0]);
+  EXPECT_GT(device_force[0], 0.0);
+  EXPECT_LT(device_force[1], 0.0);
+  EXPECT_GT(device_force[2], 0.0);
+
+  ServoSample sample;
+  ASSERT_TRUE(device_->PopSample(&sample));
+  for (int i = 0; i < 3; i++) {
+    EXPECT_NEAR(app[3 + i], sample.position[i], 1e-9);
+    EXPECT_NEAR(force[i], sample.force[i], 1e-12);
+  }
+}
+
+}  // namespace haptics
@@ -0,0 +1,65 @@
+// Copyright 2010 Mohamed Mansour. All rights reserved.
+// Use of this source code is governed by a GPL license that can
+// be found in the LICENSE file.
+
+#include "mass_spring_body.h"
+
+#include <vector>
+
+#include "benchmark/benchmark.h"
+
+namespace haptics {
+
+namespace {
+
+// A square sheet of |side| x |side| nodes, 1 cm apart and pinned along its
+// edges, with structural and diagonal springs.
+void BuildSheet(int side, MassSpringBody* body) {
+  std::vector<double> nodes;
+  std::vector<double> springs;
+  for (int row = 0; row < side; row++) {
+    for (int column = 0; column < side; column++) {
+      bool edge = row == 0 || column == 0 || row == side - 1 ||
+                  column == side - 1;
+      nodes.push_back(0.01 * column);
+      nodes.push_back(0.01 * row);
+      nodes.push_back(0.0);
+      nodes.push_back(edge ? 0.0 : 0.001);
+      int node = row * side + column;
+      const int neighbors[4][2] = { { 0, 1 }, { 1, 0 }, { 1, 1 }, { 1, -1 } };
+      for (int i = 0; i < 4; i++) {
+        int other_row = row + neighbors[i][0];
+        int other_column = column + neighbors[i][1];
+        if (other_row >= side || other_column < 0 || other_column >= side)
+          continue;
+        springs.push_back(node);
+        springs.push_back(other_row * side + other_column);
+        springs.push_back(i < 2 ? 40.0 : 20.0);
+      }
+    }
+  }
+  body->Build(nodes, springs, 0.02);
+}
+
+// One simulation step with the tool pressing the middle of the sheet, as
+// DeformableSimulation runs it.
+void BM_MassSpringStep(benchmark::State& state) {
+  const int side = static_cast<int>(state.range(0));
+  MassSpringBody body;
+  BuildSheet(side, &body);
+  double middle = 0.005 * (side - 1);
+  DeformableTool tool = { { middle, middle, 0.02 }, 0.025, 200.0 };
+  double dt = body.StableTimeStep(tool.stiffness);
+  DeformableContact contact;
+  for (auto _ : state) {
+    body.Step(dt, &tool, &contact);
+    benchmark::DoNotOptimize(contact.force[2]);
+  }
+  state.SetItemsProcessed(state.iterations() * body.spring_count());
+  state.counters["springs"] = body.spring_count();
+}
+BENCHMARK(BM_MassSpringStep)->Arg(8)->Arg(32)->Arg(64);
+
+}  // namespace
+
+}  // namespace haptics
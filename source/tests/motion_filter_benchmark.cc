@@ -0,0 +1,42 @@
+// Copyright 2010 Mohamed Mansour. All rights reserved.
+// Use of this source code is governed by a GPL license that can
+// be found in the LICENSE file.
+
+#include "motion_filter.h"
+
+#include <math.h>
+
+#include <vector>
+
+#include "benchmark/benchmark.h"
+
+namespace haptics {
+
+namespace {
+
+// One Update() per servo tick of a tool moving along a smooth path, ticks
+// a millisecond apart give or take a few microseconds.
+void BM_MotionFilterUpdate(benchmark::State& state) {
+  std::vector<double> path;
+  for (int tick = 0; tick < 1024; tick++) {
+    double t = 0.001 * tick;
+    path.push_back(0.03 * sin(2.0 * t));
+    path.push_back(0.02 * cos(3.0 * t));
+    path.push_back(0.01 * sin(5.0 * t));
+  }
+  MotionFilter filter;
+  int64_t now = 0;
+  size_t next = 0;
+  for (auto _ : state) {
+    now += 995 + (next % 11);
+    filter.Update(now, &path[next]);
+    benchmark::DoNotOptimize(filter.acceleration()[0]);
+    next = next + 3 == path.size() ? 0 : next + 3;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_MotionFilterUpdate);
+
+}  // namespace
+
+}  // namespace haptics
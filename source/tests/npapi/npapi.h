@@ -0,0 +1,178 @@
+// Copyright 2010 Mohamed Mansour. All rights reserved.
+// Use of this source code is governed by a GPL license that can
+// be found in the LICENSE file.
+
+// The part of the NPAPI SDK the plugin uses, see nptypes.h.
+
+#ifndef npapi_h_
+#define npapi_h_
+
+#include "nptypes.h"
+
+#if defined(_WIN32) && !defined(XP_WIN)
+#define XP_WIN 1
+#endif
+
+#define NP_LOADDS
+
+#define NP_VERSION_MAJOR 0
+#define NP_VERSION_MINOR 27
+
+#define NPVERS_HAS_PLUGIN_THREAD_ASYNC_CALL 19
+
+typedef unsigned char NPBool;
+typedef int16_t NPError;
+typedef int16_t NPReason;
+typedef char* NPMIMEType;
+
+typedef struct _NPP {
+  void* pdata;  // The plugin's instance data.
+  void* ndata;  // The browser's instance data.
+} NPP_t;
+
+typedef NPP_t* NPP;
+
+typedef struct _NPStream {
+  void* pdata;
+  void* ndata;
+  const char* url;
+  uint32_t end;
+  uint32_t lastmodified;
+  void* notifyData;
+  const char* headers;
+} NPStream;
+
+typedef struct _NPByteRange {
+  int32_t offset;
+  uint32_t length;
+  struct _NPByteRange* next;
+} NPByteRange;
+
+typedef struct _NPSavedData {
+  int32_t len;
+  void* buf;
+} NPSavedData;
+
+typedef struct _NPRect {
+  uint16_t top;
+  uint16_t left;
+  uint16_t bottom;
+  uint16_t right;
+} NPRect;
+
+// An HRGN, Region or RgnHandle depending on the platform.
+typedef void* NPRegion;
+
+#define NP_EMBED 1
+#define NP_FULL 2
+
+typedef enum {
+  NPPVpluginNameString = 1,
+  NPPVpluginDescriptionString = 2,
+  NPPVpluginWindowBool = 3,
+  NPPVpluginTransparentBool = 4,
+  NPPVpluginNeedsXEmbed = 14,
+  NPPVpluginScriptableNPObject = 15
+} NPPVariable;
+
+typedef enum {
+  NPNVxDisplay = 1,
+  NPNVxtAppContext = 2,
+  NPNVnetscapeWindow = 3,
+  NPNVjavascriptEnabledBool = 4,
+  NPNVSupportsXEmbedBool = 14,
+  NPNVWindowNPObject = 15,
+  NPNVPluginElementNPObject = 16,
+  NPNVSupportsWindowless = 17,
+  NPNVprivateModeBool = 18
+} NPNVariable;
+
+typedef enum {
+  NPNURLVCookie = 501,
+  NPNURLVProxy = 502
+} NPNURLVariable;
+
+#define NPERR_BASE 0
+#define NPERR_NO_ERROR (NPERR_BASE + 0)
+#define NPERR_GENERIC_ERROR (NPERR_BASE + 1)
+#define NPERR_INVALID_INSTANCE_ERROR (NPERR_BASE + 2)
+#define NPERR_INVALID_FUNCTABLE_ERROR (NPERR_BASE + 3)
+#define NPERR_MODULE_LOAD_FAILED_ERROR (NPERR_BASE + 4)
+#define NPERR_OUT_OF_MEMORY_ERROR (NPERR_BASE + 5)
+#define NPERR_INVALID_PLUGIN_ERROR (NPERR_BASE + 6)
+#define NPERR_INVALID_PLUGIN_DIR_ERROR (NPERR_BASE + 7)
+#define NPERR_INCOMPATIBLE_VERSION_ERROR (NPERR_BASE + 8)
+#define NPERR_INVALID_PARAM (NPERR_BASE + 9)
+#define NPERR_INVALID_URL (NPERR_BASE + 10)
+#define NPERR_FILE_NOT_FOUND (NPERR_BASE + 11)
+#define NPERR_NO_DATA (NPERR_BASE + 12)
+#define NPERR_STREAM_NOT_SEEKABLE (NPERR_BASE + 13)
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+// Implemented by the plugin.
+NPError NP_LOADDS NPP_New(NPMIMEType pluginType, NPP instance, uint16_t mode,
+                          int16_t argc, char* argn[], char* argv[],
+                          NPSavedData* saved);
+NPError NP_LOADDS NPP_Destroy(NPP instance, NPSavedData** save);
+int16_t NP_LOADDS NPP_HandleEvent(NPP instance, void* event);
+NPError NP_LOADDS NPP_GetValue(NPP instance, NPPVariable variable,
+                               void* value);
+
+// Implemented by the browser.
+NPError NP_LOADDS NPN_GetValue(NPP instance, NPNVariable variable,
+                               void* value);
+NPError NP_LOADDS NPN_SetValue(NPP instance, NPPVariable variable,
+                               void* value);
+NPError NP_LOADDS NPN_GetURLNotify(NPP instance, const char* url,
+                                   const char* target, void* notifyData);
+NPError NP_LOADDS NPN_GetURL(NPP instance, const char* url,
+                             const char* target);
+NPError NP_LOADDS NPN_PostURLNotify(NPP instance, const char* url,
+                                    const char* target, uint32_t len,
+                                    const char* buf, NPBool file,
+                                    void* notifyData);
+NPError NP_LOADDS NPN_PostURL(NPP instance, const char* url,
+                              const char* target, uint32_t len,
+                              const char* buf, NPBool file);
+NPError NP_LOADDS NPN_RequestRead(NPStream* stream, NPByteRange* rangeList);
+NPError NP_LOADDS NPN_NewStream(NPP instance, NPMIMEType type,
+                                const char* target, NPStream** stream);
+int32_t NP_LOADDS NPN_Write(NPP instance, NPStream* stream, int32_t len,
+                            void* buffer);
+NPError NP_LOADDS NPN_DestroyStream(NPP instance, NPStream* stream,
+                                    NPReason reason);
+void NP_LOADDS NPN_Status(NPP instance, const char* message);
+const char* NP_LOADDS NPN_UserAgent(NPP instance);
+void* NP_LOADDS NPN_MemAlloc(uint32_t size);
+void NP_LOADDS NPN_MemFree(void* ptr);
+uint32_t NP_LOADDS NPN_MemFlush(uint32_t size);
+void NP_LOADDS NPN_ReloadPlugins(NPBool reloadPages);
+void NP_LOADDS NPN_InvalidateRect(NPP instance, NPRect* invalidRect);
+void NP_LOADDS NPN_InvalidateRegion(NPP instance, NPRegion invalidRegion);
+void NP_LOADDS NPN_ForceRedraw(NPP instance);
+void NP_LOADDS NPN_PluginThreadAsyncCall(NPP instance, void (*func)(void*),
+                                         void* userData);
+NPError NP_LOADDS NPN_GetValueForURL(NPP instance, NPNURLVariable variable,
+                                     const char* url, char** value,
+                                     uint32_t* len);
+NPError NP_LOADDS NPN_SetValueForURL(NPP instance, NPNURLVariable variable,
+                                     const char* url, const char* value,
+                                     uint32_t len);
+NPError NP_LOADDS NPN_GetAuthenticationInfo(NPP instance,
+                                            const char* protocol,
+                                            const char* host, int32_t port,
+                                            const char* scheme,
+                                            const char* realm,
+                                            char** username, uint32_t* ulen,
+                                            char** password, uint32_t* plen);
+
+#ifdef __cplusplus
+}  // extern "C"
+#endif
+
+#include "npruntime.h"
+
+#endif  // npapi_h_
@@ -0,0 +1,17 @@
+// Copyright 2010 Mohamed Mansour. All rights reserved.
+// Use of this source code is governed by a GPL license that can
+// be found in the LICENSE file.
+
+// The part of the NPAPI SDK the plugin uses, with the layouts of the SDK, so
+// the tests build where no SDK is installed. Set NPAPI_INCLUDE_DIR to build
+// against the real headers instead.
+
+#ifndef nptypes_h_
+#define nptypes_h_
+
+#include <stdint.h>
+#if !defined(__cplusplus)
+#include <stdbool.h>
+#endif
+
+#endif  // nptypes_h_
@@ -0,0 +1,75 @@
+// Copyright 2010 Mohamed Mansour. All rights reserved.
+// Use of this source code is governed by a GPL license that can
+// be found in the LICENSE file.
+
+#include "packed_array.h"
+
+#include <string>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace haptics {
+
+namespace {
+
+bool Parse(const std::string& text, std::vector<double>* values) {
+  NPString string;
+  string.UTF8Characters = text.data();
+  string.UTF8Length = static_cast<uint32_t>(text.size());
+  return ParsePackedArray(string, values);
+}
+
+bool Parses(const std::string& text) {
+  std::vector<double> values;
+  return Parse(text, &values);
+}
+
+}  // namespace
+
+TEST(PackedArrayTest, ParsesWhatJsonStringifyWrites) {
+  std::vector<double> values;
+  ASSERT_TRUE(Parse("[1,-2.5,3e-3,0,1E+2]", &values));
+  ASSERT_EQ(5u, values.size());
+  EXPECT_EQ(1.0, values[0]);
+  EXPECT_EQ(-2.5, values[1]);
+  EXPECT_EQ(0.003, values[2]);
+  EXPECT_EQ(0.0, values[3]);
+  EXPECT_EQ(100.0, values[4]);
+
+  ASSERT_TRUE(Parse(" [ 1 ,\r\n 2 ] ", &values));
+  EXPECT_EQ(2u, values.size());
+  ASSERT_TRUE(Parse("4, 5", &values));
+  EXPECT_EQ(2u, values.size());
+  ASSERT_TRUE(Parse("[]", &values));
+  EXPECT_TRUE(values.empty());
+  ASSERT_TRUE(Parse("", &values));
+  EXPECT_TRUE(values.empty());
+}
+
+// strtod takes all of these, JSON none.
+TEST(PackedArrayTest, RefusesNumbersJsonDoesNotHave) {
+  EXPECT_FALSE(Parses("[nan]"));
+  EXPECT_FALSE(Parses("[NaN]"));
+  EXPECT_FALSE(Parses("[inf]"));
+  EXPECT_FALSE(Parses("[-Infinity]"));
+  EXPECT_FALSE(Parses("[1e999]"));
+  EXPECT_FALSE(Parses("[0x10]"));
+  EXPECT_FALSE(Parses("[+1]"));
+  EXPECT_FALSE(Parses("[.5]"));
+  EXPECT_FALSE(Parses("[1.]"));
+}
+
+TEST(PackedArrayTest, RefusesMalformedLists) {
+  EXPECT_FALSE(Parses("[1 2]"));
+  EXPECT_FALSE(Parses("[1,,2]"));
+  EXPECT_FALSE(Parses("[1,]"));
+  EXPECT_FALSE(Parses("[,1]"));
+  EXPECT_FALSE(Parses("[1,2"));
+  EXPECT_FALSE(Parses("1,2]"));
+  EXPECT_FALSE(Parses("[1,2]3"));
+  EXPECT_FALSE(Parses("[1,2] junk"));
+  EXPECT_FALSE(Parses(std::string("[1]\0[2]", 7)));
+}
+
+}  // namespace haptics
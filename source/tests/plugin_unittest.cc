@@ -0,0 +1,256 @@
+// Copyright 2010 Mohamed Mansour. All rights reserved.
+// Use of this source code is governed by a GPL license that can
+// be found in the LICENSE file.
+
+#include <math.h>
+#include <stdlib.h>
+
+#include <string>
+
+#include "device_manager.h"
+#include "fake_browser.h"
+#include "gtest/gtest.h"
+#include "simulated_backend.h"
+
+namespace haptics {
+
+namespace {
+
+// Long enough for the simulated device to open on a loaded machine.
+const int kStartTimeoutMs = 5000;
+
+// A simulated device whose servo thread never starts.
+class ServoFailingBackend : public SimulatedBackend {
+ public:
+  ServoFailingBackend() : SimulatedBackend(SimulatedBackend::kMinRateHz, 1) {}
+
+  virtual bool Start(ServoOp /* op */, hpointer /* data */) { return false; }
+};
+
+DeviceBackend* CreateServoFailingBackend() {
+  return new ServoFailingBackend;
+}
+
+class PluginTest : public testing::Test {
+ protected:
+  virtual void SetUp() {
+    // The page runs against the simulated device, never real hardware.
+    setenv("HAPTICS_DEVICE", "simulated", 1);
+    browser_ = new FakeBrowser;
+    ASSERT_EQ(NPERR_NO_ERROR, browser_->init_error());
+    baseline_objects_ = browser_->live_objects();
+    npp_ = browser_->CreateInstance();
+    ASSERT_TRUE(npp_ != NULL);
+    plugin_ = browser_->GetScriptableObject(npp_);
+    ASSERT_TRUE(plugin_ != NULL);
+  }
+
+  virtual void TearDown() {
+    delete browser_;
+    DeviceManager::SetBackendFactoryForTesting(NULL);
+    unsetenv("HAPTICS_REPLAY_FILE");
+  }
+
+  // Replaces the instance with a new one, which picks up a device backend
+  // set up after SetUp() once no instance holds on to the old one.
+  void Reopen() {
+    ASSERT_EQ(NPERR_NO_ERROR, browser_->DestroyInstance(npp_));
+    browser_->RunPendingCalls();
+    npp_ = browser_->CreateInstance();
+    ASSERT_TRUE(npp_ != NULL);
+    plugin_ = browser_->GetScriptableObject(npp_);
+    ASSERT_TRUE(plugin_ != NULL);
+  }
+
+  // Calls startDevice on |plugin| and pumps the browser until its callback
+  // ran. Returns the status the callback got.
+  std::string StartDevice(NPObject* plugin) {
+    NPObject* callback = browser_->NewFunction();
+    NPVariant args[1];
+    OBJECT_TO_NPVARIANT(callback, args[0]);
+    NPVariant result;
+    EXPECT_TRUE(browser_->Invoke(plugin, "startDevice", args, 1, &result));
+    FakeBrowser::ReleaseVariantValue(&result);
+    for (int waited = 0;
+         FakeBrowser::CallCount(callback) == 0 && waited < kStartTimeoutMs;
+         waited += 10) {
+      browser_->WaitForPendingCalls(10);
+    }
+    std::string status = FakeBrowser::LastString(callback);
+    EXPECT_EQ(1, FakeBrowser::CallCount(callback));
+    FakeBrowser::ReleaseObject(callback);
+    return status;
+  }
+
+  std::string StartDevice() {
+    return StartDevice(plugin_);
+  }
+
+  bool Call(const char* method, const double* numbers, int count,
+            NPVariant* result) {
+    NPVariant args[4];
+    for (int i = 0; i < count; i++)
+      DOUBLE_TO_NPVARIANT(numbers[i], args[i]);
+    return browser_->Invoke(plugin_, method, args, count, result);
+  }
+
+  FakeBrowser* browser_;
+  int baseline_objects_;
+  NPP npp_;
+  NPObject* plugin_;
+};
+
+}  // namespace
+
+TEST_F(PluginTest, StartsAndStopsTheSimulatedDevice) {
+  NPVariant initialized;
+  ASSERT_TRUE(browser_->GetProperty(plugin_, "initialized", &initialized));
+  EXPECT_TRUE(NPVARIANT_IS_BOOLEAN(initialized));
+  EXPECT_FALSE(NPVARIANT_TO_BOOLEAN(initialized));
+
+  EXPECT_EQ("ok", StartDevice());
+  ASSERT_TRUE(browser_->GetProperty(plugin_, "initialized", &initialized));
+  EXPECT_TRUE(NPVARIANT_TO_BOOLEAN(initialized));
+
+  NPVariant result;
+  ASSERT_TRUE(browser_->Invoke(plugin_, "stopDevice", NULL, 0, &result));
+  FakeBrowser::ReleaseVariantValue(&result);
+  ASSERT_TRUE(browser_->GetProperty(plugin_, "initialized", &initialized));
+  EXPECT_FALSE(NPVARIANT_TO_BOOLEAN(initialized));
+}
+
+TEST_F(PluginTest, ReportsNoDeviceWhenNoneOpens) {
+  setenv("HAPTICS_DEVICE", "replay", 1);
+  std::string missing = testing::TempDir() + "plugin_no_recording.bin";
+  remove(missing.c_str());
+  setenv("HAPTICS_REPLAY_FILE", missing.c_str(), 1);
+  Reopen();
+  EXPECT_EQ("no-device", StartDevice());
+  NPVariant initialized;
+  ASSERT_TRUE(browser_->GetProperty(plugin_, "initialized", &initialized));
+  EXPECT_FALSE(NPVARIANT_TO_BOOLEAN(initialized));
+}
+
+TEST_F(PluginTest, ReportsServoFailedWhenTheServoThreadDoesNotStart) {
+  DeviceManager::SetBackendFactoryForTesting(CreateServoFailingBackend);
+  Reopen();
+  EXPECT_EQ("servo-failed", StartDevice());
+  NPVariant initialized;
+  ASSERT_TRUE(browser_->GetProperty(plugin_, "initialized", &initialized));
+  EXPECT_FALSE(NPVARIANT_TO_BOOLEAN(initialized));
+}
+
+// Every device takes DeviceManager::kMaxClients instances, the next one is
+// turned away.
+TEST_F(PluginTest, ReportsBusyPastTheClientsADeviceTakes) {
+  NPObject* last = NULL;
+  for (int i = 1; i <= DeviceManager::kMaxClients; i++) {
+    NPP npp = browser_->CreateInstance();
+    ASSERT_TRUE(npp != NULL);
+    last = browser_->GetScriptableObject(npp);
+    ASSERT_TRUE(last != NULL);
+  }
+  EXPECT_EQ("ok", StartDevice());
+  EXPECT_EQ("busy", StartDevice(last));
+}
+
+TEST_F(PluginTest, ReadsPositionAndSendsForces) {
+  ASSERT_EQ("ok", StartDevice());
+
+  // The same array comes back on every read, refreshed in place.
+  NPVariant first;
+  NPVariant second;
+  ASSERT_TRUE(browser_->GetProperty(plugin_, "position", &first));
+  ASSERT_TRUE(browser_->GetProperty(plugin_, "position", &second));
+  ASSERT_TRUE(NPVARIANT_IS_OBJECT(first));
+  EXPECT_EQ(NPVARIANT_TO_OBJECT(first), NPVARIANT_TO_OBJECT(second));
+  NPVariant length;
+  ASSERT_TRUE(browser_->GetProperty(NPVARIANT_TO_OBJECT(first), "length",
+                                    &length));
+  EXPECT_EQ(3, NPVARIANT_TO_INT32(length));
+  FakeBrowser::ReleaseVariantValue(&first);
+  FakeBrowser::ReleaseVariantValue(&second);
+
+  NPVariant x;
+  ASSERT_TRUE(browser_->GetProperty(plugin_, "positionX", &x));
+  EXPECT_TRUE(NPVARIANT_IS_DOUBLE(x));
+  EXPECT_FALSE(isnan(NPVARIANT_TO_DOUBLE(x)));
+
+  const double force[3] = { 1.0, 2.0, 3.0 };
+  NPVariant result;
+  EXPECT_TRUE(Call("sendForce3", force, 3, &result));
+  FakeBrowser::ReleaseVariantValue(&result);
+  // Wrong arity is a script error, not a crash.
+  EXPECT_FALSE(Call("sendForce3", force, 2, &result));
+  // So are forces that are not finite.
+  const double not_finite[3] = { 1.0, NAN, 3.0 };
+  EXPECT_FALSE(Call("sendForce3", not_finite, 3, &result));
+  const double infinite[3] = { 1.0, 2.0, -HUGE_VAL };
+  EXPECT_FALSE(Call("sendForce3", infinite, 3, &result));
+
+  // Only the first call evaluated a script, for the array.
+  EXPECT_EQ(1, browser_->evaluations());
+}
+
+TEST_F(PluginTest, RejectsNonIntegerIdsWithAnException) {
+  const double id = 1.5;
+  NPVariant result;
+  EXPECT_FALSE(Call("removePrimitive", &id, 1, &result));
+  EXPECT_EQ("removePrimitive: id must be an integer",
+            browser_->last_exception());
+}
+
+// A grid too large to hold comes back as null, not as an exception out of
+// the plugin.
+TEST_F(PluginTest, RefusesVolumesPastTheSampleBudget) {
+  ASSERT_EQ("ok", StartDevice());
+  NPVariant args[3];
+  STRINGZ_TO_NPVARIANT("[65536, 65536, 65536, 0, 0, 0, 0.001]", args[0]);
+  STRINGZ_TO_NPVARIANT("[]", args[1]);
+  DOUBLE_TO_NPVARIANT(500.0, args[2]);
+  NPVariant result;
+  ASSERT_TRUE(browser_->Invoke(plugin_, "uploadVolumeBricks", args, 3,
+                               &result));
+  EXPECT_TRUE(NPVARIANT_IS_NULL(result));
+
+  STRINGZ_TO_NPVARIANT("[512, 512, 512, 0, 0, 0, 0.001]", args[0]);
+  ASSERT_TRUE(browser_->Invoke(plugin_, "uploadVolumeBricks", args, 3,
+                               &result));
+  ASSERT_TRUE(NPVARIANT_IS_INT32(result));
+  EXPECT_EQ(0, NPVARIANT_TO_INT32(result));
+}
+
+TEST_F(PluginTest, BatchesDebugMessagesToTheConsole) {
+  NPVariant debug;
+  BOOLEAN_TO_NPVARIANT(true, debug);
+  ASSERT_TRUE(browser_->SetProperty(plugin_, "debug", debug));
+  ASSERT_EQ("ok", StartDevice());
+  browser_->RunPendingCalls();
+
+  ASSERT_FALSE(browser_->console_messages().empty());
+  EXPECT_NE(std::string::npos,
+            browser_->console_messages()[0].find("StartDevice::BEGIN"));
+}
+
+// Everything the plugin created or retained on the page side is released
+// by NPP_Destroy.
+TEST_F(PluginTest, DestroyReleasesEveryObject) {
+  ASSERT_EQ("ok", StartDevice());
+  NPVariant value;
+  ASSERT_TRUE(browser_->GetProperty(plugin_, "position", &value));
+  FakeBrowser::ReleaseVariantValue(&value);
+  ASSERT_TRUE(browser_->GetProperty(plugin_, "devices", &value));
+  FakeBrowser::ReleaseVariantValue(&value);
+  NPObject* callback = browser_->NewFunction();
+  NPVariant args[1];
+  OBJECT_TO_NPVARIANT(callback, args[0]);
+  ASSERT_TRUE(browser_->Invoke(plugin_, "onState", args, 1, &value));
+  FakeBrowser::ReleaseVariantValue(&value);
+  FakeBrowser::ReleaseObject(callback);
+
+  EXPECT_EQ(NPERR_NO_ERROR, browser_->DestroyInstance(npp_));
+  browser_->RunPendingCalls();
+  EXPECT_EQ(baseline_objects_, browser_->live_objects());
+}
+
+}  // namespace haptics
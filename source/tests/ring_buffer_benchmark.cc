@@ -0,0 +1,105 @@
+// Copyright 2010 Mohamed Mansour. All rights reserved.
+// Use of this source code is governed by a GPL license that can
+// be found in the LICENSE file.
+
+#include "ring_buffer.h"
+
+#include <thread>
+
+#include "benchmark/benchmark.h"
+#include "haptics_device.h"
+#include "platform_thread.h"
+
+namespace haptics {
+
+namespace {
+
+// The queue of servo samples, allocated on the heap with its alignment
+// like in HapticsDevice.
+class SampleQueue
+    : public RingBuffer<ServoSample, HapticsDevice::kSampleCapacity> {
+ public:
+  HAPTICS_CACHE_ALIGNED_NEW
+};
+
+// Push and pop on one thread: the cost of the queue itself, without any
+// cache line moving between cores.
+void BM_RingBufferPushPop(benchmark::State& state) {
+  SampleQueue* queue = new SampleQueue;
+  ServoSample sample = ServoSample();
+  for (auto _ : state) {
+    sample.time_us++;
+    queue->Push(sample);
+    queue->Pop(&sample);
+    benchmark::DoNotOptimize(sample);
+  }
+  state.SetItemsProcessed(state.iterations());
+  delete queue;
+}
+BENCHMARK(BM_RingBufferPushPop);
+
+// Fills the queue, then drains it in place the way DrainSamples does.
+void BM_RingBufferBurst(benchmark::State& state) {
+  SampleQueue* queue = new SampleQueue;
+  ServoSample sample = ServoSample();
+  double sum = 0.0;
+  for (auto _ : state) {
+    while (queue->Push(sample))
+      sample.time_us++;
+    const ServoSample* front;
+    while ((front = queue->Front()) != NULL) {
+      sum += front->position[0];
+      queue->PopFront();
+    }
+  }
+  benchmark::DoNotOptimize(sum);
+  state.SetItemsProcessed(state.iterations() * SampleQueue::capacity());
+  delete queue;
+}
+BENCHMARK(BM_RingBufferBurst);
+
+struct Producer {
+  SampleQueue* queue;
+  volatile Atomic32 stop;
+};
+
+void ProducerMain(hpointer data) {
+  Producer* producer = static_cast<Producer*>(data);
+  ServoSample sample = ServoSample();
+  while (AcquireLoad(&producer->stop) == 0) {
+    sample.time_us++;
+    while (!producer->queue->Push(sample)) {
+      if (AcquireLoad(&producer->stop) != 0)
+        return;
+      std::this_thread::yield();
+    }
+  }
+}
+
+// The servo thread pushing while the plugin thread pops. Every iteration
+// moves one sample between the threads.
+void BM_RingBufferCrossThread(benchmark::State& state) {
+  SampleQueue* queue = new SampleQueue;
+  Producer producer = { queue, 0 };
+  PlatformThread thread;
+  if (!thread.Start(ProducerMain, &producer)) {
+    state.SkipWithError("could not start the producer");
+    delete queue;
+    return;
+  }
+  ServoSample sample;
+  for (auto _ : state) {
+    while (!queue->Pop(&sample))
+      std::this_thread::yield();
+    benchmark::DoNotOptimize(sample);
+  }
+  ReleaseStore(&producer.stop, 1);
+  thread.Join();
+  state.SetItemsProcessed(state.iterations());
+  delete queue;
+}
+BENCHMARK(BM_RingBufferCrossThread)->UseRealTime();
+
+}  // namespace
+
+}  // namespace haptics
@@ -0,0 +1,197 @@
+// Copyright 2010 Mohamed Mansour. All rights reserved.
+// Use of this source code is governed by a GPL license that can
+// be found in the LICENSE file.
+
+#include "sdf_volume.h"
+
+#include <math.h>
+#include <stdlib.h>
+
+#include <vector>
+
+#include "benchmark/benchmark.h"
+
+namespace haptics {
+
+namespace {
+
+const int kGridSize = 96;
+const double kSpacing = 0.0005;
+const double kRadius = 0.02;
+
+// The largest grid SdfVolume takes, with a 0.2 mm cell.
+const int kLargeGridSize = 512;
+const double kLargeSpacing = 0.0002;
+const double kLargeRadius = 0.03;
+
+double SphereDistance(const double p[3], double radius) {
+  return sqrt(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]) - radius;
+}
+
+// A sphere in the middle of a 96^3 grid of half millimeter cells.
+const SdfVolume& SphereVolume() {
+  static SdfVolume* volume = NULL;
+  if (volume == NULL) {
+    double origin = -0.5 * kSpacing * (kGridSize - 1);
+    VolumeGrid grid = { { kGridSize, kGridSize, kGridSize },
+                        { origin, origin, origin },
+                        kSpacing };
+    std::vector<double> values;
+    values.reserve(kGridSize * kGridSize * kGridSize);
+    for (int z = 0; z < kGridSize; z++) {
+      for (int y = 0; y < kGridSize; y++) {
+        for (int x = 0; x < kGridSize; x++) {
+          double p[3] = { origin + kSpacing * x, origin + kSpacing * y,
+                          origin + kSpacing * z };
+          values.push_back(SphereDistance(p, kRadius));
+        }
+      }
+    }
+    volume = new SdfVolume;
+    volume->BuildDense(grid, values);
+  }
+  return *volume;
+}
+
+// A sphere in the middle of a 512^3 grid, sent the way a page sends large
+// volumes: only the bricks the surface goes through.
+const SdfVolume& LargeSphereVolume() {
+  static SdfVolume* volume = NULL;
+  if (volume == NULL) {
+    const int size = SdfVolume::kBrickSize;
+    const int bricks = kLargeGridSize / size;
+    double origin = -0.5 * kLargeSpacing * (kLargeGridSize - 1);
+    VolumeGrid grid = { { kLargeGridSize, kLargeGridSize, kLargeGridSize },
+                        { origin, origin, origin },
+                        kLargeSpacing };
+    // From the center of a brick to its corners, and a cell on to the
+    // samples its neighbours lend it.
+    const double reach = kLargeSpacing * (0.5 * sqrt(3.0) * size + 1.0);
+    std::vector<double> values;
+    for (int bz = 0; bz < bricks; bz++) {
+      for (int by = 0; by < bricks; by++) {
+        for (int bx = 0; bx < bricks; bx++) {
+          double center[3] = {
+              origin + kLargeSpacing * (size * bx + 0.5 * (size - 1)),
+              origin + kLargeSpacing * (size * by + 0.5 * (size - 1)),
+              origin + kLargeSpacing * (size * bz + 0.5 * (size - 1)) };
+          if (fabs(SphereDistance(center, kLargeRadius)) > reach)
+            continue;
+          values.push_back(bx);
+          values.push_back(by);
+          values.push_back(bz);
+          for (int z = 0; z < size; z++) {
+            for (int y = 0; y < size; y++) {
+              for (int x = 0; x < size; x++) {
+                double p[3] = { origin + kLargeSpacing * (size * bx + x),
+                                origin + kLargeSpacing * (size * by + y),
+                                origin + kLargeSpacing * (size * bz + z) };
+                values.push_back(SphereDistance(p, kLargeRadius));
+              }
+            }
+          }
+        }
+      }
+    }
+    volume = new SdfVolume;
+    volume->BuildSparse(grid, values);
+  }
+  return *volume;
+}
+
+// Runs Sample() on |volume| over |positions| in a loop.
+void RunQueries(benchmark::State& state,
+                const SdfVolume& volume,
+                const std::vector<double>& positions) {
+  size_t count = positions.size() / 3;
+  size_t next = 0;
+  double distance;
+  double gradient[3];
+  for (auto _ : state) {
+    volume.Sample(&positions[3 * next], &distance, gradient);
+    benchmark::DoNotOptimize(distance);
+    benchmark::DoNotOptimize(gradient[0]);
+    if (++next == count)
+      next = 0;
+  }
+  state.SetItemsProcessed(state.iterations());
+}
+
+// A tool moving slowly along the surface, as in a servo loop: one query per
+// tick, each close to the last, mostly within a brick.
+void BM_SdfSampleSurfacePath(benchmark::State& state) {
+  std::vector<double> positions;
+  for (int tick = 0; tick < 4096; tick++) {
+    double angle = 0.001 * tick;
+    positions.push_back(kRadius * cos(angle));
+    positions.push_back(kRadius * sin(angle));
+    positions.push_back(0.005 * sin(3.0 * angle));
+  }
+  RunQueries(state, SphereVolume(), positions);
+}
+BENCHMARK(BM_SdfSampleSurfacePath);
+
+// Queries that land exactly on brick boundaries along x, y or z, where the
+// cell's far corners come from the duplicated faces.
+void BM_SdfSampleBrickBoundaries(benchmark::State& state) {
+  const double origin = -0.5 * kSpacing * (kGridSize - 1);
+  const double brick = kSpacing * SdfVolume::kBrickSize;
+  std::vector<double> positions;
+  srand(1);
+  for (int i = 0; i < 4096; i++) {
+    for (int axis = 0; axis < 3; axis++) {
+      int bricks = (kGridSize - 1) / SdfVolume::kBrickSize;
+      if (i % 3 == axis)
+        positions.push_back(origin + brick * (rand() % bricks));
+      else
+        positions.push_back(origin + kSpacing * (kGridSize - 1) *
+                            (rand() / (RAND_MAX + 1.0)));
+    }
+  }
+  RunQueries(state, SphereVolume(), positions);
+}
+BENCHMARK(BM_SdfSampleBrickBoundaries);
+
+// The same on the 512^3 volume, on the surface where the bricks are stored.
+// Each query is snapped along one axis to the nearest brick boundary.
+void BM_SdfSampleBrickBoundaries512(benchmark::State& state) {
+  const SdfVolume& volume = LargeSphereVolume();
+  state.counters["stored_bricks"] = volume.stored_bricks();
+  const double origin = -0.5 * kLargeSpacing * (kLargeGridSize - 1);
+  const double brick = kLargeSpacing * SdfVolume::kBrickSize;
+  std::vector<double> positions;
+  srand(1);
+  for (int i = 0; i < 4096; i++) {
+    double p[3];
+    double length = 0.0;
+    for (int axis = 0; axis < 3; axis++) {
+      p[axis] = rand() / (RAND_MAX + 1.0) - 0.5;
+      length += p[axis] * p[axis];
+    }
+    length = sqrt(length);
+    for (int axis = 0; axis < 3; axis++)
+      p[axis] *= kLargeRadius / length;
+    int axis = i % 3;
+    p[axis] = origin + brick * floor((p[axis] - origin) / brick + 0.5);
+    positions.insert(positions.end(), p, p + 3);
+  }
+  RunQueries(state, volume, positions);
+}
+BENCHMARK(BM_SdfSampleBrickBoundaries512);
+
+// Far outside the sphere, where bricks are stored as a single value.
+void BM_SdfSampleUniformBricks(benchmark::State& state) {
+  const double corner = 0.45 * kSpacing * (kGridSize - 1);
+  std::vector<double> positions;
+  for (int i = 0; i < 4096; i++) {
+    positions.push_back(corner - 0.000001 * (i % 97));
+    positions.push_back(corner - 0.000001 * (i % 89));
+    positions.push_back(corner - 0.000001 * (i % 83));
+  }
+  RunQueries(state, SphereVolume(), positions);
+}
+BENCHMARK(BM_SdfSampleUniformBricks);
+
+}  // namespace
+
+}  // namespace haptics
@@ -0,0 +1,65 @@
+// Copyright 2010 Mohamed Mansour. All rights reserved.
+// Use of this source code is governed by a GPL license that can
+// be found in the LICENSE file.
+
+#include "sdf_volume.h"
+
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace haptics {
+
+namespace {
+
+VolumeGrid MakeGrid(int x, int y, int z) {
+  VolumeGrid grid;
+  grid.size[0] = x;
+  grid.size[1] = y;
+  grid.size[2] = z;
+  for (int k = 0; k < 3; k++)
+    grid.origin[k] = 0.0;
+  grid.spacing = 0.001;
+  return grid;
+}
+
+}  // namespace
+
+TEST(SdfVolumeTest, SamplesAPlane) {
+  // Distance to the plane z = 0.002, a grid of 4 mm.
+  VolumeGrid grid = MakeGrid(5, 5, 5);
+  std::vector<double> values;
+  for (int z = 0; z < 5; z++) {
+    for (int i = 0; i < 25; i++)
+      values.push_back(z * 0.001 - 0.002);
+  }
+  SdfVolume volume;
+  ASSERT_TRUE(volume.BuildDense(grid, values));
+
+  const double position[3] = { 0.0015, 0.0025, 0.0005 };
+  double distance;
+  double gradient[3];
+  ASSERT_TRUE(volume.Sample(position, &distance, gradient));
+  EXPECT_NEAR(-0.0015, distance, 1e-6);
+  EXPECT_NEAR(1.0, gradient[2], 1e-3);
+  const double outside[3] = { 0.0, 0.0, 0.005 };
+  EXPECT_FALSE(volume.Sample(outside, &distance, gradient));
+}
+
+// Even with no bricks sent, a grid needs a table entry per brick. Grids
+// past the budget are refused instead of running out of memory.
+TEST(SdfVolumeTest, RejectsGridsPastTheSampleBudget) {
+  std::vector<double> no_bricks;
+  SdfVolume volume;
+  EXPECT_FALSE(volume.BuildSparse(MakeGrid(65536, 65536, 65536), no_bricks));
+  EXPECT_FALSE(volume.BuildSparse(MakeGrid(513, 512, 512), no_bricks));
+  EXPECT_FALSE(volume.BuildDense(MakeGrid(65536, 65536, 65536),
+                                 std::vector<double>()));
+  EXPECT_TRUE(volume.empty());
+
+  EXPECT_TRUE(volume.BuildSparse(MakeGrid(512, 512, 512), no_bricks));
+  EXPECT_EQ(0, volume.stored_bricks());
+  EXPECT_FALSE(volume.empty());
+}
+
+}  // namespace haptics
@@ -0,0 +1,72 @@
+// Copyright 2010 Mohamed Mansour. All rights reserved.
+// Use of this source code is governed by a GPL license that can
+// be found in the LICENSE file.
+
+// Compares the output of the SIMD and scalar builds of simd_dump. The
+// kernels may order their arithmetic differently, so values only need to
+// agree to within kTolerance of their magnitude.
+
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+
+namespace {
+
+const double kTolerance = 1e-9;
+
+}  // namespace
+
+int main(int argc, char** argv) {
+  if (argc != 3) {
+    fprintf(stderr, "Usage: %s <simd dump> <scalar dump>\n", argv[0]);
+    return 2;
+  }
+  FILE* simd = fopen(argv[1], "r");
+  FILE* scalar = fopen(argv[2], "r");
+  if (simd == NULL || scalar == NULL) {
+    fprintf(stderr, "Cannot read the dumps\n");
+    return 2;
+  }
+
+  int lines = 0;
+  int mismatches = 0;
+  char simd_kernel[64];
+  char scalar_kernel[64];
+  int simd_index;
+  int scalar_index;
+  double simd_value;
+  double scalar_value;
+  for (;;) {
+    int simd_fields = fscanf(simd, "%63s %d %lf", simd_kernel, &simd_index,
+                             &simd_value);
+    int scalar_fields = fscanf(scalar, "%63s %d %lf", scalar_kernel,
+                               &scalar_index, &scalar_value);
+    if (simd_fields == EOF && scalar_fields == EOF)
+      break;
+    if (simd_fields != 3 || scalar_fields != 3 ||
+        strcmp(simd_kernel, scalar_kernel) != 0 ||
+        simd_index != scalar_index) {
+      fprintf(stderr, "The dumps differ in shape at line %d\n", lines + 1);
+      return 1;
+    }
+    lines++;
+    double scale = fabs(simd_value) > 1.0 ? fabs(simd_value) : 1.0;
+    // NaN never compares equal, so it is reported too.
+    if (!(fabs(simd_value - scalar_value) <= kTolerance * scale)) {
+      if (mismatches < 10) {
+        fprintf(stderr, "%s %d: SIMD %.17g, scalar %.17g\n", simd_kernel,
+                simd_index, simd_value, scalar_value);
+      }
+      mismatches++;
+    }
+  }
+  fclose(simd);
+  fclose(scalar);
+
+  if (lines == 0) {
+    fprintf(stderr, "The dumps are empty\n");
+    return 1;
+  }
+  printf("%d values compared, %d differ\n", lines, mismatches);
+  return mismatches == 0 ? 0 : 1;
+}
@@ -0,0 +1,225 @@
+// Copyright 2010 Mohamed Mansour. All rights reserved.
+// Use of this source code is governed by a GPL license that can
+// be found in the LICENSE file.
+
+// Runs the servo kernels that have a SIMD version on fixed inputs and
+// writes every result, one per line as "<kernel> <index> <value>". It is
+// built once against the plugin and once against its scalar build, and
+// simd_compare checks that both wrote the same numbers.
+
+#include <math.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include <vector>
+
+#include "affine_transform.h"
+#include "mass_spring_body.h"
+#include "motion_filter.h"
+#include "sdf_volume.h"
+
+namespace haptics {
+
+namespace {
+
+// Deterministic uniform numbers in [0, 1), the same in every build.
+class Random {
+ public:
+  Random() : state_(12345) {}
+
+  double Next() {
+    state_ = state_ * 6364136223846793005ull + 1442695040888963407ull;
+    return static_cast<double>(state_ >> 11) / 9007199254740992.0;
+  }
+
+ private:
+  uint64_t state_;
+};
+
+class Dump {
+ public:
+  explicit Dump(FILE* file) : file_(file) {}
+
+  void Write(const char* kernel, int index, double value) {
+    fprintf(file_, "%s %d %.17g\n", kernel, index, value);
+  }
+
+ private:
+  FILE* file_;
+};
+
+// A non-uniform box mapping with a rotation folded in, applied to points and
+// directions spread over the Falcon workspace.
+void DumpAffineTransform(Dump* dump) {
+  const double from[6] = { -0.06, -0.06, -0.06, 0.06, 0.06, 0.06 };
+  const double to[6] = { -1.0, -0.5, -2.0, 3.0, 0.5, 0.0 };
+  AffineTransform mapping;
+  mapping.SetBoxMapping(from, to, false);
+  double matrix[16];
+  for (int i = 0; i < 16; i++)
+    matrix[i] = mapping.matrix()[i];
+  // Rotate about z by 30 degrees.
+  const double c = 0.86602540378443865;
+  const double s = 0.5;
+  for (int column = 0; column < 4; column++) {
+    double x = matrix[4 * column];
+    double y = matrix[4 * column + 1];
+    matrix[4 * column] = c * x - s * y;
+    matrix[4 * column + 1] = s * x + c * y;
+  }
+  AffineTransform transform(matrix);
+
+  Random random;
+  for (int i = 0; i < 1000; i++) {
+    double in[3];
+    for (int axis = 0; axis < 3; axis++)
+      in[axis] = -0.06 + 0.12 * random.Next();
+    double point[3];
+    double vector[3];
+    transform.TransformPoint(in, point);
+    transform.TransformVector(in, vector);
+    for (int axis = 0; axis < 3; axis++) {
+      dump->Write("affine_point", 3 * i + axis, point[axis]);
+      dump->Write("affine_vector", 3 * i + axis, vector[axis]);
+    }
+  }
+}
+
+// A 12x12 sheet of 1 cm cells pinned along its edges, with structural and
+// diagonal springs, pressed in the middle by a tool for 200 steps.
+void DumpMassSpringBody(Dump* dump) {
+  const int kSide = 12;
+  std::vector<double> nodes;
+  std::vector<double> springs;
+  for (int row = 0; row < kSide; row++) {
+    for (int column = 0; column < kSide; column++) {
+      bool edge = row == 0 || column == 0 || row == kSide - 1 ||
+                  column == kSide - 1;
+      nodes.push_back(0.01 * column);
+      nodes.push_back(0.01 * row);
+      nodes.push_back(0.0);
+      nodes.push_back(edge ? 0.0 : 0.001);
+      int node = row * kSide + column;
+      const int neighbors[4][2] = { { 0, 1 }, { 1, 0 }, { 1, 1 }, { 1, -1 } };
+      for (int i = 0; i < 4; i++) {
+        int other_row = row + neighbors[i][0];
+        int other_column = column + neighbors[i][1];
+        if (other_row >= kSide || other_column < 0 || other_column >= kSide)
+          continue;
+        springs.push_back(node);
+        springs.push_back(other_row * kSide + other_column);
+        springs.push_back(i < 2 ? 40.0 : 20.0);
+      }
+    }
+  }
+  MassSpringBody body;
+  if (!body.Build(nodes, springs, 0.02)) {
+    dump->Write("mass_spring_build_failed", 0, 1.0);
+    return;
+  }
+
+  DeformableTool tool = { { 0.055, 0.055, 0.02 }, 0.025, 200.0 };
+  double dt = body.StableTimeStep(tool.stiffness);
+  std::vector<double> positions;
+  for (int step = 0; step < 200; step++) {
+    DeformableContact contact;
+    body.Step(dt, &tool, &contact);
+    for (int axis = 0; axis < 3; axis++)
+      dump->Write("mass_spring_contact", 3 * step + axis, contact.force[axis]);
+  }
+  body.GetPositions(&positions);
+  for (size_t i = 0; i < positions.size(); i++)
+    dump->Write("mass_spring_position", static_cast<int>(i), positions[i]);
+}
+
+// A jittery tool path sampled at an irregular 1 kHz, through the default
+// filters and then with both turned off.
+void DumpMotionFilter(Dump* dump) {
+  Random random;
+  MotionFilter filter;
+  int64_t now = 0;
+  for (int i = 0; i < 2000; i++) {
+    if (i == 1000) {
+      MotionFilterSettings unfiltered = { 0.0, 0.0 };
+      filter.Configure(unfiltered);
+      filter.Reset();
+    }
+    now += 900 + static_cast<int64_t>(200 * random.Next());
+    double t = now / 1000000.0;
+    double position[3] = {
+      0.03 * sin(2.0 * t) + 0.00001 * random.Next(),
+      0.02 * cos(3.0 * t) + 0.00001 * random.Next(),
+      0.01 * sin(5.0 * t) + 0.00001 * random.Next()
+    };
+    filter.Update(now, position);
+    for (int axis = 0; axis < 3; axis++) {
+      dump->Write("motion_velocity", 3 * i + axis, filter.velocity()[axis]);
+      dump->Write("motion_acceleration", 3 * i + axis,
+                  filter.acceleration()[axis]);
+    }
+  }
+}
+
+// A sphere of radius 0.015 in a 40^3 grid of 1 mm cells, so queries cross
+// brick boundaries and hit uniform bricks.
+void DumpSdfVolume(Dump* dump) {
+  VolumeGrid grid = { { 40, 40, 40 }, { -0.02, -0.02, -0.02 }, 0.001 };
+  std::vector<double> values;
+  for (int z = 0; z < 40; z++) {
+    for (int y = 0; y < 40; y++) {
+      for (int x = 0; x < 40; x++) {
+        double p[3] = { -0.02 + 0.001 * x, -0.02 + 0.001 * y,
+                        -0.02 + 0.001 * z };
+        values.push_back(sqrt(p[0] * p[0] + p[1] * p[1] + p[2] * p[2]) -
+                         0.015);
+      }
+    }
+  }
+  SdfVolume volume;
+  if (!volume.BuildDense(grid, values)) {
+    dump->Write("sdf_build_failed", 0, 1.0);
+    return;
+  }
+
+  Random random;
+  int index = 0;
+  for (int i = 0; i < 2000; i++) {
+    double position[3];
+    for (int axis = 0; axis < 3; axis++) {
+      position[axis] = -0.02 + 0.039 * random.Next();
+      // Every fourth query sits exactly on a brick boundary on this axis.
+      if (i % 4 == axis)
+        position[axis] = -0.02 + 0.008 * static_cast<int>(4 * random.Next());
+    }
+    double distance;
+    double gradient[3];
+    if (!volume.Sample(position, &distance, gradient))
+      continue;
+    dump->Write("sdf_distance", index, distance);
+    for (int axis = 0; axis < 3; axis++)
+      dump->Write("sdf_gradient", 3 * index + axis, gradient[axis]);
+    index++;
+  }
+}
+
+}  // namespace
+
+}  // namespace haptics
+
+int main(int argc, char** argv) {
+  if (argc != 2) {
+    fprintf(stderr, "Usage: %s <output file>\n", argv[0]);
+    return 2;
+  }
+  FILE* file = fopen(argv[1], "w");
+  if (file == NULL) {
+    fprintf(stderr, "Cannot write %s\n", argv[1]);
+    return 1;
+  }
+  haptics::Dump dump(file);
+  haptics::DumpAffineTransform(&dump);
+  haptics::DumpMassSpringBody(&dump);
+  haptics::DumpMotionFilter(&dump);
+  haptics::DumpSdfVolume(&dump);
+  return fclose(file) == 0 ? 0 : 1;
+}
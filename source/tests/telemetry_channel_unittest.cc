@@ -0,0 +1,201 @@
+// Copyright 2010 Mohamed Mansour. All rights reserved.
+// Use of this source code is governed by a GPL license that can
+// be found in the LICENSE file.
+
+#include "telemetry_channel.h"
+
+#include <stdio.h>
+#include <unistd.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "gtest/gtest.h"
+
+namespace haptics {
+
+namespace {
+
+// Fills every field of |record| from |n|, so a record mixing two writes
+// shows.
+void FillRecord(uint32_t n, TelemetryRecord* record) {
+  record->device = static_cast<int32_t>(n % 4);
+  record->time_us = n;
+  record->button = static_cast<int32_t>(n & 1);
+  record->client_count = static_cast<int32_t>(n % 7);
+  for (int i = 0; i < 3; i++) {
+    record->position[i] = n * 0.001 + i;
+    record->force[i] = -(n * 0.01) - i;
+  }
+  record->period_us = static_cast<int32_t>(n * 3);
+  record->execution_us = static_cast<int32_t>(n * 5);
+}
+
+bool IsWhole(const TelemetryRecord& record) {
+  TelemetryRecord expected;
+  FillRecord(static_cast<uint32_t>(record.time_us), &expected);
+  if (record.device != expected.device ||
+      record.button != expected.button ||
+      record.client_count != expected.client_count ||
+      record.period_us != expected.period_us ||
+      record.execution_us != expected.execution_us) {
+    return false;
+  }
+  for (int i = 0; i < 3; i++) {
+    if (record.position[i] != expected.position[i] ||
+        record.force[i] != expected.force[i]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+class TelemetryChannelTest : public testing::Test {
+ protected:
+  virtual void SetUp() {
+    char name[64];
+    snprintf(name, sizeof(name), "haptics_unittest_%d",
+             static_cast<int>(getpid()));
+    name_ = name;
+    ASSERT_TRUE(publisher_.Open(name_, 4));
+    ASSERT_TRUE(reader_.Open(name_));
+    EXPECT_EQ(4, reader_.device_count());
+  }
+
+  void Publish(uint32_t n) {
+    FillRecord(n, publisher_.BeginRecord());
+    publisher_.EndRecord();
+  }
+
+  std::string name_;
+  TelemetryPublisher publisher_;
+  TelemetryReader reader_;
+};
+
+}  // namespace
+
+TEST_F(TelemetryChannelTest, ReadsRecordsInOrder) {
+  for (uint32_t n = 0; n < 100; n++)
+    Publish(n);
+  TelemetryRecord records[100];
+  ASSERT_EQ(64, reader_.Read(records, 64));
+  ASSERT_EQ(36, reader_.Read(records + 64, 64));
+  for (int i = 0; i < 100; i++) {
+    EXPECT_EQ(i, records[i].time_us);
+    EXPECT_TRUE(IsWhole(records[i]));
+  }
+  EXPECT_EQ(0, reader_.Read(records, 64));
+  EXPECT_EQ(0, reader_.lost_records());
+}
+
+// A reader more than a ring behind gets the newest ring's worth and counts
+// the rest as lost.
+TEST_F(TelemetryChannelTest, CountsRecordsOverwrittenBeforeRead) {
+  const uint32_t total = 3 * kTelemetrySlotCount + 5;
+  for (uint32_t n = 0; n < total; n++)
+    Publish(n);
+  std::vector<TelemetryRecord> records(kTelemetrySlotCount + 1);
+  ASSERT_EQ(kTelemetrySlotCount,
+            reader_.Read(&records[0], kTelemetrySlotCount + 1));
+  EXPECT_EQ(total - kTelemetrySlotCount, records[0].time_us);
+  EXPECT_EQ(total - 1, records[kTelemetrySlotCount - 1].time_us);
+  EXPECT_EQ(total - kTelemetrySlotCount, reader_.lost_records());
+}
+
+// The servo thread publishes as fast as it can while the reader drains the
+// ring. Whatever the reader gets is whole and in order, and every record it
+// skipped is counted as lost.
+TEST_F(TelemetryChannelTest, ReadsWhileWriting) {
+  const int64_t total = 2000000;
+  volatile Atomic32 done = 0;
+  std::chrono::steady_clock::time_point begin =
+      std::chrono::steady_clock::now();
+  std::thread writer([this, total, &done]() {
+    for (int64_t n = 0; n < total; n++)
+      Publish(static_cast<uint32_t>(n));
+    ReleaseStore(&done, 1);
+  });
+
+  std::vector<TelemetryRecord> records(256);
+  int64_t received = 0;
+  int64_t skipped = 0;
+  int64_t torn = 0;
+  int64_t out_of_order = 0;
+  int64_t last = -1;
+  for (;;) {
+    // Once the writer is done, one more pass gets what it wrote last.
+    bool finished = AcquireLoad(&done) != 0;
+    int count;
+    while ((count = reader_.Read(&records[0],
+                                 static_cast<int>(records.size()))) > 0) {
+      for (int i = 0; i < count; i++) {
+        if (!IsWhole(records[i]))
+          torn++;
+        if (records[i].time_us <= last)
+          out_of_order++;
+        else
+          skipped += records[i].time_us - last - 1;
+        last = records[i].time_us;
+      }
+      received += count;
+    }
+    if (finished)
+      break;
+    std::this_thread::yield();
+  }
+  writer.join();
+  double seconds = std::chrono::duration<double>(
+      std::chrono::steady_clock::now() - begin).count();
+
+  EXPECT_EQ(0, torn);
+  EXPECT_EQ(0, out_of_order);
+  EXPECT_EQ(total - 1, last);
+  EXPECT_EQ(total, received + reader_.lost_records());
+  EXPECT_EQ(skipped, reader_.lost_records());
+  RecordProperty("records_per_second", static_cast<int>(total / seconds));
+  RecordProperty("lost_records", static_cast<int>(reader_.lost_records()));
+}
+
+// Eight devices at 1 kHz fill the ring in a second, so a reader polling
+// every few milliseconds never loses a record.
+TEST_F(TelemetryChannelTest, KeepsUpWithEightDevicesAtFullRate) {
+  const int kTicks = 250;
+  const int kDevices = 8;
+  volatile Atomic32 done = 0;
+  std::thread writer([this, &done]() {
+    std::chrono::steady_clock::time_point deadline =
+        std::chrono::steady_clock::now();
+    for (int tick = 0; tick < kTicks; tick++) {
+      for (int device = 0; device < kDevices; device++)
+        Publish(static_cast<uint32_t>(tick * kDevices + device));
+      deadline += std::chrono::milliseconds(1);
+      std::this_thread::sleep_until(deadline);
+    }
+    ReleaseStore(&done, 1);
+  });
+
+  std::vector<TelemetryRecord> records(kTelemetrySlotCount);
+  int64_t received = 0;
+  int64_t unexpected = 0;
+  for (;;) {
+    bool finished = AcquireLoad(&done) != 0;
+    int count = reader_.Read(&records[0], kTelemetrySlotCount);
+    for (int i = 0; i < count; i++) {
+      if (records[i].time_us != received + i || !IsWhole(records[i]))
+        unexpected++;
+    }
+    received += count;
+    if (finished)
+      break;
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+  }
+  writer.join();
+
+  EXPECT_EQ(0, unexpected);
+  EXPECT_EQ(kTicks * kDevices, received);
+  EXPECT_EQ(0, reader_.lost_records());
+}
+
+}  // namespace haptics
@@ -0,0 +1,126 @@
+// Copyright 2010 Mohamed Mansour. All rights reserved.
+// Use of this source code is governed by a GPL license that can
+// be found in the LICENSE file.
+
+#include "trajectory_recorder.h"
+
+#include <stdio.h>
+
+#include <chrono>
+#include <string>
+#include <thread>
+
+#include "gtest/gtest.h"
+#include "replay_backend.h"
+
+namespace haptics {
+
+namespace {
+
+const int kDeviceCount = 2;
+// Enough ticks for the servo thread to move on to the second segment.
+const int kTicks = 150000;
+const double kWorkspaces[kDeviceCount * 6] = {
+  -0.06, -0.06, -0.06, 0.06, 0.06, 0.06,
+  -0.05, -0.04, -0.03, 0.05, 0.04, 0.03
+};
+
+// Where |device| was on |tick| of the recording.
+void ToolAt(int tick, int device, double position[3], bool* button) {
+  position[0] = 0.00001 * (tick % 1000) + device;
+  position[1] = -0.00002 * (tick % 777);
+  position[2] = 0.001 * device;
+  *button = tick % 3 == 0;
+}
+
+// Checks the tools a replay presents on every servo tick.
+struct ReplayCheck {
+  ReplayBackend* backend;
+  int64_t first_time;
+  int ticks;
+  int mismatches;
+  volatile Atomic32 done;
+};
+
+ServoOpExitCode CheckTick(hpointer data) {
+  ReplayCheck* check = static_cast<ReplayCheck*>(data);
+  if (check->ticks == 0)
+    check->first_time = check->backend->Now();
+  int tick = static_cast<int>((check->backend->Now() - check->first_time) /
+                              1000);
+  for (int device = 0; device < kDeviceCount; device++) {
+    double expected[3];
+    bool expected_button;
+    ToolAt(tick, device, expected, &expected_button);
+    double position[3];
+    bool button;
+    check->backend->MakeCurrent(device);
+    check->backend->GetToolPosition(position);
+    check->backend->GetToolButton(&button);
+    if (position[0] != expected[0] || position[1] != expected[1] ||
+        position[2] != expected[2] || button != expected_button) {
+      check->mismatches++;
+    }
+  }
+  if (++check->ticks < kTicks)
+    return SERVOOP_CONTINUE;
+  ReleaseStore(&check->done, 1);
+  return SERVOOP_EXIT;
+}
+
+}  // namespace
+
+TEST(TrajectoryRecorderTest, ReplaysWhatWasRecorded) {
+  const std::string path = testing::TempDir() + "trajectory_test.bin";
+  TrajectoryRecorder recorder;
+  ASSERT_TRUE(recorder.Open(path, kDeviceCount, kWorkspaces));
+  const double force[3] = { 0.1, 0.2, 0.3 };
+  for (int tick = 0; tick < kTicks; tick++) {
+    for (int device = 0; device < kDeviceCount; device++) {
+      double position[3];
+      bool button;
+      ToolAt(tick, device, position, &button);
+      recorder.Record(1000000 + 1000 * tick, device, button, position, force);
+    }
+  }
+  recorder.Close();
+  EXPECT_EQ(kTicks * kDeviceCount, recorder.record_count());
+  EXPECT_EQ(0, recorder.dropped_records());
+
+  ReplayBackend backend(path, 0.0);
+  ASSERT_EQ(kDeviceCount, backend.CountDevices());
+  EXPECT_FALSE(backend.Open(kDeviceCount + 1));
+  ASSERT_TRUE(backend.Open(kDeviceCount));
+  for (int device = 0; device < kDeviceCount; device++) {
+    double workspace[6];
+    backend.GetWorkspace(device, workspace);
+    for (int i = 0; i < 6; i++)
+      EXPECT_EQ(kWorkspaces[device * 6 + i], workspace[i]);
+  }
+
+  ReplayCheck check = { &backend, 0, 0, 0, 0 };
+  ASSERT_TRUE(backend.Start(CheckTick, &check));
+  for (int waited = 0; AcquireLoad(&check.done) == 0 && waited < 10000;
+       waited++) {
+    std::this_thread::sleep_for(std::chrono::milliseconds(1));
+  }
+  backend.Stop();
+  backend.Close();
+  remove(path.c_str());
+
+  EXPECT_EQ(kTicks, check.ticks);
+  EXPECT_EQ(0, check.mismatches);
+}
+
+TEST(TrajectoryRecorderTest, OnlyPlainFileNamesAreRecorded) {
+  EXPECT_EQ("", TrajectoryRecorder::PathForName(""));
+  EXPECT_EQ("", TrajectoryRecorder::PathForName(".."));
+  EXPECT_EQ("", TrajectoryRecorder::PathForName("../take.bin"));
+  EXPECT_EQ("", TrajectoryRecorder::PathForName("a/take.bin"));
+  EXPECT_EQ("", TrajectoryRecorder::PathForName("c:take.bin"));
+  std::string path = TrajectoryRecorder::PathForName("take.bin");
+  ASSERT_LT(9u, path.size());
+  EXPECT_EQ("/take.bin", path.substr(path.size() - 9));
+}
+
+}  // namespace haptics
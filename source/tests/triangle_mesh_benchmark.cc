@@ -0,0 +1,102 @@
+// Copyright 2010 Mohamed Mansour. All rights reserved.
+// Use of this source code is governed by a GPL license that can
+// be found in the LICENSE file.
+
+#include "triangle_mesh.h"
+
+#include <math.h>
+
+#include <vector>
+
+#include "benchmark/benchmark.h"
+
+namespace haptics {
+
+namespace {
+
+const double kPi = 3.14159265358979323846;
+
+// A sphere of |radius| meters at the origin, |segments| around and
+// |segments| / 2 from pole to pole.
+void BuildSphere(int segments, double radius, TriangleMesh* mesh) {
+  int rings = segments / 2;
+  std::vector<double> vertices;
+  std::vector<double> indices;
+  for (int ring = 0; ring <= rings; ring++) {
+    double polar = kPi * ring / rings;
+    for (int segment = 0; segment < segments; segment++) {
+      double azimuth = 2.0 * kPi * segment / segments;
+      vertices.push_back(radius * sin(polar) * cos(azimuth));
+      vertices.push_back(radius * sin(polar) * sin(azimuth));
+      vertices.push_back(radius * cos(polar));
+    }
+  }
+  for (int ring = 0; ring < rings; ring++) {
+    for (int segment = 0; segment < segments; segment++) {
+      int a = ring * segments + segment;
+      int b = ring * segments + (segment + 1) % segments;
+      int c = a + segments;
+      int d = b + segments;
+      if (ring > 0) {
+        indices.push_back(a);
+        indices.push_back(b);
+        indices.push_back(c);
+      }
+      if (ring < rings - 1) {
+        indices.push_back(b);
+        indices.push_back(d);
+        indices.push_back(c);
+      }
+    }
+  }
+  mesh->Build(vertices, indices);
+}
+
+// One servo tick of mesh rendering: the god-object follows the tool, which
+// moves like the simulated device's hand does when nothing pushes back, in
+// and out of a sphere of 2 cm. |state.range(0)| sets the mesh resolution.
+void BM_GodObjectTick(benchmark::State& state) {
+  TriangleMesh mesh;
+  BuildSphere(static_cast<int>(state.range(0)), 0.02, &mesh);
+  GodObject proxy;
+  double tool[3] = { 0.0, 0.0, 0.0 };
+  proxy.Reset(tool);
+  const double dt = 0.001;
+  double time = 0.0;
+  for (auto _ : state) {
+    time += dt;
+    tool[0] = 0.03 * sin(2.0 * kPi * 0.5 * time);
+    tool[1] = 0.03 * sin(2.0 * kPi * 0.7 * time);
+    tool[2] = 0.02 * sin(2.0 * kPi * 0.3 * time);
+    proxy.Update(mesh, tool);
+    benchmark::DoNotOptimize(proxy.position()[0]);
+  }
+  state.counters["triangles"] = mesh.triangle_count();
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_GodObjectTick)->Arg(16)->Arg(64)->Arg(256)->Arg(512);
+
+// The segment query alone, from outside the sphere to its center.
+void BM_IntersectSegment(benchmark::State& state) {
+  TriangleMesh mesh;
+  BuildSphere(static_cast<int>(state.range(0)), 0.02, &mesh);
+  const double to[3] = { 0.0, 0.0, 0.0 };
+  double from[3];
+  double t;
+  double normal[3];
+  int step = 0;
+  for (auto _ : state) {
+    double angle = 0.001 * step++;
+    from[0] = 0.03 * cos(angle);
+    from[1] = 0.03 * sin(angle);
+    from[2] = 0.01 * sin(3.0 * angle);
+    benchmark::DoNotOptimize(mesh.IntersectSegment(from, to, &t, normal));
+  }
+  state.counters["triangles"] = mesh.triangle_count();
+  state.SetItemsProcessed(state.iterations());
+}
+BENCHMARK(BM_IntersectSegment)->Arg(16)->Arg(64)->Arg(256)->Arg(512);
+
+}  // namespace
+
+}  // namespace haptics
@@ -0,0 +1,104 @@
+// Copyright 2010 Mohamed Mansour. All rights reserved.
+// Use of this source code is governed by a GPL license that can
+// be found in the LICENSE file.
+
+#include "triple_buffer.h"
+
+#include <stdint.h>
+
+#include <thread>
+
+#include "gtest/gtest.h"
+
+namespace haptics {
+
+namespace {
+
+// Larger than a cache line, so a slot copied while it is being written would
+// show words from two different publishes.
+struct Payload {
+  enum { kWords = 32 };
+  uint32_t sequence;
+  uint32_t words[kWords];
+};
+
+const uint32_t kPublishes = 2000000;
+
+void Fill(uint32_t sequence, Payload* payload) {
+  payload->sequence = sequence;
+  for (int i = 0; i < Payload::kWords; i++)
+    payload->words[i] = sequence * 2654435761u + i;
+}
+
+bool IsWhole(const Payload& payload) {
+  for (int i = 0; i < Payload::kWords; i++) {
+    if (payload.words[i] != payload.sequence * 2654435761u + i)
+      return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+TEST(TripleBufferTest, StartsWithDefaultValue) {
+  TripleBuffer<int> buffer;
+  EXPECT_FALSE(buffer.Update());
+  EXPECT_EQ(0, buffer.read_buffer());
+}
+
+TEST(TripleBufferTest, ReaderGetsLatestPublish) {
+  TripleBuffer<int> buffer;
+  *buffer.write_buffer() = 1;
+  buffer.Publish();
+  *buffer.write_buffer() = 2;
+  buffer.Publish();
+
+  EXPECT_TRUE(buffer.Update());
+  EXPECT_EQ(2, buffer.read_buffer());
+  // Nothing new, the reader keeps what it has.
+  EXPECT_FALSE(buffer.Update());
+  EXPECT_EQ(2, buffer.read_buffer());
+}
+
+// One writer publishes as fast as it can while one reader keeps updating.
+// Every value the reader sees must be one whole publish, and never older
+// than the one it saw before.
+TEST(TripleBufferTest, ConcurrentReaderNeverSeesTornOrOlderSlots) {
+  TripleBuffer<Payload> buffer;
+  volatile Atomic32 done = 0;
+  std::thread writer([&buffer, &done]() {
+    for (uint32_t i = 1; i <= kPublishes; i++) {
+      Fill(i, buffer.write_buffer());
+      buffer.Publish();
+    }
+    ReleaseStore(&done, 1);
+  });
+
+  uint32_t last_sequence = 0;
+  int64_t updates = 0;
+  int64_t torn = 0;
+  int64_t older = 0;
+  bool finished = false;
+  while (!finished) {
+    // Check the done flag before updating, so the last pass sees the final
+    // publish.
+    finished = AcquireLoad(&done) != 0;
+    if (!buffer.Update())
+      continue;
+    updates++;
+    const Payload& payload = buffer.read_buffer();
+    if (!IsWhole(payload))
+      torn++;
+    if (payload.sequence < last_sequence)
+      older++;
+    last_sequence = payload.sequence;
+  }
+  writer.join();
+
+  EXPECT_EQ(0, torn);
+  EXPECT_EQ(0, older);
+  EXPECT_GT(updates, 0);
+  EXPECT_EQ(kPublishes, last_sequence);
+}
+
+}  // namespace haptics
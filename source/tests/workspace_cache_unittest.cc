@@ -0,0 +1,88 @@
+// Copyright 2010 Mohamed Mansour. All rights reserved.
+// Use of this source code is governed by a GPL license that can
+// be found in the LICENSE file.
+
+#include "workspace_cache.h"
+
+#include <stdio.h>
+
+#include <string>
+
+#include "gtest/gtest.h"
+
+namespace haptics {
+
+namespace {
+
+const double kFalcon[6] = { -0.06, -0.06, -0.06, 0.06, 0.06, 0.06 };
+const double kOther[6] = { -0.1, -0.05, -0.02, 0.1, 0.05, 0.08 };
+
+class WorkspaceCacheTest : public testing::Test {
+ protected:
+  virtual void SetUp() {
+    path_ = testing::TempDir() + "workspace_cache_unittest.txt";
+    remove(path_.c_str());
+  }
+
+  virtual void TearDown() {
+    remove(path_.c_str());
+  }
+
+  void ExpectWorkspace(const WorkspaceCache& cache, const std::string& model,
+                       const double expected[6]) {
+    double workspace[6];
+    ASSERT_TRUE(cache.Lookup(model, workspace));
+    for (int i = 0; i < 6; i++)
+      EXPECT_EQ(expected[i], workspace[i]);
+  }
+
+  std::string path_;
+};
+
+}  // namespace
+
+TEST_F(WorkspaceCacheTest, KeepsWorkspacesByModel) {
+  WorkspaceCache cache(path_);
+  cache.Load();
+  double workspace[6];
+  EXPECT_FALSE(cache.Lookup("Novint Falcon", workspace));
+  cache.Store("Novint Falcon", kFalcon);
+  cache.Store("Other Device 2", kOther);
+  ASSERT_TRUE(cache.Save());
+
+  // Whatever port each device is on next time.
+  WorkspaceCache reloaded(path_);
+  reloaded.Load();
+  ExpectWorkspace(reloaded, "Other Device 2", kOther);
+  ExpectWorkspace(reloaded, "Novint Falcon", kFalcon);
+  EXPECT_FALSE(reloaded.Lookup("Novint", workspace));
+}
+
+TEST_F(WorkspaceCacheTest, StoringAgainReplacesTheWorkspace) {
+  WorkspaceCache cache(path_);
+  cache.Load();
+  cache.Store("Novint Falcon", kOther);
+  cache.Store("Novint Falcon", kFalcon);
+  ASSERT_TRUE(cache.Save());
+
+  WorkspaceCache reloaded(path_);
+  reloaded.Load();
+  ExpectWorkspace(reloaded, "Novint Falcon", kFalcon);
+}
+
+// The earlier format keyed workspaces by port, which is what went wrong
+// when devices were swapped.
+TEST_F(WorkspaceCacheTest, IgnoresFilesOfTheEarlierFormat) {
+  FILE* file = fopen(path_.c_str(), "w");
+  ASSERT_TRUE(file != NULL);
+  fputs("1\n0 -1 -1 -1 1 1 1\n", file);
+  fclose(file);
+
+  WorkspaceCache cache(path_);
+  cache.Load();
+  double workspace[6];
+  EXPECT_FALSE(cache.Lookup("0", workspace));
+  EXPECT_FALSE(cache.Lookup("", workspace));
+}
+
+}  // namespace haptics
@@ -0,0 +1,199 @@
+// Copyright 2010 Mohamed Mansour. All rights reserved.
+// Use of this source code is governed by a GPL license that can
+// be found in the LICENSE file.
+
+#include "trajectory_recorder.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+namespace haptics {
+
+const char kTrajectoryMagic[8] = { 'H', 'A', 'P', 'T', 'R', 'A', 'J', 0 };
+
+namespace {
+
+// Every block of the file has the same size.
+typedef char HeaderSizeCheck[
+    sizeof(TrajectoryHeader) == kTrajectoryBlockSize ? 1 : -1];
+typedef char WorkspaceSizeCheck[
+    sizeof(TrajectoryWorkspace) == kTrajectoryBlockSize ? 1 : -1];
+typedef char RecordSizeCheck[
+    sizeof(TrajectoryRecord) == kTrajectoryBlockSize ? 1 : -1];
+
+// Bytes between two touches when faulting a segment in, no larger than any
+// page size in use.
+const int kPageBytes = 4096;
+
+// How often the mapper thread looks for work. A segment lasts minutes.
+const int64_t kMapperPeriodMicroseconds = 5000;
+
+}  // namespace
+
+TrajectoryRecorder::TrajectoryRecorder()
+    : device_count_(0),
+      stop_requested_(0),
+      spare_segment_(NULL),
+      next_segment_(0),
+      segment_(NULL),
+      cursor_(NULL),
+      end_(NULL),
+      record_count_(0),
+      dropped_records_(0) {
+}
+
+TrajectoryRecorder::~TrajectoryRecorder() {
+  Close();
+}
+
+bool TrajectoryRecorder::Open(const std::string& path,
+                              int device_count,
+                              const double* workspaces) {
+  Close();
+  if (!file_.Create(path.c_str()))
+    return false;
+
+  // The first segment starts with the header and the workspaces, the ticks
+  // follow.
+  segment_ = MapSegment(0);
+  spare_segment_ = MapSegment(1);
+  if (segment_ == NULL || spare_segment_ == NULL) {
+    Close();
+    return false;
+  }
+  next_segment_ = 2;
+  device_count_ = device_count;
+
+  TrajectoryHeader* header = static_cast<TrajectoryHeader*>(segment_);
+  memset(header, 0, sizeof(*header));
+  memcpy(header->magic, kTrajectoryMagic, sizeof(header->magic));
+  header->version = kTrajectoryVersion;
+  header->block_size = kTrajectoryBlockSize;
+  header->record_count = 0;
+  header->device_count = device_count;
+  TrajectoryWorkspace* workspace =
+      reinterpret_cast<TrajectoryWorkspace*>(header + 1);
+  for (int i = 0; i < device_count; i++, workspace++) {
+    memset(workspace, 0, sizeof(*workspace));
+    for (int j = 0; j < 6; j++)
+      workspace->workspace[j] = workspaces[i * 6 + j];
+  }
+
+  cursor_ = reinterpret_cast<TrajectoryRecord*>(workspace);
+  end_ = static_cast<TrajectoryRecord*>(segment_) + kSegmentBlocks;
+  record_count_ = 0;
+  ReleaseStore(&dropped_records_, 0);
+  ReleaseStore(&stop_requested_, 0);
+  if (!mapper_.Start(MapAheadThunk, this)) {
+    Close();
+    return false;
+  }
+  return true;
+}
+
+void TrajectoryRecorder::Close() {
+  ReleaseStore(&stop_requested_, 1);
+  mapper_.Join();
+  if (!file_.is_open())
+    return;
+
+  void* segment;
+  while (retired_segments_.Pop(&segment))
+    MappedFile::Unmap(segment, kSegmentBytes);
+  MappedFile::Unmap(
+      AtomicExchangePointer(&spare_segment_, NULL), kSegmentBytes);
+  MappedFile::Unmap(segment_, kSegmentBytes);
+  segment_ = NULL;
+  cursor_ = NULL;
+  end_ = NULL;
+
+  // Now that every record is in, the header gets their count and the file
+  // loses the unused end of the last segment.
+  TrajectoryHeader* header =
+      static_cast<TrajectoryHeader*>(file_.Map(0, sizeof(TrajectoryHeader)));
+  if (header) {
+    header->record_count = record_count_;
+    MappedFile::Unmap(header, sizeof(TrajectoryHeader));
+  }
+  file_.Resize((1 + device_count_ + record_count_) * kTrajectoryBlockSize);
+  file_.Close();
+}
+
+void TrajectoryRecorder::Record(int64_t time_us,
+                                int device,
+                                bool button,
+                                const double position[3],
+                                const double force[3]) {
+  if (cursor_ == end_) {
+    void* next = AtomicExchangePointer(&spare_segment_, NULL);
+    if (next == NULL) {
+      AtomicIncrement(&dropped_records_, 1);
+      return;
+    }
+    // Sixteen retired segments are hours of ticks, the mapper thread
+    // empties the queue long before.
+    retired_segments_.Push(segment_);
+    segment_ = next;
+    cursor_ = static_cast<TrajectoryRecord*>(next);
+    end_ = cursor_ + kSegmentBlocks;
+  }
+
+  cursor_->time_us = time_us;
+  cursor_->device = device;
+  cursor_->button = button ? 1 : 0;
+  for (int i = 0; i < 3; i++) {
+    cursor_->position[i] = position[i];
+    cursor_->force[i] = force[i];
+  }
+  ++cursor_;
+  ++record_count_;
+}
+
+void TrajectoryRecorder::MapAhead() {
+  while (!AcquireLoad(&stop_requested_)) {
+    if (AcquireLoadPointer(&spare_segment_) == NULL) {
+      void* segment = MapSegment(next_segment_);
+      if (segment) {
+        AtomicExchangePointer(&spare_segment_, segment);
+        next_segment_++;
+      }
+    }
+
+    void* segment;
+    while (retired_segments_.Pop(&segment))
+      MappedFile::Unmap(segment, kSegmentBytes);
+
+    SleepUntilMicroseconds(MonotonicMicroseconds() +
+                           kMapperPeriodMicroseconds);
+  }
+}
+
+void* TrajectoryRecorder::MapSegment(int index) {
+  char* segment = static_cast<char*>(
+      file_.Map(static_cast<int64_t>(index) * kSegmentBytes, kSegmentBytes));
+  if (segment == NULL)
+    return NULL;
+  // Fault every page in now, rather than on the servo thread.
+  for (int i = 0; i < kSegmentBytes; i += kPageBytes)
+    static_cast<volatile char*>(segment)[i] = 0;
+  return segment;
+}
+
+std::string TrajectoryRecorder::PathForName(const std::string& name) {
+  if (name.empty() || name == "." || name == ".." ||
+      name.find_first_of("/\\:") != std::string::npos) {
+    return std::string();
+  }
+  const char* directory = getenv("HAPTICS_RECORD_DIR");
+  if (directory == NULL) {
+#if defined(_WIN32)
+    directory = getenv("TEMP");
+#else
+    directory = getenv("TMPDIR");
+#endif
+  }
+  std::string result = directory ? directory : "/tmp";
+  return result + "/" + name;
+}
+
+}  // namespace haptics
@@ -0,0 +1,136 @@
+// Copyright 2010 Mohamed Mansour. All rights reserved.
+// Use of this source code is governed by a GPL license that can
+// be found in the LICENSE file.
+
+#ifndef TRAJECTORY_RECORDER_H_
+#define TRAJECTORY_RECORDER_H_
+#pragma once
+
+#include <stdint.h>
+
+#include <string>
+
+#include "atomic_ops.h"
+#include "haptics_signal.h"
+#include "mapped_file.h"
+#include "platform_thread.h"
+#include "ring_buffer.h"
+
+namespace haptics {
+
+// A trajectory file is a sequence of 64 byte blocks in the byte order of the
+// machine: a TrajectoryHeader, the workspace of each device as a
+// TrajectoryWorkspace, then a TrajectoryRecord per device per servo tick.
+struct TrajectoryHeader {
+  // kTrajectoryMagic.
+  char magic[8];
+  int32_t version;
+  int32_t block_size;
+  // Number of TrajectoryRecords. Zero while recording, or if the recording
+  // was cut short, in which case the records run until the first one with
+  // a zero time.
+  int64_t record_count;
+  int32_t device_count;
+  char reserved[36];
+};
+
+struct TrajectoryWorkspace {
+  // minx, miny, minz, maxx, maxy, maxz.
+  double workspace[6];
+  char reserved[16];
+};
+
+// One device on one servo tick. Every device of a tick has the same time.
+struct TrajectoryRecord {
+  // MonotonicMicroseconds() of the tick.
+  int64_t time_us;
+  int32_t device;
+  int32_t button;
+  // As read from the device, before any workspace mapping.
+  double position[3];
+  // Total force the device was sent.
+  double force[3];
+};
+
+extern const char kTrajectoryMagic[8];
+enum {
+  kTrajectoryVersion = 1,
+  kTrajectoryBlockSize = 64
+};
+
+// Appends the servo ticks of every device to a trajectory file for as long
+// as it is open.
+//
+// The file is written through memory mappings of fixed size segments, so
+// recording is a copy into memory. A mapper thread keeps the next segment
+// mapped, and its pages touched, ahead of the servo thread and unmaps the
+// segments it is done with, so the servo thread never allocates, faults or
+// makes a syscall. A segment lasts minutes, the mapper wakes up every few
+// milliseconds.
+class TrajectoryRecorder {
+ public:
+  enum { kSegmentBytes = 16 << 20 };
+
+  HAPTICS_CACHE_ALIGNED_NEW
+
+  TrajectoryRecorder();
+  // Virtual like the mapper thread callback HAPTIC_CALLBACK declares.
+  virtual ~TrajectoryRecorder();
+
+  // Creates |path| for |device_count| devices with |workspaces|, 6 numbers
+  // per device, and starts the mapper thread.
+  bool Open(const std::string& path,
+            int device_count,
+            const double* workspaces);
+  // Finishes the file. The servo thread must be done calling Record().
+  void Close();
+
+  // Appends a record. Servo thread only, wait-free.
+  void Record(int64_t time_us,
+              int device,
+              bool button,
+              const double position[3],
+              const double force[3]);
+
+  // Records written and records lost because the mapper thread fell behind.
+  // record_count() is only up to date once closed.
+  int64_t record_count() const { return record_count_; }
+  int dropped_records() const { return AcquireLoad(&dropped_records_); }
+
+  // Where a recording called |name| goes: the HAPTICS_RECORD_DIR directory,
+  // or the temporary directory. Returns an empty string if |name| is not a
+  // plain file name.
+  static std::string PathForName(const std::string& name);
+
+ private:
+  enum { kSegmentBlocks = kSegmentBytes / kTrajectoryBlockSize };
+
+  HAPTIC_CALLBACK(TrajectoryRecorder, void, MapAhead);
+
+  // Maps the segment at |index| and touches every page of it.
+  void* MapSegment(int index);
+
+  MappedFile file_;
+  int device_count_;
+  PlatformThread mapper_;
+  volatile Atomic32 stop_requested_;
+
+  // Segment mapped by the mapper thread for the servo thread to take.
+  void* volatile spare_segment_;
+  // Segments the servo thread is done with, for the mapper thread to unmap.
+  RingBuffer<void*, 16> retired_segments_;
+  // Index of the segment the mapper thread maps next.
+  int next_segment_;
+
+  // Variables used only by servo thread
+  void* segment_;
+  TrajectoryRecord* cursor_;
+  TrajectoryRecord* end_;
+  int64_t record_count_;
+
+  HAPTICS_CACHE_ALIGNED volatile Atomic32 dropped_records_;
+};
+
+}  // namespace haptics
+
+#endif  // TRAJECTORY_RECORDER_H_
@@ -0,0 +1,346 @@
+// Copyright 2010 Mohamed Mansour. All rights reserved.
+// Use of this source code is governed by a GPL license that can
+// be found in the LICENSE file.
+
+#include "triangle_mesh.h"
+
+#include <math.h>
+
+#include <algorithm>
+
+namespace {
+
+// Triangles per leaf of the hierarchy.
+const int kLeafSize = 4;
+
+// Deep enough for any hierarchy built by median splits of up to 2^60
+// triangles.
+const int kMaxTraversalDepth = 64;
+
+// The proxy is kept this far above the surface (meters) so rounding never
+// lets it slip through.
+const double kSurfaceOffset = 1e-5;
+
+// Bounds the work per tick when the proxy keeps swapping between two
+// constraint planes in degenerate geometry.
+const int kMaxProxySteps = 6;
+
+inline double Dot(const double a[3], const double b[3]) {
+  return a[0] * b[0] + a[1] * b[1] + a[2] * b[2];
+}
+
+inline void Cross(const double a[3], const double b[3], double out[3]) {
+  out[0] = a[1] * b[2] - a[2] * b[1];
+  out[1] = a[2] * b[0] - a[0] * b[2];
+  out[2] = a[0] * b[1] - a[1] * b[0];
+}
+
+// Orders triangle indices by their centroid along one axis.
+struct CentroidLess {
+  CentroidLess(const std::vector<double>& centroids, int axis)
+      : centroids(centroids), axis(axis) {}
+  bool operator()(int a, int b) const {
+    return centroids[a * 3 + axis] < centroids[b * 3 + axis];
+  }
+  const std::vector<double>& centroids;
+  int axis;
+};
+
+// A constraint plane n.x = offset the proxy may not cross.
+struct Plane {
+  double normal[3];
+  double offset;
+};
+
+void ProjectOntoPlane(const double point[3], const Plane& plane,
+                      double out[3]) {
+  double distance = Dot(plane.normal, point) - plane.offset;
+  for (int i = 0; i < 3; i++)
+    out[i] = point[i] - distance * plane.normal[i];
+}
+
+// Closest point to |point| on the line where two planes meet. Returns false
+// if the planes are parallel.
+bool ProjectOntoLine(const double point[3], const Plane& a, const Plane& b,
+                     double out[3]) {
+  // Solve [na; nb; na x nb] out = [ca; cb; (na x nb).point] by Cramer's rule.
+  double direction[3];
+  Cross(a.normal, b.normal, direction);
+  double determinant = Dot(direction, direction);
+  if (determinant < 1e-12)
+    return false;
+
+  double along = Dot(direction, point);
+  double b_cross_d[3], d_cross_a[3];
+  Cross(b.normal, direction, b_cross_d);
+  Cross(direction, a.normal, d_cross_a);
+  for (int i = 0; i < 3; i++) {
+    out[i] = (a.offset * b_cross_d[i] + b.offset * d_cross_a[i] +
+              along * direction[i]) / determinant;
+  }
+  return true;
+}
+
+}  // namespace
+
+namespace haptics {
+
+TriangleMesh::TriangleMesh()
+    : stiffness_(0.0) {
+}
+
+bool TriangleMesh::Build(const std::vector<double>& vertices,
+                         const std::vector<double>& indices) {
+  if (vertices.size() % 3 != 0 || indices.size() % 3 != 0)
+    return false;
+
+  const int vertex_count = static_cast<int>(vertices.size() / 3);
+  const int triangle_count = static_cast<int>(indices.size() / 3);
+
+  std::vector<Triangle> triangles;
+  std::vector<double> centroids;
+  triangles.reserve(triangle_count);
+  centroids.reserve(triangle_count * 3);
+  for (int i = 0; i < triangle_count; i++) {
+    const double* corners[3];
+    for (int j = 0; j < 3; j++) {
+      double index = indices[i * 3 + j];
+      if (index < 0 || index >= vertex_count || index != floor(index))
+        return false;
+      corners[j] = &vertices[static_cast<int>(index) * 3];
+    }
+
+    Triangle triangle;
+    for (int k = 0; k < 3; k++) {
+      triangle.vertex[k] = corners[0][k];
+      triangle.edge1[k] = corners[1][k] - corners[0][k];
+      triangle.edge2[k] = corners[2][k] - corners[0][k];
+      centroids.push_back((corners[0][k] + corners[1][k] + corners[2][k]) / 3);
+    }
+    Cross(triangle.edge1, triangle.edge2, triangle.normal);
+    double length = sqrt(Dot(triangle.normal, triangle.normal));
+    if (length == 0.0) {
+      // Degenerate triangles can't be touched, drop them.
+      centroids.resize(centroids.size() - 3);
+      continue;
+    }
+    for (int k = 0; k < 3; k++)
+      triangle.normal[k] /= length;
+    triangles.push_back(triangle);
+  }
+
+  std::vector<int> order(triangles.size());
+  for (size_t i = 0; i < order.size(); i++)
+    order[i] = static_cast<int>(i);
+
+  nodes_.clear();
+  triangles_.clear();
+  if (triangles.empty())
+    return true;
+
+  nodes_.reserve(2 * triangles.size() / kLeafSize + 1);
+  triangles_.reserve(triangles.size());
+  BuildNode(&order, centroids, triangles, 0, static_cast<int>(order.size()));
+  return true;
+}
+
+int TriangleMesh::BuildNode(std::vector<int>* order,
+                            const std::vector<double>& centroids,
+                            const std::vector<Triangle>& triangles,
+                            int begin,
+                            int end) {
+  int index = static_cast<int>(nodes_.size());
+  nodes_.push_back(Node());
+
+  // Bounds of the triangles and of their centroids.
+  Node node;
+  double centroid_min[3], centroid_max[3];
+  for (int k = 0; k < 3; k++) {
+    node.min[k] = centroid_min[k] = HUGE_VAL;
+    node.max[k] = centroid_max[k] = -HUGE_VAL;
+  }
+  for (int i = begin; i < end; i++) {
+    int t = (*order)[i];
+    const Triangle& triangle = triangles[t];
+    for (int k = 0; k < 3; k++) {
+      double a = triangle.vertex[k];
+      double b = a + triangle.edge1[k];
+      double c = a + triangle.edge2[k];
+      node.min[k] = std::min(node.min[k], std::min(a, std::min(b, c)));
+      node.max[k] = std::max(node.max[k], std::max(a, std::max(b, c)));
+      centroid_min[k] = std::min(centroid_min[k], centroids[t * 3 + k]);
+      centroid_max[k] = std::max(centroid_max[k], centroids[t * 3 + k]);
+    }
+  }
+
+  if (end - begin <= kLeafSize) {
+    node.first = static_cast<int>(triangles_.size());
+    node.count = end - begin;
+    node.right = -1;
+    for (int i = begin; i < end; i++)
+      triangles_.push_back(triangles[(*order)[i]]);
+    nodes_[index] = node;
+    return index;
+  }
+
+  // Split at the median along the axis the centroids spread the most.
+  int axis = 0;
+  for (int k = 1; k < 3; k++) {
+    if (centroid_max[k] - centroid_min[k] >
+        centroid_max[axis] - centroid_min[axis]) {
+      axis = k;
+    }
+  }
+  int middle = begin + (end - begin) / 2;
+  std::nth_element(order->begin() + begin, order->begin() + middle,
+                   order->begin() + end, CentroidLess(centroids, axis));
+
+  node.first = 0;
+  node.count = 0;
+  BuildNode(order, centroids, triangles, begin, middle);
+  node.right = BuildNode(order, centroids, triangles, middle, end);
+  nodes_[index] = node;
+  return index;
+}
+
+bool TriangleMesh::IntersectSegment(const double from[3],
+                                    const double to[3],
+                                    double* t,
+                                    double normal[3]) const {
+  if (nodes_.empty())
+    return false;
+
+  double direction[3] = { to[0] - from[0], to[1] - from[1], to[2] - from[2] };
+  double best_t = 1.0;
+  const Triangle* best = NULL;
+
+  int stack[kMaxTraversalDepth];
+  int stack_size = 0;
+  stack[stack_size++] = 0;
+  while (stack_size > 0) {
+    const Node& node = nodes_[stack[--stack_size]];
+
+    // Slab test of the segment, clipped to the closest hit so far, against
+    // the bounds of the node.
+    double enter = 0.0;
+    double exit = best_t;
+    bool missed = false;
+    for (int k = 0; k < 3 && !missed; k++) {
+      if (direction[k] == 0.0) {
+        missed = from[k] < node.min[k] || from[k] > node.max[k];
+        continue;
+      }
+      double inverse = 1.0 / direction[k];
+      double near_t = (node.min[k] - from[k]) * inverse;
+      double far_t = (node.max[k] - from[k]) * inverse;
+      if (near_t > far_t)
+        std::swap(near_t, far_t);
+      enter = std::max(enter, near_t);
+      exit = std::min(exit, far_t);
+      missed = enter > exit;
+    }
+    if (missed)
+      continue;
+
+    if (node.count == 0) {
+      int left = static_cast<int>(&node - &nodes_[0]) + 1;
+      if (stack_size + 2 > kMaxTraversalDepth)
+        continue;
+      stack[stack_size++] = node.right;
+      stack[stack_size++] = left;
+      continue;
+    }
+
+    for (int i = node.first; i < node.first + node.count; i++) {
+      const Triangle& triangle = triangles_[i];
+      double p[3];
+      Cross(direction, triangle.edge2, p);
+      double determinant = Dot(triangle.edge1, p);
+      if (determinant > -1e-18 && determinant < 1e-18)
+        continue;  // Parallel to the triangle.
+      double inverse = 1.0 / determinant;
+      double s[3] = { from[0] - triangle.vertex[0],
+                      from[1] - triangle.vertex[1],
+                      from[2] - triangle.vertex[2] };
+      double u = Dot(s, p) * inverse;
+      if (u < 0.0 || u > 1.0)
+        continue;
+      double q[3];
+      Cross(s, triangle.edge1, q);
+      double v = Dot(direction, q) * inverse;
+      if (v < 0.0 || u + v > 1.0)
+        continue;
+      double hit_t = Dot(triangle.edge2, q) * inverse;
+      if (hit_t < 0.0 || hit_t > best_t)
+        continue;
+      best_t = hit_t;
+      best = &triangle;
+    }
+  }
+
+  if (best == NULL)
+    return false;
+
+  *t = best_t;
+  double facing = Dot(best->normal, direction) > 0.0 ? -1.0 : 1.0;
+  for (int k = 0; k < 3; k++)
+    normal[k] = facing * best->normal[k];
+  return true;
+}
+
+GodObject::GodObject() {
+  proxy_[0] = proxy_[1] = proxy_[2] = 0.0;
+}
+
+void GodObject::Reset(const double tool[3]) {
+  for (int k = 0; k < 3; k++)
+    proxy_[k] = tool[k];
+}
+
+void GodObject::Update(const TriangleMesh& mesh, const double tool[3]) {
+  // Every tick the proxy heads straight for the tool. Each surface it runs
+  // into becomes a constraint plane and the goal is moved to the closest
+  // point to the tool that respects all of them: on a face the proxy slides
+  // along it, in a crease along the edge, in a corner it stops.
+  Plane planes[3];
+  int plane_count = 0;
+  double goal[3] = { tool[0], tool[1], tool[2] };
+
+  for (int step = 0; step < kMaxProxySteps && plane_count < 3; step++) {
+    double t;
+    double normal[3];
+    if (!mesh.IntersectSegment(proxy_, goal, &t, normal)) {
+      Reset(goal);
+      return;
+    }
+
+    double hit[3];
+    for (int k = 0; k < 3; k++) {
+      hit[k] = proxy_[k] + t * (goal[k] - proxy_[k]);
+      proxy_[k] = hit[k] + kSurfaceOffset * normal[k];
+    }
+
+    Plane& plane = planes[plane_count++];
+    for (int k = 0; k < 3; k++)
+      plane.normal[k] = normal[k];
+    plane.offset = Dot(normal, proxy_);
+
+    if (plane_count == 1) {
+      ProjectOntoPlane(tool, plane, goal);
+    } else if (plane_count == 2) {
+      // The first plane only matters if sliding along the second one alone
+      // would take the proxy back through it.
+      ProjectOntoPlane(tool, planes[1], goal);
+      if (Dot(planes[0].normal, goal) >= planes[0].offset) {
+        planes[0] = planes[1];
+        plane_count = 1;
+      } else if (!ProjectOntoLine(tool, planes[0], planes[1], goal)) {
+        planes[0] = planes[1];
+        plane_count = 1;
+      }
+    }
+  }
+  // Three constraints pin the proxy where it is.
+}
+
+}  // namespace haptics
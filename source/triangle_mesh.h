@@ -0,0 +1,95 @@
+// Copyright 2010 Mohamed Mansour. All rights reserved.
+// Use of this source code is governed by a GPL license that can
+// be found in the LICENSE file.
+
+#ifndef TRIANGLE_MESH_H_
+#define TRIANGLE_MESH_H_
+#pragma once
+
+#include <vector>
+
+namespace haptics {
+
+// Touchable triangle mesh with a bounding volume hierarchy, so the servo
+// thread can find the triangles near the tool in logarithmic time. Built once
+// on the application thread and only read by the servo thread afterwards.
+class TriangleMesh {
+ public:
+  TriangleMesh();
+
+  // Builds the mesh from xyz vertex coordinates and triples of vertex
+  // indices. Returns false if the data is malformed.
+  bool Build(const std::vector<double>& vertices,
+             const std::vector<double>& indices);
+
+  bool empty() const { return triangles_.empty(); }
+  int triangle_count() const { return static_cast<int>(triangles_.size()); }
+
+  // N/m.
+  double stiffness() const { return stiffness_; }
+  void set_stiffness(double stiffness) { stiffness_ = stiffness; }
+
+  // Finds the first triangle crossed by the segment from |from| to |to|.
+  // Returns false if there is none. Otherwise |*t| is the fraction of the
+  // segment before the hit and |normal| is the unit triangle normal, turned
+  // to face |from|.
+  bool IntersectSegment(const double from[3],
+                        const double to[3],
+                        double* t,
+                        double normal[3]) const;
+
+ private:
+  // Precomputed for the Moller-Trumbore intersection test.
+  struct Triangle {
+    double vertex[3];
+    double edge1[3];
+    double edge2[3];
+    double normal[3];
+  };
+
+  // Nodes are stored depth first: the left child of an interior node
+  // directly follows it, |right| is the index of the right child. Leaves
+  // have |count| > 0 and cover triangles_[first, first + count).
+  struct Node {
+    double min[3];
+    double max[3];
+    int first;
+    int count;
+    int right;
+  };
+
+  // Recursively builds the node for |order|[begin, end) and returns its
+  // index.
+  int BuildNode(std::vector<int>* order,
+                const std::vector<double>& centroids,
+                const std::vector<Triangle>& triangles,
+                int begin,
+                int end);
+
+  std::vector<Triangle> triangles_;
+  std::vector<Node> nodes_;
+  double stiffness_;
+};
+
+// Proxy point that stays on the surface of a mesh while the tool sinks into
+// it, after Zilles and Salisbury's god-object. The force is a spring from the
+// tool to the proxy. Lives on the servo thread.
+class GodObject {
+ public:
+  GodObject();
+
+  // Puts the proxy on the tool, e.g. when the mesh changes.
+  void Reset(const double tool[3]);
+
+  // Moves the proxy as close to |tool| as the surface of |mesh| allows.
+  void Update(const TriangleMesh& mesh, const double tool[3]);
+
+  const double* position() const { return proxy_; }
+
+ private:
+  double proxy_[3];
+};
+
+}  // namespace haptics
+
+#endif  // TRIANGLE_MESH_H_
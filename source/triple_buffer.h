@@ -0,0 +1,87 @@
+// Copyright 2010 Mohamed Mansour. All rights reserved.
+// Use of this source code is governed by a GPL license that can
+// be found in the LICENSE file.
+
+#ifndef TRIPLE_BUFFER_H_
+#define TRIPLE_BUFFER_H_
+#pragma once
+
+#include "atomic_ops.h"
+
+namespace haptics {
+
+// Wait-free single writer, single reader channel that always hands the reader
+// the most recent complete value the writer published.
+//
+// Three copies of |T| exist at any time: the writer owns the back slot, the
+// reader owns the front slot and the middle slot is in transit. Publishing
+// swaps back and middle, updating swaps front and middle, so neither side ever
+// touches a slot the other one is using and neither side ever waits. Values
+// published faster than the reader updates are silently replaced by newer
+// ones, which is exactly what we want for device state.
+//
+// The writer thread may only call write_buffer() and Publish(), the reader
+// thread may only call Update() and read_buffer().
+template <typename T>
+class TripleBuffer {
+ public:
+  TripleBuffer() : middle_(1), back_(2), front_(0) {
+    slots_[0].value = T();
+    slots_[1].value = T();
+    slots_[2].value = T();
+  }
+
+  // The slot the writer fills before calling Publish(). Its contents are
+  // undefined after a publish, so the writer should rewrite it completely.
+  T* write_buffer() { return &slots_[back_].value; }
+
+  // Makes the contents of write_buffer() visible to the reader.
+  void Publish() {
+    Atomic32 previous = AtomicExchange(&middle_, back_ | kDirtyBit);
+    back_ = previous & kIndexMask;
+  }
+
+  // Pulls the latest published value into read_buffer(). Returns false if
+  // nothing was published since the last update.
+  bool Update() {
+    if (!(AcquireLoad(&middle_) & kDirtyBit))
+      return false;
+    Atomic32 previous = AtomicExchange(&middle_, front_);
+    front_ = previous & kIndexMask;
+    return true;
+  }
+
+  // The value the reader obtained in the last successful Update().
+  const T& read_buffer() const { return slots_[front_].value; }
+
+ private:
+  enum {
+    kIndexMask = 0x3,
+    kDirtyBit = 0x4
+  };
+
+  // Each slot lives on its own cache line(s) so the writer filling the back
+  // slot never invalidates the line the reader is copying from.
+  struct HAPTICS_CACHE_ALIGNED Slot {
+    T value;
+  };
+
+  Slot slots_[3];
+
+  // Index of the slot in transit, with kDirtyBit set when it holds a value
+  // the reader has not picked up yet. The only shared word.
+  HAPTICS_CACHE_ALIGNED volatile Atomic32 middle_;
+
+  // Touched only by the writer.
+  HAPTICS_CACHE_ALIGNED Atomic32 back_;
+
+  // Touched only by the reader.
+  HAPTICS_CACHE_ALIGNED Atomic32 front_;
+
+  TripleBuffer(const TripleBuffer&);
+  void operator=(const TripleBuffer&);
+};
+
+}  // namespace haptics
+
+#endif  // TRIPLE_BUFFER_H_
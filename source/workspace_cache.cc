@@ -0,0 +1,126 @@
+// Copyright 2010 Mohamed Mansour. All rights reserved.
+// Use of this source code is governed by a GPL license that can
+// be found in the LICENSE file.
+
+#include "workspace_cache.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace haptics {
+
+namespace {
+
+// First line of the file. Files without it keyed workspaces by port.
+const char kVersionLine[] = "haptics-workspace-cache 2\n";
+
+}  // namespace
+
+WorkspaceCache::WorkspaceCache(const std::string& path)
+    : path_(path),
+      dirty_(false) {
+}
+
+// static
+std::string WorkspaceCache::DefaultPath() {
+  const char* path = getenv("HAPTICS_WORKSPACE_CACHE");
+  if (path)
+    return path;
+#if defined(_WIN32)
+  const char* directory = getenv("TEMP");
+#else
+  const char* directory = getenv("TMPDIR");
+#endif
+  std::string result = directory ? directory : "/tmp";
+  return result + "/haptics_workspace.txt";
+}
+
+void WorkspaceCache::Load() {
+  entries_.clear();
+  dirty_ = false;
+
+  FILE* file = fopen(path_.c_str(), "r");
+  if (!file)
+    return;
+
+  char line[512];
+  if (fgets(line, sizeof(line), file) && strcmp(line, kVersionLine) == 0) {
+    while (fgets(line, sizeof(line), file)) {
+      Entry entry;
+      int name_start = -1;
+      if (sscanf(line, "%lf %lf %lf %lf %lf %lf %n",
+                 &entry.workspace[0], &entry.workspace[1],
+                 &entry.workspace[2], &entry.workspace[3],
+                 &entry.workspace[4], &entry.workspace[5],
+                 &name_start) != 6 || name_start < 0) {
+        continue;
+      }
+      entry.model = line + name_start;
+      size_t end = entry.model.find_last_not_of("\r\n");
+      entry.model.erase(end == std::string::npos ? 0 : end + 1);
+      if (Find(entry.model) < 0)
+        entries_.push_back(entry);
+    }
+  }
+  fclose(file);
+}
+
+bool WorkspaceCache::Save() {
+  if (!dirty_)
+    return true;
+
+  FILE* file = fopen(path_.c_str(), "w");
+  if (!file)
+    return false;
+  fputs(kVersionLine, file);
+  for (size_t i = 0; i < entries_.size(); i++) {
+    const double* workspace = entries_[i].workspace;
+    fprintf(file, "%.17g %.17g %.17g %.17g %.17g %.17g %s\n",
+            workspace[0], workspace[1], workspace[2],
+            workspace[3], workspace[4], workspace[5],
+            entries_[i].model.c_str());
+  }
+  bool written = fclose(file) == 0;
+  dirty_ = !written;
+  return written;
+}
+
+bool WorkspaceCache::Lookup(const std::string& model,
+                            double workspace[6]) const {
+  int index = Find(model);
+  if (index < 0)
+    return false;
+  for (int i = 0; i < 6; i++)
+    workspace[i] = entries_[index].workspace[i];
+  return true;
+}
+
+void WorkspaceCache::Store(const std::string& model,
+                           const double workspace[6]) {
+  // Names that would not read back are not kept.
+  if (model.empty() || model[0] == ' ' || model[0] == '\t' ||
+      model.find_first_of("\r\n") != std::string::npos) {
+    return;
+  }
+  int index = Find(model);
+  if (index < 0) {
+    Entry entry;
+    entry.model = model;
+    entries_.push_back(entry);
+    index = static_cast<int>(entries_.size()) - 1;
+  }
+  for (int i = 0; i < 6; i++)
+    entries_[index].workspace[i] = workspace[i];
+  dirty_ = true;
+}
+
+int WorkspaceCache::Find(const std::string& model) const {
+  for (size_t i = 0; i < entries_.size(); i++) {
+    if (entries_[i].model == model)
+      return static_cast<int>(i);
+  }
+  return -1;
+}
+
+}  // namespace haptics
@@ -0,0 +1,56 @@
+// Copyright 2010 Mohamed Mansour. All rights reserved.
+// Use of this source code is governed by a GPL license that can
+// be found in the LICENSE file.
+
+#ifndef WORKSPACE_CACHE_H_
+#define WORKSPACE_CACHE_H_
+#pragma once
+
+#include <string>
+#include <vector>
+
+namespace haptics {
+
+// Device workspaces remembered across browser sessions, so a warm start
+// does not have to query every device before the servo loop can run. The
+// workspace is a property of the device model, so entries are keyed by the
+// model name the driver reports rather than by the port a device is on, and
+// swapping devices around cannot hand one the workspace of another. After
+// a version line, the file holds one line per model with minx, miny, minz,
+// maxx, maxy, maxz and the model name.
+class WorkspaceCache {
+ public:
+  explicit WorkspaceCache(const std::string& path);
+
+  // The path in HAPTICS_WORKSPACE_CACHE, or haptics_workspace.txt in the
+  // temporary directory.
+  static std::string DefaultPath();
+
+  // Reads the file. A missing or malformed file, or one from another
+  // version, leaves every model unknown.
+  void Load();
+  // Writes the file back if Store() changed anything. Returns false if it
+  // could not be written.
+  bool Save();
+
+  // Returns false if the workspace of |model| is unknown.
+  bool Lookup(const std::string& model, double workspace[6]) const;
+  void Store(const std::string& model, const double workspace[6]);
+
+ private:
+  struct Entry {
+    std::string model;
+    double workspace[6];
+  };
+
+  // Index of |model| in |entries_|, or -1.
+  int Find(const std::string& model) const;
+
+  std::string path_;
+  std::vector<Entry> entries_;
+  bool dirty_;
+};
+
+}  // namespace haptics
+
+#endif  // WORKSPACE_CACHE_H_